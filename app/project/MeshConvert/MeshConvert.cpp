@@ -0,0 +1,60 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "graphics/Mesh.h"
+#include "string/String.h"
+
+using namespace Viry3D;
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        printf("Usage:\n");
+        printf("\tMeshConvert.exe input.mesh output.mesh [-nohalf]\n");
+        printf("\t-nohalf: store blend weights as float, for gles targets without half float vertex attributes\n");
+        return 0;
+    }
+
+    String input = argv[1];
+    String output = argv[2];
+    bool half_float = !(argc == 4 && String(argv[3]) == "-nohalf");
+
+    Ref<Mesh::FileData> data = Mesh::ReadFile(input);
+    if (!data)
+    {
+        printf("read mesh failed: %s\n", input.CString());
+        return 1;
+    }
+
+    if (data->file)
+    {
+        printf("mesh is already converted: %s\n", input.CString());
+        return 1;
+    }
+
+    // .mesh content is parsed into memory and the input is closed, so output may be the same path
+    if (!Mesh::WriteBinaryFile(output, data, half_float))
+    {
+        printf("write mesh failed: %s\n", output.CString());
+        return 1;
+    }
+
+    printf("converted %s: %d vertices, %d indices\n", output.CString(), data->vertices.Size(), data->indices.Size());
+
+    return 0;
+}
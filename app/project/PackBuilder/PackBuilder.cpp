@@ -0,0 +1,53 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "io/AssetPack.h"
+#include "string/String.h"
+
+using namespace Viry3D;
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        printf("Usage:\n");
+        printf("\tPackBuilder.exe input_directory output.pak [-compress]\n");
+        printf("\t-compress: zlib compress entries which shrink by more than an eighth\n");
+        return 0;
+    }
+
+    String input = argv[1];
+    String output = argv[2];
+    bool compress = argc == 4 && String(argv[3]) == "-compress";
+
+    if (!AssetPack::Build(input, output, compress))
+    {
+        printf("build pack failed: %s\n", output.CString());
+        return 1;
+    }
+
+    Ref<AssetPack> pack = AssetPack::Open(output);
+    if (!pack)
+    {
+        printf("open pack failed: %s\n", output.CString());
+        return 1;
+    }
+
+    printf("packed %d files into %s\n", pack->GetEntryCount(), output.CString());
+
+    return 0;
+}
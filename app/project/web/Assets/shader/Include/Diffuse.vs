@@ -45,11 +45,15 @@ UniformBuffer(0, 0) uniform UniformBuffer00
 } buf_0_0;
 
 #if (SKINNED_MESH == 1)
-    #define BONE_VECTOR_MAX 210
+    // bones of all skinned meshes, 3 row vectors per bone
+    StorageBuffer(0, 5) readonly buffer BonePalette
+    {
+        vec4 u_bone_palette[];
+    };
 
     UniformBuffer(1, 0) uniform UniformBuffer10
     {
-	    vec4 u_bones[BONE_VECTOR_MAX];
+        int u_bone_offset;
     } buf_1_0;
 
     Input(6) vec4 a_bone_weights;
@@ -93,7 +97,7 @@ void main()
 {
 #if (SKINNED_MESH == 1)
     mat4 model_mat;
-    SKIN_MAT(model_mat, a_bone_weights, a_bone_indices, buf_1_0.u_bones);
+    SKIN_MAT_OFFSET(model_mat, a_bone_weights, a_bone_indices, u_bone_palette, buf_1_0.u_bone_offset);
 #else
     mat4 model_mat = buf_1_0.u_model_matrix;
 #endif
@@ -1,4 +1,4 @@
-#define SKIN_MAT(skin_mat, blend_weight, blend_indices, bones)                                          \
+#define SKIN_MAT_OFFSET(skin_mat, blend_weight, blend_indices, bones, offset)                                        \
 {						                                                                                \
     int index_0 = int(blend_indices.x);																	\
     int index_1 = int(blend_indices.y);                         										\
@@ -10,9 +10,11 @@
     float weights_2 = blend_weight.z;                           										\
     float weights_3 = blend_weight.w;                           										\
                                                                 										\
-	mat4 bone_0 = mat4(bones[index_0*3], bones[index_0*3+1], bones[index_0*3+2], vec4(0, 0, 0, 1));		\
-	mat4 bone_1 = mat4(bones[index_1*3], bones[index_1*3+1], bones[index_1*3+2], vec4(0, 0, 0, 1));     \
-	mat4 bone_2 = mat4(bones[index_2*3], bones[index_2*3+1], bones[index_2*3+2], vec4(0, 0, 0, 1));     \
-	mat4 bone_3 = mat4(bones[index_3*3], bones[index_3*3+1], bones[index_3*3+2], vec4(0, 0, 0, 1));     \
+	mat4 bone_0 = mat4(bones[offset+index_0*3], bones[offset+index_0*3+1], bones[offset+index_0*3+2], vec4(0, 0, 0, 1));		\
+	mat4 bone_1 = mat4(bones[offset+index_1*3], bones[offset+index_1*3+1], bones[offset+index_1*3+2], vec4(0, 0, 0, 1));     \
+	mat4 bone_2 = mat4(bones[offset+index_2*3], bones[offset+index_2*3+1], bones[offset+index_2*3+2], vec4(0, 0, 0, 1));     \
+	mat4 bone_3 = mat4(bones[offset+index_3*3], bones[offset+index_3*3+1], bones[offset+index_3*3+2], vec4(0, 0, 0, 1));     \
 	skin_mat = bone_0 * weights_0 + bone_1 * weights_1 + bone_2 * weights_2 + bone_3 * weights_3;       \
 }
+
+#define SKIN_MAT(skin_mat, blend_weight, blend_indices, bones) SKIN_MAT_OFFSET(skin_mat, blend_weight, blend_indices, bones, 0)
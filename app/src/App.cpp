@@ -18,6 +18,7 @@
 #include "App.h"
 #include "Demo/DemoMesh.h"
 #include "Demo/DemoSkinnedMesh.h"
+#include "Demo/DemoAnimationCrowd.h"
 #include "Demo/DemoSkybox.h"
 #include "Demo/DemoRenderToTexture.h"
 #include "Demo/DemoFXAA.h"
@@ -102,6 +103,7 @@ namespace Viry3D
             m_demo_entries = {
                 { "Mesh", [this]() { m_demo = new DemoMesh(); } },
                 { "SkinnedMesh", [this]() { m_demo = new DemoSkinnedMesh(); } },
+                { "AnimationCrowd", [this]() { m_demo = new DemoAnimationCrowd(); } },
                 { "ShadowMap", [this]() { m_demo = new DemoShadowMap(); } },
                 { "Skybox", [this]() { m_demo = new DemoSkybox(); } },
                 { "RenderToTexture", [this]() { m_demo = new DemoRenderToTexture(); } },
@@ -0,0 +1,167 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include "DemoMesh.h"
+#include "Resources.h"
+#include "graphics/SkinnedMeshRenderer.h"
+#include "animation/Animation.h"
+#include "Input.h"
+
+namespace Viry3D
+{
+    // animation update benchmark, touch to switch between serial and job system update
+    class DemoAnimationCrowd : public DemoMesh
+    {
+    public:
+        const int m_crowd_width = 16;
+        const int m_crowd_depth = 32;
+        const float m_crowd_space = 1.2f;
+        Vector<Ref<Animation>> m_anims;
+        bool m_parallel = true;
+        float m_update_time = 0;
+
+        void InitCrowd()
+        {
+            // pre cache shader
+            RenderState render_state;
+
+#if VR_VULKAN
+            auto shader = RefMake<Shader>(
+                "#define SKINNED_MESH 1",
+                Vector<String>({ "Skin.vs", "Diffuse.vs" }),
+                "",
+                "",
+                Vector<String>({ "Diffuse.fs" }),
+                "",
+                render_state);
+#elif VR_GLES
+            auto shader = RefMake<Shader>(
+                "#define SKINNED_MESH 1",
+                Vector<String>({ "Diffuse.100.vs" }),
+                "",
+                "",
+                Vector<String>({ "Diffuse.100.fs" }),
+                "",
+                render_state);
+#endif
+
+            Shader::AddCache("SkinnedMesh/Diffuse", shader);
+
+            // clips are compressed once, the other soldiers share them
+            Vector<AnimationClip> clips;
+
+            for (int i = 0; i < m_crowd_depth; ++i)
+            {
+                for (int j = 0; j < m_crowd_width; ++j)
+                {
+                    auto anim = RefCast<Animation>(Resources::LoadNode("res/model/ToonSoldier 1/ToonSoldier 1.go"));
+                    if (clips.Empty())
+                    {
+                        anim->CompressClips();
+                        clips = anim->GetClips();
+                    }
+                    else
+                    {
+                        anim->SetClips(Vector<AnimationClip>(clips));
+                    }
+
+                    auto skin = RefCast<SkinnedMeshRenderer>(anim->Find("MESH_Infantry"));
+                    skin->GetMaterial()->SetLightProperties(m_light);
+
+                    m_camera->AddRenderer(skin);
+                    m_renderers.Add(skin);
+
+                    float x = (j - (m_crowd_width - 1) * 0.5f) * m_crowd_space;
+                    float z = i * m_crowd_space;
+                    anim->SetLocalPosition(Vector3(x, 0, z));
+                    anim->SetLocalRotation(Quaternion::Euler(0, 180, 0));
+
+                    // spread the clips over the crowd
+                    if (anim->GetClipCount() > 0)
+                    {
+                        anim->Play((i * m_crowd_width + j) % anim->GetClipCount(), 0);
+                    }
+
+                    m_anims.Add(anim);
+                }
+            }
+        }
+
+        virtual void Init()
+        {
+            m_camera_param.pos = Vector3(0, 12, -10);
+            m_camera_param.rot = Vector3(40, 0, 0);
+
+            DemoMesh::Init();
+
+            this->InitCrowd();
+
+            m_label->SetSize(Vector2i(600, 60));
+        }
+
+        virtual void Done()
+        {
+            m_anims.Clear();
+
+            Shader::RemoveCache("SkinnedMesh/Diffuse");
+
+            DemoMesh::Done();
+        }
+
+        virtual void Update()
+        {
+            if (Input::GetTouchCount() > 0)
+            {
+                const Touch& touch = Input::GetTouch(0);
+                if (touch.phase == TouchPhase::Began)
+                {
+                    m_parallel = !m_parallel;
+                }
+            }
+
+            float start_time = Time::GetRealTimeSinceStartup();
+
+            if (m_parallel)
+            {
+                Animation::UpdateAll(m_anims);
+            }
+            else
+            {
+                for (int i = 0; i < m_anims.Size(); ++i)
+                {
+                    m_anims[i]->Update();
+                }
+            }
+
+            // smooth the time to keep the label readable
+            float update_time = (Time::GetRealTimeSinceStartup() - start_time) * 1000;
+            m_update_time = Mathf::Lerp(m_update_time, update_time, 0.1f);
+
+            if (m_label)
+            {
+                m_label->SetText(String::Format("FPS:%d\nAnimations:%d %s %.2fms",
+                    Time::GetFPS(),
+                    m_anims.Size(),
+                    m_parallel ? "parallel" : "serial",
+                    m_update_time));
+            }
+        }
+    };
+}
@@ -83,6 +83,7 @@ namespace Viry3D
             render_state.cull = RenderState::Cull::Front;
 
 #if VR_VULKAN
+            // skinned meshes are skinned once by compute and cast shadows as plain meshes
             auto shader = RefMake<Shader>(
                 "#define CAST_SHADOW 1",
                 Vector<String>({ "Diffuse.vs" }),
@@ -91,15 +92,7 @@ namespace Viry3D
                 Vector<String>({ "Diffuse.fs" }),
                 "",
                 render_state);
-            auto skin_shader = RefMake<Shader>(
-                "#define CAST_SHADOW 1\n"
-                "#define SKINNED_MESH 1",
-                Vector<String>({ "Skin.vs", "Diffuse.vs" }),
-                "",
-                "#define CAST_SHADOW 1",
-                Vector<String>({ "Diffuse.fs" }),
-                "",
-                render_state);
+            auto skin_shader = shader;
 #elif VR_GLES
             auto shader = RefMake<Shader>(
                 "#define CAST_SHADOW 1",
@@ -132,19 +125,28 @@ namespace Viry3D
                 Ref<SkinnedMeshRenderer> skin = RefCast<SkinnedMeshRenderer>(m_renderers[i]);
                 if (skin)
                 {
+#if VR_VULKAN
+                    skin->SetComputeSkinning(true);
+
+                    shadow_mesh = RefMake<MeshRenderer>();
+                    shadow_mesh->SetMaterial(skin_material);
+                    shadow_mesh->SetMesh(skin->GetSkinnedMesh());
+#elif VR_GLES
                     Ref<SkinnedMeshRenderer> shadow_skin = RefMake<SkinnedMeshRenderer>();
                     shadow_skin->SetBonePaths(skin->GetBonePaths());
                     shadow_skin->SetBonesRoot(skin->GetBonesRoot());
                     shadow_mesh = shadow_skin;
                     shadow_mesh->SetMaterial(skin_material);
+                    shadow_mesh->SetMesh(m_renderers[i]->GetMesh());
+#endif
                 }
                 else
                 {
                     shadow_mesh = RefMake<MeshRenderer>();
                     shadow_mesh->SetMaterial(material);
+                    shadow_mesh->SetMesh(m_renderers[i]->GetMesh());
                 }
                 
-                shadow_mesh->SetMesh(m_renderers[i]->GetMesh());
                 shadow_mesh->SetLocalPosition(m_renderers[i]->GetPosition());
                 shadow_mesh->SetLocalRotation(m_renderers[i]->GetRotation());
                 shadow_mesh->SetLocalScale(m_renderers[i]->GetScale());
@@ -169,15 +171,8 @@ namespace Viry3D
                 Vector<String>({ "Shadow.fs", "Diffuse.fs" }),
                 "",
                 render_state);
-            auto skin_shader = RefMake<Shader>(
-                "#define RECIEVE_SHADOW 1\n"
-                "#define SKINNED_MESH 1",
-                Vector<String>({ "Skin.vs", "Diffuse.vs" }),
-                "",
-                "#define RECIEVE_SHADOW 1",
-                Vector<String>({ "Shadow.fs", "Diffuse.fs" }),
-                "",
-                render_state);
+            // compute skinned in InitShadowCaster
+            auto skin_shader = shader;
 #elif VR_GLES
             auto shader = RefMake<Shader>(
                 "#define RECIEVE_SHADOW 1",
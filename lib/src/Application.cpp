@@ -19,10 +19,12 @@
 #include "Input.h"
 #include "container/List.h"
 #include "thread/ThreadPool.h"
+#include "thread/JobSystem.h"
 #include "time/Time.h"
 #include "graphics/Display.h"
 #include "graphics/Shader.h"
 #include "graphics/Texture.h"
+#include "graphics/BonePalette.h"
 #include "ui/Font.h"
 #include "audio/AudioManager.h"
 #include "Debug.h"
@@ -50,6 +52,7 @@ namespace Viry3D
         Mutex m_mutex;
         bool m_quit;
         Ref<ThreadPool> m_thread_pool;
+        Ref<JobSystem> m_job_system;
 #if VR_GLES
         Ref<ThreadPool> m_resource_thread_pool;
 #endif
@@ -58,6 +61,7 @@ namespace Viry3D
             m_quit(false)
         {
             m_app = app;
+            m_job_system = RefMake<JobSystem>(JobSystem::GetHardwareWorkerCount());
 #if !VR_WASM
             m_thread_pool = RefMake<ThreadPool>(8);
 #if VR_GLES
@@ -78,9 +82,13 @@ namespace Viry3D
         {
             AudioManager::Done();
             Font::Done();
+#if VR_VULKAN
+            BonePalette::Done();
+#endif
 			Texture::Done();
 			Shader::Done();
             m_thread_pool.reset();
+            m_job_system.reset();
 #if VR_GLES
             m_resource_thread_pool.reset();
 #endif
@@ -252,6 +260,11 @@ void Application::SetSavePath(const String& path)
         return m_private->m_thread_pool.get();
     }
 
+    JobSystem* Application::GetJobSystem() const
+    {
+        return m_private->m_job_system.get();
+    }
+
 #if VR_GLES
     ThreadPool* Application::GetResourceThreadPool() const
     {
@@ -268,16 +281,19 @@ void Application::SetSavePath(const String& path)
 
     void Application::ProcessActions()
     {
+        // run outside the lock, so actions can post new actions
+        List<Action> actions;
         m_private->m_mutex.lock();
-        for (const auto& action : m_private->m_actions)
+        std::swap(actions, m_private->m_actions);
+        m_private->m_mutex.unlock();
+
+        for (const auto& action : actions)
         {
             if (action)
             {
                 action();
             }
         }
-        m_private->m_actions.Clear();
-        m_private->m_mutex.unlock();
     }
 
     void Application::OnFrameBegin()
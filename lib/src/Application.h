@@ -25,6 +25,7 @@
 namespace Viry3D
 {
     class ApplicationPrivate;
+    class JobSystem;
 
     class Application
     {
@@ -43,6 +44,7 @@ namespace Viry3D
         void SetSavePath(const String& path);
 #endif
         ThreadPool* GetThreadPool() const;
+        JobSystem* GetJobSystem() const;
 #if VR_GLES
         ThreadPool* GetResourceThreadPool() const;
 #endif
@@ -16,73 +16,60 @@
 */
 
 #include "Node.h"
+#include "TransformHierarchy.h"
 
 namespace Viry3D
 {
     Node::Node():
-        m_local_position(0, 0, 0),
-        m_local_rotation(Quaternion::Identity()),
-        m_local_scale(1, 1, 1),
-        m_matrix_dirty(true),
-        m_notify_children_on_matrix_dirty(true)
+        m_transform(TransformHierarchy::Create(this))
     {
         
     }
     
     Node::~Node()
     {
-    
+        // children kept alive elsewhere become roots
+        for (auto& i : m_children)
+        {
+            TransformHierarchy::SetParent(i->m_transform, -1);
+        }
+
+        TransformHierarchy::Destroy(m_transform);
     }
 
-    void Node::SetLocalPosition(const Vector3& pos)
+    Vector3 Node::GetLocalPosition() const
     {
-        m_local_position = pos;
-        this->MarkMatrixDirty();
+        return TransformHierarchy::GetLocalPosition(m_transform);
     }
 
-    void Node::SetLocalRotation(const Quaternion& rot)
+    void Node::SetLocalPosition(const Vector3& pos)
     {
-        m_local_rotation = rot;
-        this->MarkMatrixDirty();
+        TransformHierarchy::SetLocalPosition(m_transform, pos);
     }
 
-    void Node::SetLocalScale(const Vector3& scale)
+    Quaternion Node::GetLocalRotation() const
     {
-        m_local_scale = scale;
-        this->MarkMatrixDirty();
+        return TransformHierarchy::GetLocalRotation(m_transform);
     }
 
-    void Node::MarkMatrixDirty()
+    void Node::SetLocalRotation(const Quaternion& rot)
     {
-        m_matrix_dirty = true;
-        this->OnMatrixDirty();
-
-        if (m_notify_children_on_matrix_dirty)
-        {
-            for (auto& i : m_children)
-            {
-                i->MarkMatrixDirty();
-            }
-        }
+        TransformHierarchy::SetLocalRotation(m_transform, rot);
     }
 
-    const Matrix4x4& Node::GetLocalToWorldMatrix()
+    Vector3 Node::GetLocalScale() const
     {
-        if (m_matrix_dirty)
-        {
-            m_matrix_dirty = false;
+        return TransformHierarchy::GetLocalScale(m_transform);
+    }
 
-            if (!m_parent.expired())
-            {
-                m_local_to_world_matrix = m_parent.lock()->GetLocalToWorldMatrix() * Matrix4x4::TRS(m_local_position, m_local_rotation, m_local_scale);
-            }
-            else
-            {
-                m_local_to_world_matrix = Matrix4x4::TRS(m_local_position, m_local_rotation, m_local_scale);
-            }
-        }
+    void Node::SetLocalScale(const Vector3& scale)
+    {
+        TransformHierarchy::SetLocalScale(m_transform, scale);
+    }
 
-        return m_local_to_world_matrix;
+    Matrix4x4 Node::GetLocalToWorldMatrix()
+    {
+        return TransformHierarchy::GetLocalToWorldMatrix(m_transform);
     }
 
     Vector3 Node::GetPosition()
@@ -92,13 +79,7 @@ namespace Viry3D
 
     Quaternion Node::GetRotation()
     {
-        Quaternion rotation = m_local_rotation;
-        if (!m_parent.expired())
-        {
-            Quaternion parent_rotation = m_parent.lock()->GetRotation();
-            rotation = parent_rotation * rotation;
-        }
-        return rotation;
+        return TransformHierarchy::GetRotation(m_transform);
     }
 
     Vector3 Node::GetRight()
@@ -118,41 +99,38 @@ namespace Viry3D
 
     Vector3 Node::GetScale()
     {
-        Vector3 scale = m_local_scale;
-        if (!m_parent.expired())
-        {
-            Vector3 parent_scale = m_parent.lock()->GetScale();
-            scale.x *= parent_scale.x;
-            scale.y *= parent_scale.y;
-            scale.z *= parent_scale.z;
-        }
-        return scale;
+        return TransformHierarchy::GetScale(m_transform);
     }
 
     void Node::SetParent(const Ref<Node>& node, const Ref<Node>& parent)
     {
-        bool matrix_dirty = false;
+        bool parent_changed = false;
 
         if (!node->m_parent.expired())
         {
             node->m_parent.lock()->m_children.Remove(node);
             node->m_parent.reset();
-            matrix_dirty = true;
+            parent_changed = true;
         }
 
         if (parent)
         {
             parent->m_children.Add(node);
             node->m_parent = parent;
-            matrix_dirty = true;
+            parent_changed = true;
         }
 
-        if (matrix_dirty)
+        if (parent_changed)
         {
-            node->MarkMatrixDirty();
+            TransformHierarchy::SetParent(node->m_transform, parent ? parent->m_transform : -1);
         }
     }
 
+    int Node::GetHierarchyVersion() const
+    {
+        return TransformHierarchy::GetHierarchyVersion(m_transform);
+    }
+
     const Ref<Node>& Node::GetRoot(const Ref<Node>& node)
     {
         if (!node->m_parent.expired())
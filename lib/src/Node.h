@@ -32,13 +32,13 @@ namespace Viry3D
         static const Ref<Node>& GetRoot(const Ref<Node>& node);
         Node();
         virtual ~Node();
-        const Vector3& GetLocalPosition() const { return m_local_position; }
+        Vector3 GetLocalPosition() const;
         void SetLocalPosition(const Vector3& pos);
-        const Quaternion& GetLocalRotation() const { return m_local_rotation; }
+        Quaternion GetLocalRotation() const;
         void SetLocalRotation(const Quaternion& rot);
-        const Vector3& GetLocalScale() const { return m_local_scale; }
+        Vector3 GetLocalScale() const;
         void SetLocalScale(const Vector3& scale);
-        const Matrix4x4& GetLocalToWorldMatrix();
+        Matrix4x4 GetLocalToWorldMatrix();
         Vector3 GetPosition();
         Quaternion GetRotation();
         Vector3 GetRight();
@@ -49,21 +49,19 @@ namespace Viry3D
         int GetChildCount() const { return m_children.Size(); }
         const Ref<Node>& GetChild(int index) const { return m_children[index]; }
         Ref<Node> Find(const String& path);
-        void EnableNotifyChildrenOnMatrixDirty(bool enable) { m_notify_children_on_matrix_dirty = enable; }
+        // changes when nodes are attached to or detached from anywhere below this node
+        int GetHierarchyVersion() const;
 
     protected:
+        // called when the node moves, and in TransformHierarchy::Update for nodes moved by an ancestor
         virtual void OnMatrixDirty() { }
 
     private:
-        void MarkMatrixDirty();
+        friend class TransformHierarchy;
 
     private:
-        Vector3 m_local_position;
-        Quaternion m_local_rotation;
-        Vector3 m_local_scale;
-        bool m_matrix_dirty;
-        bool m_notify_children_on_matrix_dirty;
-        Matrix4x4 m_local_to_world_matrix;
+        // handle of the transform in TransformHierarchy
+        int m_transform;
         Vector<Ref<Node>> m_children;
         WeakRef<Node> m_parent;
     };
@@ -19,6 +19,7 @@
 #include "Node.h"
 #include "Application.h"
 #include "io/File.h"
+#include "io/AssetPack.h"
 #include "io/MemoryStream.h"
 #include "graphics/MeshRenderer.h"
 #include "graphics/SkinnedMeshRenderer.h"
@@ -26,11 +27,66 @@
 #include "graphics/Material.h"
 #include "graphics/Shader.h"
 #include "graphics/Texture.h"
+#include "graphics/Display.h"
 #include "animation/Animation.h"
+#include "thread/ThreadPool.h"
 #include "json/json.h"
 
 namespace Viry3D
 {
+    enum class NodeComponent
+    {
+        None,
+        MeshRenderer,
+        SkinnedMeshRenderer,
+        Animation,
+    };
+
+    // node file content, parsed without touching the gpu so any thread can read it
+    class NodeData : public Object
+    {
+    public:
+        Vector3 local_pos;
+        Quaternion local_rot;
+        Vector3 local_scale;
+        NodeComponent component = NodeComponent::None;
+        int lightmap_index = -1;
+        Vector4 lightmap_scale_offset;
+        Vector<String> materials;
+        String mesh;
+        Vector<String> bones;
+        Vector<AnimationClip> clips;
+        Vector<Ref<NodeData>> children;
+    };
+
+    class MaterialData : public Object
+    {
+    public:
+        struct Property
+        {
+            String name;
+            MaterialProperty::Type type;
+            Vector4 value;
+            String texture;
+        };
+
+        String shader;
+        Vector<Property> properties;
+    };
+
+    class TextureData : public Object
+    {
+    public:
+        String type;
+        int width = 0;
+        SamplerAddressMode wrap_mode = SamplerAddressMode::ClampToEdge;
+        FilterMode filter_mode = FilterMode::Linear;
+        int mipmap_count = 1;
+        // one image for Texture2D, 6 faces per mip level for Cubemap
+        Vector<Ref<Image>> images;
+    };
+
+    // used by the synchronous loads only, on the calling thread
     static Map<String, Ref<Object>> g_loading_cache;
 
     static String ReadString(MemoryStream& ms)
@@ -39,14 +95,21 @@ namespace Viry3D
         return ms.ReadString(size);
     }
 
-    static Ref<Texture> ReadTexture(const String& path)
+    static void AddUnique(Vector<String>& paths, const String& path)
     {
-        if (g_loading_cache.Contains(path))
+        for (const auto& i : paths)
         {
-            return RefCast<Texture>(g_loading_cache[path]);
+            if (i == path)
+            {
+                return;
+            }
         }
+        paths.Add(path);
+    }
 
-        Ref<Texture> texture;
+    static Ref<TextureData> ReadTextureData(const String& path)
+    {
+        Ref<TextureData> data;
 
         String full_path = Application::Instance()->GetDataPath() + "/" + path;
         if (File::Exist(full_path))
@@ -59,29 +122,29 @@ namespace Viry3D
             const char* end = begin + json.Size();
             if (reader->parse(begin, end, &root, nullptr))
             {
-                String texture_name = root["name"].asCString();
-                int width = root["width"].asInt();
-                int height = root["height"].asInt();
-                SamplerAddressMode wrap_mode = (SamplerAddressMode) root["wrap_mode"].asInt();
-                FilterMode filter_mode = (FilterMode) root["filter_mode"].asInt();
-                String texture_type = root["type"].asCString();
-
-                if (texture_type == "Texture2D")
+                data = RefMake<TextureData>();
+                data->SetName(root["name"].asCString());
+                data->width = root["width"].asInt();
+                data->wrap_mode = (SamplerAddressMode) root["wrap_mode"].asInt();
+                data->filter_mode = (FilterMode) root["filter_mode"].asInt();
+                data->type = root["type"].asCString();
+                data->mipmap_count = root["mipmap"].asInt();
+
+                if (data->type == "Texture2D")
                 {
-                    int mipmap_count = root["mipmap"].asInt();
                     String png_path = root["path"].asCString();
 
-                    texture = Texture::LoadTexture2DFromFile(Application::Instance()->GetDataPath() + "/" + png_path, filter_mode, wrap_mode, mipmap_count > 1, false);
-                    texture->SetName(texture_name);
+                    Ref<Image> image = Texture::LoadImageFromFile(Application::Instance()->GetDataPath() + "/" + png_path);
+                    if (image)
+                    {
+                        data->images.Add(image);
+                    }
                 }
-                else if (texture_type == "Cubemap")
+                else if (data->type == "Cubemap")
                 {
-                    int mipmap_count = root["mipmap"].asInt();
                     Json::Value levels = root["levels"];
 
-                    texture = Texture::CreateCubemap(width, TextureFormat::R8G8B8A8, filter_mode, wrap_mode, mipmap_count > 1);
-
-                    for (int i = 0; i < mipmap_count; ++i)
+                    for (int i = 0; i < data->mipmap_count; ++i)
                     {
                         Json::Value faces = levels[i];
 
@@ -89,106 +152,207 @@ namespace Viry3D
                         {
                             String face_path = faces[j].asCString();
 
-                            Ref<Image> image = Texture::LoadImageFromFile(Application::Instance()->GetDataPath() + "/" + face_path);
-                            texture->UpdateCubemap(image->data, (CubemapFace) j, i);
+                            data->images.Add(Texture::LoadImageFromFile(Application::Instance()->GetDataPath() + "/" + face_path));
                         }
                     }
                 }
             }
         }
 
-        g_loading_cache.Add(path, texture);
+        return data;
+    }
+
+    static Ref<Texture> CreateTexture(const Ref<TextureData>& data)
+    {
+        Ref<Texture> texture;
+
+        if (data->type == "Texture2D")
+        {
+            if (data->images.Size() > 0)
+            {
+                const Ref<Image>& image = data->images[0];
+                TextureFormat format = TextureFormat::R8G8B8A8;
+
+                if (image->format == ImageFormat::R8)
+                {
+                    format = TextureFormat::R8;
+                }
+                else if (image->format != ImageFormat::R8G8B8A8)
+                {
+                    assert(!"texture format not support");
+                }
+
+                texture = Texture::CreateTexture2DFromMemory(image->data, image->width, image->height, format, data->filter_mode, data->wrap_mode, data->mipmap_count > 1, false, false);
+                texture->SetName(data->GetName());
+            }
+        }
+        else if (data->type == "Cubemap")
+        {
+            texture = Texture::CreateCubemap(data->width, TextureFormat::R8G8B8A8, data->filter_mode, data->wrap_mode, data->mipmap_count > 1);
+
+            for (int i = 0; i < data->images.Size(); ++i)
+            {
+                texture->UpdateCubemap(data->images[i]->data, (CubemapFace) (i % 6), i / 6);
+            }
+        }
 
         return texture;
     }
 
-    static Ref<Material> ReadMaterial(const String& path)
+    static Ref<Texture> ReadTexture(const String& path)
     {
         if (g_loading_cache.Contains(path))
         {
-            return RefCast<Material>(g_loading_cache[path]);
+            return RefCast<Texture>(g_loading_cache[path]);
         }
 
-        Ref<Material> material;
+        Ref<Texture> texture;
+
+        Ref<TextureData> data = ReadTextureData(path);
+        if (data)
+        {
+            texture = CreateTexture(data);
+        }
+
+        g_loading_cache.Add(path, texture);
+
+        return texture;
+    }
+
+    static Ref<MaterialData> ReadMaterialData(const String& path)
+    {
+        Ref<MaterialData> data;
 
         String full_path = Application::Instance()->GetDataPath() + "/" + path;
         if (File::Exist(full_path))
         {
             MemoryStream ms(File::ReadAllBytes(full_path));
 
-            String material_name = ReadString(ms);
-            String shader_name = ReadString(ms);
+            data = RefMake<MaterialData>();
+            data->SetName(ReadString(ms));
+            data->shader = ReadString(ms);
             int property_count = ms.Read<int>();
 
-            Ref<Shader> shader = Shader::Find(shader_name);
-            if (shader)
-            {
-                material = RefMake<Material>(shader);
-                material->SetName(material_name);
-            }
-
             for (int i = 0; i < property_count; ++i)
             {
-                String property_name = ReadString(ms);
-                MaterialProperty::Type property_type = (MaterialProperty::Type) ms.Read<int>();
+                MaterialData::Property property;
+                property.name = ReadString(ms);
+                property.type = (MaterialProperty::Type) ms.Read<int>();
 
-                switch (property_type)
+                switch (property.type)
                 {
                     case MaterialProperty::Type::Color:
                     {
                         Color value = ms.Read<Color>();
-                        if (material)
-                        {
-                            material->SetColor(property_name, value);
-                        }
+                        property.value = Vector4(value.r, value.g, value.b, value.a);
                         break;
                     }
                     case MaterialProperty::Type::Vector:
                     {
-                        Vector4 value = ms.Read<Vector4>();
-                        if (material)
-                        {
-                            material->SetVector(property_name, value);
-                        }
+                        property.value = ms.Read<Vector4>();
                         break;
                     }
                     case MaterialProperty::Type::Float:
                     case MaterialProperty::Type::Range:
                     {
-                        float value = ms.Read<float>();
-                        if (material)
-                        {
-                            material->SetFloat(property_name, value);
-                        }
+                        property.value.x = ms.Read<float>();
                         break;
                     }
                     case MaterialProperty::Type::Texture:
                     {
                         Vector4 uv_scale_offset = ms.Read<Vector4>();
-                        String texture_path = ReadString(ms);
-                        if (texture_path.Size() > 0)
-                        {
-                            Ref<Texture> texture = ReadTexture(texture_path);
-                            if (material && texture)
-                            {
-                                material->SetTexture(property_name, texture);
-                            }
-                        }
+                        (void) uv_scale_offset;
+                        property.texture = ReadString(ms);
                         break;
                     }
+                    default:
+                        break;
                 }
+
+                data->properties.Add(property);
             }
         }
 
+        return data;
+    }
+
+    static Ref<Material> CreateMaterial(const Ref<MaterialData>& data, const Map<String, Ref<Texture>>& textures)
+    {
+        Ref<Material> material;
+
+        Ref<Shader> shader = Shader::Find(data->shader);
+        if (!shader)
+        {
+            return material;
+        }
+
+        material = RefMake<Material>(shader);
+        material->SetName(data->GetName());
+
+        for (const auto& property : data->properties)
+        {
+            switch (property.type)
+            {
+                case MaterialProperty::Type::Color:
+                    material->SetColor(property.name, Color(property.value.x, property.value.y, property.value.z, property.value.w));
+                    break;
+                case MaterialProperty::Type::Vector:
+                    material->SetVector(property.name, property.value);
+                    break;
+                case MaterialProperty::Type::Float:
+                case MaterialProperty::Type::Range:
+                    material->SetFloat(property.name, property.value.x);
+                    break;
+                case MaterialProperty::Type::Texture:
+                {
+                    const Ref<Texture>* texture_ptr;
+                    if (property.texture.Size() > 0 && textures.TryGet(property.texture, &texture_ptr) && *texture_ptr)
+                    {
+                        material->SetTexture(property.name, *texture_ptr);
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        return material;
+    }
+
+    static Ref<Material> ReadMaterial(const String& path)
+    {
+        if (g_loading_cache.Contains(path))
+        {
+            return RefCast<Material>(g_loading_cache[path]);
+        }
+
+        Ref<Material> material;
+
+        Ref<MaterialData> data = ReadMaterialData(path);
+        if (data)
+        {
+            Map<String, Ref<Texture>> textures;
+            for (const auto& property : data->properties)
+            {
+                if (property.texture.Size() > 0 && !textures.Contains(property.texture))
+                {
+                    textures.Add(property.texture, ReadTexture(property.texture));
+                }
+            }
+
+            material = CreateMaterial(data, textures);
+        }
+
         g_loading_cache.Add(path, material);
 
         return material;
     }
 
-    static void ReadRenderer(MemoryStream& ms, const Ref<Renderer>& renderer)
+    static void ReadRenderer(MemoryStream& ms, const Ref<NodeData>& data)
     {
-        int lightmap_index = ms.Read<int>();
-        Vector4 lightmap_scale_offset = ms.Read<Vector4>();
+        data->lightmap_index = ms.Read<int>();
+        data->lightmap_scale_offset = ms.Read<Vector4>();
         bool cast_shadow = ms.Read<byte>() == 1;
         bool receive_shadow = ms.Read<byte>() == 1;
 
@@ -201,49 +365,37 @@ namespace Viry3D
             String material_path = ReadString(ms);
             if (material_path.Size() > 0)
             {
-                Ref<Material> material = ReadMaterial(material_path);
-                if (material)
-                {
-                    renderer->SetMaterial(material);
-                }
+                data->materials.Add(material_path);
             }
         }
-
-        if (lightmap_index >= 0)
-        {
-            renderer->SetLightmapIndex(lightmap_index);
-            renderer->SetLightmapScaleOffset(lightmap_scale_offset);
-        }
     }
 
-    static void ReadMeshRenderer(MemoryStream& ms, const Ref<MeshRenderer>& renderer)
+    static void ReadMeshRenderer(MemoryStream& ms, const Ref<NodeData>& data)
     {
-        ReadRenderer(ms, renderer);
+        ReadRenderer(ms, data);
 
-        String mesh_path = ReadString(ms);
-        auto mesh = Mesh::LoadFromFile(Application::Instance()->GetDataPath() + "/" + mesh_path);
-        renderer->SetMesh(mesh);
+        data->mesh = ReadString(ms);
     }
 
-    static void ReadSkinnedMeshRenderer(MemoryStream& ms, const Ref<SkinnedMeshRenderer>& renderer)
+    static void ReadSkinnedMeshRenderer(MemoryStream& ms, const Ref<NodeData>& data)
     {
-        ReadMeshRenderer(ms, renderer);
+        ReadMeshRenderer(ms, data);
 
         int bone_count = ms.Read<int>();
 
-        Vector<String> bones(bone_count);
+        data->bones.Resize(bone_count);
         for (int i = 0; i < bone_count; ++i)
         {
-            bones[i] = ReadString(ms);
+            data->bones[i] = ReadString(ms);
         }
-        renderer->SetBonePaths(bones);
     }
 
-    static void ReadAnimation(MemoryStream& ms, const Ref<Animation>& animation)
+    static void ReadAnimation(MemoryStream& ms, const Ref<NodeData>& data)
     {
         int clip_count = ms.Read<int>();
 
-        Vector<AnimationClip> clips(clip_count);
+        Vector<AnimationClip>& clips = data->clips;
+        clips.Resize(clip_count);
 
         for (int i = 0; i < clip_count; ++i)
         {
@@ -298,24 +450,22 @@ namespace Viry3D
                 }
             }
         }
-
-        animation->SetClips(std::move(clips));
     }
 
-    static Ref<Node> ReadNode(MemoryStream& ms, const Ref<Node>& parent)
+    static Ref<NodeData> ReadNode(MemoryStream& ms)
     {
-        Ref<Node> node;
+        Ref<NodeData> data = RefMake<NodeData>();
 
-        String name = ReadString(ms);
+        data->SetName(ReadString(ms));
         int layer = ms.Read<int>();
         bool active = ms.Read<byte>() == 1;
 
         (void) layer;
         (void) active;
 
-        Vector3 local_pos = ms.Read<Vector3>();
-        Quaternion local_rot = ms.Read<Quaternion>();
-        Vector3 local_scale = ms.Read<Vector3>();
+        data->local_pos = ms.Read<Vector3>();
+        data->local_rot = ms.Read<Quaternion>();
+        data->local_scale = ms.Read<Vector3>();
 
         int com_count = ms.Read<int>();
         for (int i = 0; i < com_count; ++i)
@@ -324,40 +474,132 @@ namespace Viry3D
 
             if (com_name == "MeshRenderer")
             {
-                assert(!node);
+                assert(data->component == NodeComponent::None);
 
-                auto com = RefMake<MeshRenderer>();
-                ReadMeshRenderer(ms, com);
-                node = com;
+                data->component = NodeComponent::MeshRenderer;
+                ReadMeshRenderer(ms, data);
             }
             else if (com_name == "SkinnedMeshRenderer")
             {
-                assert(!node);
+                assert(data->component == NodeComponent::None);
 
-                auto com = RefMake<SkinnedMeshRenderer>();
-                ReadSkinnedMeshRenderer(ms, com);
-                node = com;
-
-                if (parent)
-                {
-                    com->SetBonesRoot(Node::GetRoot(parent));
-                }
-                else
-                {
-                    com->SetBonesRoot(com);
-                }
+                data->component = NodeComponent::SkinnedMeshRenderer;
+                ReadSkinnedMeshRenderer(ms, data);
             }
             else if (com_name == "Animation")
             {
-                assert(!node);
+                assert(data->component == NodeComponent::None);
 
-                auto com = RefMake<Animation>();
-                ReadAnimation(ms, com);
-                node = com;
+                data->component = NodeComponent::Animation;
+                ReadAnimation(ms, data);
             }
         }
 
-        if (!node)
+        int child_count = ms.Read<int>();
+        for (int i = 0; i < child_count; ++i)
+        {
+            data->children.Add(ReadNode(ms));
+        }
+
+        return data;
+    }
+
+    static Ref<NodeData> ReadNodeData(const String& path)
+    {
+        Ref<NodeData> data;
+
+        String full_path = Application::Instance()->GetDataPath() + "/" + path;
+        if (File::Exist(full_path))
+        {
+            MemoryStream ms(File::ReadAllBytes(full_path));
+            data = ReadNode(ms);
+        }
+
+        return data;
+    }
+
+    // unique material and mesh paths used by the node tree
+    static void CollectAssets(const Ref<NodeData>& data, Vector<String>& materials, Vector<String>& meshes)
+    {
+        for (const auto& i : data->materials)
+        {
+            AddUnique(materials, i);
+        }
+
+        if (data->mesh.Size() > 0)
+        {
+            AddUnique(meshes, data->mesh);
+        }
+
+        for (const auto& i : data->children)
+        {
+            CollectAssets(i, materials, meshes);
+        }
+    }
+
+    static void SetupRenderer(const Ref<NodeData>& data, const Ref<Renderer>& renderer, const Map<String, Ref<Object>>& assets)
+    {
+        for (const auto& i : data->materials)
+        {
+            const Ref<Object>* material_ptr;
+            if (assets.TryGet(i, &material_ptr) && *material_ptr)
+            {
+                renderer->SetMaterial(RefCast<Material>(*material_ptr));
+            }
+        }
+
+        if (data->lightmap_index >= 0)
+        {
+            renderer->SetLightmapIndex(data->lightmap_index);
+            renderer->SetLightmapScaleOffset(data->lightmap_scale_offset);
+        }
+    }
+
+    static void SetupMeshRenderer(const Ref<NodeData>& data, const Ref<MeshRenderer>& renderer, const Map<String, Ref<Object>>& assets)
+    {
+        SetupRenderer(data, renderer, assets);
+
+        const Ref<Object>* mesh_ptr;
+        if (assets.TryGet(data->mesh, &mesh_ptr))
+        {
+            renderer->SetMesh(RefCast<Mesh>(*mesh_ptr));
+        }
+    }
+
+    // creates the node tree once every asset it uses is loaded
+    static Ref<Node> CreateNode(const Ref<NodeData>& data, const Ref<Node>& parent, const Map<String, Ref<Object>>& assets)
+    {
+        Ref<Node> node;
+
+        if (data->component == NodeComponent::MeshRenderer)
+        {
+            auto com = RefMake<MeshRenderer>();
+            SetupMeshRenderer(data, com, assets);
+            node = com;
+        }
+        else if (data->component == NodeComponent::SkinnedMeshRenderer)
+        {
+            auto com = RefMake<SkinnedMeshRenderer>();
+            SetupMeshRenderer(data, com, assets);
+            com->SetBonePaths(data->bones);
+            node = com;
+
+            if (parent)
+            {
+                com->SetBonesRoot(Node::GetRoot(parent));
+            }
+            else
+            {
+                com->SetBonesRoot(com);
+            }
+        }
+        else if (data->component == NodeComponent::Animation)
+        {
+            auto com = RefMake<Animation>();
+            com->SetClips(Vector<AnimationClip>(data->clips));
+            node = com;
+        }
+        else
         {
             node = RefMake<Node>();
         }
@@ -367,30 +609,205 @@ namespace Viry3D
             Node::SetParent(node, parent);
         }
 
-        node->SetName(name);
-        node->SetLocalPosition(local_pos);
-        node->SetLocalRotation(local_rot);
-        node->SetLocalScale(local_scale);
+        node->SetName(data->GetName());
+        node->SetLocalPosition(data->local_pos);
+        node->SetLocalRotation(data->local_rot);
+        node->SetLocalScale(data->local_scale);
 
-        int child_count = ms.Read<int>();
-        for (int i = 0; i < child_count; ++i)
+        for (const auto& i : data->children)
         {
-            ReadNode(ms, node);
+            CreateNode(i, node, assets);
         }
 
         return node;
     }
 
+    typedef std::function<void(const Ref<Object>&)> AssetCallback;
+
+    class AsyncAsset
+    {
+    public:
+        Vector<AssetCallback> callbacks;
+    };
+
+    // assets being loaded by LoadNodeAsync, concurrent requests for the same path share one load,
+    // only used on the main thread as all task completions run there
+    static Map<String, Ref<AsyncAsset>> g_async_assets;
+
+    static void RunTask(const Thread::Task::Job& job, const Thread::Task::CompleteCallback& complete)
+    {
+        Thread::Task task;
+        task.job = job;
+        task.complete = complete;
+        Application::Instance()->GetThreadPool()->AddTask(task);
+    }
+
+    // gl objects are created on the resource thread with the shared context,
+    // vulkan objects on the main thread
+    static void RunGpuTask(const Thread::Task::Job& job, const Thread::Task::CompleteCallback& complete)
+    {
+#if VR_GLES
+        Thread::Task task;
+        task.job = job;
+        task.complete = complete;
+        Application::Instance()->GetResourceThreadPool()->AddTask(task);
+#else
+        Display::Instance()->BeginUploadBatch();
+        Ref<Object> result = job();
+        Display::Instance()->EndUploadBatch();
+
+        complete(result);
+#endif
+    }
+
+    static void RequestAsyncAsset(const String& path, const AssetCallback& callback, const std::function<void()>& load)
+    {
+        Ref<AsyncAsset>* asset_ptr;
+        if (g_async_assets.TryGet(path, &asset_ptr))
+        {
+            (*asset_ptr)->callbacks.Add(callback);
+            return;
+        }
+
+        auto asset = RefMake<AsyncAsset>();
+        asset->callbacks.Add(callback);
+        g_async_assets.Add(path, asset);
+
+        load();
+    }
+
+    static void FinishAsyncAsset(const String& path, const Ref<Object>& result)
+    {
+        Ref<AsyncAsset> asset = g_async_assets[path];
+        g_async_assets.Remove(path);
+
+        for (const auto& i : asset->callbacks)
+        {
+            i(result);
+        }
+    }
+
+    static void LoadTextureAsync(const String& path, const AssetCallback& callback)
+    {
+        RequestAsyncAsset(path, callback, [=]() {
+            RunTask([=]() -> Ref<Object> {
+                return ReadTextureData(path);
+            }, [=](const Ref<Object>& data) {
+                if (!data)
+                {
+                    FinishAsyncAsset(path, Ref<Object>());
+                    return;
+                }
+
+                RunGpuTask([=]() -> Ref<Object> {
+                    return CreateTexture(RefCast<TextureData>(data));
+                }, [=](const Ref<Object>& texture) {
+                    FinishAsyncAsset(path, texture);
+                });
+            });
+        });
+    }
+
+    static void LoadMaterialAsync(const String& path, const AssetCallback& callback)
+    {
+        RequestAsyncAsset(path, callback, [=]() {
+            RunTask([=]() -> Ref<Object> {
+                return ReadMaterialData(path);
+            }, [=](const Ref<Object>& obj) {
+                Ref<MaterialData> data = RefCast<MaterialData>(obj);
+                if (!data)
+                {
+                    FinishAsyncAsset(path, Ref<Object>());
+                    return;
+                }
+
+                Vector<String> texture_paths;
+                for (const auto& i : data->properties)
+                {
+                    if (i.texture.Size() > 0)
+                    {
+                        AddUnique(texture_paths, i.texture);
+                    }
+                }
+
+                // materials own no gpu memory of their own, created on the main thread for the descriptor sets
+                if (texture_paths.Empty())
+                {
+                    FinishAsyncAsset(path, CreateMaterial(data, Map<String, Ref<Texture>>()));
+                    return;
+                }
+
+                auto textures = RefMake<Map<String, Ref<Texture>>>();
+                for (const auto& i : texture_paths)
+                {
+                    String texture_path = i;
+                    int texture_count = texture_paths.Size();
+
+                    LoadTextureAsync(texture_path, [=](const Ref<Object>& texture) {
+                        textures->Add(texture_path, RefCast<Texture>(texture));
+
+                        if (textures->Size() == texture_count)
+                        {
+                            FinishAsyncAsset(path, CreateMaterial(data, *textures));
+                        }
+                    });
+                }
+            });
+        });
+    }
+
+    static void LoadMeshAsync(const String& path, const AssetCallback& callback)
+    {
+        RequestAsyncAsset(path, callback, [=]() {
+            RunTask([=]() -> Ref<Object> {
+                return Mesh::ReadFile(Application::Instance()->GetDataPath() + "/" + path);
+            }, [=](const Ref<Object>& data) {
+                if (!data)
+                {
+                    FinishAsyncAsset(path, Ref<Object>());
+                    return;
+                }
+
+                RunGpuTask([=]() -> Ref<Object> {
+                    return Mesh::CreateFromFileData(RefCast<Mesh::FileData>(data));
+                }, [=](const Ref<Object>& mesh) {
+                    FinishAsyncAsset(path, mesh);
+                });
+            });
+        });
+    }
+
     Ref<Node> Resources::LoadNode(const String& path)
     {
         Ref<Node> node;
 
-        String full_path = Application::Instance()->GetDataPath() + "/" + path;
-        if (File::Exist(full_path))
+        Ref<NodeData> data = ReadNodeData(path);
+        if (data)
         {
-            MemoryStream ms(File::ReadAllBytes(full_path));
+            Vector<String> materials;
+            Vector<String> meshes;
+            CollectAssets(data, materials, meshes);
 
-            node = ReadNode(ms, Ref<Node>());
+#if VR_VULKAN
+            // all meshes and textures of the node share one transfer submit
+            Display::Instance()->BeginUploadBatch();
+#endif
+
+            Map<String, Ref<Object>> assets;
+            for (const auto& i : materials)
+            {
+                assets.Add(i, ReadMaterial(i));
+            }
+            for (const auto& i : meshes)
+            {
+                assets.Add(i, Mesh::LoadFromFile(Application::Instance()->GetDataPath() + "/" + i));
+            }
+
+            node = CreateNode(data, Ref<Node>(), assets);
+
+#if VR_VULKAN
+            Display::Instance()->EndUploadBatch();
+#endif
 
             g_loading_cache.Clear();
         }
@@ -398,12 +815,91 @@ namespace Viry3D
         return node;
     }
 
+    void Resources::LoadNodeAsync(const String& path, LoadComplete complete, LoadProgress progress)
+    {
+        RunTask([=]() -> Ref<Object> {
+            return ReadNodeData(path);
+        }, [=](const Ref<Object>& obj) {
+            Ref<NodeData> data = RefCast<NodeData>(obj);
+            if (!data)
+            {
+                if (complete)
+                {
+                    complete(Ref<Node>());
+                }
+                return;
+            }
+
+            Vector<String> materials;
+            Vector<String> meshes;
+            CollectAssets(data, materials, meshes);
+
+            auto assets = RefMake<Map<String, Ref<Object>>>();
+            int asset_count = materials.Size() + meshes.Size();
+
+            auto on_asset_loaded = [=](const String& asset_path, const Ref<Object>& asset) {
+                assets->Add(asset_path, asset);
+
+                if (progress)
+                {
+                    progress(assets->Size() / (float) asset_count);
+                }
+
+                if (assets->Size() == asset_count)
+                {
+                    Ref<Node> node = CreateNode(data, Ref<Node>(), *assets);
+                    if (complete)
+                    {
+                        complete(node);
+                    }
+                }
+            };
+
+            if (asset_count == 0)
+            {
+                Ref<Node> node = CreateNode(data, Ref<Node>(), *assets);
+                if (progress)
+                {
+                    progress(1.0f);
+                }
+                if (complete)
+                {
+                    complete(node);
+                }
+                return;
+            }
+
+            for (const auto& i : materials)
+            {
+                String material_path = i;
+                LoadMaterialAsync(material_path, [=](const Ref<Object>& material) {
+                    on_asset_loaded(material_path, material);
+                });
+            }
+            for (const auto& i : meshes)
+            {
+                String mesh_path = i;
+                LoadMeshAsync(mesh_path, [=](const Ref<Object>& mesh) {
+                    on_asset_loaded(mesh_path, mesh);
+                });
+            }
+        });
+    }
+
     Ref<Texture> Resources::LoadTexture(const String& path)
     {
         Ref<Texture> texture;
 
+#if VR_VULKAN
+        Display::Instance()->BeginUploadBatch();
+#endif
+
         texture = ReadTexture(path);
 
+#if VR_VULKAN
+        Display::Instance()->EndUploadBatch();
+#endif
+
         g_loading_cache.Clear();
 
         return texture;
@@ -489,4 +985,14 @@ namespace Viry3D
 
         return lightmap;
     }
+
+    bool Resources::MountPack(const String& path)
+    {
+        return AssetPack::Mount(Application::Instance()->GetDataPath() + "/" + path, Application::Instance()->GetDataPath());
+    }
+
+    void Resources::UnmountPack(const String& path)
+    {
+        AssetPack::Unmount(Application::Instance()->GetDataPath() + "/" + path);
+    }
 }
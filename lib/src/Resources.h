@@ -19,6 +19,7 @@
 
 #include "string/String.h"
 #include "container/Vector.h"
+#include <functional>
 
 namespace Viry3D
 {
@@ -28,8 +29,17 @@ namespace Viry3D
     class Resources
     {
     public:
+        typedef std::function<void(const Ref<Node>& node)> LoadComplete;
+        typedef std::function<void(float progress)> LoadProgress;
+
         static Ref<Node> LoadNode(const String& path);
+        // files are parsed and images decoded on the worker threads, gpu objects are created on the main thread,
+        // or on the resource thread with gles, callbacks are called on the main thread
+        static void LoadNodeAsync(const String& path, LoadComplete complete, LoadProgress progress = nullptr);
         static Ref<Texture> LoadTexture(const String& path);
         static Ref<Texture> LoadLightmap(const String& path);
+        // mounts an asset pack at the data path, so loads of packed files read the pack instead of loose files
+        static bool MountPack(const String& path);
+        static void UnmountPack(const String& path);
     };
 }
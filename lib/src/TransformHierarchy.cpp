@@ -0,0 +1,348 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "TransformHierarchy.h"
+#include "Node.h"
+#include "math/Mathf.h"
+
+namespace Viry3D
+{
+    Vector<Node*> TransformHierarchy::m_nodes;
+    Vector<int> TransformHierarchy::m_parents;
+    Vector<Vector3> TransformHierarchy::m_local_positions;
+    Vector<Quaternion> TransformHierarchy::m_local_rotations;
+    Vector<Vector3> TransformHierarchy::m_local_scales;
+    Vector<Matrix4x4> TransformHierarchy::m_world_matrices;
+    Vector<int> TransformHierarchy::m_flags;
+    Vector<int> TransformHierarchy::m_versions;
+    Vector<int> TransformHierarchy::m_handles;
+    Vector<int> TransformHierarchy::m_indices;
+    Vector<int> TransformHierarchy::m_free_handles;
+    int TransformHierarchy::m_free_index_count = 0;
+    int TransformHierarchy::m_version_counter = 0;
+    bool TransformHierarchy::m_order_dirty = false;
+    bool TransformHierarchy::m_dirty = false;
+
+    int TransformHierarchy::Create(Node* node)
+    {
+        int handle;
+        if (m_free_handles.Size() > 0)
+        {
+            handle = m_free_handles[m_free_handles.Size() - 1];
+            m_free_handles.Resize(m_free_handles.Size() - 1);
+        }
+        else
+        {
+            handle = m_indices.Size();
+            m_indices.Add(-1);
+        }
+
+        // a node without parent may go anywhere in depth order, so appending keeps the order
+        int index = m_nodes.Size();
+        m_nodes.Add(node);
+        m_parents.Add(-1);
+        m_local_positions.Add(Vector3(0, 0, 0));
+        m_local_rotations.Add(Quaternion::Identity());
+        m_local_scales.Add(Vector3(1, 1, 1));
+        m_world_matrices.Add(Matrix4x4::Identity());
+        m_flags.Add(0);
+        m_versions.Add(++m_version_counter);
+        m_handles.Add(handle);
+        m_indices[handle] = index;
+
+        return handle;
+    }
+
+    void TransformHierarchy::Destroy(int handle)
+    {
+        int index = m_indices[handle];
+
+        // the slot is removed by the next sort
+        m_nodes[index] = nullptr;
+        m_parents[index] = -1;
+        m_flags[index] = 0;
+        m_handles[index] = -1;
+        m_free_index_count += 1;
+        m_order_dirty = true;
+
+        m_indices[handle] = -1;
+        m_free_handles.Add(handle);
+    }
+
+    void TransformHierarchy::SetParent(int handle, int parent_handle)
+    {
+        int index = m_indices[handle];
+        int parent = parent_handle >= 0 ? m_indices[parent_handle] : -1;
+
+        // the subtrees of all ancestors, old and new, changed
+        for (int i = m_parents[index]; i >= 0; i = m_parents[i])
+        {
+            m_versions[i] = ++m_version_counter;
+        }
+        for (int i = parent; i >= 0; i = m_parents[i])
+        {
+            m_versions[i] = ++m_version_counter;
+        }
+
+        m_parents[index] = parent;
+        if (parent > index)
+        {
+            m_order_dirty = true;
+        }
+
+        MarkDirty(index);
+    }
+
+    void TransformHierarchy::MarkDirty(int index)
+    {
+        m_flags[index] |= FLAG_DIRTY;
+        m_dirty = true;
+
+        m_nodes[index]->OnMatrixDirty();
+    }
+
+    void TransformHierarchy::SetLocalPosition(int handle, const Vector3& pos)
+    {
+        int index = m_indices[handle];
+        m_local_positions[index] = pos;
+        MarkDirty(index);
+    }
+
+    void TransformHierarchy::SetLocalRotation(int handle, const Quaternion& rot)
+    {
+        int index = m_indices[handle];
+        m_local_rotations[index] = rot;
+        MarkDirty(index);
+    }
+
+    void TransformHierarchy::SetLocalScale(int handle, const Vector3& scale)
+    {
+        int index = m_indices[handle];
+        m_local_scales[index] = scale;
+        MarkDirty(index);
+    }
+
+    const Matrix4x4& TransformHierarchy::UpdateWorldMatrix(int index)
+    {
+        Matrix4x4 local = Matrix4x4::TRS(m_local_positions[index], m_local_rotations[index], m_local_scales[index]);
+
+        int parent = m_parents[index];
+        if (parent >= 0)
+        {
+            m_world_matrices[index] = UpdateWorldMatrix(parent) * local;
+        }
+        else
+        {
+            m_world_matrices[index] = local;
+        }
+
+        return m_world_matrices[index];
+    }
+
+    const Matrix4x4& TransformHierarchy::GetLocalToWorldMatrix(int handle)
+    {
+        int index = m_indices[handle];
+
+        if (m_dirty)
+        {
+            for (int i = index; i >= 0; i = m_parents[i])
+            {
+                // flags stay set, the descendants of the dirty node still need the sweep
+                if (m_flags[i] & FLAG_DIRTY)
+                {
+                    return UpdateWorldMatrix(index);
+                }
+            }
+        }
+
+        return m_world_matrices[index];
+    }
+
+    Quaternion TransformHierarchy::GetRotation(int handle)
+    {
+        int index = m_indices[handle];
+        Quaternion rotation = m_local_rotations[index];
+
+        for (int i = m_parents[index]; i >= 0; i = m_parents[i])
+        {
+            rotation = m_local_rotations[i] * rotation;
+        }
+
+        return rotation;
+    }
+
+    Vector3 TransformHierarchy::GetScale(int handle)
+    {
+        int index = m_indices[handle];
+        Vector3 scale = m_local_scales[index];
+
+        for (int i = m_parents[index]; i >= 0; i = m_parents[i])
+        {
+            scale.x *= m_local_scales[i].x;
+            scale.y *= m_local_scales[i].y;
+            scale.z *= m_local_scales[i].z;
+        }
+
+        return scale;
+    }
+
+    // counting sort by depth, which also drops the slots of destroyed nodes
+    void TransformHierarchy::Sort()
+    {
+        int count = m_nodes.Size();
+        Vector<int> depths(count);
+        int max_depth = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            int depth = 0;
+            for (int j = m_parents[i]; j >= 0; j = m_parents[j])
+            {
+                // parents before i already have their depth when the order still holds
+                if (j < i)
+                {
+                    depth += depths[j] + 1;
+                    break;
+                }
+                depth += 1;
+            }
+            depths[i] = depth;
+            max_depth = Mathf::Max(max_depth, depth);
+        }
+
+        Vector<int> depth_starts(max_depth + 2, 0);
+        for (int i = 0; i < count; ++i)
+        {
+            if (m_nodes[i])
+            {
+                depth_starts[depths[i] + 1] += 1;
+            }
+        }
+        for (int i = 1; i < depth_starts.Size(); ++i)
+        {
+            depth_starts[i] += depth_starts[i - 1];
+        }
+
+        // new index of every old index
+        Vector<int> remap(count, -1);
+        for (int i = 0; i < count; ++i)
+        {
+            if (m_nodes[i])
+            {
+                remap[i] = depth_starts[depths[i]]++;
+            }
+        }
+
+        int new_count = count - m_free_index_count;
+        Vector<Node*> nodes(new_count);
+        Vector<int> parents(new_count);
+        Vector<Vector3> local_positions(new_count);
+        Vector<Quaternion> local_rotations(new_count);
+        Vector<Vector3> local_scales(new_count);
+        Vector<Matrix4x4> world_matrices(new_count);
+        Vector<int> flags(new_count);
+        Vector<int> versions(new_count);
+        Vector<int> handles(new_count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            int j = remap[i];
+            if (j < 0)
+            {
+                continue;
+            }
+
+            nodes[j] = m_nodes[i];
+            parents[j] = m_parents[i] >= 0 ? remap[m_parents[i]] : -1;
+            local_positions[j] = m_local_positions[i];
+            local_rotations[j] = m_local_rotations[i];
+            local_scales[j] = m_local_scales[i];
+            world_matrices[j] = m_world_matrices[i];
+            flags[j] = m_flags[i];
+            versions[j] = m_versions[i];
+            handles[j] = m_handles[i];
+            m_indices[m_handles[i]] = j;
+        }
+
+        m_nodes = std::move(nodes);
+        m_parents = std::move(parents);
+        m_local_positions = std::move(local_positions);
+        m_local_rotations = std::move(local_rotations);
+        m_local_scales = std::move(local_scales);
+        m_world_matrices = std::move(world_matrices);
+        m_flags = std::move(flags);
+        m_versions = std::move(versions);
+        m_handles = std::move(handles);
+        m_free_index_count = 0;
+        m_order_dirty = false;
+    }
+
+    void TransformHierarchy::Update()
+    {
+        if (m_order_dirty)
+        {
+            Sort();
+        }
+
+        if (!m_dirty)
+        {
+            return;
+        }
+        m_dirty = false;
+
+        Vector<Node*> notify_nodes;
+        int count = m_nodes.Size();
+
+        // parents come first, so one pass sees the final flags of the parent before each child
+        for (int i = 0; i < count; ++i)
+        {
+            int parent = m_parents[i];
+            if (parent >= 0 && (m_flags[parent] & FLAG_DIRTY))
+            {
+                m_flags[i] |= FLAG_DIRTY | FLAG_NOTIFY;
+            }
+
+            if (m_flags[i] & FLAG_DIRTY)
+            {
+                Matrix4x4 local = Matrix4x4::TRS(m_local_positions[i], m_local_rotations[i], m_local_scales[i]);
+                if (parent >= 0)
+                {
+                    m_world_matrices[i] = m_world_matrices[parent] * local;
+                }
+                else
+                {
+                    m_world_matrices[i] = local;
+                }
+            }
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (m_flags[i] & FLAG_NOTIFY)
+            {
+                notify_nodes.Add(m_nodes[i]);
+            }
+            m_flags[i] = 0;
+        }
+
+        // after the flags are cleared, so nodes moved by the callbacks are flagged again
+        for (auto i : notify_nodes)
+        {
+            i->OnMatrixDirty();
+        }
+    }
+}
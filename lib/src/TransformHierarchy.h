@@ -0,0 +1,89 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "math/Vector3.h"
+#include "math/Quaternion.h"
+#include "math/Matrix4x4.h"
+#include "container/Vector.h"
+
+namespace Viry3D
+{
+    class Node;
+
+    // transforms of all nodes in flat arrays, ordered by depth so every parent comes before its children,
+    // moving a node only flags it, Update propagates the flags and computes the world matrices in one linear sweep,
+    // nodes refer to their transform by a handle which stays valid while the arrays are reordered,
+    // main thread only
+    class TransformHierarchy
+    {
+    public:
+        static int Create(Node* node);
+        static void Destroy(int handle);
+        // parent_handle -1 for no parent
+        static void SetParent(int handle, int parent_handle);
+        static const Vector3& GetLocalPosition(int handle) { return m_local_positions[m_indices[handle]]; }
+        static void SetLocalPosition(int handle, const Vector3& pos);
+        static const Quaternion& GetLocalRotation(int handle) { return m_local_rotations[m_indices[handle]]; }
+        static void SetLocalRotation(int handle, const Quaternion& rot);
+        static const Vector3& GetLocalScale(int handle) { return m_local_scales[m_indices[handle]]; }
+        static void SetLocalScale(int handle, const Vector3& scale);
+        // computed along the parent chain when the node or an ancestor moved since the last Update
+        static const Matrix4x4& GetLocalToWorldMatrix(int handle);
+        static Quaternion GetRotation(int handle);
+        static Vector3 GetScale(int handle);
+        // changes when a node is attached to or detached from the subtree of the node,
+        // unique across nodes so a new node at a reused address never matches an old version
+        static int GetHierarchyVersion(int handle) { return m_versions[m_indices[handle]]; }
+        // called once per frame before rendering, notifies the nodes moved by an ancestor
+        static void Update();
+        static int GetNodeCount() { return m_nodes.Size() - m_free_index_count; }
+
+    private:
+        enum
+        {
+            // world matrix of the node and its descendants is out of date
+            FLAG_DIRTY = 1,
+            // OnMatrixDirty not yet called, for nodes moved by an ancestor
+            FLAG_NOTIFY = 2,
+        };
+
+        static void MarkDirty(int index);
+        static const Matrix4x4& UpdateWorldMatrix(int index);
+        static void Sort();
+
+    private:
+        // by index, in depth order after Sort
+        static Vector<Node*> m_nodes;
+        static Vector<int> m_parents;
+        static Vector<Vector3> m_local_positions;
+        static Vector<Quaternion> m_local_rotations;
+        static Vector<Vector3> m_local_scales;
+        static Vector<Matrix4x4> m_world_matrices;
+        static Vector<int> m_flags;
+        static Vector<int> m_versions;
+        static Vector<int> m_handles;
+        // by handle
+        static Vector<int> m_indices;
+        static Vector<int> m_free_handles;
+        static int m_free_index_count;
+        static int m_version_counter;
+        static bool m_order_dirty;
+        static bool m_dirty;
+    };
+}
@@ -16,11 +16,20 @@
 */
 
 #include "Animation.h"
+#include "SkeletonBinding.h"
 #include "time/Time.h"
+#include "math/Simd.h"
+#include "container/Map.h"
+#include "Application.h"
+#include "thread/JobSystem.h"
+
+// most animations sampled by one job
+#define ANIMATION_BATCH_CHUNK_SIZE 8
 
 namespace Viry3D
 {
-    Animation::Animation()
+    Animation::Animation():
+        m_bone_targets_dirty(false)
     {
     
     }
@@ -30,11 +39,150 @@ namespace Viry3D
     
     }
 
+    void Animation::SetClips(Vector<AnimationClip>&& clips)
+    {
+        m_clips = std::move(clips);
+        m_states.Clear();
+
+        this->BindClips();
+    }
+
     const String& Animation::GetClipName(int index) const
     {
         return m_clips[index].name;
     }
 
+    void Animation::BindClips()
+    {
+        Map<String, int> bone_indices;
+        int max_clip_bones = 0;
+
+        m_bone_paths.Clear();
+        m_clip_bindings.Clear();
+        m_clip_bindings.Resize(m_clips.Size());
+
+        for (int i = 0; i < m_clips.Size(); ++i)
+        {
+            const auto& clip = m_clips[i];
+            auto& binding = m_clip_bindings[i];
+
+            binding.bones.Resize(clip.curves.Size());
+            binding.channels.Resize(clip.curves.Size());
+
+            for (int j = 0; j < clip.curves.Size(); ++j)
+            {
+                const auto& curve = clip.curves[j];
+
+                int* bone_ptr;
+                if (bone_indices.TryGet(curve.path, &bone_ptr))
+                {
+                    binding.bones[j] = *bone_ptr;
+                }
+                else
+                {
+                    binding.bones[j] = m_bone_paths.Size();
+                    bone_indices.Add(curve.path, m_bone_paths.Size());
+                    m_bone_paths.Add(curve.path);
+                }
+                binding.channels[j] = AnimationPose::GetChannelMask(curve);
+            }
+
+            max_clip_bones = Mathf::Max(max_clip_bones, clip.curves.Size());
+        }
+
+        m_bone_targets.Clear();
+        m_bone_targets.Resize(m_bone_paths.Size(), nullptr);
+        m_bone_targets_dirty = true;
+        m_pose.Clear();
+        m_pose.Resize(m_bone_paths.Size() * ANIMATION_POSE_BONE_SIZE, 0.0f);
+        m_pose_channels.Clear();
+        m_pose_channels.Resize(m_bone_paths.Size(), 0);
+        m_sample.Resize(max_clip_bones * ANIMATION_POSE_BONE_SIZE);
+    }
+
+    void Animation::CompileClips(float sample_rate)
+    {
+        for (int i = 0; i < m_clips.Size(); ++i)
+        {
+            const auto& clip = m_clips[i];
+
+            // curve keys are gone
+            if (clip.compressed)
+            {
+                continue;
+            }
+
+            float rate = sample_rate;
+            if (rate <= 0)
+            {
+                rate = clip.fps > 0 ? clip.fps : 30;
+            }
+
+            m_clip_bindings[i].compiled = CompiledAnimationClip::Compile(clip, rate);
+        }
+    }
+
+    void Animation::CompressClips(const AnimationCompression& compression)
+    {
+        for (int i = 0; i < m_clips.Size(); ++i)
+        {
+            auto& clip = m_clips[i];
+
+            if (clip.compressed)
+            {
+                continue;
+            }
+
+            clip.compressed = CompressedAnimationClip::Compress(clip, compression);
+            if (clip.compressed)
+            {
+                m_clip_bindings[i].compiled.reset();
+
+                // paths and properties still bind the clip when it is copied to other animations
+                for (auto& j : clip.curves)
+                {
+                    j.curves = Vector<AnimationCurve>();
+                }
+            }
+        }
+
+        // cursors of playing states index curves
+        for (auto& i : m_states)
+        {
+            i.key_cursors.Clear();
+        }
+    }
+
+    // the hierarchy is complete only after the clips are set, so targets are bound at the first update,
+    // always on the calling thread as sampling may run on job system workers
+    void Animation::BindBoneTargets()
+    {
+        // bones reparented, added or removed anywhere in the rig
+        if (m_skeleton && !m_skeleton->IsBuiltFrom(this))
+        {
+            m_bone_targets_dirty = true;
+        }
+
+        if (!m_bone_targets_dirty)
+        {
+            return;
+        }
+        m_bone_targets_dirty = false;
+
+        m_skeleton = SkeletonBinding::Get(this);
+
+        for (int i = 0; i < m_bone_targets.Size(); ++i)
+        {
+            Node* target = nullptr;
+            int index = m_skeleton->FindIndex(m_bone_paths[i]);
+            if (index >= 0)
+            {
+                target = m_skeleton->GetNode(index).get();
+            }
+            m_bone_targets[i] = target;
+        }
+    }
+
     void Animation::Play(int index, float fade_length)
     {
         if (m_states.Size() == 0)
@@ -84,9 +232,49 @@ namespace Viry3D
     }
 
     void Animation::Update()
+    {
+        this->BindBoneTargets();
+        this->SamplePose();
+        this->ApplyPose();
+    }
+
+    void Animation::UpdateAll(const Vector<Ref<Animation>>& animations)
+    {
+        if (animations.Empty())
+        {
+            return;
+        }
+
+        for (int i = 0; i < animations.Size(); ++i)
+        {
+            animations[i]->BindBoneTargets();
+        }
+
+        // this thread samples ranges too while waiting, idle workers steal the rest
+        JobSystem* jobs = Application::Instance()->GetJobSystem();
+        jobs->ParallelFor(animations.Size(), ANIMATION_BATCH_CHUNK_SIZE, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i)
+            {
+                animations[i]->SamplePose();
+            }
+        });
+
+        // node writes go to the transform hierarchy, which is only touched from the main thread
+        for (int i = 0; i < animations.Size(); ++i)
+        {
+            animations[i]->ApplyPose();
+        }
+    }
+
+    void Animation::SamplePose()
     {
         bool first_state = true;
 
+        for (int i = 0; i < m_pose_channels.Size(); ++i)
+        {
+            m_pose_channels[i] = 0;
+        }
+
         for (auto i = m_states.begin(); i != m_states.end(); )
         {
             auto& state = *i;
@@ -155,14 +343,7 @@ namespace Viry3D
                     break;
             }
 
-            bool last_state = false;
-            auto j = i;
-            if (++j == m_states.end())
-            {
-                last_state = true;
-            }
-
-            this->Sample(state, time, state.weight, first_state, last_state);
+            this->Sample(state, time, state.weight, first_state);
             first_state = false;
 
             if (remove_later)
@@ -176,144 +357,157 @@ namespace Viry3D
         }
     }
 
-    void Animation::Sample(AnimationState& state, float time, float weight, bool first_state, bool last_state)
+    static void ReadNodeChannel(Node* node, AnimationChannel channel, float* value)
+    {
+        switch (channel)
+        {
+            case AnimationChannel::Position:
+            {
+                const Vector3& pos = node->GetLocalPosition();
+                value[0] = pos.x;
+                value[1] = pos.y;
+                value[2] = pos.z;
+                value[3] = 0;
+                break;
+            }
+            case AnimationChannel::Rotation:
+            {
+                const Quaternion& rot = node->GetLocalRotation();
+                value[0] = rot.x;
+                value[1] = rot.y;
+                value[2] = rot.z;
+                value[3] = rot.w;
+                break;
+            }
+            case AnimationChannel::Scale:
+            {
+                const Vector3& scale = node->GetLocalScale();
+                value[0] = scale.x;
+                value[1] = scale.y;
+                value[2] = scale.z;
+                value[3] = 0;
+                break;
+            }
+        }
+    }
+
+    void Animation::Sample(AnimationState& state, float time, float weight, bool first_state)
     {
         const auto& clip = m_clips[state.clip_index];
-        if (state.targets.Size() == 0)
+        const auto& binding = m_clip_bindings[state.clip_index];
+
+        if (binding.bones.Empty())
         {
-            state.targets.Resize(clip.curves.Size(), nullptr);
+            return;
         }
 
-        for (int i = 0; i < clip.curves.Size(); ++i)
+        if (clip.compressed)
         {
-            const auto& curve = clip.curves[i];
-            Node* target = state.targets[i];
-            if (target == nullptr)
+            if (state.key_cursors.Empty())
             {
-                target = this->Find(curve.path).get();
-                state.targets[i] = target;
-                if (target)
-                {
-                    target->EnableNotifyChildrenOnMatrixDirty(false);
-                }
-                else
-                {
-                    continue;
-                }
+                state.key_cursors.Resize(clip.compressed->GetTrackCount(), -1);
             }
 
-            Vector3 local_pos;
-            Quaternion local_rot;
-            Vector3 local_scale;
-            bool set_pos = false;
-            bool set_rot = false;
-            bool set_scale = false;
-
-            for (int j = 0; j < curve.property_types.Size(); ++j)
+            clip.compressed->Sample(time, &state.key_cursors[0], &m_sample[0]);
+        }
+        else if (binding.compiled)
+        {
+            binding.compiled->Sample(time, &m_sample[0]);
+        }
+        else
+        {
+            if (state.key_cursors.Empty())
             {
-                auto type = curve.property_types[j];
-                float value = curve.curves[j].Evaluate(time);
-
-                switch (type)
+                int curve_count = 0;
+                for (int i = 0; i < clip.curves.Size(); ++i)
                 {
-                    case CurvePropertyType::LocalPositionX:
-                        local_pos.x = value;
-                        set_pos = true;
-                        break;
-                    case CurvePropertyType::LocalPositionY:
-                        local_pos.y = value;
-                        set_pos = true;
-                        break;
-                    case CurvePropertyType::LocalPositionZ:
-                        local_pos.z = value;
-                        set_pos = true;
-                        break;
-
-                    case CurvePropertyType::LocalRotationX:
-                        local_rot.x = value;
-                        set_rot = true;
-                        break;
-                    case CurvePropertyType::LocalRotationY:
-                        local_rot.y = value;
-                        set_rot = true;
-                        break;
-                    case CurvePropertyType::LocalRotationZ:
-                        local_rot.z = value;
-                        set_rot = true;
-                        break;
-                    case CurvePropertyType::LocalRotationW:
-                        local_rot.w = value;
-                        set_rot = true;
-                        break;
+                    curve_count += clip.curves[i].curves.Size();
+                }
+                state.key_cursors.Resize(curve_count + 1, -1);
+            }
 
-                    case CurvePropertyType::LocalScaleX:
-                        local_scale.x = value;
-                        set_scale = true;
-                        break;
-                    case CurvePropertyType::LocalScaleY:
-                        local_scale.y = value;
-                        set_scale = true;
-                        break;
-                    case CurvePropertyType::LocalScaleZ:
-                        local_scale.z = value;
-                        set_scale = true;
-                        break;
+            int cursor_offset = 0;
+            for (int i = 0; i < clip.curves.Size(); ++i)
+            {
+                AnimationPose::SampleCurves(clip.curves[i], time, &state.key_cursors[cursor_offset], &m_sample[i * ANIMATION_POSE_BONE_SIZE]);
+                cursor_offset += clip.curves[i].curves.Size();
+            }
+        }
 
-                    case CurvePropertyType::Unknown:
-                        break;
-                }
+        for (int i = 0; i < binding.bones.Size(); ++i)
+        {
+            int bone = binding.bones[i];
+            Node* target = m_bone_targets[bone];
+            if (target == nullptr)
+            {
+                continue;
             }
 
-            if (set_pos)
+            const float* src = &m_sample[i * ANIMATION_POSE_BONE_SIZE];
+            float* dest = &m_pose[bone * ANIMATION_POSE_BONE_SIZE];
+
+            for (int j = 0; j < 3; ++j)
             {
-                Vector3 pos;
-                if (first_state)
-                {
-                    pos = local_pos * weight;
-                }
-                else
+                AnimationChannel channel = (AnimationChannel) (1 << j);
+                if ((binding.channels[i] & (int) channel) == 0)
                 {
-                    pos = target->GetLocalPosition() + local_pos * weight;
+                    continue;
                 }
-                target->SetLocalPosition(pos);
-            }
-            if (set_rot)
-            {
-                Quaternion rot;
+
+                const float* s = &src[j * 4];
+                float* d = &dest[j * 4];
+
                 if (first_state)
                 {
-                    rot = local_rot * weight;
+                    Simd::Mul(s, weight, d, 4);
                 }
                 else
                 {
-                    rot = Quaternion(target->GetLocalRotation());
-                    if (rot.Dot(local_rot) < 0)
+                    // not animated by the states before, blend onto the current transform
+                    if ((m_pose_channels[bone] & (int) channel) == 0)
                     {
-                        local_rot = local_rot * -1.0f;
+                        ReadNodeChannel(target, channel, d);
                     }
-                    rot.x += local_rot.x * weight;
-                    rot.y += local_rot.y * weight;
-                    rot.z += local_rot.z * weight;
-                    rot.w += local_rot.w * weight;
-                }
-                if (last_state)
-                {
-                    rot.Normalize();
+
+                    float w = weight;
+                    if (channel == AnimationChannel::Rotation && d[0] * s[0] + d[1] * s[1] + d[2] * s[2] + d[3] * s[3] < 0)
+                    {
+                        w = -weight;
+                    }
+                    Simd::MulAdd(s, w, d, 4);
                 }
+
+                m_pose_channels[bone] |= (int) channel;
+            }
+        }
+    }
+
+    void Animation::ApplyPose()
+    {
+        for (int i = 0; i < m_pose_channels.Size(); ++i)
+        {
+            int channels = m_pose_channels[i];
+            if (channels == 0)
+            {
+                continue;
+            }
+
+            Node* target = m_bone_targets[i];
+            const float* pose = &m_pose[i * ANIMATION_POSE_BONE_SIZE];
+
+            if (channels & (int) AnimationChannel::Position)
+            {
+                target->SetLocalPosition(Vector3(pose[0], pose[1], pose[2]));
+            }
+            if (channels & (int) AnimationChannel::Rotation)
+            {
+                Quaternion rot(pose[4], pose[5], pose[6], pose[7]);
+                rot.Normalize();
                 target->SetLocalRotation(rot);
             }
-            if (set_scale)
+            if (channels & (int) AnimationChannel::Scale)
             {
-                Vector3 scale;
-                if (first_state)
-                {
-                    scale = local_scale * weight;
-                }
-                else
-                {
-                    scale = target->GetLocalScale() + local_scale * weight;
-                }
-                target->SetLocalScale(scale);
+                target->SetLocalScale(Vector3(pose[8], pose[9], pose[10]));
             }
         }
     }
@@ -19,10 +19,14 @@
 
 #include "Node.h"
 #include "AnimationCurve.h"
+#include "AnimationPose.h"
+#include "CompressedAnimationClip.h"
 #include "container/List.h"
 
 namespace Viry3D
 {
+    class SkeletonBinding;
+
     enum class CurvePropertyType
     {
         Unknown = 0,
@@ -62,6 +66,8 @@ namespace Viry3D
         float fps;
         AnimationWrapMode wrap_mode;
         Vector<AnimationCurveWrapper> curves;
+        // replaces the keys of the curves once compressed, copies of the clip share it
+        Ref<CompressedAnimationClip> compressed;
     };
 
     enum class FadeState
@@ -75,7 +81,8 @@ namespace Viry3D
     {
         int clip_index;
         float play_start_time;
-        Vector<Node*> targets;
+        // key segment cursor of every curve of the clip in curve order, or of every compressed track
+        Vector<int> key_cursors;
         FadeState fade_state;
         float fade_start_time;
         float fade_length;
@@ -83,23 +90,57 @@ namespace Viry3D
         float weight;
     };
 
+    // states are sampled into a local pose buffer holding every bone the clips animate,
+    // blended there and written to the bone nodes once per update
     class Animation : public Node
     {
     public:
         Animation();
         virtual ~Animation();
-        void SetClips(Vector<AnimationClip>&& clips) { m_clips = std::move(clips); }
+        void SetClips(Vector<AnimationClip>&& clips);
+        const Vector<AnimationClip>& GetClips() const { return m_clips; }
         int GetClipCount() const { return m_clips.Size(); }
         const String& GetClipName(int index) const;
+        // resamples the clips at sample_rate, or at the clip fps when 0, for simd sampling of whole poses,
+        // costs memory per frame and bone and loses curve shape between frames
+        void CompileClips(float sample_rate = 0);
+        // replaces the clip curves with quantized keys, the curve keys are released afterwards,
+        // compress the clips of a model once and give copies of GetClips() to its other instances
+        void CompressClips(const AnimationCompression& compression = AnimationCompression());
         void Play(int index, float fade_length);
         void Stop();
         void Update();
+        // samples the animations on the job system, then writes the poses to the nodes on the calling thread in order,
+        // animations must not be nested in each other
+        static void UpdateAll(const Vector<Ref<Animation>>& animations);
 
     private:
-        void Sample(AnimationState& state, float time, float weight, bool first_state, bool last_state);
+        struct ClipBinding
+        {
+            // pose bone of each clip curve
+            Vector<int> bones;
+            Vector<int> channels;
+            Ref<CompiledAnimationClip> compiled;
+        };
+
+        void BindClips();
+        void BindBoneTargets();
+        // blends the playing states into the pose, only reads the bone nodes
+        void SamplePose();
+        void Sample(AnimationState& state, float time, float weight, bool first_state);
+        void ApplyPose();
 
     private:
         Vector<AnimationClip> m_clips;
+        Vector<ClipBinding> m_clip_bindings;
         List<AnimationState> m_states;
+        Vector<String> m_bone_paths;
+        Ref<SkeletonBinding> m_skeleton;
+        Vector<Node*> m_bone_targets;
+        bool m_bone_targets_dirty;
+        Vector<float> m_pose;
+        // AnimationChannel bits written to each pose bone in this update
+        Vector<int> m_pose_channels;
+        Vector<float> m_sample;
     };
 }
@@ -16,39 +16,72 @@
 */
 
 #include "AnimationCurve.h"
+#include "Debug.h"
 #include "math/Mathf.h"
 
 namespace Viry3D
 {
-    float AnimationCurve::Evaluate(float time, const Key& k0, const Key& k1)
+    void AnimationCurve::AddKey(float time, float value, float in_tangent, float out_tangent)
     {
-        float dt = k1.time - k0.time;
-        if (fabs(dt) < Mathf::Epsilon)
+        assert(m_keys.Empty() || time >= m_keys[m_keys.Size() - 1].time);
+
+        m_keys.Add(Key({ time, value, in_tangent, out_tangent }));
+
+        if (m_keys.Size() < 2)
         {
-            return k0.value;
+            return;
         }
 
-        float t = (time - k0.time) / dt;
-        float t2 = t * t;
-        float t3 = t2 * t;
-        float _t = 1 - t;
-        float _t2 = _t * _t;
-        float _t3 = _t2 * _t;
+        // bezier of the hermite segment from the previous key, expanded to power basis
+        const Key& k0 = m_keys[m_keys.Size() - 2];
+        const Key& k1 = m_keys[m_keys.Size() - 1];
+        Segment segment = { 0, 0, 0, k0.value };
 
-        float c = 1 / 3.0f;
-        float c0 = dt * c * k0.out_tangent + k0.value;
-        float c1 = -dt * c * k1.in_tangent + k1.value;
-        float value = k0.value * _t3 + 3 * c0 * t * _t2 + 3 * c1 * t2 * _t + k1.value * t3;
+        float dt = k1.time - k0.time;
+        if (fabs(dt) >= Mathf::Epsilon)
+        {
+            float c = 1 / 3.0f;
+            float p0 = k0.value;
+            float p1 = dt * c * k0.out_tangent + k0.value;
+            float p2 = -dt * c * k1.in_tangent + k1.value;
+            float p3 = k1.value;
+            float inv_dt = 1 / dt;
+
+            segment.a = (p3 - 3 * p2 + 3 * p1 - p0) * inv_dt * inv_dt * inv_dt;
+            segment.b = 3 * (p0 - 2 * p1 + p2) * inv_dt * inv_dt;
+            segment.c = 3 * (p1 - p0) * inv_dt;
+        }
 
-        return value;
+        m_segments.Add(segment);
     }
 
-    void AnimationCurve::AddKey(float time, float value, float in_tangent, float out_tangent)
+    int AnimationCurve::FindSegment(float time) const
     {
-        m_keys.Add(Key({ time, value, in_tangent, out_tangent }));
+        // last key with key time <= time, the caller handles times out of the key range
+        int low = 0;
+        int high = m_keys.Size() - 1;
+        while (high - low > 1)
+        {
+            int mid = (low + high) / 2;
+            if (m_keys[mid].time <= time)
+            {
+                low = mid;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        return low;
     }
 
     float AnimationCurve::Evaluate(float time) const
+    {
+        int cursor = -1;
+        return this->Evaluate(time, cursor);
+    }
+
+    float AnimationCurve::Evaluate(float time, int& cursor) const
     {
         if (m_keys.Empty())
         {
@@ -61,23 +94,45 @@ namespace Viry3D
             return back.value;
         }
 
-        for (int i = 0; i < m_keys.Size(); ++i)
+        const auto& front = m_keys[0];
+        if (time < front.time)
         {
-            const auto& key = m_keys[i];
+            return front.value;
+        }
 
-            if (time < key.time)
+        // time is inside the keys, so there are at least 2 keys and segment + 1 is a valid key
+        int segment = cursor;
+        if (segment < 0 || segment >= m_segments.Size())
+        {
+            segment = this->FindSegment(time);
+        }
+        else if (time < m_keys[segment].time)
+        {
+            if (segment > 0 && time >= m_keys[segment - 1].time)
+            {
+                segment -= 1;
+            }
+            else
+            {
+                segment = this->FindSegment(time);
+            }
+        }
+        else if (time >= m_keys[segment + 1].time)
+        {
+            if (segment + 2 < m_keys.Size() && time < m_keys[segment + 2].time)
+            {
+                segment += 1;
+            }
+            else
             {
-                if (i == 0)
-                {
-                    return key.value;
-                }
-                else
-                {
-                    return Evaluate(time, m_keys[i - 1], key);
-                }
+                segment = this->FindSegment(time);
             }
         }
+        cursor = segment;
+
+        const Segment& s = m_segments[segment];
+        float x = time - m_keys[segment].time;
 
-        return 0;
+        return ((s.a * x + s.b) * x + s.c) * x + s.d;
     }
 }
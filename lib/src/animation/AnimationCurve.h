@@ -32,14 +32,28 @@ namespace Viry3D
             float out_tangent;
         };
 
+        // cubic polynomial of a key segment in time relative to the segment start
+        struct Segment
+        {
+            float a;
+            float b;
+            float c;
+            float d;
+        };
+
     public:
+        // keys are added in time order
         void AddKey(float time, float value, float in_tangent, float out_tangent);
         float Evaluate(float time) const;
+        // cursor caches the segment of the last evaluation, start with -1,
+        // time moving forward or backward by a segment is found without searching
+        float Evaluate(float time, int& cursor) const;
 
     private:
-        static float Evaluate(float time, const Key& k0, const Key& k1);
+        int FindSegment(float time) const;
         
     private:
         Vector<Key> m_keys;
+        Vector<Segment> m_segments;
     };
 }
@@ -0,0 +1,130 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "AnimationPose.h"
+#include "Animation.h"
+#include "math/Simd.h"
+
+namespace Viry3D
+{
+    static int GetChannelOffset(CurvePropertyType type)
+    {
+        switch (type)
+        {
+            case CurvePropertyType::LocalPositionX: return 0;
+            case CurvePropertyType::LocalPositionY: return 1;
+            case CurvePropertyType::LocalPositionZ: return 2;
+            case CurvePropertyType::LocalRotationX: return 4;
+            case CurvePropertyType::LocalRotationY: return 5;
+            case CurvePropertyType::LocalRotationZ: return 6;
+            case CurvePropertyType::LocalRotationW: return 7;
+            case CurvePropertyType::LocalScaleX: return 8;
+            case CurvePropertyType::LocalScaleY: return 9;
+            case CurvePropertyType::LocalScaleZ: return 10;
+            case CurvePropertyType::Unknown: return -1;
+        }
+        return -1;
+    }
+
+    int AnimationPose::GetChannelMask(const AnimationCurveWrapper& curve)
+    {
+        int mask = 0;
+        for (int i = 0; i < curve.property_types.Size(); ++i)
+        {
+            int offset = GetChannelOffset(curve.property_types[i]);
+            if (offset >= 0)
+            {
+                mask |= 1 << (offset / 4);
+            }
+        }
+        return mask;
+    }
+
+    void AnimationPose::SampleCurves(const AnimationCurveWrapper& curve, float time, int* key_cursors, float* bone)
+    {
+        for (int i = 0; i < ANIMATION_POSE_BONE_SIZE; ++i)
+        {
+            bone[i] = 0;
+        }
+        bone[7] = 1;
+
+        for (int i = 0; i < curve.property_types.Size(); ++i)
+        {
+            int offset = GetChannelOffset(curve.property_types[i]);
+            if (offset >= 0)
+            {
+                bone[offset] = curve.curves[i].Evaluate(time, key_cursors[i]);
+            }
+        }
+    }
+
+    Ref<CompiledAnimationClip> CompiledAnimationClip::Compile(const AnimationClip& clip, float sample_rate)
+    {
+        Ref<CompiledAnimationClip> compiled = RefMake<CompiledAnimationClip>();
+        compiled->SetName(clip.name);
+        compiled->m_bone_count = clip.curves.Size();
+        compiled->m_sample_rate = sample_rate;
+        compiled->m_frame_count = Mathf::Max((int) ceil(clip.length * sample_rate - Mathf::Epsilon), 0) + 1;
+
+        int frame_size = compiled->m_bone_count * ANIMATION_POSE_BONE_SIZE;
+        compiled->m_frames.Resize(compiled->m_frame_count * frame_size);
+
+        for (int i = 0; i < clip.curves.Size(); ++i)
+        {
+            const auto& curve = clip.curves[i];
+            Vector<int> key_cursors(curve.curves.Size(), -1);
+
+            for (int j = 0; j < compiled->m_frame_count; ++j)
+            {
+                float time = Mathf::Min(j / sample_rate, clip.length);
+                float* bone = &compiled->m_frames[j * frame_size + i * ANIMATION_POSE_BONE_SIZE];
+                AnimationPose::SampleCurves(curve, time, key_cursors.Empty() ? nullptr : &key_cursors[0], bone);
+
+                // keep neighbor rotations in one hemisphere so interpolating components stays short
+                if (j > 0)
+                {
+                    const float* prev = bone - frame_size;
+                    float dot = prev[4] * bone[4] + prev[5] * bone[5] + prev[6] * bone[6] + prev[7] * bone[7];
+                    if (dot < 0)
+                    {
+                        for (int k = 4; k < 8; ++k)
+                        {
+                            bone[k] = -bone[k];
+                        }
+                    }
+                }
+            }
+        }
+
+        return compiled;
+    }
+
+    void CompiledAnimationClip::Sample(float time, float* pose) const
+    {
+        int frame_size = m_bone_count * ANIMATION_POSE_BONE_SIZE;
+        if (frame_size == 0)
+        {
+            return;
+        }
+
+        float frame = Mathf::Clamp(time * m_sample_rate, 0.0f, (float) (m_frame_count - 1));
+        int frame0 = (int) frame;
+        int frame1 = Mathf::Min(frame0 + 1, m_frame_count - 1);
+
+        Simd::Lerp(&m_frames[frame0 * frame_size], &m_frames[frame1 * frame_size], frame - frame0, pose, frame_size);
+    }
+}
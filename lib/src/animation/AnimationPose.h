@@ -0,0 +1,65 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Object.h"
+#include "container/Vector.h"
+
+// floats of one bone in a pose: position xyz_, rotation xyzw, scale xyz_, each a simd float4
+#define ANIMATION_POSE_BONE_SIZE 12
+
+namespace Viry3D
+{
+    struct AnimationClip;
+    struct AnimationCurveWrapper;
+
+    enum class AnimationChannel
+    {
+        Position = 1,
+        Rotation = 2,
+        Scale = 4,
+    };
+
+    class AnimationPose
+    {
+    public:
+        // channels with at least one curve, as AnimationChannel bits
+        static int GetChannelMask(const AnimationCurveWrapper& curve);
+        // evaluates the curves of one bone, components without curves are 0 and rotation w is 1
+        static void SampleCurves(const AnimationCurveWrapper& curve, float time, int* key_cursors, float* bone);
+    };
+
+    // clip resampled at a fixed rate into one pose per frame,
+    // sampling interpolates two whole frames with simd instead of evaluating curves one by one
+    class CompiledAnimationClip : public Object
+    {
+    public:
+        static Ref<CompiledAnimationClip> Compile(const AnimationClip& clip, float sample_rate);
+        int GetBoneCount() const { return m_bone_count; }
+        int GetFrameCount() const { return m_frame_count; }
+        float GetSampleRate() const { return m_sample_rate; }
+        // writes GetBoneCount() bones in clip curve order
+        void Sample(float time, float* pose) const;
+
+    private:
+        int m_bone_count = 0;
+        int m_frame_count = 0;
+        float m_sample_rate = 0;
+        Vector<float> m_frames;
+    };
+}
@@ -0,0 +1,415 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "CompressedAnimationClip.h"
+#include "Animation.h"
+#include "Debug.h"
+#include "memory/Memory.h"
+#include <algorithm>
+
+// smallest three components of a unit quaternion are in [-1 / sqrt(2), 1 / sqrt(2)]
+#define ROTATION_COMPONENT_RANGE 0.70710678f
+#define ROTATION_COMPONENT_MAX 32767
+#define VALUE_MAX 65535
+// longest segment key removal tries, keeps the scan linear in the frame count
+#define SEGMENT_FRAME_MAX 32
+
+namespace Viry3D
+{
+    static void EncodeRotation(const float* rot, unsigned short* data)
+    {
+        int largest = 0;
+        for (int i = 1; i < 4; ++i)
+        {
+            if (fabs(rot[i]) > fabs(rot[largest]))
+            {
+                largest = i;
+            }
+        }
+
+        // q and -q are the same rotation, make the dropped component positive
+        float sign = rot[largest] < 0 ? -1.0f : 1.0f;
+
+        int values[3];
+        int count = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (i != largest)
+            {
+                float v = rot[i] * sign / ROTATION_COMPONENT_RANGE * 0.5f + 0.5f;
+                values[count++] = Mathf::Clamp(Mathf::RoundToInt(v * ROTATION_COMPONENT_MAX), 0, ROTATION_COMPONENT_MAX);
+            }
+        }
+
+        // 15 bits per component, the dropped index in the low bits of the first two
+        data[0] = (unsigned short) ((values[0] << 1) | (largest >> 1));
+        data[1] = (unsigned short) ((values[1] << 1) | (largest & 1));
+        data[2] = (unsigned short) (values[2] << 1);
+    }
+
+    static void DecodeRotation(const unsigned short* data, float* rot)
+    {
+        int largest = ((data[0] & 1) << 1) | (data[1] & 1);
+
+        float sum = 0;
+        int count = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (i != largest)
+            {
+                float v = (data[count++] >> 1) / (float) ROTATION_COMPONENT_MAX;
+                rot[i] = (v * 2.0f - 1.0f) * ROTATION_COMPONENT_RANGE;
+                sum += rot[i] * rot[i];
+            }
+        }
+        rot[largest] = sqrt(Mathf::Max(1.0f - sum, 0.0f));
+    }
+
+    static void EncodeValue(const float* value, const float* min, const float* extent, unsigned short* data)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            float v = extent[i] > 0 ? (value[i] - min[i]) / extent[i] : 0.0f;
+            data[i] = (unsigned short) Mathf::Clamp(Mathf::RoundToInt(v * VALUE_MAX), 0, VALUE_MAX);
+        }
+    }
+
+    static void DecodeValue(const unsigned short* data, const float* min, const float* extent, float* value)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            value[i] = min[i] + data[i] / (float) VALUE_MAX * extent[i];
+        }
+    }
+
+    static float Dot4(const float* a, const float* b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    }
+
+    // max component error of lerping decoded frames start and end against the source frames between them
+    static bool IsSegmentLinear(const Vector<float>& source, const Vector<float>& decoded, int start, int end, int channel, float tolerance)
+    {
+        const float* a = &decoded[start * 4];
+        const float* b = &decoded[end * 4];
+        float b_sign = channel == (int) AnimationChannel::Rotation && Dot4(a, b) < 0 ? -1.0f : 1.0f;
+
+        for (int i = start + 1; i < end; ++i)
+        {
+            float t = (i - start) / (float) (end - start);
+            float value[4];
+            for (int j = 0; j < 4; ++j)
+            {
+                value[j] = Mathf::Lerp(a[j], b[j] * b_sign, t);
+            }
+
+            const float* expected = &source[i * 4];
+            float sign = 1.0f;
+            if (channel == (int) AnimationChannel::Rotation)
+            {
+                float length = sqrt(Dot4(value, value));
+                if (length > 0)
+                {
+                    for (int j = 0; j < 4; ++j)
+                    {
+                        value[j] /= length;
+                    }
+                }
+                sign = Dot4(value, expected) < 0 ? -1.0f : 1.0f;
+            }
+
+            for (int j = 0; j < 4; ++j)
+            {
+                if (fabs(value[j] * sign - expected[j]) > tolerance)
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    Ref<CompressedAnimationClip> CompressedAnimationClip::Compress(const AnimationClip& clip, const AnimationCompression& compression)
+    {
+        float sample_rate = compression.sample_rate;
+        if (sample_rate <= 0)
+        {
+            sample_rate = clip.fps > 0 ? clip.fps : 30;
+        }
+
+        Ref<CompressedAnimationClip> compressed = RefMake<CompressedAnimationClip>();
+        compressed->SetName(clip.name);
+        compressed->m_bone_count = clip.curves.Size();
+        compressed->m_sample_rate = sample_rate;
+        compressed->m_frame_count = Mathf::Max((int) ceil(clip.length * sample_rate - Mathf::Epsilon), 0) + 1;
+        compressed->m_tracks.Resize(compressed->m_bone_count * 3);
+
+        int frame_count = compressed->m_frame_count;
+        if (frame_count > VALUE_MAX + 1)
+        {
+            Log("animation clip %s has too many frames to compress: %d", clip.name.CString(), frame_count);
+            return Ref<CompressedAnimationClip>();
+        }
+
+        Vector<float> bone(ANIMATION_POSE_BONE_SIZE);
+        Vector<float> source(frame_count * 4);
+        Vector<float> decoded(frame_count * 4);
+        Vector<unsigned short> encoded(frame_count * 3);
+
+        for (int i = 0; i < clip.curves.Size(); ++i)
+        {
+            const auto& curve = clip.curves[i];
+            int channels = AnimationPose::GetChannelMask(curve);
+            Vector<float> frames(frame_count * ANIMATION_POSE_BONE_SIZE);
+            Vector<int> key_cursors(curve.curves.Size(), -1);
+
+            for (int j = 0; j < frame_count; ++j)
+            {
+                float time = Mathf::Min(j / sample_rate, clip.length);
+                AnimationPose::SampleCurves(curve, time, key_cursors.Empty() ? nullptr : &key_cursors[0], &frames[j * ANIMATION_POSE_BONE_SIZE]);
+            }
+
+            for (int j = 0; j < 3; ++j)
+            {
+                int channel = 1 << j;
+                Track& track = compressed->m_tracks[i * 3 + j];
+                track.format = TrackFormat::None;
+                track.key_offset = 0;
+                track.key_count = 0;
+                for (int k = 0; k < 4; ++k)
+                {
+                    track.value[k] = 0;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    track.extent[k] = 0;
+                }
+
+                if ((channels & channel) == 0)
+                {
+                    continue;
+                }
+
+                float tolerance = compression.position_tolerance;
+                if (channel == (int) AnimationChannel::Rotation)
+                {
+                    tolerance = compression.rotation_tolerance;
+                }
+                else if (channel == (int) AnimationChannel::Scale)
+                {
+                    tolerance = compression.scale_tolerance;
+                }
+
+                for (int k = 0; k < frame_count; ++k)
+                {
+                    Memory::Copy(&source[k * 4], &frames[k * ANIMATION_POSE_BONE_SIZE + j * 4], sizeof(float) * 4);
+
+                    // keep neighbor rotations in one hemisphere, sampling interpolates the same way
+                    if (channel == (int) AnimationChannel::Rotation && k > 0 && Dot4(&source[(k - 1) * 4], &source[k * 4]) < 0)
+                    {
+                        for (int l = 0; l < 4; ++l)
+                        {
+                            source[k * 4 + l] = -source[k * 4 + l];
+                        }
+                    }
+                }
+
+                // constant track
+                bool constant = true;
+                for (int k = 1; k < frame_count && constant; ++k)
+                {
+                    for (int l = 0; l < 4; ++l)
+                    {
+                        if (fabs(source[k * 4 + l] - source[l]) > tolerance)
+                        {
+                            constant = false;
+                            break;
+                        }
+                    }
+                }
+
+                if (constant)
+                {
+                    track.format = TrackFormat::Constant;
+                    Memory::Copy(track.value, &source[0], sizeof(float) * 4);
+                    continue;
+                }
+
+                // quantize every frame, key removal measures the error of decoded values
+                if (channel == (int) AnimationChannel::Rotation)
+                {
+                    for (int k = 0; k < frame_count; ++k)
+                    {
+                        EncodeRotation(&source[k * 4], &encoded[k * 3]);
+                        DecodeRotation(&encoded[k * 3], &decoded[k * 4]);
+                    }
+                }
+                else
+                {
+                    for (int l = 0; l < 3; ++l)
+                    {
+                        float min = source[l];
+                        float max = source[l];
+                        for (int k = 1; k < frame_count; ++k)
+                        {
+                            min = Mathf::Min(min, source[k * 4 + l]);
+                            max = Mathf::Max(max, source[k * 4 + l]);
+                        }
+                        track.value[l] = min;
+                        track.extent[l] = max - min;
+                    }
+
+                    for (int k = 0; k < frame_count; ++k)
+                    {
+                        EncodeValue(&source[k * 4], track.value, track.extent, &encoded[k * 3]);
+                        DecodeValue(&encoded[k * 3], track.value, track.extent, &decoded[k * 4]);
+                        decoded[k * 4 + 3] = 0;
+                    }
+                }
+
+                // extend each segment while the frames it skips stay within tolerance
+                Vector<int> keys;
+                keys.Add(0);
+                int start = 0;
+                for (int k = 2; k < frame_count; ++k)
+                {
+                    if (k - start > SEGMENT_FRAME_MAX || !IsSegmentLinear(source, decoded, start, k, channel, tolerance))
+                    {
+                        start = k - 1;
+                        keys.Add(start);
+                    }
+                }
+                keys.Add(frame_count - 1);
+
+                track.format = TrackFormat::Animated;
+                track.key_offset = compressed->m_key_frames.Size();
+                track.key_count = keys.Size();
+
+                for (int k = 0; k < keys.Size(); ++k)
+                {
+                    compressed->m_key_frames.Add((unsigned short) keys[k]);
+                    compressed->m_key_data.Add(encoded[keys[k] * 3 + 0]);
+                    compressed->m_key_data.Add(encoded[keys[k] * 3 + 1]);
+                    compressed->m_key_data.Add(encoded[keys[k] * 3 + 2]);
+                }
+            }
+        }
+
+        return compressed;
+    }
+
+    int CompressedAnimationClip::GetMemorySize() const
+    {
+        return sizeof(CompressedAnimationClip) + m_tracks.SizeInBytes() + m_key_frames.SizeInBytes() + m_key_data.SizeInBytes();
+    }
+
+    static int FindKeySegment(const unsigned short* frames, int count, float frame, int& cursor)
+    {
+        int segment_count = count - 1;
+
+        if (cursor >= 0 && cursor < segment_count)
+        {
+            if (frame >= frames[cursor] && frame <= frames[cursor + 1])
+            {
+                return cursor;
+            }
+            if (cursor + 1 < segment_count && frame >= frames[cursor + 1] && frame <= frames[cursor + 2])
+            {
+                return ++cursor;
+            }
+            if (cursor > 0 && frame >= frames[cursor - 1] && frame <= frames[cursor])
+            {
+                return --cursor;
+            }
+        }
+
+        int index = (int) (std::upper_bound(frames, frames + count, frame) - frames) - 1;
+        cursor = Mathf::Clamp(index, 0, segment_count - 1);
+
+        return cursor;
+    }
+
+    void CompressedAnimationClip::SampleTrack(const Track& track, int channel, float frame, int& cursor, float* value) const
+    {
+        if (track.format == TrackFormat::Constant)
+        {
+            Memory::Copy(value, track.value, sizeof(float) * 4);
+            return;
+        }
+
+        const unsigned short* frames = &m_key_frames[track.key_offset];
+        int segment = FindKeySegment(frames, track.key_count, frame, cursor);
+        const unsigned short* data = &m_key_data[(track.key_offset + segment) * 3];
+        float t = (frame - frames[segment]) / (float) (frames[segment + 1] - frames[segment]);
+        t = Mathf::Clamp01(t);
+
+        float a[4];
+        float b[4];
+        if (channel == (int) AnimationChannel::Rotation)
+        {
+            DecodeRotation(&data[0], a);
+            DecodeRotation(&data[3], b);
+            if (Dot4(a, b) < 0)
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    b[i] = -b[i];
+                }
+            }
+            for (int i = 0; i < 4; ++i)
+            {
+                value[i] = Mathf::Lerp(a[i], b[i], t);
+            }
+        }
+        else
+        {
+            DecodeValue(&data[0], track.value, track.extent, a);
+            DecodeValue(&data[3], track.value, track.extent, b);
+            for (int i = 0; i < 3; ++i)
+            {
+                value[i] = Mathf::Lerp(a[i], b[i], t);
+            }
+            value[3] = 0;
+        }
+    }
+
+    void CompressedAnimationClip::Sample(float time, int* key_cursors, float* pose) const
+    {
+        float frame = Mathf::Clamp(time * m_sample_rate, 0.0f, (float) (m_frame_count - 1));
+
+        for (int i = 0; i < m_bone_count; ++i)
+        {
+            float* bone = &pose[i * ANIMATION_POSE_BONE_SIZE];
+            for (int j = 0; j < ANIMATION_POSE_BONE_SIZE; ++j)
+            {
+                bone[j] = 0;
+            }
+            bone[7] = 1;
+
+            for (int j = 0; j < 3; ++j)
+            {
+                const Track& track = m_tracks[i * 3 + j];
+                if (track.format != TrackFormat::None)
+                {
+                    this->SampleTrack(track, 1 << j, frame, key_cursors[i * 3 + j], &bone[j * 4]);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include "Object.h"
+#include "container/Vector.h"
+
+namespace Viry3D
+{
+    struct AnimationClip;
+
+    struct AnimationCompression
+    {
+        // frames the clip is resampled at before removing keys, 0 for the clip fps
+        float sample_rate = 0;
+        // max error of a component at the resampled frames after key removal and quantization
+        float position_tolerance = 0.001f;
+        float rotation_tolerance = 0.0005f;
+        float scale_tolerance = 0.001f;
+    };
+
+    // clip with constant and linearly redundant keys removed,
+    // rotations stored as 48 bit smallest three and positions / scales as 16 bits in the track range
+    class CompressedAnimationClip : public Object
+    {
+    public:
+        static Ref<CompressedAnimationClip> Compress(const AnimationClip& clip, const AnimationCompression& compression);
+        int GetBoneCount() const { return m_bone_count; }
+        int GetTrackCount() const { return m_tracks.Size(); }
+        int GetKeyCount() const { return m_key_frames.Size(); }
+        int GetMemorySize() const;
+        // writes GetBoneCount() bones in clip curve order,
+        // key_cursors holds GetTrackCount() cursors starting with -1
+        void Sample(float time, int* key_cursors, float* pose) const;
+
+    private:
+        enum class TrackFormat
+        {
+            None,
+            Constant,
+            Animated,
+        };
+
+        struct Track
+        {
+            TrackFormat format;
+            int key_offset;
+            int key_count;
+            // constant value, or range min of animated position and scale
+            float value[4];
+            float extent[3];
+        };
+
+        void SampleTrack(const Track& track, int channel, float frame, int& cursor, float* value) const;
+
+    private:
+        int m_bone_count = 0;
+        int m_frame_count = 0;
+        float m_sample_rate = 0;
+        // position, rotation, scale of each bone
+        Vector<Track> m_tracks;
+        Vector<unsigned short> m_key_frames;
+        // 3 values of each key
+        Vector<unsigned short> m_key_data;
+    };
+}
@@ -0,0 +1,185 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "SkeletonBinding.h"
+#include "Node.h"
+#include "memory/Memory.h"
+#include "math/Mathf.h"
+
+namespace Viry3D
+{
+    Map<Node*, WeakRef<SkeletonBinding>> SkeletonBinding::m_bindings;
+    Mutex SkeletonBinding::m_mutex;
+
+    // fnv-1a
+    static unsigned int HashPath(const char* str, int size)
+    {
+        unsigned int hash = 2166136261u;
+        for (int i = 0; i < size; ++i)
+        {
+            hash ^= (unsigned char) str[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    Ref<SkeletonBinding> SkeletonBinding::Get(Node* root)
+    {
+        // released after the lock, its destructor takes the lock too
+        Ref<SkeletonBinding> stale;
+
+        std::lock_guard<Mutex> lock(m_mutex);
+
+        Ref<SkeletonBinding> binding;
+
+        WeakRef<SkeletonBinding>* binding_ptr = nullptr;
+        if (m_bindings.TryGet(root, &binding_ptr))
+        {
+            binding = binding_ptr->lock();
+        }
+
+        // a new node at the address of a destroyed root, or nodes added / removed below root since
+        if (!binding || !binding->IsBuiltFrom(root))
+        {
+            stale = binding;
+            binding = RefMake<SkeletonBinding>(root);
+
+            if (binding_ptr)
+            {
+                *binding_ptr = binding;
+            }
+            else
+            {
+                m_bindings.Add(root, binding);
+            }
+        }
+
+        return binding;
+    }
+
+    SkeletonBinding::SkeletonBinding(Node* root):
+        m_root(root),
+        m_version(root->GetHierarchyVersion())
+    {
+        this->AddNodes(root, "");
+    }
+
+    SkeletonBinding::~SkeletonBinding()
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+
+        // the entry may already point to a binding rebuilt for the same root
+        WeakRef<SkeletonBinding>* binding_ptr;
+        if (m_bindings.TryGet(m_root, &binding_ptr) && binding_ptr->expired())
+        {
+            m_bindings.Remove(m_root);
+        }
+    }
+
+    bool SkeletonBinding::IsBuiltFrom(Node* root) const
+    {
+        return root == m_root && root->GetHierarchyVersion() == m_version;
+    }
+
+    void SkeletonBinding::AddNodes(Node* node, const String& path)
+    {
+        for (int i = 0; i < node->GetChildCount(); ++i)
+        {
+            const auto& child = node->GetChild(i);
+            String child_path = path.Empty() ? child->GetName() : path + "/" + child->GetName();
+
+            this->AddNode(child, child_path);
+            this->AddNodes(child.get(), child_path);
+        }
+    }
+
+    void SkeletonBinding::AddNode(const Ref<Node>& node, const String& path)
+    {
+        // siblings with the same name resolve to the first one, as Node::Find does
+        if (this->FindIndex(path) >= 0)
+        {
+            return;
+        }
+
+        int index = m_nodes.Size();
+        m_nodes.Add(node);
+        m_paths.Add(path);
+        m_hashes.Add(HashPath(path.CString(), path.Size()));
+
+        // keep the table at most half full
+        if (m_table.Size() < m_nodes.Size() * 2)
+        {
+            int size = Mathf::Max(m_table.Size() * 2, 64);
+            m_table.Clear();
+            m_table.Resize(size, -1);
+
+            for (int i = 0; i < m_nodes.Size(); ++i)
+            {
+                int slot = m_hashes[i] & (size - 1);
+                while (m_table[slot] >= 0)
+                {
+                    slot = (slot + 1) & (size - 1);
+                }
+                m_table[slot] = i;
+            }
+        }
+        else
+        {
+            int slot = m_hashes[index] & (m_table.Size() - 1);
+            while (m_table[slot] >= 0)
+            {
+                slot = (slot + 1) & (m_table.Size() - 1);
+            }
+            m_table[slot] = index;
+        }
+    }
+
+    int SkeletonBinding::FindIndex(const String& path, int start) const
+    {
+        int size = path.Size() - start;
+        if (size <= 0 || m_table.Empty())
+        {
+            return -1;
+        }
+
+        const char* str = path.CString() + start;
+        unsigned int hash = HashPath(str, size);
+        int mask = m_table.Size() - 1;
+
+        for (int slot = hash & mask; m_table[slot] >= 0; slot = (slot + 1) & mask)
+        {
+            int index = m_table[slot];
+            if (m_hashes[index] == hash && m_paths[index].Size() == size && Memory::Compare(m_paths[index].CString(), str, size) == 0)
+            {
+                return index;
+            }
+        }
+
+        return -1;
+    }
+
+    Ref<Node> SkeletonBinding::Find(const String& path) const
+    {
+        int index = this->FindIndex(path);
+        if (index >= 0)
+        {
+            return m_nodes[index].lock();
+        }
+
+        return Ref<Node>();
+    }
+}
@@ -0,0 +1,61 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Object.h"
+#include "container/Vector.h"
+#include "container/Map.h"
+#include "thread/ThreadPool.h"
+
+namespace Viry3D
+{
+    class Node;
+
+    // hashed path to node table of a hierarchy, paths are relative to the root as in Node::Find,
+    // built once per root and shared by the skinned mesh renderers and animations of the rig
+    class SkeletonBinding : public Object
+    {
+    public:
+        // the binding of root, rebuilt when the hierarchy below root changed since it was built
+        static Ref<SkeletonBinding> Get(Node* root);
+        explicit SkeletonBinding(Node* root);
+        virtual ~SkeletonBinding();
+        int GetNodeCount() const { return m_nodes.Size(); }
+        // -1 if no node is at path, the first start chars of path are skipped
+        int FindIndex(const String& path, int start = 0) const;
+        Ref<Node> GetNode(int index) const { return m_nodes[index].lock(); }
+        Ref<Node> Find(const String& path) const;
+        // false once nodes were attached or detached anywhere below root, users then get a new binding
+        bool IsBuiltFrom(Node* root) const;
+
+    private:
+        void AddNodes(Node* node, const String& path);
+        void AddNode(const Ref<Node>& node, const String& path);
+
+    private:
+        static Map<Node*, WeakRef<SkeletonBinding>> m_bindings;
+        static Mutex m_mutex;
+        Node* m_root;
+        int m_version;
+        Vector<WeakRef<Node>> m_nodes;
+        Vector<String> m_paths;
+        Vector<unsigned int> m_hashes;
+        // open addressing slots holding node indices, -1 when empty
+        Vector<int> m_table;
+    };
+}
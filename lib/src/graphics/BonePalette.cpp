@@ -0,0 +1,190 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "BonePalette.h"
+
+#if VR_VULKAN
+
+#include "BufferObject.h"
+#include "Debug.h"
+#include "math/Mathf.h"
+
+// vectors of the first buffer, 4096 / 3 bones
+#define BONE_PALETTE_SIZE_MIN 4096
+
+namespace Viry3D
+{
+    Ref<BufferObject> BonePalette::m_buffer;
+    Vector<Vector4> BonePalette::m_vectors;
+    List<BonePalette::Range> BonePalette::m_free_ranges;
+    int BonePalette::m_dirty_begin = 0;
+    int BonePalette::m_dirty_end = 0;
+    int BonePalette::m_version = 0;
+
+    void BonePalette::Done()
+    {
+        if (m_buffer)
+        {
+            m_buffer->Destroy(Display::Instance()->GetDevice());
+            m_buffer.reset();
+        }
+        m_vectors.Clear();
+        m_free_ranges.Clear();
+        m_dirty_begin = 0;
+        m_dirty_end = 0;
+    }
+
+    void BonePalette::Grow(int size)
+    {
+        int old_size = m_vectors.Size();
+        int new_size = Mathf::Max(old_size * 2, BONE_PALETTE_SIZE_MIN);
+        while (new_size < old_size + size)
+        {
+            new_size *= 2;
+        }
+
+        m_vectors.Resize(new_size, Vector4(0, 0, 0, 0));
+
+        // a free range at the end grows with the palette
+        if (!m_free_ranges.Empty() && m_free_ranges.Last().offset + m_free_ranges.Last().size == old_size)
+        {
+            m_free_ranges.Last().size += new_size - old_size;
+        }
+        else
+        {
+            m_free_ranges.AddLast({ old_size, new_size - old_size });
+        }
+
+        // frames in flight still read the old buffer, its release waits for them
+        if (m_buffer)
+        {
+            m_buffer->Destroy(Display::Instance()->GetDevice());
+        }
+        m_buffer = Display::Instance()->CreateBuffer(nullptr, m_vectors.SizeInBytes(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, true, VK_FORMAT_UNDEFINED);
+
+        // the new buffer starts empty
+        m_dirty_begin = 0;
+        m_dirty_end = old_size;
+
+        m_version += 1;
+    }
+
+    int BonePalette::Allocate(int bone_count)
+    {
+        int size = bone_count * 3;
+
+        for (int i = 0; i < 2; ++i)
+        {
+            for (auto j = m_free_ranges.begin(); j != m_free_ranges.end(); ++j)
+            {
+                if (j->size >= size)
+                {
+                    int offset = j->offset;
+                    j->offset += size;
+                    j->size -= size;
+                    if (j->size == 0)
+                    {
+                        m_free_ranges.Remove(j);
+                    }
+                    return offset;
+                }
+            }
+
+            Grow(size);
+        }
+
+        assert(false);
+        return -1;
+    }
+
+    void BonePalette::Reserve(int size)
+    {
+        // the free ranges before the end may be too fragmented for the allocations,
+        // but first fit never needs more than one range at the end holding all of them
+        int tail_size = 0;
+        if (!m_free_ranges.Empty() && m_free_ranges.Last().offset + m_free_ranges.Last().size == m_vectors.Size())
+        {
+            tail_size = m_free_ranges.Last().size;
+        }
+
+        if (tail_size < size)
+        {
+            Grow(size - tail_size);
+        }
+    }
+
+    void BonePalette::Free(int offset, int bone_count)
+    {
+        int size = bone_count * 3;
+
+        auto next = m_free_ranges.begin();
+        while (next != m_free_ranges.end() && next->offset < offset)
+        {
+            ++next;
+        }
+
+        auto i = m_free_ranges.AddBefore(next, { offset, size });
+
+        // merge with following range
+        if (next != m_free_ranges.end() && i->offset + i->size == next->offset)
+        {
+            i->size += next->size;
+            m_free_ranges.Remove(next);
+        }
+
+        // merge with previous range
+        if (i != m_free_ranges.begin())
+        {
+            auto prev = i;
+            --prev;
+            if (prev->offset + prev->size == i->offset)
+            {
+                prev->size += i->size;
+                m_free_ranges.Remove(i);
+            }
+        }
+    }
+
+    void BonePalette::SetBones(int offset, const Vector<Vector4>& vectors)
+    {
+        Memory::Copy(&m_vectors[offset], vectors.Bytes(), vectors.SizeInBytes());
+
+        if (m_dirty_end > m_dirty_begin)
+        {
+            m_dirty_begin = Mathf::Min(m_dirty_begin, offset);
+            m_dirty_end = Mathf::Max(m_dirty_end, offset + vectors.Size());
+        }
+        else
+        {
+            m_dirty_begin = offset;
+            m_dirty_end = offset + vectors.Size();
+        }
+    }
+
+    void BonePalette::Upload()
+    {
+        if (m_buffer && m_dirty_end > m_dirty_begin)
+        {
+            Display::Instance()->QueueUpdateBuffer(m_buffer, m_dirty_begin * sizeof(Vector4), &m_vectors[m_dirty_begin], (m_dirty_end - m_dirty_begin) * sizeof(Vector4));
+        }
+        m_dirty_begin = 0;
+        m_dirty_end = 0;
+    }
+}
+
+#endif
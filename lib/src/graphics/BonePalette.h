@@ -0,0 +1,71 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include "Display.h"
+
+#if VR_VULKAN
+
+#include "container/Vector.h"
+#include "container/List.h"
+#include "math/Vector4.h"
+
+namespace Viry3D
+{
+    class BufferObject;
+
+    // bone matrices of all skinned mesh renderers in one storage buffer, 3 row vectors per bone,
+    // renderers keep their range while alive and the written span is uploaded once per frame
+    class BonePalette
+    {
+    public:
+        static void Done();
+        // returns the first vector of the range
+        static int Allocate(int bone_count);
+        // grows the palette so a contiguous range of size vectors is free at the end,
+        // called before any renderer binds in a frame so the allocations after it never grow
+        static void Reserve(int size);
+        static void Free(int offset, int bone_count);
+        static void SetBones(int offset, const Vector<Vector4>& vectors);
+        // replaced when the palette grows, renderers bind it again before the frame is recorded
+        static const Ref<BufferObject>& GetBuffer() { return m_buffer; }
+        // changes every time the palette grows
+        static int GetVersion() { return m_version; }
+        static void Upload();
+
+    private:
+        struct Range
+        {
+            int offset;
+            int size;
+        };
+
+        static void Grow(int size);
+
+    private:
+        static Ref<BufferObject> m_buffer;
+        static Vector<Vector4> m_vectors;
+        static List<Range> m_free_ranges;
+        static int m_dirty_begin;
+        static int m_dirty_end;
+        static int m_version;
+    };
+}
+
+#endif
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "Display.h"
+#include "MemoryAllocator.h"
 #include "memory/Memory.h"
 
 namespace Viry3D
@@ -31,7 +32,6 @@ namespace Viry3D
         BufferObject(int size):
 #if VR_VULKAN
             m_buffer(VK_NULL_HANDLE),
-            m_memory(VK_NULL_HANDLE),
             m_buffer_view(VK_NULL_HANDLE),
             m_device_local(false),
 #elif VR_GLES
@@ -41,9 +41,7 @@ namespace Viry3D
 #endif
             m_size(size)
         {
-#if VR_VULKAN
-            Memory::Zero(&m_memory_info, sizeof(m_memory_info));
-#endif
+
         }
 
         int GetSize() const { return m_size; }
@@ -51,16 +49,24 @@ namespace Viry3D
 #if VR_VULKAN
         void Destroy(VkDevice device)
         {
-            if (m_buffer_view)
-            {
-                vkDestroyBufferView(device, m_buffer_view, nullptr);
-            }
-            vkDestroyBuffer(device, m_buffer, nullptr);
-            vkFreeMemory(device, m_memory, nullptr);
+            VkBuffer buffer = m_buffer;
+            VkBufferView buffer_view = m_buffer_view;
+            MemoryAllocation memory = m_memory;
+            m_buffer = VK_NULL_HANDLE;
+            m_buffer_view = VK_NULL_HANDLE;
+
+            Display::Instance()->ReleaseAfterFrames([=]() mutable {
+                if (buffer_view)
+                {
+                    vkDestroyBufferView(device, buffer_view, nullptr);
+                }
+                vkDestroyBuffer(device, buffer, nullptr);
+                Display::Instance()->FreeMemory(memory);
+            });
         }
 
         const VkBuffer& GetBuffer() const { return m_buffer; }
-        const VkDeviceMemory& GetMemory() const { return m_memory; }
+        const MemoryAllocation& GetMemory() const { return m_memory; }
         const VkBufferView& GetBufferView() const { return m_buffer_view; }
         bool IsDeviceLocal() const { return m_device_local; }
 #elif VR_GLES
@@ -82,8 +88,7 @@ namespace Viry3D
     private:
 #if VR_VULKAN
         VkBuffer m_buffer;
-        VkDeviceMemory m_memory;
-        VkMemoryAllocateInfo m_memory_info;
+        MemoryAllocation m_memory;
         VkBufferView m_buffer_view;
         bool m_device_local;
 #elif VR_GLES
@@ -22,13 +22,16 @@
 #include "Shader.h"
 #include "Debug.h"
 #include "Computer.h"
+#include "math/Frustum.h"
+#include "Application.h"
+#include "thread/JobSystem.h"
 
 namespace Viry3D
 {
 	Camera::Camera():
 #if VR_VULKAN
         m_render_pass(VK_NULL_HANDLE),
-        m_cmd_pool(VK_NULL_HANDLE),
+        m_next_cmd_pool(0),
         m_compute_cmd_pool(VK_NULL_HANDLE),
         m_render_pass_dirty(true),
         m_instance_cmds_dirty(true),
@@ -51,7 +54,10 @@ namespace Viry3D
         m_stereo_rendering(false),
         m_stereo_offset(0.06f),
         m_view_matrix_external(false),
-        m_projection_matrix_external(false)
+        m_projection_matrix_external(false),
+        m_culling_enabled(true),
+        m_visible_renderer_count(0),
+        m_culled_renderer_count(0)
 	{
 
 	}
@@ -295,6 +301,7 @@ namespace Viry3D
 		if (m_render_pass_dirty)
 		{
 			m_render_pass_dirty = false;
+			Display::Instance()->WaitFramesInFlight();
 			this->UpdateRenderPass();
 
 			m_instance_cmds_dirty = true;
@@ -313,6 +320,7 @@ namespace Viry3D
 		}
 
 		this->UpdateRenderers();
+        this->CullRenderers();
 
 #if VR_VULKAN
 		this->UpdateInstanceCmds();
@@ -327,7 +335,10 @@ namespace Viry3D
 
         for (auto& i : m_renderers)
         {
-            i.renderer->OnDraw();
+            if (i.visible)
+            {
+                i.renderer->OnDraw();
+            }
         }
 
         this->ResolveMultiSample();
@@ -609,7 +620,7 @@ namespace Viry3D
 #if VR_VULKAN
                 if (i->cmd)
                 {
-                    vkFreeCommandBuffers(device, m_cmd_pool, 1, &i->cmd);
+                    vkFreeCommandBuffers(device, m_cmd_pools[i->cmd_pool_index], 1, &i->cmd);
                 }
 
                 if (i->compute_cmd)
@@ -642,6 +653,49 @@ namespace Viry3D
         }
     }
 
+    void Camera::CullRenderers()
+    {
+        // one frustum can not cover both eyes, so stereo cameras draw everything
+        bool culling = m_culling_enabled && !m_stereo_rendering;
+        Frustum frustum;
+        if (culling)
+        {
+            frustum = Frustum(this->GetProjectionMatrix() * this->GetViewMatrix());
+        }
+
+        m_visible_renderer_count = 0;
+        m_culled_renderer_count = 0;
+
+        for (auto& i : m_renderers)
+        {
+            bool visible = true;
+            Bounds bounds;
+
+            if (culling && i.renderer->GetBounds(bounds))
+            {
+                visible = frustum.ContainsBounds(bounds.Min(), bounds.Max()) != ContainsResult::Out;
+            }
+
+            if (i.visible != visible)
+            {
+                i.visible = visible;
+
+#if VR_VULKAN
+                Display::Instance()->MarkPrimaryCmdDirty();
+#endif
+            }
+
+            if (visible)
+            {
+                m_visible_renderer_count += 1;
+            }
+            else
+            {
+                m_culled_renderer_count += 1;
+            }
+        }
+    }
+
 #if VR_VULKAN
     void Camera::UpdateRenderPass()
     {
@@ -675,48 +729,122 @@ namespace Viry3D
         }
     }
 
+    struct InstanceCmdDraw
+    {
+        VkPipelineLayout pipeline_layout;
+        VkPipeline pipeline;
+        Vector<VkDescriptorSet> descriptor_sets;
+        Rect scissor_rect;
+        int draw_index;
+    };
+
+    // everything an instance cmd needs, gathered on the main thread,
+    // as pipelines and other resources are created lazily and not thread safe
+    struct InstanceCmdRecord
+    {
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        Ref<BufferObject> vertex_buffer;
+        Vector<int> vertex_stream_offsets;
+        Ref<BufferObject> index_buffer;
+        IndexType index_type = IndexType::Uint16;
+        Ref<BufferObject> draw_buffer;
+        Ref<BufferObject> instance_buffer;
+        Vector<InstanceCmdDraw> draws;
+        // empty cmd when nothing can be drawn
+        bool empty = true;
+    };
+
     void Camera::UpdateInstanceCmds()
     {
+        Vector<RendererInstance*> dirty_instances;
+
         for (auto& i : m_renderers)
         {
+            if (!i.visible)
+            {
+                // record when it becomes visible again
+                if (m_instance_cmds_dirty)
+                {
+                    i.cmd_dirty = true;
+                }
+                continue;
+            }
+
             if (i.cmd_dirty || m_instance_cmds_dirty)
             {
                 i.cmd_dirty = false;
+                dirty_instances.Add(&i);
+            }
+        }
 
-                if (RefCast<Computer>(i.renderer))
-                {
-                    if (m_compute_cmd_pool == VK_NULL_HANDLE)
-                    {
-                        Display::Instance()->CreateComputeCommandPool(&m_compute_cmd_pool);
-                    }
+        m_instance_cmds_dirty = false;
 
-                    if (i.compute_cmd == VK_NULL_HANDLE)
-                    {
-                        Display::Instance()->CreateCommandBuffer(m_compute_cmd_pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, &i.compute_cmd);
-                    }
+        if (dirty_instances.Empty())
+        {
+            return;
+        }
 
-                    this->BuildComputeInstanceCmd(i.compute_cmd, RefCast<Computer>(i.renderer));
+        // instance cmds are shared by all frames in flight, none of them may be pending while recording
+        Display::Instance()->WaitFramesInFlight();
+
+        JobSystem* jobs = Application::Instance()->GetJobSystem();
+
+        if (m_cmd_pools.Empty())
+        {
+            m_cmd_pools.Resize(jobs->GetWorkerCount() + 1);
+            for (int i = 0; i < m_cmd_pools.Size(); ++i)
+            {
+                Display::Instance()->CreateCommandPool(&m_cmd_pools[i]);
+            }
+        }
+
+        Vector<Vector<InstanceCmdRecord>> pool_records(m_cmd_pools.Size());
+
+        for (auto i : dirty_instances)
+        {
+            if (RefCast<Computer>(i->renderer))
+            {
+                // computers are few, record them here
+                if (m_compute_cmd_pool == VK_NULL_HANDLE)
+                {
+                    Display::Instance()->CreateComputeCommandPool(&m_compute_cmd_pool);
                 }
-                else
+
+                if (i->compute_cmd == VK_NULL_HANDLE)
                 {
-                    if (m_cmd_pool == VK_NULL_HANDLE)
-                    {
-                        Display::Instance()->CreateCommandPool(&m_cmd_pool);
-                    }
+                    Display::Instance()->CreateCommandBuffer(m_compute_cmd_pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, &i->compute_cmd);
+                }
 
-                    if (i.cmd == VK_NULL_HANDLE)
-                    {
-                        Display::Instance()->CreateCommandBuffer(m_cmd_pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, &i.cmd);
-                    }
+                this->BuildComputeInstanceCmd(i->compute_cmd, RefCast<Computer>(i->renderer));
+            }
+            else
+            {
+                if (i->cmd == VK_NULL_HANDLE)
+                {
+                    i->cmd_pool_index = m_next_cmd_pool;
+                    m_next_cmd_pool = (m_next_cmd_pool + 1) % m_cmd_pools.Size();
 
-                    this->BuildInstanceCmd(i.cmd, i.renderer);
+                    Display::Instance()->CreateCommandBuffer(m_cmd_pools[i->cmd_pool_index], VK_COMMAND_BUFFER_LEVEL_SECONDARY, &i->cmd);
                 }
 
-                Display::Instance()->MarkPrimaryCmdDirty();
+                InstanceCmdRecord record;
+                record.cmd = i->cmd;
+                this->PrepareInstanceCmd(i->renderer, record);
+                pool_records[i->cmd_pool_index].Add(record);
             }
         }
 
-        m_instance_cmds_dirty = false;
+        jobs->ParallelFor(pool_records.Size(), 1, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i)
+            {
+                for (const auto& j : pool_records[i])
+                {
+                    this->RecordInstanceCmd(j);
+                }
+            }
+        });
+
+        Display::Instance()->MarkPrimaryCmdDirty();
     }
 
     void Camera::ClearInstanceCmds()
@@ -727,22 +855,24 @@ namespace Viry3D
         {
             if (i.cmd)
             {
-                vkFreeCommandBuffers(device, m_cmd_pool, 1, &i.cmd);
+                vkFreeCommandBuffers(device, m_cmd_pools[i.cmd_pool_index], 1, &i.cmd);
                 i.cmd = VK_NULL_HANDLE;
+                i.cmd_pool_index = -1;
             }
 
             if (i.compute_cmd)
             {
                 vkFreeCommandBuffers(device, m_compute_cmd_pool, 1, &i.compute_cmd);
-                i.cmd = VK_NULL_HANDLE;
+                i.compute_cmd = VK_NULL_HANDLE;
             }
         }
 
-        if (m_cmd_pool)
+        for (int i = 0; i < m_cmd_pools.Size(); ++i)
         {
-            vkDestroyCommandPool(device, m_cmd_pool, nullptr);
-            m_cmd_pool = VK_NULL_HANDLE;
+            vkDestroyCommandPool(device, m_cmd_pools[i], nullptr);
         }
+        m_cmd_pools.Clear();
+        m_next_cmd_pool = 0;
 
         if (m_compute_cmd_pool)
         {
@@ -757,7 +887,7 @@ namespace Viry3D
 
         for (const auto& i : m_renderers)
         {
-            if (i.cmd)
+            if (i.cmd && i.visible)
             {
                 cmds.Add(i.cmd);
             }
@@ -805,24 +935,27 @@ namespace Viry3D
         }
     }
 
-    void Camera::BuildInstanceCmd(VkCommandBuffer cmd, const Ref<Renderer>& renderer)
+    void Camera::PrepareInstanceCmd(const Ref<Renderer>& renderer, InstanceCmdRecord& record)
     {
         const auto& materials = renderer->GetMaterials();
         const auto& instance_materials = renderer->GetInstanceMaterials();
-        Ref<BufferObject> vertex_buffer = renderer->GetVertexBuffer();
-        Ref<BufferObject> index_buffer = renderer->GetIndexBuffer();
-        IndexType index_type = renderer->GetIndexType();
-        Ref<BufferObject> draw_buffer = renderer->GetDrawBuffer();
-        Ref<BufferObject> instance_buffer = renderer->GetInstanceBuffer();
+        record.vertex_buffer = renderer->GetVertexBuffer();
+        record.index_buffer = renderer->GetIndexBuffer();
+        record.index_type = renderer->GetIndexType();
+        record.draw_buffer = renderer->GetDrawBuffer();
+        record.instance_buffer = renderer->GetInstanceBuffer();
         int instance_count = renderer->GetInstanceCount();
         int instance_stride = renderer->GetInstanceStride();
+        const VertexLayout& vertex_layout = renderer->GetVertexLayout();
 
-        if (materials.Size() == 0 || !vertex_buffer || !index_buffer || !draw_buffer || instance_count <= 0)
+        if (materials.Size() == 0 || !record.vertex_buffer || !record.index_buffer || !record.draw_buffer || instance_count <= 0)
         {
-            Display::Instance()->BuildEmptyInstanceCmd(cmd, m_render_pass);
+            record.empty = true;
             return;
         }
 
+        record.empty = false;
+
         bool color_attachment = true;
         bool depth_attachment = true;
         int sample_count = 1;
@@ -840,7 +973,11 @@ namespace Viry3D
             }
         }
 
-        Display::Instance()->BeginInstanceCmd(cmd, m_render_pass);
+        record.vertex_stream_offsets.Resize(vertex_layout.GetStreamCount());
+        for (int i = 0; i < record.vertex_stream_offsets.Size(); ++i)
+        {
+            record.vertex_stream_offsets[i] = renderer->GetVertexStreamOffset(i);
+        }
 
         for (int i = 0; i < materials.Size(); ++i)
         {
@@ -868,25 +1005,49 @@ namespace Viry3D
 
                 const Vector4* clip_rect = material->GetVector(CLIP_RECT);
 
-                Display::Instance()->BuildInstanceCmd(
-                    cmd,
-                    shader->GetPipelineLayout(),
-                    shader->GetPipeline(m_render_pass, color_attachment, depth_attachment, this->GetExtraRenderTargets().Size(), sample_count, instance_count > 1, instance_stride),
-                    descriptor_sets,
-                    this->GetTargetWidth(),
-                    this->GetTargetHeight(),
-                    m_viewport_rect,
-                    clip_rect != nullptr ? Rect(clip_rect->x, clip_rect->y, clip_rect->z, clip_rect->w) : Rect(0, 0, 1, 1),
-                    vertex_buffer,
-                    index_buffer,
-                    index_type,
-                    draw_buffer,
-                    i,
-                    instance_buffer);
-            }
-        }
-
-        Display::Instance()->EndInstanceCmd(cmd);
+                InstanceCmdDraw draw;
+                draw.pipeline_layout = shader->GetPipelineLayout();
+                draw.pipeline = shader->GetPipeline(m_render_pass, color_attachment, depth_attachment, this->GetExtraRenderTargets().Size(), sample_count, instance_count > 1, instance_stride, vertex_layout);
+                draw.descriptor_sets = descriptor_sets;
+                draw.scissor_rect = clip_rect != nullptr ? Rect(clip_rect->x, clip_rect->y, clip_rect->z, clip_rect->w) : Rect(0, 0, 1, 1);
+                draw.draw_index = i;
+                record.draws.Add(draw);
+            }
+        }
+    }
+
+    // runs on job system threads, only touches vulkan and the gathered record
+    void Camera::RecordInstanceCmd(const InstanceCmdRecord& record)
+    {
+        if (record.empty)
+        {
+            Display::Instance()->BuildEmptyInstanceCmd(record.cmd, m_render_pass);
+            return;
+        }
+
+        Display::Instance()->BeginInstanceCmd(record.cmd, m_render_pass);
+
+        for (const auto& i : record.draws)
+        {
+            Display::Instance()->BuildInstanceCmd(
+                record.cmd,
+                i.pipeline_layout,
+                i.pipeline,
+                i.descriptor_sets,
+                this->GetTargetWidth(),
+                this->GetTargetHeight(),
+                m_viewport_rect,
+                i.scissor_rect,
+                record.vertex_buffer,
+                record.vertex_stream_offsets,
+                record.index_buffer,
+                record.index_type,
+                record.draw_buffer,
+                i.draw_index,
+                record.instance_buffer);
+        }
+
+        Display::Instance()->EndInstanceCmd(record.cmd);
     }
 
     void Camera::BuildComputeInstanceCmd(VkCommandBuffer cmd, const Ref<Computer>& computer)
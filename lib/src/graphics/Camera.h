@@ -31,14 +31,20 @@ namespace Viry3D
     class Texture;
     class Renderer;
     class Computer;
+#if VR_VULKAN
+    struct InstanceCmdRecord;
+#endif
 
     struct RendererInstance
     {
         Ref<Renderer> renderer;
+        bool visible = true;
 #if VR_VULKAN
         bool cmd_dirty = true;
         VkCommandBuffer cmd = VK_NULL_HANDLE;
         VkCommandBuffer compute_cmd = VK_NULL_HANDLE;
+        // cmd is allocated from and always recorded with this pool of the camera
+        int cmd_pool_index = -1;
 #endif
 
         bool operator ==(const RendererInstance& a) const
@@ -95,6 +101,10 @@ namespace Viry3D
         void MarkRendererOrderDirty();
         void SetViewUniforms(const Ref<Material>& material);
         void SetProjectionUniform(const Ref<Material>& material);
+        bool IsCullingEnabled() const { return m_culling_enabled; }
+        void SetCullingEnabled(bool enable) { m_culling_enabled = enable; }
+        int GetVisibleRendererCount() const { return m_visible_renderer_count; }
+        int GetCulledRendererCount() const { return m_culled_renderer_count; }
 #if VR_VULKAN
         void MarkInstanceCmdDirty(Renderer* renderer);
         VkRenderPass GetRenderPass() const { return m_render_pass; }
@@ -111,12 +121,14 @@ namespace Viry3D
     private:
         void SortRenderers();
         void UpdateRenderers();
+        void CullRenderers();
 #if VR_VULKAN
         void UpdateRenderPass();
         void ClearRenderPass();
         void UpdateInstanceCmds();
         void ClearInstanceCmds();
-        void BuildInstanceCmd(VkCommandBuffer cmd, const Ref<Renderer>& renderer);
+        void PrepareInstanceCmd(const Ref<Renderer>& renderer, InstanceCmdRecord& record);
+        void RecordInstanceCmd(const InstanceCmdRecord& record);
         void BuildComputeInstanceCmd(VkCommandBuffer cmd, const Ref<Computer>& computer);
 #elif VR_GLES
         void BindTarget();
@@ -128,7 +140,9 @@ namespace Viry3D
 #if VR_VULKAN
         VkRenderPass m_render_pass;
         Vector<VkFramebuffer> m_framebuffers;
-        VkCommandPool m_cmd_pool;
+        // one pool per job system thread, pools are not thread safe so each is recorded by one job
+        Vector<VkCommandPool> m_cmd_pools;
+        int m_next_cmd_pool;
         VkCommandPool m_compute_cmd_pool;
         bool m_render_pass_dirty;
         bool m_instance_cmds_dirty;
@@ -158,5 +172,8 @@ namespace Viry3D
         float m_stereo_offset;
         bool m_view_matrix_external;
         bool m_projection_matrix_external;
+        bool m_culling_enabled;
+        int m_visible_renderer_count;
+        int m_culled_renderer_count;
     };
 }
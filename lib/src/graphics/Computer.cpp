@@ -50,7 +50,7 @@ namespace Viry3D
         }
         else
         {
-            Display::Instance()->UpdateBuffer(m_dispatch_buffer, 0, &dispatch, sizeof(dispatch));
+            Display::Instance()->QueueUpdateBuffer(m_dispatch_buffer, 0, &dispatch, sizeof(dispatch));
         }
 
         this->MarkInstanceCmdDirty();
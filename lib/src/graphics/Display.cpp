@@ -27,10 +27,16 @@
 #include "Mesh.h"
 #include "Material.h"
 #include "MeshRenderer.h"
+#include "MemoryAllocator.h"
+#include "UniformArena.h"
+#include "BonePalette.h"
+#include "SkinnedMeshRenderer.h"
+#include "TransformHierarchy.h"
 #include "container/List.h"
 #include "string/String.h"
 #include "memory/Memory.h"
 #include "math/Matrix4x4.h"
+#include <thread>
 #include "io/File.h"
 #include "Debug.h"
 
@@ -71,8 +77,15 @@ static PFN_vkGetDeviceProcAddr g_gdpa = nullptr;
 
 #define VSYNC 1
 #define DESCRIPTOR_POOL_SIZE_MAX 65536
+#define FRAMES_IN_FLIGHT_DEFAULT 2
+#define FRAMES_IN_FLIGHT_MAX 3
+#define UPLOAD_BUFFER_SIZE_MIN (64 * 1024)
+#define STAGING_BUFFER_SIZE (16 * 1024 * 1024)
+#define STAGING_ALIGNMENT 16
+// vertex streams use bindings 0 to VERTEX_STREAM_MAX - 1
 #define VERTEX_INPUT_BINDING_VERTEX 0
-#define VERTEX_INPUT_BINDING_INSTANCE 1
+#define VERTEX_INPUT_BINDING_INSTANCE VERTEX_STREAM_MAX
+#define VERTEX_INPUT_BINDING_DEFAULT (VERTEX_STREAM_MAX + 1)
 
 #elif VR_GLES
 #if VR_MAC
@@ -187,6 +200,7 @@ namespace Viry3D
             "#define VR_VULKAN 1\n"
             "#define UniformBuffer(set_index, binding_index) layout(std140, set = set_index, binding = binding_index)\n"
             "#define UniformTexture(set_index, binding_index) layout(set = set_index, binding = binding_index)\n"
+            "#define StorageBuffer(set_index, binding_index) layout(std430, set = set_index, binding = binding_index)\n"
             "#define Input(location_index) layout(location = location_index) in\n"
             "#define Output(location_index) layout(location = location_index) out\n";
 
@@ -245,7 +259,36 @@ namespace Viry3D
         VkFormat format;
         VkImage image;
         VkImageView image_view;
-        VkCommandBuffer cmd = VK_NULL_HANDLE;
+    };
+
+    struct FrameResources
+    {
+        VkFence draw_complete_fence = VK_NULL_HANDLE;
+        VkSemaphore image_acquired_semaphore = VK_NULL_HANDLE;
+        VkSemaphore upload_semaphore = VK_NULL_HANDLE;
+        VkSemaphore compute_semaphore = VK_NULL_HANDLE;
+        VkSemaphore draw_complete_semaphore = VK_NULL_HANDLE;
+        // signaled by the draw submit, the next frame's compute waits on it before writing what this frame reads
+        VkSemaphore draw_read_semaphore = VK_NULL_HANDLE;
+        VkCommandBuffer upload_cmd = VK_NULL_HANDLE;
+        Ref<BufferObject> upload_buffer;
+        // primary cmds are recorded per frame and per swapchain image, as frames and images do not pair up
+        // the same way every time, and are recorded again only after a change
+        Vector<VkCommandBuffer> draw_cmds;
+        Vector<int> draw_cmd_versions;
+        VkCommandBuffer compute_cmd = VK_NULL_HANDLE;
+        bool has_compute = false;
+        int compute_cmd_version = -1;
+        // releases of resources the frame may read, run once its fence signals
+        Vector<Action> releases;
+    };
+
+    struct BufferUpdate
+    {
+        Ref<BufferObject> buffer;
+        int buffer_offset;
+        int data_offset;
+        int size;
     };
 #elif VR_UWP
 extern void BindSharedContext();
@@ -297,20 +340,39 @@ extern void UnbindSharedContext();
         VkSwapchainKHR m_swapchain = VK_NULL_HANDLE;
         Vector<SwapchainImageResources> m_swapchain_image_resources;
         VkFence m_image_fence = VK_NULL_HANDLE;
-        VkFence m_draw_complete_fence = VK_NULL_HANDLE;
-        VkSemaphore m_image_acquired_semaphore = VK_NULL_HANDLE;
-        VkSemaphore m_compute_semaphore = VK_NULL_HANDLE;
-        VkSemaphore m_draw_complete_semaphore = VK_NULL_HANDLE;
+        Vector<FrameResources> m_frames;
+        int m_frames_in_flight = FRAMES_IN_FLIGHT_DEFAULT;
+        int m_frame_index = 0;
         int m_image_index = 0;
-        VkCommandPool m_graphics_cmd_pool = VK_NULL_HANDLE;
+        // signaled by the last draw submit and not waited yet
+        VkSemaphore m_draw_read_semaphore = VK_NULL_HANDLE;
+        VkCommandPool m_frame_cmd_pool = VK_NULL_HANDLE;
+        Vector<BufferUpdate> m_buffer_updates;
+        Vector<byte> m_buffer_update_data;
+        Mutex m_buffer_update_mutex;
+        Vector<Action> m_pending_releases;
+        Mutex m_release_mutex;
         VkCommandPool m_image_cmd_pool = VK_NULL_HANDLE;
         VkCommandBuffer m_image_cmd = VK_NULL_HANDLE;
         VkCommandPool m_compute_cmd_pool = VK_NULL_HANDLE;
-        VkCommandBuffer m_compute_cmd = VK_NULL_HANDLE;
-        bool m_has_compute_instance_cmds = false;
         Mutex m_image_cmd_mutex;
+        Vector<Ref<BufferObject>> m_image_staging_buffers;
+        VkCommandPool m_upload_batch_cmd_pool = VK_NULL_HANDLE;
+        VkCommandBuffer m_upload_batch_cmd = VK_NULL_HANDLE;
+        VkFence m_upload_batch_fence = VK_NULL_HANDLE;
+        std::thread::id m_upload_batch_thread;
+        int m_upload_batch_depth = 0;
+        bool m_upload_batch_recording = false;
+        Mutex m_upload_batch_mutex;
+        Ref<BufferObject> m_staging_buffer;
+        int m_staging_offset = 0;
+        Vector<Ref<BufferObject>> m_staging_temp_buffers;
+        MemoryAllocator* m_memory_allocator = nullptr;
+        UniformArena* m_uniform_arena = nullptr;
+        // constant values for attributes a shader reads but a vertex layout does not store
+        Ref<BufferObject> m_default_vertex_buffer;
         Ref<Texture> m_depth_texture;
-        bool m_primary_cmd_dirty = true;
+        int m_primary_cmd_version = 0;
         bool m_pause_draw = false;
 #endif
 
@@ -337,24 +399,25 @@ extern void UnbindSharedContext();
             m_cameras.Clear();
 
             this->DestroySizeDependentResources();
-
-            if (m_compute_cmd_pool != VK_NULL_HANDLE)
+            if (m_default_vertex_buffer)
             {
-                if (m_compute_cmd != VK_NULL_HANDLE)
-                {
-                    vkFreeCommandBuffers(m_device, m_compute_cmd_pool, 1, &m_compute_cmd);
-                    m_compute_cmd = VK_NULL_HANDLE;
-                }
-                vkDestroyCommandPool(m_device, m_compute_cmd_pool, nullptr);
-                m_compute_cmd_pool = VK_NULL_HANDLE;
+                m_default_vertex_buffer->Destroy(m_device);
+                m_default_vertex_buffer.reset();
             }
+            // uniform blocks freed by materials go back to the arena before it is deleted
+            this->RunAllReleases();
+            Memory::SafeDelete(m_uniform_arena);
+            this->DestroyUploadBatch();
             vkFreeCommandBuffers(m_device, m_image_cmd_pool, 1, &m_image_cmd);
             vkDestroyCommandPool(m_device, m_image_cmd_pool, nullptr);
             vkDestroyFence(m_device, m_image_fence, nullptr);
-            vkDestroyFence(m_device, m_draw_complete_fence, nullptr);
-            vkDestroySemaphore(m_device, m_image_acquired_semaphore, nullptr);
-            vkDestroySemaphore(m_device, m_compute_semaphore, nullptr);
-            vkDestroySemaphore(m_device, m_draw_complete_semaphore, nullptr);
+            this->DestroyFrameResources();
+            if (m_compute_cmd_pool != VK_NULL_HANDLE)
+            {
+                vkDestroyCommandPool(m_device, m_compute_cmd_pool, nullptr);
+                m_compute_cmd_pool = VK_NULL_HANDLE;
+            }
+            Memory::SafeDelete(m_memory_allocator);
             vkDestroyDevice(m_device, nullptr);
             if (m_surface != VK_NULL_HANDLE)
             {
@@ -845,20 +908,194 @@ extern void UnbindSharedContext();
 
             VkResult err = vkCreateFence(m_device, &fence_info, nullptr, &m_image_fence);
             assert(!err);
-            err = vkCreateFence(m_device, &fence_info, nullptr, &m_draw_complete_fence);
-            assert(!err);
-            err = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_image_acquired_semaphore);
-            assert(!err);
-            err = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_compute_semaphore);
-            assert(!err);
-            err = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_draw_complete_semaphore);
-            assert(!err);
+
+            this->CreateFrameResources();
+        }
+
+        void CreateFrameResources()
+        {
+            VkFenceCreateInfo fence_info;
+            Memory::Zero(&fence_info, sizeof(fence_info));
+            fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fence_info.pNext = nullptr;
+            fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+            VkSemaphoreCreateInfo semaphore_info;
+            Memory::Zero(&semaphore_info, sizeof(semaphore_info));
+            semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            semaphore_info.pNext = nullptr;
+            semaphore_info.flags = 0;
+
+            this->CreateCommandPool(m_graphics_queue_family_index, &m_frame_cmd_pool);
+
+            m_frames.Resize(m_frames_in_flight);
+            for (int i = 0; i < m_frames.Size(); ++i)
+            {
+                FrameResources& frame = m_frames[i];
+
+                VkResult err = vkCreateFence(m_device, &fence_info, nullptr, &frame.draw_complete_fence);
+                assert(!err);
+                err = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &frame.image_acquired_semaphore);
+                assert(!err);
+                err = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &frame.upload_semaphore);
+                assert(!err);
+                err = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &frame.compute_semaphore);
+                assert(!err);
+                err = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &frame.draw_complete_semaphore);
+                assert(!err);
+                err = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &frame.draw_read_semaphore);
+                assert(!err);
+
+                this->CreateCommandBuffer(m_frame_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &frame.upload_cmd);
+            }
+            m_frame_index = 0;
+        }
+
+        // only after the device is idle
+        void DestroyFrameResources()
+        {
+            for (int i = 0; i < m_frames.Size(); ++i)
+            {
+                if (m_frames[i].upload_buffer)
+                {
+                    m_frames[i].upload_buffer->Destroy(m_device);
+                    m_frames[i].upload_buffer.reset();
+                }
+            }
+            this->RunAllReleases();
+
+            for (int i = 0; i < m_frames.Size(); ++i)
+            {
+                FrameResources& frame = m_frames[i];
+
+                vkFreeCommandBuffers(m_device, m_frame_cmd_pool, 1, &frame.upload_cmd);
+                if (frame.draw_cmds.Size() > 0)
+                {
+                    vkFreeCommandBuffers(m_device, m_frame_cmd_pool, (uint32_t) frame.draw_cmds.Size(), &frame.draw_cmds[0]);
+                }
+                if (frame.compute_cmd != VK_NULL_HANDLE)
+                {
+                    vkFreeCommandBuffers(m_device, m_compute_cmd_pool, 1, &frame.compute_cmd);
+                }
+                vkDestroyFence(m_device, frame.draw_complete_fence, nullptr);
+                vkDestroySemaphore(m_device, frame.image_acquired_semaphore, nullptr);
+                vkDestroySemaphore(m_device, frame.upload_semaphore, nullptr);
+                vkDestroySemaphore(m_device, frame.compute_semaphore, nullptr);
+                vkDestroySemaphore(m_device, frame.draw_complete_semaphore, nullptr);
+                vkDestroySemaphore(m_device, frame.draw_read_semaphore, nullptr);
+            }
+            m_frames.Clear();
+            m_draw_read_semaphore = VK_NULL_HANDLE;
+
+            if (m_frame_cmd_pool != VK_NULL_HANDLE)
+            {
+                vkDestroyCommandPool(m_device, m_frame_cmd_pool, nullptr);
+                m_frame_cmd_pool = VK_NULL_HANDLE;
+            }
+        }
+
+        void SetFramesInFlight(int count)
+        {
+            count = Mathf::Clamp(count, 1, FRAMES_IN_FLIGHT_MAX);
+            if (count == m_frames_in_flight)
+            {
+                return;
+            }
+
+            vkDeviceWaitIdle(m_device);
+
+            this->DestroyFrameResources();
+            m_frames_in_flight = count;
+            this->CreateFrameResources();
+        }
+
+        // command buffers, descriptor sets and resources shared by all frames
+        // must not be changed while any frame using them is still pending
+        void WaitFramesInFlight()
+        {
+            for (int i = 0; i < m_frames.Size(); ++i)
+            {
+                VkResult err = vkWaitForFences(m_device, 1, &m_frames[i].draw_complete_fence, VK_TRUE, UINT64_MAX);
+                assert(!err);
+            }
+        }
+
+        // frames already submitted or being recorded may still use the resource,
+        // so it goes with the next submitted frame and is released after its fence
+        void ReleaseAfterFrames(const Action& release)
+        {
+            if (m_frames.Size() == 0)
+            {
+                release();
+                return;
+            }
+
+            std::lock_guard<Mutex> lock(m_release_mutex);
+            m_pending_releases.Add(release);
+        }
+
+        void RunReleases(Vector<Action>& releases)
+        {
+            // a release may destroy more buffers, those are queued again
+            Vector<Action> runs;
+            {
+                std::lock_guard<Mutex> lock(m_release_mutex);
+                runs = std::move(releases);
+                releases.Clear();
+            }
+
+            for (int i = 0; i < runs.Size(); ++i)
+            {
+                runs[i]();
+            }
+        }
+
+        // only after the device is idle
+        void RunAllReleases()
+        {
+            for (int i = 0; i < m_frames.Size(); ++i)
+            {
+                this->RunReleases(m_frames[i].releases);
+            }
+            while (m_pending_releases.Size() > 0)
+            {
+                this->RunReleases(m_pending_releases);
+            }
         }
 
         void CreateImageCmd()
         {
             this->CreateCommandPool(m_graphics_queue_family_index, &m_image_cmd_pool);
             this->CreateCommandBuffer(m_image_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &m_image_cmd);
+
+            VkFenceCreateInfo fence_info;
+            Memory::Zero(&fence_info, sizeof(fence_info));
+            fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fence_info.pNext = nullptr;
+            fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+            VkResult err = vkCreateFence(m_device, &fence_info, nullptr, &m_upload_batch_fence);
+            assert(!err);
+
+            this->CreateCommandPool(m_graphics_queue_family_index, &m_upload_batch_cmd_pool);
+            this->CreateCommandBuffer(m_upload_batch_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &m_upload_batch_cmd);
+        }
+
+        void DestroyUploadBatch()
+        {
+            VkResult err = vkWaitForFences(m_device, 1, &m_upload_batch_fence, VK_TRUE, UINT64_MAX);
+            assert(!err);
+
+            this->ReleaseStagingBuffers(m_staging_temp_buffers);
+            if (m_staging_buffer)
+            {
+                this->DestroyStagingBuffer(m_staging_buffer);
+                m_staging_buffer.reset();
+            }
+
+            vkFreeCommandBuffers(m_device, m_upload_batch_cmd_pool, 1, &m_upload_batch_cmd);
+            vkDestroyCommandPool(m_device, m_upload_batch_cmd_pool, nullptr);
+            vkDestroyFence(m_device, m_upload_batch_fence, nullptr);
         }
 
         void CreateComputeCmd()
@@ -866,18 +1103,12 @@ extern void UnbindSharedContext();
             if (m_compute_queue_family_index >= 0)
             {
                 this->CreateCommandPool(m_compute_queue_family_index, &m_compute_cmd_pool);
-                this->CreateCommandBuffer(m_compute_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &m_compute_cmd);
             }
         }
 
         void CreateSizeDependentResources()
         {
             this->CreateSwapChain();
-            this->CreateCommandPool(m_graphics_queue_family_index, &m_graphics_cmd_pool);
-            for (int i = 0; i < m_swapchain_image_resources.Size(); ++i)
-            {
-                this->CreateCommandBuffer(m_graphics_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &m_swapchain_image_resources[i].cmd);
-            }
             m_depth_texture = Texture::CreateRenderTexture(
                 m_width,
                 m_height,
@@ -893,16 +1124,6 @@ extern void UnbindSharedContext();
         {
             m_depth_texture.reset();
 
-            for (int i = 0; i < m_swapchain_image_resources.Size(); ++i)
-            {
-                vkFreeCommandBuffers(m_device, m_graphics_cmd_pool, 1, &m_swapchain_image_resources[i].cmd);
-            }
-            if (m_graphics_cmd_pool != VK_NULL_HANDLE)
-            {
-                vkDestroyCommandPool(m_device, m_graphics_cmd_pool, nullptr);
-                m_graphics_cmd_pool = VK_NULL_HANDLE;
-            }
-
             for (int i = 0; i < m_swapchain_image_resources.Size(); ++i)
             {
                 vkDestroyImageView(m_device, m_swapchain_image_resources[i].image_view, nullptr);
@@ -934,7 +1155,7 @@ extern void UnbindSharedContext();
             this->GetQueues();
             this->CreateSizeDependentResources();
 
-            m_primary_cmd_dirty = true;
+            m_primary_cmd_version += 1;
         }
 
         void OnPause()
@@ -1397,6 +1618,22 @@ extern void UnbindSharedContext();
             return false;
         }
 
+        void CreateMemoryAllocator()
+        {
+            m_memory_allocator = new MemoryAllocator(m_device, m_memory_properties);
+            m_uniform_arena = new UniformArena((int) m_gpu_properties.limits.minUniformBufferOffsetAlignment);
+        }
+
+        void AllocateMemory(const VkMemoryRequirements& mem_reqs, VkMemoryPropertyFlags mem_flags, bool linear, MemoryAllocation& allocation)
+        {
+            uint32_t type_index = 0;
+            bool pass = this->CheckMemoryType(mem_reqs.memoryTypeBits, mem_flags, &type_index);
+            assert(pass);
+
+            pass = m_memory_allocator->Allocate(mem_reqs, type_index, linear, allocation);
+            assert(pass);
+        }
+
         VkFormat ChooseFormatSupported(const Vector<VkFormat>& formats, VkFormatFeatureFlags features)
         {
             for (int i = 0; i < formats.Size(); ++i)
@@ -1500,38 +1737,18 @@ extern void UnbindSharedContext();
             VkMemoryRequirements mem_reqs;
             vkGetImageMemoryRequirements(m_device, texture->m_image, &mem_reqs);
 
-            Memory::Zero(&texture->m_memory_info, sizeof(texture->m_memory_info));
-            texture->m_memory_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            texture->m_memory_info.pNext = nullptr;
-            texture->m_memory_info.allocationSize = mem_reqs.size;
-            texture->m_memory_info.memoryTypeIndex = 0;
+            this->AllocateMemory(mem_reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, texture->m_memory);
 
-            bool pass = this->CheckMemoryType(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->m_memory_info.memoryTypeIndex);
-            assert(pass);
-
-            err = vkAllocateMemory(m_device, &texture->m_memory_info, nullptr, &texture->m_memory);
-            assert(!err);
-
-            err = vkBindImageMemory(m_device, texture->m_image, texture->m_memory, 0);
+            err = vkBindImageMemory(m_device, texture->m_image, texture->m_memory.memory, texture->m_memory.offset);
             assert(!err);
 
             if (sample_count > 1)
             {
                 vkGetImageMemoryRequirements(m_device, texture->m_image_multi_sample, &mem_reqs);
 
-                Memory::Zero(&texture->m_memory_info_multi_sample, sizeof(texture->m_memory_info_multi_sample));
-                texture->m_memory_info_multi_sample.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-                texture->m_memory_info_multi_sample.pNext = nullptr;
-                texture->m_memory_info_multi_sample.allocationSize = mem_reqs.size;
-                texture->m_memory_info_multi_sample.memoryTypeIndex = 0;
+                this->AllocateMemory(mem_reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, texture->m_memory_multi_sample);
 
-                pass = this->CheckMemoryType(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->m_memory_info_multi_sample.memoryTypeIndex);
-                assert(pass);
-
-                err = vkAllocateMemory(m_device, &texture->m_memory_info_multi_sample, nullptr, &texture->m_memory_multi_sample);
-                assert(!err);
-
-                err = vkBindImageMemory(m_device, texture->m_image_multi_sample, texture->m_memory_multi_sample, 0);
+                err = vkBindImageMemory(m_device, texture->m_image_multi_sample, texture->m_memory_multi_sample.memory, texture->m_memory_multi_sample.offset);
                 assert(!err);
             }
 
@@ -1605,18 +1822,22 @@ extern void UnbindSharedContext();
             buffer_info.queueFamilyIndexCount = 0;
             buffer_info.pQueueFamilyIndices = nullptr;
 
+            // buffers written on one queue family and read on the other, as bone palettes and skinned vertices,
+            // would need ownership transfers under exclusive sharing
+            uint32_t queue_family_indices[2] = { (uint32_t) m_graphics_queue_family_index, (uint32_t) m_compute_queue_family_index };
+            if (m_compute_queue_family_index >= 0 && m_compute_queue_family_index != m_graphics_queue_family_index)
+            {
+                buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+                buffer_info.queueFamilyIndexCount = 2;
+                buffer_info.pQueueFamilyIndices = queue_family_indices;
+            }
+
             VkResult err = vkCreateBuffer(m_device, &buffer_info, nullptr, &buffer->m_buffer);
             assert(!err);
 
             VkMemoryRequirements mem_reqs;
             vkGetBufferMemoryRequirements(m_device, buffer->m_buffer, &mem_reqs);
 
-            Memory::Zero(&buffer->m_memory_info, sizeof(buffer->m_memory_info));
-            buffer->m_memory_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            buffer->m_memory_info.pNext = nullptr;
-            buffer->m_memory_info.allocationSize = mem_reqs.size;
-            buffer->m_memory_info.memoryTypeIndex = 0;
-
             VkMemoryPropertyFlags mem_flags;
             if (device_local)
             {
@@ -1626,24 +1847,14 @@ extern void UnbindSharedContext();
             {
                 mem_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
             }
-            bool pass = this->CheckMemoryType(mem_reqs.memoryTypeBits, mem_flags, &buffer->m_memory_info.memoryTypeIndex);
-            assert(pass);
-
-            err = vkAllocateMemory(m_device, &buffer->m_memory_info, nullptr, &buffer->m_memory);
-            assert(!err);
+            this->AllocateMemory(mem_reqs, mem_flags, true, buffer->m_memory);
 
-            err = vkBindBufferMemory(m_device, buffer->m_buffer, buffer->m_memory, 0);
+            err = vkBindBufferMemory(m_device, buffer->m_buffer, buffer->m_memory.memory, buffer->m_memory.offset);
             assert(!err);
 
             if (!device_local && data)
             {
-                void* map_data = nullptr;
-                err = vkMapMemory(m_device, buffer->m_memory, 0, size, 0, (void**) &map_data);
-                assert(!err);
-
-                Memory::Copy(map_data, data, size);
-
-                vkUnmapMemory(m_device, buffer->m_memory);
+                Memory::Copy(buffer->m_memory.mapped, data, size);
             }
 
             if (view_format != VK_FORMAT_UNDEFINED)
@@ -1667,13 +1878,10 @@ extern void UnbindSharedContext();
 
         void UpdateBuffer(const Ref<BufferObject>& buffer, int buffer_offset, const void* data, int size)
         {
-            void* map_data = nullptr;
-            VkResult err = vkMapMemory(m_device, buffer->GetMemory(), buffer_offset, size, 0, (void**) &map_data);
-            assert(!err);
+            // host visible buffers stay mapped for their whole lifetime
+            assert(buffer->GetMemory().mapped);
 
-            Memory::Copy(map_data, data, size);
-
-            vkUnmapMemory(m_device, buffer->GetMemory());
+            Memory::Copy((byte*) buffer->GetMemory().mapped + buffer_offset, data, size);
         }
 
         void ReadBuffer(const Ref<BufferObject>& buffer, ByteBuffer& data)
@@ -1683,13 +1891,125 @@ extern void UnbindSharedContext();
                 return;
             }
 
-            void* map_data = nullptr;
-            VkResult err = vkMapMemory(m_device, buffer->GetMemory(), 0, buffer->GetSize(), 0, (void**) &map_data);
+            assert(buffer->GetMemory().mapped);
+
+            // gpu writes recorded in an open upload batch must have executed
+            this->FlushUploadBatch();
+
+            Memory::Copy(&data[0], buffer->GetMemory().mapped, buffer->GetSize());
+        }
+
+        void QueueUpdateBuffer(const Ref<BufferObject>& buffer, int buffer_offset, const void* data, int size)
+        {
+            std::lock_guard<Mutex> lock(m_buffer_update_mutex);
+
+            BufferUpdate update;
+            update.buffer = buffer;
+            update.buffer_offset = buffer_offset;
+            update.data_offset = m_buffer_update_data.Size();
+            update.size = size;
+            m_buffer_updates.Add(update);
+
+            m_buffer_update_data.Resize(update.data_offset + size);
+            Memory::Copy(&m_buffer_update_data[update.data_offset], data, size);
+        }
+
+        // copy queued updates into the frame upload buffer and record the transfers,
+        // the upload buffer is only reused after the frame fence has signaled
+        bool FlushBufferUpdates(FrameResources& frame)
+        {
+            std::lock_guard<Mutex> lock(m_buffer_update_mutex);
+
+            if (m_buffer_updates.Size() == 0)
+            {
+                return false;
+            }
+
+            int data_size = m_buffer_update_data.Size();
+            if (!frame.upload_buffer || frame.upload_buffer->GetSize() < data_size)
+            {
+                int buffer_size = UPLOAD_BUFFER_SIZE_MIN;
+                if (frame.upload_buffer)
+                {
+                    buffer_size = frame.upload_buffer->GetSize();
+                    frame.upload_buffer->Destroy(m_device);
+                    frame.upload_buffer.reset();
+                }
+                while (buffer_size < data_size)
+                {
+                    buffer_size *= 2;
+                }
+
+                frame.upload_buffer = this->CreateBuffer(nullptr, buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, VK_FORMAT_UNDEFINED);
+            }
+
+            Memory::Copy(frame.upload_buffer->GetMemory().mapped, m_buffer_update_data.Bytes(), data_size);
+
+            VkCommandBufferBeginInfo cmd_begin;
+            Memory::Zero(&cmd_begin, sizeof(cmd_begin));
+            cmd_begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            cmd_begin.pNext = nullptr;
+            cmd_begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            cmd_begin.pInheritanceInfo = nullptr;
+
+            VkResult err = vkBeginCommandBuffer(frame.upload_cmd, &cmd_begin);
+            assert(!err);
+
+            // earlier frames may still read the destination buffers
+            vkCmdPipelineBarrier(frame.upload_cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+            for (int i = 0; i < m_buffer_updates.Size(); ++i)
+            {
+                const BufferUpdate& update = m_buffer_updates[i];
+
+                // destroyed before the frame was submitted
+                if (update.buffer->GetBuffer() == VK_NULL_HANDLE)
+                {
+                    continue;
+                }
+
+                VkBufferCopy copy;
+                copy.srcOffset = update.data_offset;
+                copy.dstOffset = update.buffer_offset;
+                copy.size = update.size;
+
+                vkCmdCopyBuffer(frame.upload_cmd, frame.upload_buffer->GetBuffer(), update.buffer->GetBuffer(), 1, &copy);
+            }
+
+            VkMemoryBarrier barrier;
+            Memory::Zero(&barrier, sizeof(barrier));
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask =
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                VK_ACCESS_INDEX_READ_BIT |
+                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                VK_ACCESS_UNIFORM_READ_BIT |
+                VK_ACCESS_SHADER_READ_BIT;
+
+            vkCmdPipelineBarrier(frame.upload_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+            err = vkEndCommandBuffer(frame.upload_cmd);
             assert(!err);
 
-            Memory::Copy(&data[0], map_data, buffer->GetSize());
+            m_buffer_updates.Clear();
+            m_buffer_update_data.Clear();
 
-            vkUnmapMemory(m_device, buffer->GetMemory());
+            return true;
+        }
+
+        void UploadBuffer(const Ref<BufferObject>& buffer, int buffer_offset, const void* data, int size)
+        {
+            this->BeginImageCmd();
+
+            int staging_offset = 0;
+            Ref<BufferObject> staging_buffer = this->StageData(data, size, &staging_offset);
+
+            VkBufferCopy region = { (VkDeviceSize) staging_offset, (VkDeviceSize) buffer_offset, (VkDeviceSize) size };
+            vkCmdCopyBuffer(this->GetImageCmd(), staging_buffer->GetBuffer(), buffer->GetBuffer(), 1, &region);
+
+            this->EndImageCmd();
         }
 
         void CopyBuffer(const Ref<BufferObject>& src, int src_offset, const Ref<BufferObject>& dst, int dst_offset, int size)
@@ -1697,15 +2017,230 @@ extern void UnbindSharedContext();
             this->BeginImageCmd();
 
             VkBufferCopy region = { (VkDeviceSize) src_offset, (VkDeviceSize) dst_offset, (VkDeviceSize) size };
-            vkCmdCopyBuffer(m_image_cmd, src->GetBuffer(), dst->GetBuffer(), 1, &region);
+            vkCmdCopyBuffer(this->GetImageCmd(), src->GetBuffer(), dst->GetBuffer(), 1, &region);
 
             this->EndImageCmd();
         }
 
+        // staging memory for the image cmd being recorded, valid until that cmd has executed
+        Ref<BufferObject> StageData(const void* data, int size, int* offset)
+        {
+            Ref<BufferObject> staging_buffer;
+
+            if (this->IsUploadBatchThread() && size <= STAGING_BUFFER_SIZE)
+            {
+                if (!m_staging_buffer)
+                {
+                    m_staging_buffer = this->CreateBuffer(nullptr, STAGING_BUFFER_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, VK_FORMAT_UNDEFINED);
+                }
+
+                int staging_offset = (m_staging_offset + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+                if (staging_offset + size > STAGING_BUFFER_SIZE)
+                {
+                    // staging buffer is full, submit what is recorded so far and start over when it is done
+                    this->SubmitUploadBatch();
+                    this->BeginUploadBatchCmd();
+                    staging_offset = 0;
+                }
+
+                Memory::Copy((byte*) m_staging_buffer->GetMemory().mapped + staging_offset, data, size);
+                m_staging_offset = staging_offset + size;
+
+                *offset = staging_offset;
+                staging_buffer = m_staging_buffer;
+            }
+            else
+            {
+                staging_buffer = this->CreateBuffer(data, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, VK_FORMAT_UNDEFINED);
+                if (this->IsUploadBatchThread())
+                {
+                    m_staging_temp_buffers.Add(staging_buffer);
+                }
+                else
+                {
+                    m_image_staging_buffers.Add(staging_buffer);
+                }
+
+                *offset = 0;
+            }
+
+            return staging_buffer;
+        }
+
+        // staging buffers are never used by frames, skip BufferObject::Destroy waiting for frames in flight
+        void DestroyStagingBuffer(const Ref<BufferObject>& buffer)
+        {
+            vkDestroyBuffer(m_device, buffer->m_buffer, nullptr);
+            buffer->m_buffer = VK_NULL_HANDLE;
+            m_memory_allocator->Free(buffer->m_memory);
+        }
+
+        void ReleaseStagingBuffers(Vector<Ref<BufferObject>>& buffers)
+        {
+            for (int i = 0; i < buffers.Size(); ++i)
+            {
+                this->DestroyStagingBuffer(buffers[i]);
+            }
+            buffers.Clear();
+        }
+
+        bool IsUploadBatchThread()
+        {
+            std::lock_guard<Mutex> lock(m_upload_batch_mutex);
+            return m_upload_batch_depth > 0 && m_upload_batch_thread == std::this_thread::get_id();
+        }
+
+        void BeginUploadBatch()
+        {
+            std::lock_guard<Mutex> lock(m_upload_batch_mutex);
+
+            if (m_upload_batch_depth == 0)
+            {
+                m_upload_batch_thread = std::this_thread::get_id();
+                m_upload_batch_depth = 1;
+            }
+            else if (m_upload_batch_thread == std::this_thread::get_id())
+            {
+                m_upload_batch_depth += 1;
+            }
+
+            // other threads keep uploading immediately while a batch is open
+        }
+
+        void EndUploadBatch()
+        {
+            {
+                std::lock_guard<Mutex> lock(m_upload_batch_mutex);
+
+                if (m_upload_batch_depth == 0 || m_upload_batch_thread != std::this_thread::get_id())
+                {
+                    return;
+                }
+                if (m_upload_batch_depth > 1)
+                {
+                    m_upload_batch_depth -= 1;
+                    return;
+                }
+            }
+
+            // not waited for, later submits on the graphics queue are ordered after the batch
+            this->SubmitUploadBatch();
+
+            std::lock_guard<Mutex> lock(m_upload_batch_mutex);
+            m_upload_batch_depth = 0;
+            m_upload_batch_thread = std::thread::id();
+        }
+
+        void BeginUploadBatchCmd()
+        {
+            // the last batch must have executed before its cmd and staging memory are reused
+            VkResult err = vkWaitForFences(m_device, 1, &m_upload_batch_fence, VK_TRUE, UINT64_MAX);
+            assert(!err);
+
+            this->ReleaseStagingBuffers(m_staging_temp_buffers);
+            m_staging_offset = 0;
+
+            VkCommandBufferBeginInfo cmd_info;
+            Memory::Zero(&cmd_info, sizeof(cmd_info));
+            cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            cmd_info.pNext = nullptr;
+            cmd_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            cmd_info.pInheritanceInfo = nullptr;
+
+            err = vkBeginCommandBuffer(m_upload_batch_cmd, &cmd_info);
+            assert(!err);
+
+            // frames in flight may still use resources the batch writes to
+            this->FullBarrier(m_upload_batch_cmd);
+
+            m_upload_batch_recording = true;
+        }
+
+        void SubmitUploadBatch()
+        {
+            if (!m_upload_batch_recording)
+            {
+                return;
+            }
+            m_upload_batch_recording = false;
+
+            this->FullBarrier(m_upload_batch_cmd);
+
+            VkResult err = vkEndCommandBuffer(m_upload_batch_cmd);
+            assert(!err);
+
+            VkSubmitInfo submit_info;
+            Memory::Zero(&submit_info, sizeof(submit_info));
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.pNext = nullptr;
+            submit_info.waitSemaphoreCount = 0;
+            submit_info.pWaitSemaphores = nullptr;
+            submit_info.pWaitDstStageMask = nullptr;
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &m_upload_batch_cmd;
+            submit_info.signalSemaphoreCount = 0;
+            submit_info.pSignalSemaphores = nullptr;
+
+            // the graphics queue is shared with the draw thread
+            m_image_cmd_mutex.lock();
+
+            err = vkResetFences(m_device, 1, &m_upload_batch_fence);
+            assert(!err);
+
+            err = vkQueueSubmit(m_graphics_queue, 1, &submit_info, m_upload_batch_fence);
+            assert(!err);
+
+            m_image_cmd_mutex.unlock();
+        }
+
+        void FlushUploadBatch()
+        {
+            if (this->IsUploadBatchThread())
+            {
+                this->SubmitUploadBatch();
+
+                VkResult err = vkWaitForFences(m_device, 1, &m_upload_batch_fence, VK_TRUE, UINT64_MAX);
+                assert(!err);
+            }
+        }
+
+        void FullBarrier(VkCommandBuffer cmd)
+        {
+            VkMemoryBarrier barrier;
+            Memory::Zero(&barrier, sizeof(barrier));
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        VkCommandBuffer GetImageCmd()
+        {
+            if (this->IsUploadBatchThread())
+            {
+                return m_upload_batch_cmd;
+            }
+            return m_image_cmd;
+        }
+
         void BeginImageCmd()
         {
+            // inside an upload batch commands are only recorded, the batch is submitted as a whole
+            if (this->IsUploadBatchThread())
+            {
+                if (!m_upload_batch_recording)
+                {
+                    this->BeginUploadBatchCmd();
+                }
+                return;
+            }
+
             m_image_cmd_mutex.lock();
 
+            this->WaitFramesInFlight();
+
             VkCommandBufferBeginInfo cmd_info;
             cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
             cmd_info.pNext = nullptr;
@@ -1718,6 +2253,11 @@ extern void UnbindSharedContext();
 
         void EndImageCmd()
         {
+            if (this->IsUploadBatchThread())
+            {
+                return;
+            }
+
             VkResult err = vkEndCommandBuffer(m_image_cmd);
             assert(!err);
 
@@ -1742,6 +2282,8 @@ extern void UnbindSharedContext();
             err = vkWaitForFences(m_device, 1, &m_image_fence, VK_TRUE, UINT64_MAX);
             assert(!err);
 
+            this->ReleaseStagingBuffers(m_image_staging_buffers);
+
             m_image_cmd_mutex.unlock();
         }
 
@@ -2217,9 +2759,52 @@ extern void UnbindSharedContext();
             assert(!err);
         }
 
+        static VkFormat GetVertexFormat(VertexFormat format)
+        {
+            switch (format)
+            {
+            case VertexFormat::Float:
+                return VK_FORMAT_R32_SFLOAT;
+            case VertexFormat::Float2:
+                return VK_FORMAT_R32G32_SFLOAT;
+            case VertexFormat::Float3:
+                return VK_FORMAT_R32G32B32_SFLOAT;
+            case VertexFormat::Float4:
+                return VK_FORMAT_R32G32B32A32_SFLOAT;
+            case VertexFormat::Half2:
+                return VK_FORMAT_R16G16_SFLOAT;
+            case VertexFormat::Half4:
+                return VK_FORMAT_R16G16B16A16_SFLOAT;
+            case VertexFormat::Snorm8x4:
+                return VK_FORMAT_R8G8B8A8_SNORM;
+            case VertexFormat::Unorm8x4:
+                return VK_FORMAT_R8G8B8A8_UNORM;
+            case VertexFormat::Uint8x4:
+                // scaled, so shaders keep reading the indices as float vectors
+                return VK_FORMAT_R8G8B8A8_USCALED;
+            default:
+                assert(!"invalid vertex format");
+                return VK_FORMAT_UNDEFINED;
+            }
+        }
+
+        const Ref<BufferObject>& GetDefaultVertexBuffer()
+        {
+            if (!m_default_vertex_buffer)
+            {
+                // one float4 per attribute type, read with stride 0
+                Vector<Vector4> values((int) VertexAttributeType::Count, Vector4(0, 0, 0, 0));
+                values[(int) VertexAttributeType::Color] = Vector4(1, 1, 1, 1);
+
+                m_default_vertex_buffer = this->CreateBuffer(&values[0], values.SizeInBytes(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, false, VK_FORMAT_UNDEFINED);
+            }
+            return m_default_vertex_buffer;
+        }
+
         void CreatePipeline(
             VkRenderPass render_pass,
             const Vector<VertexAttribute>& attributes,
+            const VertexLayout& vertex_layout,
             VkShaderModule vs_module,
             VkShaderModule fs_module,
             const RenderState& render_state,
@@ -2265,11 +2850,15 @@ extern void UnbindSharedContext();
 
             Vector<VkVertexInputBindingDescription> vi_binds;
             VkVertexInputBindingDescription vi_bind;
-            Memory::Zero(&vi_bind, sizeof(vi_bind));
-            vi_bind.binding = VERTEX_INPUT_BINDING_VERTEX;
-            vi_bind.stride = sizeof(Vertex);
-            vi_bind.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-            vi_binds.Add(vi_bind);
+            for (int i = 0; i < vertex_layout.GetStreamCount(); ++i)
+            {
+                Memory::Zero(&vi_bind, sizeof(vi_bind));
+                vi_bind.binding = VERTEX_INPUT_BINDING_VERTEX + i;
+                vi_bind.stride = vertex_layout.GetStride(i);
+                vi_bind.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+                vi_binds.Add(vi_bind);
+            }
+            bool default_binding = false;
 
             Vector<VkVertexInputAttributeDescription> vi_attrs;
             for (int i = 0; i < attributes.Size(); ++i)
@@ -2278,25 +2867,23 @@ extern void UnbindSharedContext();
 
                 if (location < (int) VertexAttributeType::Count)
                 {
+                    const VertexLayoutAttribute* layout_attr = vertex_layout.GetAttribute((VertexAttributeType) location);
+
                     VkVertexInputAttributeDescription attr;
                     attr.location = location;
-                    attr.binding = VERTEX_INPUT_BINDING_VERTEX;
-                    switch (attributes[i].vector_size)
+                    if (layout_attr)
                     {
-                    case 2:
-                        attr.format = VK_FORMAT_R32G32_SFLOAT;
-                        break;
-                    case 3:
-                        attr.format = VK_FORMAT_R32G32B32_SFLOAT;
-                        break;
-                    case 4:
+                        attr.binding = VERTEX_INPUT_BINDING_VERTEX + layout_attr->stream;
+                        attr.format = GetVertexFormat(layout_attr->format);
+                        attr.offset = layout_attr->offset;
+                    }
+                    else
+                    {
+                        attr.binding = VERTEX_INPUT_BINDING_DEFAULT;
                         attr.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-                        break;
-                    default:
-                        assert(!"invalid vertex attribute vector size");
-                        break;
+                        attr.offset = sizeof(Vector4) * location;
+                        default_binding = true;
                     }
-                    attr.offset = VERTEX_ATTR_OFFSETS[location];
 
                     vi_attrs.Add(attr);
                 }
@@ -2325,6 +2912,15 @@ extern void UnbindSharedContext();
                 vi_binds.Add(vi_bind);
             }
 
+            if (default_binding)
+            {
+                Memory::Zero(&vi_bind, sizeof(vi_bind));
+                vi_bind.binding = VERTEX_INPUT_BINDING_DEFAULT;
+                vi_bind.stride = 0;
+                vi_bind.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+                vi_binds.Add(vi_bind);
+            }
+
             VkPipelineVertexInputStateCreateInfo vi;
             Memory::Zero(&vi, sizeof(vi));
             vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -2643,11 +3239,20 @@ extern void UnbindSharedContext();
         void CreateUniformBuffer(VkDescriptorSet descriptor_set, UniformBuffer& buffer)
         {
             assert(!buffer.buffer);
-            buffer.buffer = this->CreateBuffer(nullptr, buffer.size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, false, VK_FORMAT_UNDEFINED);
+            this->WaitFramesInFlight();
+
+            // written through QueueUpdateBuffer, so the gpu never reads memory the cpu is writing
+            m_uniform_arena->Allocate(buffer.size, buffer.buffer, &buffer.offset);
+
+            // the whole block is uploaded once, so members never set read as zero
+            buffer.data.Resize(buffer.size);
+            Memory::Zero(buffer.data.Bytes(), buffer.size);
+            buffer.dirty_begin = 0;
+            buffer.dirty_end = buffer.size;
 
             VkDescriptorBufferInfo buffer_info;
             buffer_info.buffer = buffer.buffer->GetBuffer();
-            buffer_info.offset = 0;
+            buffer_info.offset = buffer.offset;
             buffer_info.range = buffer.size;
 
             VkWriteDescriptorSet desc_write;
@@ -2668,6 +3273,8 @@ extern void UnbindSharedContext();
 
         void UpdateUniformTexture(VkDescriptorSet descriptor_set, int binding, bool is_storage, const Ref<Texture>& texture)
         {
+            this->WaitFramesInFlight();
+
             VkDescriptorImageInfo image_info;
             image_info.sampler = texture->GetSampler();
             image_info.imageView = texture->GetImageView();
@@ -2691,6 +3298,8 @@ extern void UnbindSharedContext();
 
         void UpdateStorageBuffer(VkDescriptorSet descriptor_set, int binding, const Ref<BufferObject>& buffer)
         {
+            this->WaitFramesInFlight();
+
             VkDescriptorBufferInfo buffer_info;
             buffer_info.buffer = buffer->GetBuffer();
             buffer_info.offset = 0;
@@ -2714,6 +3323,8 @@ extern void UnbindSharedContext();
 
         void UpdateTexelBuffer(VkDescriptorSet descriptor_set, int binding, VkDescriptorType type, const Ref<BufferObject>& buffer)
         {
+            this->WaitFramesInFlight();
+
             VkWriteDescriptorSet desc_write;
             Memory::Zero(&desc_write, sizeof(desc_write));
             desc_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -2766,6 +3377,7 @@ extern void UnbindSharedContext();
             const Rect& view_rect,
             const Rect& scissor_rect,
             const Ref<BufferObject>& vertex_buffer,
+            const Vector<int>& vertex_stream_offsets,
             const Ref<BufferObject>& index_buffer,
             IndexType index_type,
             const Ref<BufferObject>& draw_buffer,
@@ -2797,7 +3409,12 @@ extern void UnbindSharedContext();
             vkCmdSetScissor(cmd, 0, 1, &scissor);
 
             VkDeviceSize offset = 0;
-            vkCmdBindVertexBuffers(cmd, VERTEX_INPUT_BINDING_VERTEX, 1, &vertex_buffer->GetBuffer(), &offset);
+            for (int i = 0; i < vertex_stream_offsets.Size(); ++i)
+            {
+                VkDeviceSize stream_offset = vertex_stream_offsets[i];
+                vkCmdBindVertexBuffers(cmd, VERTEX_INPUT_BINDING_VERTEX + i, 1, &vertex_buffer->GetBuffer(), &stream_offset);
+            }
+            vkCmdBindVertexBuffers(cmd, VERTEX_INPUT_BINDING_DEFAULT, 1, &this->GetDefaultVertexBuffer()->GetBuffer(), &offset);
             if (instance_buffer)
             {
                 vkCmdBindVertexBuffers(cmd, VERTEX_INPUT_BINDING_INSTANCE, 1, &instance_buffer->GetBuffer(), &offset);
@@ -3133,72 +3750,124 @@ extern void UnbindSharedContext();
             vkCmdExecuteCommands(cmd, (uint32_t) instance_cmds.Size(), &instance_cmds[0]);
         }
 
-        void BuildPrimaryCmds()
+        // only the frame about to be submitted is recorded, its fence was waited so it is not pending,
+        // returns the draw cmd of image_index
+        VkCommandBuffer BuildPrimaryCmds(FrameResources& frame, int image_index)
         {
+            while (frame.draw_cmds.Size() <= image_index)
+            {
+                VkCommandBuffer draw_cmd;
+                this->CreateCommandBuffer(m_frame_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &draw_cmd);
+                frame.draw_cmds.Add(draw_cmd);
+                frame.draw_cmd_versions.Add(-1);
+            }
+
+            bool compute_dirty = frame.compute_cmd_version != m_primary_cmd_version;
+            bool draw_dirty = frame.draw_cmd_versions[image_index] != m_primary_cmd_version;
+            if (!compute_dirty && !draw_dirty)
+            {
+                return frame.draw_cmds[image_index];
+            }
+
             m_cameras.Sort([](const Ref<Camera>& a, const Ref<Camera>& b) {
                 return a->GetDepth() < b->GetDepth();
             });
 
-            if (m_compute_cmd != VK_NULL_HANDLE)
+            if (compute_dirty)
             {
-                VkCommandBuffer cmd = m_compute_cmd;
+                this->BuildComputePrimaryCmds(frame);
+            }
+
+            if (draw_dirty)
+            {
+                this->BuildDrawPrimaryCmd(frame.draw_cmds[image_index], image_index);
+                frame.draw_cmd_versions[image_index] = m_primary_cmd_version;
+            }
+
+            return frame.draw_cmds[image_index];
+        }
+
+        void BuildComputePrimaryCmds(FrameResources& frame)
+        {
+            frame.has_compute = false;
+            frame.compute_cmd_version = m_primary_cmd_version;
+
+            if (m_compute_cmd_pool != VK_NULL_HANDLE)
+            {
+                if (frame.compute_cmd == VK_NULL_HANDLE)
+                {
+                    this->CreateCommandBuffer(m_compute_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &frame.compute_cmd);
+                }
+
+                VkCommandBuffer cmd = frame.compute_cmd;
 
                 this->BuildPrimaryCmdBegin(cmd);
 
-                m_has_compute_instance_cmds = false;
                 for (auto j : m_cameras)
                 {
                     Vector<VkCommandBuffer> cmds = j->GetComputeInstanceCmds();
                     if (cmds.Size() > 0)
                     {
-                        m_has_compute_instance_cmds = true;
+                        frame.has_compute = true;
                         this->BuildComputePrimaryCmd(cmd, cmds);
                     }
                 }
 
                 this->BuildPrimaryCmdEnd(cmd);
             }
+        }
 
-            for (int i = 0; i < m_swapchain_image_resources.Size(); ++i)
-            {
-                VkCommandBuffer cmd = m_swapchain_image_resources[i].cmd;
-
-                this->BuildPrimaryCmdBegin(cmd);
-
-                for (auto j : m_cameras)
-                {
-                    this->BuildPrimaryCmd(
-                        cmd,
-                        i,
-                        j->GetInstanceCmds(),
-                        j->GetRenderPass(),
-                        j->GetFramebuffer(i),
-                        j->GetTargetWidth(),
-                        j->GetTargetHeight(),
-                        j->GetClearFlags(),
-                        j->GetClearColor(),
-						j->GetRenderTargetColor(),
-						j->GetRenderTargetDepth(),
-                        j->GetExtraRenderTargets());
-                }
-
-                this->BuildPrimaryCmdEnd(cmd);
-            }
+        void BuildDrawPrimaryCmd(VkCommandBuffer cmd, int image_index)
+        {
+            this->BuildPrimaryCmdBegin(cmd);
+
+            for (auto j : m_cameras)
+            {
+                this->BuildPrimaryCmd(
+                    cmd,
+                    image_index,
+                    j->GetInstanceCmds(),
+                    j->GetRenderPass(),
+                    j->GetFramebuffer(image_index),
+                    j->GetTargetWidth(),
+                    j->GetTargetHeight(),
+                    j->GetClearFlags(),
+                    j->GetClearColor(),
+                    j->GetRenderTargetColor(),
+                    j->GetRenderTargetDepth(),
+                    j->GetExtraRenderTargets());
+            }
+
+            this->BuildPrimaryCmdEnd(cmd);
         }
 
         void Update()
         {
+            TransformHierarchy::Update();
+
+            // before any camera records, the bone palette buffer stays the same for the rest of the frame
+            SkinnedMeshRenderer::BindBonePalettes();
+            int bone_palette_version = BonePalette::GetVersion();
+
             for (auto i : m_cameras)
             {
                 i->Update();
             }
 
-            if (m_primary_cmd_dirty)
+            // a renderer added during the camera updates grew the palette after others bound it,
+            // bind all of them to the new buffer and update the cameras again
+            if (BonePalette::GetVersion() != bone_palette_version)
             {
-                m_primary_cmd_dirty = false;
+                SkinnedMeshRenderer::BindBonePalettes();
 
-                this->BuildPrimaryCmds();
+                for (auto i : m_cameras)
+                {
+                    i->Update();
+                }
             }
+
+            // skinned mesh renderers wrote their bones in camera updates
+            BonePalette::Upload();
         }
 
         void OnDraw()
@@ -3223,70 +3892,143 @@ extern void UnbindSharedContext();
                 return;
             }
 
-            // wait for previous frame draw complete
-            VkResult err = vkWaitForFences(m_device, 1, &m_draw_complete_fence, VK_TRUE, UINT64_MAX);
-            assert(!err);
-            err = vkResetFences(m_device, 1, &m_draw_complete_fence);
+            FrameResources& frame = m_frames[m_frame_index];
+
+            // wait only for the frame that last used these resources,
+            // the other frames in flight keep the gpu busy while this one is prepared
+            VkResult err = vkWaitForFences(m_device, 1, &frame.draw_complete_fence, VK_TRUE, UINT64_MAX);
             assert(!err);
 
+            // fences signal in submission order, so every frame before this one is complete as well
+            this->RunReleases(frame.releases);
+
             this->Update();
 
-            err = fpAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, m_image_acquired_semaphore, VK_NULL_HANDLE, (uint32_t*) &m_image_index);
+            err = fpAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, frame.image_acquired_semaphore, VK_NULL_HANDLE, (uint32_t*) &m_image_index);
             assert(!err);
 
+            VkCommandBuffer draw_cmd = this->BuildPrimaryCmds(frame, m_image_index);
+
+            bool has_compute = m_compute_queue != VK_NULL_HANDLE && frame.has_compute;
+            bool has_upload = this->FlushBufferUpdates(frame);
+
             m_image_cmd_mutex.lock();
 
-            if (m_compute_queue != VK_NULL_HANDLE && m_has_compute_instance_cmds)
+            // reset right before submit, anyone waiting on frames in flight meanwhile sees it signaled
+            err = vkResetFences(m_device, 1, &frame.draw_complete_fence);
+            assert(!err);
+
+            {
+                std::lock_guard<Mutex> lock(m_release_mutex);
+                frame.releases.AddRange(m_pending_releases);
+                m_pending_releases.Clear();
+            }
+
+            if (has_upload)
             {
-                VkPipelineStageFlags pipe_stage_flags = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
                 VkSubmitInfo submit_info;
                 Memory::Zero(&submit_info, sizeof(submit_info));
                 submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
                 submit_info.pNext = nullptr;
-                submit_info.waitSemaphoreCount = 1;
-                submit_info.pWaitSemaphores = &m_image_acquired_semaphore;
-                submit_info.pWaitDstStageMask = &pipe_stage_flags;
+                submit_info.waitSemaphoreCount = 0;
+                submit_info.pWaitSemaphores = nullptr;
+                submit_info.pWaitDstStageMask = nullptr;
                 submit_info.commandBufferCount = 1;
-                submit_info.pCommandBuffers = &m_compute_cmd;
+                submit_info.pCommandBuffers = &frame.upload_cmd;
+                submit_info.signalSemaphoreCount = has_compute ? 1 : 0;
+                submit_info.pSignalSemaphores = has_compute ? &frame.upload_semaphore : nullptr;
+
+                err = vkQueueSubmit(m_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+                assert(!err);
+            }
+
+            // with one frame in flight the fence already orders this frame after the last one
+            bool signal_draw_read = m_frames.Size() > 1 && m_compute_queue != VK_NULL_HANDLE;
+
+            if (has_compute)
+            {
+                VkSemaphore wait_semaphores[3] = { frame.image_acquired_semaphore };
+                VkPipelineStageFlags wait_stages[3] = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
+                int wait_count = 1;
+                if (has_upload)
+                {
+                    wait_semaphores[wait_count++] = frame.upload_semaphore;
+                }
+                // the last frame may still draw from the vertices this compute writes again
+                if (m_draw_read_semaphore != VK_NULL_HANDLE)
+                {
+                    wait_semaphores[wait_count++] = m_draw_read_semaphore;
+                    m_draw_read_semaphore = VK_NULL_HANDLE;
+                }
+
+                VkSubmitInfo submit_info;
+                Memory::Zero(&submit_info, sizeof(submit_info));
+                submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submit_info.pNext = nullptr;
+                submit_info.waitSemaphoreCount = wait_count;
+                submit_info.pWaitSemaphores = wait_semaphores;
+                submit_info.pWaitDstStageMask = wait_stages;
+                submit_info.commandBufferCount = 1;
+                submit_info.pCommandBuffers = &frame.compute_cmd;
                 submit_info.signalSemaphoreCount = 1;
-                submit_info.pSignalSemaphores = &m_compute_semaphore;
+                submit_info.pSignalSemaphores = &frame.compute_semaphore;
 
                 err = vkQueueSubmit(m_compute_queue, 1, &submit_info, VK_NULL_HANDLE);
                 assert(!err);
 
-                pipe_stage_flags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-                submit_info.pWaitSemaphores = &m_compute_semaphore;
-                submit_info.pCommandBuffers = &m_swapchain_image_resources[m_image_index].cmd;
-                submit_info.pSignalSemaphores = &m_draw_complete_semaphore;
+                // compute may write vertex buffers, as pre skinned vertices, so wait before vertex input
+                VkPipelineStageFlags pipe_stage_flags = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+                VkSemaphore signal_semaphores[2] = { frame.draw_complete_semaphore, frame.draw_read_semaphore };
+                submit_info.waitSemaphoreCount = 1;
+                submit_info.pWaitSemaphores = &frame.compute_semaphore;
+                submit_info.pWaitDstStageMask = &pipe_stage_flags;
+                submit_info.pCommandBuffers = &draw_cmd;
+                submit_info.signalSemaphoreCount = signal_draw_read ? 2 : 1;
+                submit_info.pSignalSemaphores = signal_semaphores;
 
-                err = vkQueueSubmit(m_graphics_queue, 1, &submit_info, m_draw_complete_fence);
+                err = vkQueueSubmit(m_graphics_queue, 1, &submit_info, frame.draw_complete_fence);
                 assert(!err);
             }
             else
             {
-                VkPipelineStageFlags pipe_stage_flags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                VkSemaphore wait_semaphores[2] = { frame.image_acquired_semaphore };
+                VkPipelineStageFlags wait_stages[2] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT };
+                int wait_count = 1;
+                // nothing to order without compute, the semaphore is only consumed so it can be signaled again
+                if (m_draw_read_semaphore != VK_NULL_HANDLE)
+                {
+                    wait_semaphores[wait_count++] = m_draw_read_semaphore;
+                    m_draw_read_semaphore = VK_NULL_HANDLE;
+                }
+
+                VkSemaphore signal_semaphores[2] = { frame.draw_complete_semaphore, frame.draw_read_semaphore };
                 VkSubmitInfo submit_info;
                 Memory::Zero(&submit_info, sizeof(submit_info));
                 submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
                 submit_info.pNext = nullptr;
-                submit_info.waitSemaphoreCount = 1;
-                submit_info.pWaitSemaphores = &m_image_acquired_semaphore;
-                submit_info.pWaitDstStageMask = &pipe_stage_flags;
+                submit_info.waitSemaphoreCount = wait_count;
+                submit_info.pWaitSemaphores = wait_semaphores;
+                submit_info.pWaitDstStageMask = wait_stages;
                 submit_info.commandBufferCount = 1;
-                submit_info.pCommandBuffers = &m_swapchain_image_resources[m_image_index].cmd;
-                submit_info.signalSemaphoreCount = 1;
-                submit_info.pSignalSemaphores = &m_draw_complete_semaphore;
+                submit_info.pCommandBuffers = &draw_cmd;
+                submit_info.signalSemaphoreCount = signal_draw_read ? 2 : 1;
+                submit_info.pSignalSemaphores = signal_semaphores;
 
-                err = vkQueueSubmit(m_graphics_queue, 1, &submit_info, m_draw_complete_fence);
+                err = vkQueueSubmit(m_graphics_queue, 1, &submit_info, frame.draw_complete_fence);
                 assert(!err);
             }
 
+            if (signal_draw_read)
+            {
+                m_draw_read_semaphore = frame.draw_read_semaphore;
+            }
+
             VkPresentInfoKHR present_info;
             Memory::Zero(&present_info, sizeof(present_info));
             present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
             present_info.pNext = nullptr;
             present_info.waitSemaphoreCount = 1;
-            present_info.pWaitSemaphores = &m_draw_complete_semaphore;
+            present_info.pWaitSemaphores = &frame.draw_complete_semaphore;
             present_info.swapchainCount = 1;
             present_info.pSwapchains = &m_swapchain;
             present_info.pImageIndices = (uint32_t*) &m_image_index;
@@ -3296,6 +4038,8 @@ extern void UnbindSharedContext();
             assert(!err);
 
             m_image_cmd_mutex.unlock();
+
+            m_frame_index = (m_frame_index + 1) % m_frames.Size();
         }
 #endif
 
@@ -3700,6 +4444,8 @@ extern void UnbindSharedContext();
                 return a->GetDepth() < b->GetDepth();
             });
 
+            TransformHierarchy::Update();
+
             for (auto i : m_cameras)
             {
                 i->Update();
@@ -3845,11 +4591,14 @@ void main()
         m_private->InitPhysicalDevice();
         m_private->CreateSurface();
         m_private->CreateDevice();
+        m_private->CreateMemoryAllocator();
         m_private->GetQueues();
         m_private->CreateSignals();
         m_private->CreateImageCmd();
         m_private->CreateComputeCmd();
         m_private->CreateSizeDependentResources();
+        // created up front, instance cmds are recorded on worker threads
+        m_private->GetDefaultVertexBuffer();
 #elif VR_GLES
         String version = (const char*) glGetString(GL_VERSION);
         Log("GL Version: %s", version.CString());
@@ -3993,9 +4742,29 @@ void main()
         vkDeviceWaitIdle(m_private->m_device);
     }
 
+    void Display::WaitFramesInFlight()
+    {
+        m_private->WaitFramesInFlight();
+    }
+
+    void Display::ReleaseAfterFrames(const Action& release)
+    {
+        m_private->ReleaseAfterFrames(release);
+    }
+
+    int Display::GetFramesInFlight() const
+    {
+        return m_private->m_frames_in_flight;
+    }
+
+    void Display::SetFramesInFlight(int count)
+    {
+        m_private->SetFramesInFlight(count);
+    }
+
     void Display::MarkPrimaryCmdDirty()
     {
-        m_private->m_primary_cmd_dirty = true;
+        m_private->m_primary_cmd_version += 1;
     }
 
     void Display::CreateRenderPass(
@@ -4184,6 +4953,7 @@ void main()
     void Display::CreatePipeline(
         VkRenderPass render_pass,
         const Vector<VertexAttribute>& attributes,
+        const VertexLayout& vertex_layout,
         VkShaderModule vs_module,
         VkShaderModule fs_module,
         const RenderState& render_state,
@@ -4200,6 +4970,7 @@ void main()
         m_private->CreatePipeline(
             render_pass,
             attributes,
+            vertex_layout,
             vs_module,
             fs_module,
             render_state,
@@ -4250,6 +5021,23 @@ void main()
         m_private->CreateUniformBuffer(descriptor_set, buffer);
     }
 
+    void Display::FreeUniformBuffer(UniformBuffer& buffer)
+    {
+        if (buffer.buffer && m_private->m_uniform_arena)
+        {
+            // a frame in flight may still read the block, it can be handed out again only after
+            UniformArena* arena = m_private->m_uniform_arena;
+            Ref<BufferObject> block_buffer = buffer.buffer;
+            int offset = buffer.offset;
+            int size = buffer.size;
+            m_private->ReleaseAfterFrames([=]() {
+                arena->Free(block_buffer, offset, size);
+            });
+        }
+        buffer.buffer.reset();
+        buffer.data.Clear();
+    }
+
     void Display::UpdateUniformTexture(VkDescriptorSet descriptor_set, int binding, bool is_storage, const Ref<Texture>& texture)
     {
         m_private->UpdateUniformTexture(descriptor_set, binding, is_storage, texture);
@@ -4269,10 +5057,8 @@ void main()
     {
         if (device_local && data)
         {
-            Ref<BufferObject> staging_buffer = m_private->CreateBuffer(data, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, VK_FORMAT_UNDEFINED);
             Ref<BufferObject> buffer = m_private->CreateBuffer(nullptr, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, true, view_format);
-            m_private->CopyBuffer(staging_buffer, 0, buffer, 0, size);
-            staging_buffer->Destroy(this->GetDevice());
+            m_private->UploadBuffer(buffer, 0, data, size);
             return buffer;
         }
         else
@@ -4285,9 +5071,7 @@ void main()
     {
         if (buffer->IsDeviceLocal())
         {
-            Ref<BufferObject> staging_buffer = m_private->CreateBuffer(data, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, VK_FORMAT_UNDEFINED);
-            m_private->CopyBuffer(staging_buffer, 0, buffer, buffer_offset, size);
-            staging_buffer->Destroy(this->GetDevice());
+            m_private->UploadBuffer(buffer, buffer_offset, data, size);
         }
         else
         {
@@ -4295,11 +5079,31 @@ void main()
         }
     }
 
+    void Display::CopyBuffer(const Ref<BufferObject>& src, int src_offset, const Ref<BufferObject>& dst, int dst_offset, int size)
+    {
+        m_private->CopyBuffer(src, src_offset, dst, dst_offset, size);
+    }
+
     void Display::ReadBuffer(const Ref<BufferObject>& buffer, ByteBuffer& data)
     {
         m_private->ReadBuffer(buffer, data);
     }
 
+    void Display::QueueUpdateBuffer(const Ref<BufferObject>& buffer, int buffer_offset, const void* data, int size)
+    {
+        m_private->QueueUpdateBuffer(buffer, buffer_offset, data, size);
+    }
+
+    void Display::FreeMemory(MemoryAllocation& allocation)
+    {
+        m_private->m_memory_allocator->Free(allocation);
+    }
+
+    MemoryStatistics Display::GetMemoryStatistics() const
+    {
+        return m_private->m_memory_allocator->GetStatistics();
+    }
+
     void Display::BeginInstanceCmd(
         VkCommandBuffer cmd,
         VkRenderPass render_pass)
@@ -4317,6 +5121,7 @@ void main()
         const Rect& view_rect,
         const Rect& scissor_rect,
         const Ref<BufferObject>& vertex_buffer,
+        const Vector<int>& vertex_stream_offsets,
         const Ref<BufferObject>& index_buffer,
         IndexType index_type,
         const Ref<BufferObject>& draw_buffer,
@@ -4333,6 +5138,7 @@ void main()
             view_rect,
             scissor_rect,
             vertex_buffer,
+            vertex_stream_offsets,
             index_buffer,
             index_type,
             draw_buffer,
@@ -4422,6 +5228,21 @@ void main()
         m_private->EndImageCmd();
     }
 
+    void Display::BeginUploadBatch()
+    {
+        m_private->BeginUploadBatch();
+    }
+
+    void Display::EndUploadBatch()
+    {
+        m_private->EndUploadBatch();
+    }
+
+    Ref<BufferObject> Display::StageData(const void* data, int size, int* offset)
+    {
+        return m_private->StageData(data, size, offset);
+    }
+
     void Display::SetImageLayout(
         VkImage image,
 		VkPipelineStageFlags src_stage,
@@ -4432,7 +5253,7 @@ void main()
         VkAccessFlagBits src_access_mask)
     {
         m_private->SetImageLayout(
-			m_private->m_image_cmd,
+			m_private->GetImageCmd(),
             image,
 			src_stage,
 			dst_stage,
@@ -4444,7 +5265,7 @@ void main()
 
     VkCommandBuffer Display::GetImageCmd() const
     {
-        return m_private->m_image_cmd;
+        return m_private->GetImageCmd();
     }
 
     bool Display::IsSupportMultiview() const
@@ -45,6 +45,10 @@ namespace Viry3D
     struct RenderState;
     class BufferObject;
     class DisplayPrivate;
+#if VR_VULKAN
+    struct MemoryAllocation;
+    struct MemoryStatistics;
+#endif
 
     class Display
     {
@@ -66,6 +70,12 @@ namespace Viry3D
 #if VR_VULKAN
         VkDevice GetDevice() const;
         void WaitDevice() const;
+        void WaitFramesInFlight();
+        // runs release after all frames that may use the resource have completed
+        void ReleaseAfterFrames(const Action& release);
+        int GetFramesInFlight() const;
+        // 1 to 3, call between frames
+        void SetFramesInFlight(int count);
         void MarkPrimaryCmdDirty();
         void CreateRenderPass(
             const Ref<Texture>& color_texture,
@@ -101,6 +111,7 @@ namespace Viry3D
         void CreatePipeline(
             VkRenderPass render_pass,
             const Vector<VertexAttribute>& attributes,
+            const VertexLayout& vertex_layout,
             VkShaderModule vs_module,
             VkShaderModule fs_module,
             const RenderState& render_state,
@@ -125,12 +136,20 @@ namespace Viry3D
             const Vector<VkDescriptorSetLayout>& descriptor_layouts,
             Vector<VkDescriptorSet>& descriptor_sets);
         void CreateUniformBuffer(VkDescriptorSet descriptor_set, UniformBuffer& buffer);
+        void FreeUniformBuffer(UniformBuffer& buffer);
         void UpdateUniformTexture(VkDescriptorSet descriptor_set, int binding, bool is_storage, const Ref<Texture>& texture);
         void UpdateStorageBuffer(VkDescriptorSet descriptor_set, int binding, const Ref<BufferObject>& buffer);
         void UpdateTexelBuffer(VkDescriptorSet descriptor_set, int binding, VkDescriptorType type, const Ref<BufferObject>& buffer);
         Ref<BufferObject> CreateBuffer(const void* data, int size, VkBufferUsageFlags usage, bool device_local, VkFormat view_format);
         void UpdateBuffer(const Ref<BufferObject>& buffer, int buffer_offset, const void* data, int size);
+        // copied into the buffer on the gpu at the start of the next submitted frame,
+        // for data changing every frame, the buffer needs VK_BUFFER_USAGE_TRANSFER_DST_BIT
+        void QueueUpdateBuffer(const Ref<BufferObject>& buffer, int buffer_offset, const void* data, int size);
+        // copied on the gpu before returning, both buffers need the matching transfer usage bit
+        void CopyBuffer(const Ref<BufferObject>& src, int src_offset, const Ref<BufferObject>& dst, int dst_offset, int size);
         void ReadBuffer(const Ref<BufferObject>& buffer, ByteBuffer& data);
+        void FreeMemory(MemoryAllocation& allocation);
+        MemoryStatistics GetMemoryStatistics() const;
         void BeginInstanceCmd(
             VkCommandBuffer cmd,
             VkRenderPass render_pass);
@@ -144,6 +163,7 @@ namespace Viry3D
             const Rect& view_rect,
             const Rect& scissor_rect,
             const Ref<BufferObject>& vertex_buffer,
+            const Vector<int>& vertex_stream_offsets,
             const Ref<BufferObject>& index_buffer,
             IndexType index_type,
             const Ref<BufferObject>& draw_buffer,
@@ -178,6 +198,12 @@ namespace Viry3D
             VkSamplerAddressMode wrap_mode);
         void BeginImageCmd();
         void EndImageCmd();
+        // image cmds and device local uploads from this thread are recorded into one batch,
+        // submitted with a single fence at EndUploadBatch, resources are usable after that
+        void BeginUploadBatch();
+        void EndUploadBatch();
+        // copies data to staging memory for the image cmd being recorded
+        Ref<BufferObject> StageData(const void* data, int size, int* offset);
         void SetImageLayout(
             VkImage image,
 			VkPipelineStageFlags src_stage,
@@ -21,6 +21,7 @@
 #include "Light.h"
 #include "BufferObject.h"
 #include "Texture.h"
+#include "math/Mathf.h"
 
 namespace Viry3D
 {
@@ -40,19 +41,13 @@ namespace Viry3D
     void Material::Release()
     {
 #if VR_VULKAN
-        VkDevice device = Display::Instance()->GetDevice();
-
         m_descriptor_sets.Clear();
 
         for (int i = 0; i < m_uniform_sets.Size(); ++i)
         {
             for (int j = 0; j < m_uniform_sets[i].buffers.Size(); ++j)
             {
-                if (m_uniform_sets[i].buffers[j].buffer)
-                {
-                    m_uniform_sets[i].buffers[j].buffer->Destroy(device);
-                    m_uniform_sets[i].buffers[j].buffer.reset();
-                }
+                Display::Instance()->FreeUniformBuffer(m_uniform_sets[i].buffers[j]);
             }
         }
         m_uniform_sets.Clear();
@@ -164,7 +159,7 @@ namespace Viry3D
             property.type = MaterialProperty::Type::Texture;
             property.texture = texture;
             property.dirty = true;
-            m_properties.Add(name, property);
+            this->AddProperty(property);
         }
     }
 
@@ -184,7 +179,7 @@ namespace Viry3D
             property.type = MaterialProperty::Type::StorageBuffer;
             property.buffer = buffer;
             property.dirty = true;
-            m_properties.Add(name, property);
+            this->AddProperty(property);
         }
     }
 
@@ -204,7 +199,7 @@ namespace Viry3D
             property.type = MaterialProperty::Type::UniformTexelBuffer;
             property.buffer = buffer;
             property.dirty = true;
-            m_properties.Add(name, property);
+            this->AddProperty(property);
         }
     }
 
@@ -224,7 +219,7 @@ namespace Viry3D
             property.type = MaterialProperty::Type::StorageTexelBuffer;
             property.buffer = buffer;
             property.dirty = true;
-            m_properties.Add(name, property);
+            this->AddProperty(property);
         }
     }
 
@@ -244,7 +239,7 @@ namespace Viry3D
             property.type = MaterialProperty::Type::VectorArray;
             property.vector_array = array;
             property.dirty = true;
-            m_properties.Add(name, property);
+            this->AddProperty(property);
         }
     }
 
@@ -264,10 +259,24 @@ namespace Viry3D
             property.type = MaterialProperty::Type::MatrixArray;
             property.matrix_array = array;
             property.dirty = true;
-            m_properties.Add(name, property);
+            this->AddProperty(property);
         }
     }
 
+    void Material::AddProperty(const MaterialProperty& property)
+    {
+        m_properties.Add(property.name, property);
+
+        MaterialProperty* property_ptr;
+        m_properties.TryGet(property.name, &property_ptr);
+        property_ptr->id = Shader::PropertyToID(property.name);
+
+#if VR_GLES
+        // map nodes never move, the flat list is walked on every draw instead of the map
+        m_property_list.Add(property_ptr);
+#endif
+    }
+
     void Material::SetLightProperties(const Ref<Light>& light)
     {
         this->SetColor(AMBIENT_COLOR, Light::GetAmbientColor());
@@ -337,12 +346,37 @@ namespace Viry3D
             }
         }
 
+        this->FlushUniformBuffers();
+
         if (instance_cmd_dirty)
         {
             this->MarkInstanceCmdDirty();
         }
     }
 
+    void Material::FlushUniformBuffers()
+    {
+        for (int i = 0; i < m_uniform_sets.Size(); ++i)
+        {
+            for (int j = 0; j < m_uniform_sets[i].buffers.Size(); ++j)
+            {
+                auto& buffer = m_uniform_sets[i].buffers[j];
+
+                if (buffer.dirty_end > buffer.dirty_begin)
+                {
+                    Display::Instance()->QueueUpdateBuffer(
+                        buffer.buffer,
+                        buffer.offset + buffer.dirty_begin,
+                        buffer.data.Bytes(buffer.dirty_begin),
+                        buffer.dirty_end - buffer.dirty_begin);
+
+                    buffer.dirty_begin = 0;
+                    buffer.dirty_end = 0;
+                }
+            }
+        }
+    }
+
     int Material::FindUniformSetIndex(const String& name)
     {
         for (int i = 0; i < m_uniform_sets.Size(); ++i)
@@ -397,7 +431,20 @@ namespace Viry3D
                             Display::Instance()->CreateUniformBuffer(m_descriptor_sets[i], buffer);
                             instance_cmd_dirty = true;
                         }
-                        Display::Instance()->UpdateBuffer(buffer.buffer, member.offset, data, size);
+
+                        // gathered in the cpu copy, uploaded by FlushUniformBuffers
+                        Memory::Copy(buffer.data.Bytes(member.offset), data, size);
+
+                        if (buffer.dirty_end > buffer.dirty_begin)
+                        {
+                            buffer.dirty_begin = Mathf::Min(buffer.dirty_begin, member.offset);
+                            buffer.dirty_end = Mathf::Max(buffer.dirty_end, member.offset + size);
+                        }
+                        else
+                        {
+                            buffer.dirty_begin = member.offset;
+                            buffer.dirty_end = member.offset + size;
+                        }
                         return;
                     }
                 }
@@ -481,40 +528,40 @@ namespace Viry3D
     void Material::ApplyUniforms() const
     {
         int texture_unit = 0;
-        for (const auto& i : m_properties)
+        for (int i = 0; i < m_property_list.Size(); ++i)
         {
-            const MaterialProperty& p = i.second;
+            const MaterialProperty& p = *m_property_list[i];
             switch (p.type)
             {
             case MaterialProperty::Type::Color:
-                m_shader->SetUniform4f(p.name, 1, (const float*) &p.data.color);
+                m_shader->SetUniform4f(p.id, 1, (const float*) &p.data.color);
                 break;
             case MaterialProperty::Type::Vector:
-                m_shader->SetUniform4f(p.name, 1, (const float*) &p.data.vector);
+                m_shader->SetUniform4f(p.id, 1, (const float*) &p.data.vector);
                 break;
             case MaterialProperty::Type::Float:
-                m_shader->SetUniform1f(p.name, p.data.float_value);
+                m_shader->SetUniform1f(p.id, p.data.float_value);
                 break;
             case MaterialProperty::Type::Texture:
                 if (p.texture)
                 {
                     glActiveTexture(GL_TEXTURE0 + texture_unit);
                     p.texture->Bind();
-                    m_shader->SetUniform1i(p.name, texture_unit);
+                    m_shader->SetUniform1i(p.id, texture_unit);
                     texture_unit += 1;
                 }
                 break;
             case MaterialProperty::Type::Matrix:
-                m_shader->SetUniformMatrix(p.name, 1, (const float*) &p.data.matrix);
+                m_shader->SetUniformMatrix(p.id, 1, (const float*) &p.data.matrix);
                 break;
             case MaterialProperty::Type::VectorArray:
-                m_shader->SetUniform4f(p.name, p.vector_array.Size(), (const float*) &p.vector_array[0]);
+                m_shader->SetUniform4f(p.id, p.vector_array.Size(), (const float*) &p.vector_array[0]);
                 break;
             case MaterialProperty::Type::MatrixArray:
-                m_shader->SetUniformMatrix(p.name, p.matrix_array.Size(), (const float*) &p.matrix_array[0]);
+                m_shader->SetUniformMatrix(p.id, p.matrix_array.Size(), (const float*) &p.matrix_array[0]);
                 break;
             case MaterialProperty::Type::Int:
-                m_shader->SetUniform1i(p.name, p.data.int_value);
+                m_shader->SetUniform1i(p.id, p.data.int_value);
                 break;
             }
         }
@@ -77,6 +77,8 @@ namespace Viry3D
         };
 
         String name;
+        // from Shader::PropertyToID
+        int id;
         Type type;
         Data data;
         Ref<Texture> texture;
@@ -155,10 +157,12 @@ namespace Viry3D
                 Memory::Copy(&property.data, &v, sizeof(v));
                 property.size = sizeof(v);
                 property.dirty = true;
-                m_properties.Add(name, property);
+                this->AddProperty(property);
             }
         }
+        void AddProperty(const MaterialProperty& property);
         void UpdateUniformMember(const String& name, const void* data, int size, bool& instance_cmd_dirty);
+        void FlushUniformBuffers();
         void UpdateUniformTexture(const String& name, const Ref<Texture>& texture, bool& instance_cmd_dirty);
         void UpdateStorageBuffer(const String& name, const Ref<BufferObject>& buffer, bool& instance_cmd_dirty);
         void UpdateUniformTexelBuffer(const String& name, const Ref<BufferObject>& buffer, bool& instance_cmd_dirty);
@@ -178,6 +182,8 @@ namespace Viry3D
 #if VR_VULKAN
         Vector<UniformSet> m_uniform_sets;
         Vector<VkDescriptorSet> m_descriptor_sets;
+#elif VR_GLES
+        Vector<MaterialProperty*> m_property_list;
 #endif
     };
 }
@@ -0,0 +1,401 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "MemoryAllocator.h"
+
+#if VR_VULKAN
+
+#include "Debug.h"
+#include "container/List.h"
+#include "memory/Memory.h"
+#include "math/Mathf.h"
+
+#define MEMORY_BLOCK_SIZE_MAX (64 * 1024 * 1024)
+#define MEMORY_BLOCK_SIZE_MIN (4 * 1024 * 1024)
+
+namespace Viry3D
+{
+    class MemoryBlock
+    {
+    public:
+        struct Range
+        {
+            VkDeviceSize offset;
+            VkDeviceSize size;
+        };
+
+        MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, void* mapped, bool linear):
+            m_memory(memory),
+            m_size(size),
+            m_mapped(mapped),
+            m_linear(linear),
+            m_used_bytes(0),
+            m_allocation_count(0)
+        {
+            m_free_ranges.AddLast({ 0, size });
+        }
+
+        // best fit into the free ranges, which are kept sorted by offset
+        bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+        {
+            auto best = m_free_ranges.end();
+            VkDeviceSize best_offset = 0;
+
+            for (auto i = m_free_ranges.begin(); i != m_free_ranges.end(); ++i)
+            {
+                VkDeviceSize aligned_offset = (i->offset + alignment - 1) / alignment * alignment;
+                VkDeviceSize padding = aligned_offset - i->offset;
+
+                if (padding + size <= i->size)
+                {
+                    if (best == m_free_ranges.end() || i->size < best->size)
+                    {
+                        best = i;
+                        best_offset = aligned_offset;
+                    }
+                }
+            }
+
+            if (best == m_free_ranges.end())
+            {
+                return false;
+            }
+
+            Range range = *best;
+            auto next = m_free_ranges.Remove(best);
+
+            if (best_offset > range.offset)
+            {
+                m_free_ranges.AddBefore(next, { range.offset, best_offset - range.offset });
+            }
+
+            VkDeviceSize end = best_offset + size;
+            if (end < range.offset + range.size)
+            {
+                m_free_ranges.AddBefore(next, { end, range.offset + range.size - end });
+            }
+
+            *offset = best_offset;
+            m_used_bytes += size;
+            m_allocation_count += 1;
+
+            return true;
+        }
+
+        void Free(VkDeviceSize offset, VkDeviceSize size)
+        {
+            auto next = m_free_ranges.begin();
+            while (next != m_free_ranges.end() && next->offset < offset)
+            {
+                ++next;
+            }
+
+            auto i = m_free_ranges.AddBefore(next, { offset, size });
+
+            // merge with following range
+            if (next != m_free_ranges.end() && i->offset + i->size == next->offset)
+            {
+                i->size += next->size;
+                m_free_ranges.Remove(next);
+            }
+
+            // merge with previous range
+            if (i != m_free_ranges.begin())
+            {
+                auto prev = i;
+                --prev;
+                if (prev->offset + prev->size == i->offset)
+                {
+                    prev->size += i->size;
+                    m_free_ranges.Remove(i);
+                }
+            }
+
+            m_used_bytes -= size;
+            m_allocation_count -= 1;
+        }
+
+        void CollectStatistics(MemoryStatistics& stats) const
+        {
+            stats.block_count += 1;
+            stats.allocation_count += m_allocation_count;
+            stats.block_bytes += m_size;
+            stats.used_bytes += m_used_bytes;
+
+            for (const auto& i : m_free_ranges)
+            {
+                stats.free_bytes += i.size;
+                stats.free_range_count += 1;
+                if (i.size > stats.largest_free_range)
+                {
+                    stats.largest_free_range = i.size;
+                }
+            }
+        }
+
+        VkDeviceMemory GetMemory() const { return m_memory; }
+        VkDeviceSize GetSize() const { return m_size; }
+        void* GetMapped() const { return m_mapped; }
+        bool IsLinear() const { return m_linear; }
+        bool IsEmpty() const { return m_allocation_count == 0; }
+
+    private:
+        VkDeviceMemory m_memory;
+        VkDeviceSize m_size;
+        void* m_mapped;
+        bool m_linear;
+        VkDeviceSize m_used_bytes;
+        int m_allocation_count;
+        List<Range> m_free_ranges;
+    };
+
+    MemoryAllocator::MemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memory_properties):
+        m_device(device),
+        m_memory_properties(memory_properties)
+    {
+        for (int i = 0; i < VK_MAX_MEMORY_TYPES; ++i)
+        {
+            m_dedicated_count[i] = 0;
+            m_dedicated_bytes[i] = 0;
+        }
+    }
+
+    MemoryAllocator::~MemoryAllocator()
+    {
+        for (int i = 0; i < VK_MAX_MEMORY_TYPES; ++i)
+        {
+            for (int j = 0; j < 2; ++j)
+            {
+                for (auto block : m_blocks[i][j])
+                {
+                    if (!block->IsEmpty())
+                    {
+                        Log("memory block released with live allocations, type: %d", i);
+                    }
+
+                    this->FreeDeviceMemory(block->GetMemory(), block->GetMapped());
+                    delete block;
+                }
+                m_blocks[i][j].Clear();
+            }
+        }
+    }
+
+    VkDeviceSize MemoryAllocator::GetBlockSize(uint32_t memory_type_index) const
+    {
+        uint32_t heap_index = m_memory_properties.memoryTypes[memory_type_index].heapIndex;
+        VkDeviceSize heap_size = m_memory_properties.memoryHeaps[heap_index].size;
+
+        // small heaps, as host visible device local memory on some desktop gpus, get smaller blocks
+        VkDeviceSize block_size = heap_size / 8;
+        block_size = Mathf::Min<VkDeviceSize>(block_size, MEMORY_BLOCK_SIZE_MAX);
+        block_size = Mathf::Max<VkDeviceSize>(block_size, MEMORY_BLOCK_SIZE_MIN);
+
+        return block_size;
+    }
+
+    bool MemoryAllocator::AllocateDeviceMemory(VkDeviceSize size, uint32_t memory_type_index, VkDeviceMemory* memory, void** mapped)
+    {
+        VkMemoryAllocateInfo memory_info;
+        Memory::Zero(&memory_info, sizeof(memory_info));
+        memory_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memory_info.pNext = nullptr;
+        memory_info.allocationSize = size;
+        memory_info.memoryTypeIndex = memory_type_index;
+
+        VkResult err = vkAllocateMemory(m_device, &memory_info, nullptr, memory);
+        if (err != VK_SUCCESS)
+        {
+            Log("vkAllocateMemory failed: %d size: %d type: %d", err, (int) size, memory_type_index);
+            return false;
+        }
+
+        *mapped = nullptr;
+        if (m_memory_properties.memoryTypes[memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            err = vkMapMemory(m_device, *memory, 0, VK_WHOLE_SIZE, 0, mapped);
+            assert(!err);
+        }
+
+        return true;
+    }
+
+    void MemoryAllocator::FreeDeviceMemory(VkDeviceMemory memory, void* mapped)
+    {
+        if (mapped)
+        {
+            vkUnmapMemory(m_device, memory);
+        }
+        vkFreeMemory(m_device, memory, nullptr);
+    }
+
+    bool MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, uint32_t memory_type_index, bool linear, MemoryAllocation& allocation)
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+
+        VkDeviceSize block_size = this->GetBlockSize(memory_type_index);
+
+        allocation.size = requirements.size;
+        allocation.memory_type_index = memory_type_index;
+
+        // large resources get their own memory instead of wasting most of a block
+        if (requirements.size > block_size / 2)
+        {
+            void* mapped = nullptr;
+            if (!this->AllocateDeviceMemory(requirements.size, memory_type_index, &allocation.memory, &mapped))
+            {
+                return false;
+            }
+
+            allocation.offset = 0;
+            allocation.mapped = mapped;
+            allocation.block = nullptr;
+
+            m_dedicated_count[memory_type_index] += 1;
+            m_dedicated_bytes[memory_type_index] += requirements.size;
+
+            return true;
+        }
+
+        Vector<MemoryBlock*>& blocks = m_blocks[memory_type_index][linear ? 1 : 0];
+        VkDeviceSize alignment = Mathf::Max<VkDeviceSize>(requirements.alignment, 1);
+        VkDeviceSize offset = 0;
+
+        for (auto block : blocks)
+        {
+            if (block->Allocate(requirements.size, alignment, &offset))
+            {
+                allocation.memory = block->GetMemory();
+                allocation.offset = offset;
+                allocation.mapped = block->GetMapped() ? (byte*) block->GetMapped() + offset : nullptr;
+                allocation.block = block;
+
+                return true;
+            }
+        }
+
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        if (!this->AllocateDeviceMemory(block_size, memory_type_index, &memory, &mapped))
+        {
+            return false;
+        }
+
+        MemoryBlock* block = new MemoryBlock(memory, block_size, mapped, linear);
+        blocks.Add(block);
+
+        bool pass = block->Allocate(requirements.size, alignment, &offset);
+        assert(pass);
+
+        allocation.memory = memory;
+        allocation.offset = offset;
+        allocation.mapped = mapped ? (byte*) mapped + offset : nullptr;
+        allocation.block = block;
+
+        return true;
+    }
+
+    void MemoryAllocator::Free(MemoryAllocation& allocation)
+    {
+        if (allocation.memory == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        std::lock_guard<Mutex> lock(m_mutex);
+
+        uint32_t type_index = allocation.memory_type_index;
+        MemoryBlock* block = allocation.block;
+
+        if (block == nullptr)
+        {
+            this->FreeDeviceMemory(allocation.memory, allocation.mapped);
+
+            m_dedicated_count[type_index] -= 1;
+            m_dedicated_bytes[type_index] -= allocation.size;
+        }
+        else
+        {
+            block->Free(allocation.offset, allocation.size);
+
+            // keep one empty block per pool around, so a load / unload cycle does not hit the driver every time
+            if (block->IsEmpty())
+            {
+                Vector<MemoryBlock*>& blocks = m_blocks[type_index][block->IsLinear() ? 1 : 0];
+
+                int empty_count = 0;
+                for (auto i : blocks)
+                {
+                    if (i->IsEmpty())
+                    {
+                        empty_count += 1;
+                    }
+                }
+
+                if (empty_count > 1)
+                {
+                    blocks.Remove(block);
+                    this->FreeDeviceMemory(block->GetMemory(), block->GetMapped());
+                    delete block;
+                }
+            }
+        }
+
+        allocation = MemoryAllocation();
+    }
+
+    void MemoryAllocator::CollectStatistics(uint32_t memory_type_index, MemoryStatistics& stats) const
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            for (auto block : m_blocks[memory_type_index][i])
+            {
+                block->CollectStatistics(stats);
+            }
+        }
+
+        stats.dedicated_count += m_dedicated_count[memory_type_index];
+        stats.dedicated_bytes += m_dedicated_bytes[memory_type_index];
+        stats.allocation_count += m_dedicated_count[memory_type_index];
+        stats.used_bytes += m_dedicated_bytes[memory_type_index];
+    }
+
+    MemoryStatistics MemoryAllocator::GetStatistics() const
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+
+        MemoryStatistics stats;
+        for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; ++i)
+        {
+            this->CollectStatistics(i, stats);
+        }
+
+        return stats;
+    }
+
+    MemoryStatistics MemoryAllocator::GetStatistics(uint32_t memory_type_index) const
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+
+        MemoryStatistics stats;
+        this->CollectStatistics(memory_type_index, stats);
+
+        return stats;
+    }
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Display.h"
+
+#if VR_VULKAN
+
+#include "container/Vector.h"
+#include "thread/ThreadPool.h"
+
+namespace Viry3D
+{
+    class MemoryBlock;
+
+    struct MemoryAllocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        // persistently mapped address of offset, null if memory is not host visible
+        void* mapped = nullptr;
+        // null for dedicated allocations
+        MemoryBlock* block = nullptr;
+        uint32_t memory_type_index = 0;
+    };
+
+    struct MemoryStatistics
+    {
+        int block_count = 0;
+        int dedicated_count = 0;
+        int allocation_count = 0;
+        VkDeviceSize block_bytes = 0;
+        VkDeviceSize dedicated_bytes = 0;
+        VkDeviceSize used_bytes = 0;
+        VkDeviceSize free_bytes = 0;
+        VkDeviceSize largest_free_range = 0;
+        int free_range_count = 0;
+
+        // 0 when all free space in blocks is one range, approaching 1 as it is scattered into small holes
+        float GetFragmentation() const
+        {
+            if (free_bytes == 0)
+            {
+                return 0;
+            }
+            return 1.0f - largest_free_range / (float) free_bytes;
+        }
+    };
+
+    // sub allocates buffers and images from large device memory blocks per memory type,
+    // buffers and optimal tiling images are kept in separate blocks to satisfy bufferImageGranularity
+    class MemoryAllocator
+    {
+    public:
+        MemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memory_properties);
+        ~MemoryAllocator();
+        bool Allocate(const VkMemoryRequirements& requirements, uint32_t memory_type_index, bool linear, MemoryAllocation& allocation);
+        void Free(MemoryAllocation& allocation);
+        MemoryStatistics GetStatistics() const;
+        MemoryStatistics GetStatistics(uint32_t memory_type_index) const;
+
+    private:
+        VkDeviceSize GetBlockSize(uint32_t memory_type_index) const;
+        bool AllocateDeviceMemory(VkDeviceSize size, uint32_t memory_type_index, VkDeviceMemory* memory, void** mapped);
+        void FreeDeviceMemory(VkDeviceMemory memory, void* mapped);
+        void CollectStatistics(uint32_t memory_type_index, MemoryStatistics& stats) const;
+
+    private:
+        VkDevice m_device;
+        VkPhysicalDeviceMemoryProperties m_memory_properties;
+        // [memory type][linear]
+        Vector<MemoryBlock*> m_blocks[VK_MAX_MEMORY_TYPES][2];
+        int m_dedicated_count[VK_MAX_MEMORY_TYPES];
+        VkDeviceSize m_dedicated_bytes[VK_MAX_MEMORY_TYPES];
+        mutable Mutex m_mutex;
+    };
+}
+
+#endif
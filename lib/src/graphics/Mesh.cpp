@@ -20,122 +20,470 @@
 #include "BufferObject.h"
 #include "Debug.h"
 #include "io/File.h"
+#include "io/MappedFile.h"
 #include "io/MemoryStream.h"
+#include "memory/Memory.h"
+#include <climits>
+
+#define MESH_FILE_MAGIC "VMSH"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_ALIGNMENT 16
+
+#if VR_VULKAN
+// compute shaders read vertices as storage buffers, vertex copies are made on the gpu
+#define MESH_VERTEX_BUFFER_USAGE (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+#endif
 
 namespace Viry3D
 {
-    Ref<Mesh> Mesh::LoadFromFile(const String& path)
+    // binary mesh file layout, offsets are from the file start,
+    // every block is aligned to MESH_FILE_ALIGNMENT so it can be used in place from the mapped file
+    struct MeshFileHeader
     {
-        Ref<Mesh> mesh;
+        char magic[4];
+        int version;
+        int vertex_count;
+        int index_count;
+        int index_type;
+        int submesh_count;
+        int bindpose_count;
+        int attribute_count;
+        Vector3 bounds_min;
+        Vector3 bounds_max;
+        int name_offset;
+        int name_size;
+        int attribute_offset;
+        int submesh_offset;
+        int bindpose_offset;
+        int vertex_offset;
+        int vertex_size;
+        int index_offset;
+        int index_size;
+    };
+
+    // attributes in VertexLayout order, offsets follow from the order
+    struct MeshFileAttribute
+    {
+        int type;
+        int format;
+        int stream;
+    };
 
-        if (File::Exist(path))
+    static int AlignFileOffset(int offset)
+    {
+        return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+    }
+
+    static bool IsFileRangeValid(const Ref<MappedFile>& file, int offset, int size)
+    {
+        return offset >= 0 && size >= 0 && offset <= file->GetSize() - size;
+    }
+
+    // count * element_size must not overflow int
+    static bool IsCountValid(int count, int element_size)
+    {
+        return count >= 0 && element_size > 0 && count <= INT_MAX / element_size;
+    }
+
+    static Ref<Mesh::FileData> ReadBinaryFile(const Ref<MappedFile>& file, const String& path)
+    {
+        const byte* bytes = file->GetData();
+        const MeshFileHeader* header = (const MeshFileHeader*) bytes;
+
+        if (header->version != MESH_FILE_VERSION)
         {
-            MemoryStream ms(File::ReadAllBytes(path));
+            Log("mesh file version %d not support: %s", header->version, path.CString());
+            return Ref<Mesh::FileData>();
+        }
 
-            int name_size = ms.Read<int>();
-            String mesh_name = ms.ReadString(name_size);
+        if (header->index_type != (int) IndexType::Uint16 && header->index_type != (int) IndexType::Uint32)
+        {
+            Log("mesh file corrupted: %s", path.CString());
+            return Ref<Mesh::FileData>();
+        }
 
-            Vector<Vertex>* vertices = new Vector<Vertex>();
-            Vector<unsigned short>* indices = new Vector<unsigned short>();
-            Vector<Submesh>* submeshes = new Vector<Submesh>();
-            Vector<Matrix4x4>* bindposes = new Vector<Matrix4x4>();
+        int index_size = header->index_type == (int) IndexType::Uint16 ? 2 : 4;
+        if (!IsCountValid(header->attribute_count, (int) sizeof(MeshFileAttribute)) ||
+            !IsCountValid(header->submesh_count, (int) sizeof(Mesh::Submesh)) ||
+            !IsCountValid(header->bindpose_count, (int) sizeof(Matrix4x4)) ||
+            !IsCountValid(header->index_count, index_size) ||
+            !IsFileRangeValid(file, header->name_offset, header->name_size) ||
+            !IsFileRangeValid(file, header->attribute_offset, header->attribute_count * (int) sizeof(MeshFileAttribute)) ||
+            !IsFileRangeValid(file, header->submesh_offset, header->submesh_count * (int) sizeof(Mesh::Submesh)) ||
+            !IsFileRangeValid(file, header->bindpose_offset, header->bindpose_count * (int) sizeof(Matrix4x4)) ||
+            !IsFileRangeValid(file, header->vertex_offset, header->vertex_size) ||
+            !IsFileRangeValid(file, header->index_offset, header->index_size) ||
+            header->index_size != header->index_count * index_size)
+        {
+            Log("mesh file corrupted: %s", path.CString());
+            return Ref<Mesh::FileData>();
+        }
 
-            int vertex_count = ms.Read<int>();
-            vertices->Resize(vertex_count);
+        Ref<Mesh::FileData> data = RefMake<Mesh::FileData>();
+        data->SetName(String((const char*) &bytes[header->name_offset], header->name_size));
 
-            for (int i = 0; i < vertex_count; ++i)
+        const MeshFileAttribute* attributes = (const MeshFileAttribute*) &bytes[header->attribute_offset];
+        for (int i = 0; i < header->attribute_count; ++i)
+        {
+            if (attributes[i].type < 0 || attributes[i].type >= (int) VertexAttributeType::Count ||
+                attributes[i].format < 0 || attributes[i].format >= (int) VertexFormat::Count ||
+                attributes[i].stream < 0 || attributes[i].stream >= VERTEX_STREAM_MAX ||
+                data->layout.GetAttribute((VertexAttributeType) attributes[i].type) != nullptr)
             {
-                (*vertices)[i].vertex = ms.Read<Vector3>();
+                Log("mesh file corrupted: %s", path.CString());
+                return Ref<Mesh::FileData>();
             }
 
-            int color_count = ms.Read<int>();
-            for (int i = 0; i < color_count; ++i)
-            {
-                float r = ms.Read<byte>() / 255.0f;
-                float g = ms.Read<byte>() / 255.0f;
-                float b = ms.Read<byte>() / 255.0f;
-                float a = ms.Read<byte>() / 255.0f;
-                (*vertices)[i].color = Color(r, g, b, a);
-            }
+            data->layout.AddAttribute((VertexAttributeType) attributes[i].type, (VertexFormat) attributes[i].format, attributes[i].stream);
+        }
 
-            int uv_count = ms.Read<int>();
-            for (int i = 0; i < uv_count; ++i)
-            {
-                (*vertices)[i].uv = ms.Read<Vector2>();
-            }
+        if (!IsCountValid(header->vertex_count, data->layout.GetVertexSize()) ||
+            header->vertex_size != data->layout.GetVertexSize() * header->vertex_count)
+        {
+            Log("mesh file corrupted: %s", path.CString());
+            return Ref<Mesh::FileData>();
+        }
 
-            int uv2_count = ms.Read<int>();
-            for (int i = 0; i < uv2_count; ++i)
-            {
-                (*vertices)[i].uv2 = ms.Read<Vector2>();
-            }
+        if (!data->layout.IsSupported())
+        {
+            Log("mesh file vertex format not support, convert it without half float: %s", path.CString());
+            return Ref<Mesh::FileData>();
+        }
 
-            int normal_count = ms.Read<int>();
-            for (int i = 0; i < normal_count; ++i)
+        data->submeshes.Resize(header->submesh_count);
+        if (header->submesh_count > 0)
+        {
+            Memory::Copy(&data->submeshes[0], &bytes[header->submesh_offset], data->submeshes.SizeInBytes());
+        }
+
+        for (const auto& i : data->submeshes)
+        {
+            if (i.index_first < 0 || i.index_count < 0 || i.index_first > header->index_count - i.index_count)
             {
-                (*vertices)[i].normal = ms.Read<Vector3>();
+                Log("mesh file corrupted: %s", path.CString());
+                return Ref<Mesh::FileData>();
             }
+        }
+
+        data->bindposes.Resize(header->bindpose_count);
+        if (header->bindpose_count > 0)
+        {
+            Memory::Copy(&data->bindposes[0], &bytes[header->bindpose_offset], data->bindposes.SizeInBytes());
+        }
+
+        data->file = file;
+        data->vertex_data = &bytes[header->vertex_offset];
+        data->vertex_count = header->vertex_count;
+        data->index_data = &bytes[header->index_offset];
+        data->index_count = header->index_count;
+        data->index_type = (IndexType) header->index_type;
+        data->bounds = Bounds(header->bounds_min, header->bounds_max);
+
+        return data;
+    }
+
+    static Ref<Mesh::FileData> ReadMeshFile(const Ref<MappedFile>& file)
+    {
+        Ref<Mesh::FileData> data = RefMake<Mesh::FileData>();
+
+        MemoryStream ms(ByteBuffer((byte*) file->GetData(), file->GetSize()));
+
+        int name_size = ms.Read<int>();
+        data->SetName(ms.ReadString(name_size));
+
+        Vector<Vertex>* vertices = &data->vertices;
+        Vector<unsigned short>* indices = &data->indices;
+        Vector<Mesh::Submesh>* submeshes = &data->submeshes;
+        Vector<Matrix4x4>* bindposes = &data->bindposes;
+
+        // only attributes present in the file are stored in the vertex buffer
+        int attribute_mask = VertexLayout::GetAttributeMask(VertexAttributeType::Vertex);
+
+        int vertex_count = ms.Read<int>();
+        vertices->Resize(vertex_count);
+
+        for (int i = 0; i < vertex_count; ++i)
+        {
+            (*vertices)[i].vertex = ms.Read<Vector3>();
+        }
 
-            int tangent_count = ms.Read<int>();
-            for (int i = 0; i < tangent_count; ++i)
+        int color_count = ms.Read<int>();
+        if (color_count > 0)
+        {
+            attribute_mask |= VertexLayout::GetAttributeMask(VertexAttributeType::Color);
+        }
+        for (int i = 0; i < color_count; ++i)
+        {
+            float r = ms.Read<byte>() / 255.0f;
+            float g = ms.Read<byte>() / 255.0f;
+            float b = ms.Read<byte>() / 255.0f;
+            float a = ms.Read<byte>() / 255.0f;
+            (*vertices)[i].color = Color(r, g, b, a);
+        }
+
+        int uv_count = ms.Read<int>();
+        if (uv_count > 0)
+        {
+            attribute_mask |= VertexLayout::GetAttributeMask(VertexAttributeType::Texcoord);
+        }
+        for (int i = 0; i < uv_count; ++i)
+        {
+            (*vertices)[i].uv = ms.Read<Vector2>();
+        }
+
+        int uv2_count = ms.Read<int>();
+        if (uv2_count > 0)
+        {
+            attribute_mask |= VertexLayout::GetAttributeMask(VertexAttributeType::Texcoord2);
+        }
+        for (int i = 0; i < uv2_count; ++i)
+        {
+            (*vertices)[i].uv2 = ms.Read<Vector2>();
+        }
+
+        int normal_count = ms.Read<int>();
+        if (normal_count > 0)
+        {
+            attribute_mask |= VertexLayout::GetAttributeMask(VertexAttributeType::Normal);
+        }
+        for (int i = 0; i < normal_count; ++i)
+        {
+            (*vertices)[i].normal = ms.Read<Vector3>();
+        }
+
+        int tangent_count = ms.Read<int>();
+        if (tangent_count > 0)
+        {
+            attribute_mask |= VertexLayout::GetAttributeMask(VertexAttributeType::Tangent);
+        }
+        for (int i = 0; i < tangent_count; ++i)
+        {
+            (*vertices)[i].tangent = ms.Read<Vector4>();
+        }
+
+        int bone_weight_count = ms.Read<int>();
+        if (bone_weight_count > 0)
+        {
+            attribute_mask |= VertexLayout::GetAttributeMask(VertexAttributeType::BlendWeight);
+            attribute_mask |= VertexLayout::GetAttributeMask(VertexAttributeType::BlendIndices);
+        }
+        for (int i = 0; i < bone_weight_count; ++i)
+        {
+            (*vertices)[i].bone_weight = ms.Read<Vector4>();
+            float index0 = (float) ms.Read<byte>();
+            float index1 = (float) ms.Read<byte>();
+            float index2 = (float) ms.Read<byte>();
+            float index3 = (float) ms.Read<byte>();
+            (*vertices)[i].bone_indices = Vector4(index0, index1, index2, index3);
+        }
+
+        int index_count = ms.Read<int>();
+        indices->Resize(index_count);
+        ms.Read(&(*indices)[0], indices->SizeInBytes());
+
+        int submesh_count = ms.Read<int>();
+        submeshes->Resize(submesh_count);
+        ms.Read(&(*submeshes)[0], submeshes->SizeInBytes());
+
+        int bindpose_count = ms.Read<int>();
+        if (bindpose_count > 0)
+        {
+            bindposes->Resize(bindpose_count);
+            ms.Read(&(*bindposes)[0], bindposes->SizeInBytes());
+        }
+
+        data->attribute_mask = attribute_mask;
+
+        return data;
+    }
+
+    Ref<Mesh> Mesh::LoadFromFile(const String& path)
+    {
+        Ref<Mesh> mesh;
+
+        Ref<FileData> data = Mesh::ReadFile(path);
+        if (data)
+        {
+            mesh = Mesh::CreateFromFileData(data);
+        }
+
+        return mesh;
+    }
+
+    Ref<Mesh::FileData> Mesh::ReadFile(const String& path)
+    {
+        Ref<FileData> data;
+
+        Ref<MappedFile> file = MappedFile::Open(path);
+        if (file)
+        {
+            if (file->GetSize() >= (int) sizeof(MeshFileHeader) && Memory::Compare(file->GetData(), MESH_FILE_MAGIC, 4) == 0)
             {
-                (*vertices)[i].tangent = ms.Read<Vector4>();
+                data = ReadBinaryFile(file, path);
             }
-
-            int bone_weight_count = ms.Read<int>();
-            for (int i = 0; i < bone_weight_count; ++i)
+            else
             {
-                (*vertices)[i].bone_weight = ms.Read<Vector4>();
-                float index0 = (float) ms.Read<byte>();
-                float index1 = (float) ms.Read<byte>();
-                float index2 = (float) ms.Read<byte>();
-                float index3 = (float) ms.Read<byte>();
-                (*vertices)[i].bone_indices = Vector4(index0, index1, index2, index3);
+                data = ReadMeshFile(file);
             }
+        }
+        else
+        {
+            Log("mesh file not exist: %s", path.CString());
+        }
 
-            int index_count = ms.Read<int>();
-            indices->Resize(index_count);
-            ms.Read(&(*indices)[0], indices->SizeInBytes());
+        return data;
+    }
 
-            int submesh_count = ms.Read<int>();
-            submeshes->Resize(submesh_count);
-            ms.Read(&(*submeshes)[0], submeshes->SizeInBytes());
+    Ref<Mesh> Mesh::CreateFromFileData(const Ref<FileData>& data)
+    {
+        Ref<Mesh> mesh;
 
-            int bindpose_count = ms.Read<int>();
-            if (bindpose_count > 0)
+        if (data->file)
+        {
+            mesh = RefMake<Mesh>(data->layout, data->vertex_data, data->vertex_count, data->index_data, data->index_count, data->index_type, data->submeshes, data->bounds);
+        }
+        else
+        {
+            mesh = RefMake<Mesh>(data->vertices, data->indices, data->submeshes, false, VertexLayout::Compact(data->attribute_mask));
+        }
+        mesh->SetName(data->GetName());
+        mesh->SetBindposes(data->bindposes);
+
+        return mesh;
+    }
+
+    bool Mesh::WriteBinaryFile(const String& path, const Ref<FileData>& data, bool half_float)
+    {
+        if (data->file)
+        {
+            Log("mesh data is already binary");
+            return false;
+        }
+
+        VertexLayout layout = VertexLayout::Compact(data->attribute_mask, half_float);
+        Vector<byte> vertex_data;
+        layout.Pack(data->vertices, data->vertices.Size(), vertex_data);
+
+        Vector3 bounds_min;
+        Vector3 bounds_max;
+        if (data->vertices.Size() > 0)
+        {
+            bounds_min = data->vertices[0].vertex;
+            bounds_max = data->vertices[0].vertex;
+
+            for (int i = 1; i < data->vertices.Size(); ++i)
             {
-                bindposes->Resize(bindpose_count);
-                ms.Read(&(*bindposes)[0], bindposes->SizeInBytes());
+                bounds_min = Vector3::Min(bounds_min, data->vertices[i].vertex);
+                bounds_max = Vector3::Max(bounds_max, data->vertices[i].vertex);
             }
-            
-            mesh = RefMake<Mesh>(*vertices, *indices, *submeshes);
-            mesh->SetName(mesh_name);
-            mesh->SetBindposes(*bindposes);
+        }
+
+        const Vector<VertexLayoutAttribute>& attributes = layout.GetAttributes();
+
+        MeshFileHeader header;
+        Memory::Zero(&header, sizeof(header));
+        Memory::Copy(header.magic, MESH_FILE_MAGIC, 4);
+        header.version = MESH_FILE_VERSION;
+        header.vertex_count = data->vertices.Size();
+        header.index_count = data->indices.Size();
+        header.index_type = (int) IndexType::Uint16;
+        header.submesh_count = data->submeshes.Size();
+        header.bindpose_count = data->bindposes.Size();
+        header.attribute_count = attributes.Size();
+        header.bounds_min = bounds_min;
+        header.bounds_max = bounds_max;
+        header.name_offset = AlignFileOffset(sizeof(MeshFileHeader));
+        header.name_size = data->GetName().Size();
+        header.attribute_offset = AlignFileOffset(header.name_offset + header.name_size);
+        header.submesh_offset = AlignFileOffset(header.attribute_offset + attributes.Size() * sizeof(MeshFileAttribute));
+        header.bindpose_offset = AlignFileOffset(header.submesh_offset + data->submeshes.SizeInBytes());
+        header.vertex_offset = AlignFileOffset(header.bindpose_offset + data->bindposes.SizeInBytes());
+        header.vertex_size = vertex_data.SizeInBytes();
+        header.index_offset = AlignFileOffset(header.vertex_offset + header.vertex_size);
+        header.index_size = data->indices.SizeInBytes();
 
-            delete vertices;
-            delete indices;
-            delete submeshes;
-            delete bindposes;
+        ByteBuffer buffer(header.index_offset + header.index_size);
+        Memory::Zero(buffer.Bytes(), buffer.Size());
+
+        Memory::Copy(&buffer[0], &header, sizeof(header));
+        Memory::Copy(&buffer[header.name_offset], data->GetName().CString(), header.name_size);
+        for (int i = 0; i < attributes.Size(); ++i)
+        {
+            MeshFileAttribute attribute;
+            attribute.type = (int) attributes[i].type;
+            attribute.format = (int) attributes[i].format;
+            attribute.stream = attributes[i].stream;
+            Memory::Copy(&buffer[header.attribute_offset + i * sizeof(MeshFileAttribute)], &attribute, sizeof(attribute));
         }
-        else
+        Memory::Copy(&buffer[header.submesh_offset], data->submeshes.Bytes(), data->submeshes.SizeInBytes());
+        Memory::Copy(&buffer[header.bindpose_offset], data->bindposes.Bytes(), data->bindposes.SizeInBytes());
+        Memory::Copy(&buffer[header.vertex_offset], vertex_data.Bytes(), header.vertex_size);
+        Memory::Copy(&buffer[header.index_offset], data->indices.Bytes(), header.index_size);
+
+        return File::WriteAllBytes(path, buffer);
+    }
+
+    Mesh::Mesh(const VertexLayout& layout, const void* vertex_data, int vertex_count, const void* index_data, int index_count, IndexType index_type, const Vector<Submesh>& submeshes, const Bounds& bounds):
+        m_vertex_layout(layout),
+        m_index_type(index_type),
+        m_vertex_count(vertex_count),
+        m_index_count(index_count),
+        m_buffer_vertex_count(vertex_count),
+        m_buffer_index_count(index_count),
+        m_submeshes(submeshes),
+        m_bounds(bounds)
+    {
+        int vertex_size = layout.GetVertexSize() * vertex_count;
+        int index_size = index_count * (index_type == IndexType::Uint16 ? sizeof(unsigned short) : sizeof(unsigned int));
+
+#if VR_VULKAN
+        m_vertex_buffer = Display::Instance()->CreateBuffer(vertex_data, vertex_size, MESH_VERTEX_BUFFER_USAGE, true, VK_FORMAT_UNDEFINED);
+        m_index_buffer = Display::Instance()->CreateBuffer(index_data, index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, true, VK_FORMAT_UNDEFINED);
+#elif VR_GLES
+        m_vertex_buffer = Display::Instance()->CreateBuffer(vertex_data, vertex_size, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
+        m_index_buffer = Display::Instance()->CreateBuffer(index_data, index_size, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+#endif
+
+        if (m_submeshes.Empty())
         {
-            Log("mesh file not exist: %s", path.CString());
+            m_submeshes.Add(Submesh({ 0, index_count }));
         }
+    }
 
-        return mesh;
+#if VR_VULKAN
+    Mesh::Mesh(const Ref<Mesh>& mesh):
+        m_vertex_layout(mesh->m_vertex_layout),
+        m_index_buffer(mesh->m_index_buffer),
+        m_index_type(mesh->m_index_type),
+        m_vertex_count(mesh->m_vertex_count),
+        m_index_count(mesh->m_index_count),
+        m_buffer_vertex_count(mesh->m_buffer_vertex_count),
+        m_buffer_index_count(mesh->m_buffer_index_count),
+        m_submeshes(mesh->m_submeshes),
+        m_bindposes(mesh->m_bindposes),
+        m_bounds(mesh->m_bounds),
+        // skinning moves the vertices away from the bind pose bounds every frame
+        m_has_bounds(false),
+        m_index_buffer_owner(mesh)
+    {
+        int size = mesh->m_vertex_buffer->GetSize();
+        m_vertex_buffer = Display::Instance()->CreateBuffer(nullptr, size, MESH_VERTEX_BUFFER_USAGE, true, VK_FORMAT_UNDEFINED);
+        Display::Instance()->CopyBuffer(mesh->m_vertex_buffer, 0, m_vertex_buffer, 0, size);
     }
+#endif
 
-    Mesh::Mesh(const Vector<Vertex>& vertices, const Vector<unsigned short>& indices, const Vector<Submesh>& submeshes, bool dynamic):
+    Mesh::Mesh(const Vector<Vertex>& vertices, const Vector<unsigned short>& indices, const Vector<Submesh>& submeshes, bool dynamic, const VertexLayout& layout):
+        m_vertex_layout(layout),
         m_vertex_count(0),
         m_index_count(0),
         m_buffer_vertex_count(0),
         m_buffer_index_count(0)
     {
+        this->CreateVertexBuffer(vertices, dynamic);
+
 #if VR_VULKAN
-        m_vertex_buffer = Display::Instance()->CreateBuffer(&vertices[0], vertices.SizeInBytes(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, !dynamic, VK_FORMAT_UNDEFINED);
-        m_index_buffer = Display::Instance()->CreateBuffer(&indices[0], indices.SizeInBytes(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, !dynamic, VK_FORMAT_UNDEFINED);
+        m_index_buffer = Display::Instance()->CreateBuffer(&indices[0], indices.SizeInBytes(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, !dynamic, VK_FORMAT_UNDEFINED);
 #elif VR_GLES
-        m_vertex_buffer = Display::Instance()->CreateBuffer(&vertices[0], vertices.SizeInBytes(), GL_ARRAY_BUFFER, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
         m_index_buffer = Display::Instance()->CreateBuffer(&indices[0], indices.SizeInBytes(), GL_ELEMENT_ARRAY_BUFFER, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
 #endif
 
@@ -149,19 +497,22 @@ namespace Viry3D
         {
             m_submeshes.Add(Submesh({ 0, indices.Size() }));
         }
+
+        this->UpdateBounds(vertices);
     }
 
-    Mesh::Mesh(const Vector<Vertex>& vertices, const Vector<unsigned int>& indices, const Vector<Submesh>& submeshes, bool dynamic):
+    Mesh::Mesh(const Vector<Vertex>& vertices, const Vector<unsigned int>& indices, const Vector<Submesh>& submeshes, bool dynamic, const VertexLayout& layout):
+        m_vertex_layout(layout),
         m_vertex_count(0),
         m_index_count(0),
         m_buffer_vertex_count(0),
         m_buffer_index_count(0)
     {
+        this->CreateVertexBuffer(vertices, dynamic);
+
 #if VR_VULKAN
-        m_vertex_buffer = Display::Instance()->CreateBuffer(&vertices[0], vertices.SizeInBytes(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, !dynamic, VK_FORMAT_UNDEFINED);
-        m_index_buffer = Display::Instance()->CreateBuffer(&indices[0], indices.SizeInBytes(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, !dynamic, VK_FORMAT_UNDEFINED);
+        m_index_buffer = Display::Instance()->CreateBuffer(&indices[0], indices.SizeInBytes(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, !dynamic, VK_FORMAT_UNDEFINED);
 #elif VR_GLES
-        m_vertex_buffer = Display::Instance()->CreateBuffer(&vertices[0], vertices.SizeInBytes(), GL_ARRAY_BUFFER, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
         m_index_buffer = Display::Instance()->CreateBuffer(&indices[0], indices.SizeInBytes(), GL_ELEMENT_ARRAY_BUFFER, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
 #endif
 
@@ -175,6 +526,8 @@ namespace Viry3D
         {
             m_submeshes.Add(Submesh({ 0, indices.Size() }));
         }
+
+        this->UpdateBounds(vertices);
     }
     
     Mesh::~Mesh()
@@ -182,7 +535,10 @@ namespace Viry3D
 #if VR_VULKAN
         VkDevice device = Display::Instance()->GetDevice();
         m_vertex_buffer->Destroy(device);
-        m_index_buffer->Destroy(device);
+        if (!m_index_buffer_owner)
+        {
+            m_index_buffer->Destroy(device);
+        }
 #endif
         
         m_vertex_buffer.reset();
@@ -195,8 +551,13 @@ namespace Viry3D
         assert(indices.Size() <= m_buffer_index_count);
         assert(m_index_type == IndexType::Uint16);
 
-        Display::Instance()->UpdateBuffer(m_vertex_buffer, 0, &vertices[0], vertices.SizeInBytes());
+        this->UpdateVertexBuffer(vertices);
+
+#if VR_VULKAN
+        Display::Instance()->QueueUpdateBuffer(m_index_buffer, 0, &indices[0], indices.SizeInBytes());
+#elif VR_GLES
         Display::Instance()->UpdateBuffer(m_index_buffer, 0, &indices[0], indices.SizeInBytes());
+#endif
 
         m_vertex_count = vertices.Size();
         m_index_count = indices.Size();
@@ -205,6 +566,8 @@ namespace Viry3D
         {
             m_submeshes.Add(Submesh({ 0, indices.Size() }));
         }
+
+        this->UpdateBounds(vertices);
     }
 
     void Mesh::Update(const Vector<Vertex>& vertices, const Vector<unsigned int>& indices, const Vector<Submesh>& submeshes)
@@ -213,8 +576,13 @@ namespace Viry3D
         assert(indices.Size() <= m_buffer_index_count);
         assert(m_index_type == IndexType::Uint32);
 
-        Display::Instance()->UpdateBuffer(m_vertex_buffer, 0, &vertices[0], vertices.SizeInBytes());
+        this->UpdateVertexBuffer(vertices);
+
+#if VR_VULKAN
+        Display::Instance()->QueueUpdateBuffer(m_index_buffer, 0, &indices[0], indices.SizeInBytes());
+#elif VR_GLES
         Display::Instance()->UpdateBuffer(m_index_buffer, 0, &indices[0], indices.SizeInBytes());
+#endif
 
         m_vertex_count = vertices.Size();
         m_index_count = indices.Size();
@@ -223,5 +591,118 @@ namespace Viry3D
         {
             m_submeshes.Add(Submesh({ 0, indices.Size() }));
         }
+
+        this->UpdateBounds(vertices);
+    }
+
+    void Mesh::UpdateRange(int vertex_start, const Vector<Vertex>& vertices, int index_start, const Vector<unsigned short>& indices)
+    {
+        assert(vertex_start + vertices.Size() <= m_vertex_count);
+        assert(index_start + indices.Size() <= m_index_count);
+        assert(m_index_type == IndexType::Uint16);
+
+        if (vertices.Size() > 0)
+        {
+            const void* data = &vertices[0];
+            Vector<byte> packed;
+
+            if (m_vertex_layout != VertexLayout::Default())
+            {
+                m_vertex_layout.Pack(vertices, vertices.Size(), packed);
+                data = &packed[0];
+            }
+
+            for (int i = 0; i < m_vertex_layout.GetStreamCount(); ++i)
+            {
+                int stride = m_vertex_layout.GetStride(i);
+                int src_offset = m_vertex_layout.GetStreamOffset(i, vertices.Size());
+                int offset = m_vertex_layout.GetStreamOffset(i, m_buffer_vertex_count) + stride * vertex_start;
+                int size = stride * vertices.Size();
+
+#if VR_VULKAN
+                Display::Instance()->QueueUpdateBuffer(m_vertex_buffer, offset, (const byte*) data + src_offset, size);
+#elif VR_GLES
+                Display::Instance()->UpdateBuffer(m_vertex_buffer, offset, (const byte*) data + src_offset, size);
+#endif
+            }
+
+            // only grows, the rest of the vertices are not known here
+            Vector3 min = m_bounds.Min();
+            Vector3 max = m_bounds.Max();
+            for (int i = 0; i < vertices.Size(); ++i)
+            {
+                min = Vector3::Min(min, vertices[i].vertex);
+                max = Vector3::Max(max, vertices[i].vertex);
+            }
+            m_bounds = Bounds(min, max);
+        }
+
+        if (indices.Size() > 0)
+        {
+            int offset = index_start * sizeof(unsigned short);
+
+#if VR_VULKAN
+            Display::Instance()->QueueUpdateBuffer(m_index_buffer, offset, &indices[0], indices.SizeInBytes());
+#elif VR_GLES
+            Display::Instance()->UpdateBuffer(m_index_buffer, offset, &indices[0], indices.SizeInBytes());
+#endif
+        }
+    }
+
+    void Mesh::CreateVertexBuffer(const Vector<Vertex>& vertices, bool dynamic)
+    {
+        Vector<byte> data;
+        m_vertex_layout.Pack(vertices, vertices.Size(), data);
+
+#if VR_VULKAN
+        m_vertex_buffer = Display::Instance()->CreateBuffer(&data[0], data.SizeInBytes(), MESH_VERTEX_BUFFER_USAGE, !dynamic, VK_FORMAT_UNDEFINED);
+#elif VR_GLES
+        m_vertex_buffer = Display::Instance()->CreateBuffer(&data[0], data.SizeInBytes(), GL_ARRAY_BUFFER, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+#endif
+    }
+
+    void Mesh::UpdateVertexBuffer(const Vector<Vertex>& vertices)
+    {
+        const void* data = &vertices[0];
+        Vector<byte> packed;
+
+        if (m_vertex_layout != VertexLayout::Default())
+        {
+            m_vertex_layout.Pack(vertices, m_buffer_vertex_count, packed);
+            data = &packed[0];
+        }
+
+        // streams are laid out for the buffer capacity, only the used part of each is uploaded
+        for (int i = 0; i < m_vertex_layout.GetStreamCount(); ++i)
+        {
+            int offset = m_vertex_layout.GetStreamOffset(i, m_buffer_vertex_count);
+            int size = m_vertex_layout.GetStride(i) * vertices.Size();
+
+#if VR_VULKAN
+            Display::Instance()->QueueUpdateBuffer(m_vertex_buffer, offset, (const byte*) data + offset, size);
+#elif VR_GLES
+            Display::Instance()->UpdateBuffer(m_vertex_buffer, offset, (const byte*) data + offset, size);
+#endif
+        }
+    }
+
+    void Mesh::UpdateBounds(const Vector<Vertex>& vertices)
+    {
+        if (vertices.Size() == 0)
+        {
+            m_bounds = Bounds();
+            return;
+        }
+
+        Vector3 min = vertices[0].vertex;
+        Vector3 max = vertices[0].vertex;
+
+        for (int i = 1; i < vertices.Size(); ++i)
+        {
+            min = Vector3::Min(min, vertices[i].vertex);
+            max = Vector3::Max(max, vertices[i].vertex);
+        }
+
+        m_bounds = Bounds(min, max);
     }
 }
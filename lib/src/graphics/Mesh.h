@@ -22,10 +22,12 @@
 #include "VertexAttribute.h"
 #include "container/Vector.h"
 #include "math/Matrix4x4.h"
+#include "math/Bounds.h"
 
 namespace Viry3D
 {
     class BufferObject;
+    class MappedFile;
 
     class Mesh : public Object
     {
@@ -36,15 +38,53 @@ namespace Viry3D
             int index_count;
         };
 
+        // mesh file content, read without touching the gpu so any thread can load it
+        class FileData : public Object
+        {
+        public:
+            // .mesh files exported from unity
+            Vector<Vertex> vertices;
+            Vector<unsigned short> indices;
+            int attribute_mask = 0;
+
+            // binary mesh files, vertex and index data point into the mapped file
+            Ref<MappedFile> file;
+            VertexLayout layout;
+            const void* vertex_data = nullptr;
+            int vertex_count = 0;
+            const void* index_data = nullptr;
+            int index_count = 0;
+            IndexType index_type = IndexType::Uint16;
+            Bounds bounds;
+
+            Vector<Submesh> submeshes;
+            Vector<Matrix4x4> bindposes;
+        };
+
     public:
+        // loads both .mesh files and binary mesh files, told apart by the file header
         static Ref<Mesh> LoadFromFile(const String& path);
-        Mesh(const Vector<Vertex>& vertices, const Vector<unsigned short>& indices, const Vector<Submesh>& submeshes = Vector<Submesh>(), bool dynamic = false);
-        Mesh(const Vector<Vertex>& vertices, const Vector<unsigned int>& indices, const Vector<Submesh>& submeshes = Vector<Submesh>(), bool dynamic = false);
+        static Ref<FileData> ReadFile(const String& path);
+        static Ref<Mesh> CreateFromFileData(const Ref<FileData>& data);
+        // converts a .mesh file content to the binary mesh format, vertices packed with the compact layout
+        static bool WriteBinaryFile(const String& path, const Ref<FileData>& data, bool half_float);
+        // vertex data packed with layout, uploaded as is
+        Mesh(const VertexLayout& layout, const void* vertex_data, int vertex_count, const void* index_data, int index_count, IndexType index_type, const Vector<Submesh>& submeshes, const Bounds& bounds);
+        Mesh(const Vector<Vertex>& vertices, const Vector<unsigned short>& indices, const Vector<Submesh>& submeshes = Vector<Submesh>(), bool dynamic = false, const VertexLayout& layout = VertexLayout::Default());
+        Mesh(const Vector<Vertex>& vertices, const Vector<unsigned int>& indices, const Vector<Submesh>& submeshes = Vector<Submesh>(), bool dynamic = false, const VertexLayout& layout = VertexLayout::Default());
+#if VR_VULKAN
+        // own copy of the vertices of mesh for compute shaders to write, the index buffer is shared and must not be updated
+        explicit Mesh(const Ref<Mesh>& mesh);
+#endif
         virtual ~Mesh();
         void Update(const Vector<Vertex>& vertices, const Vector<unsigned short>& indices, const Vector<Submesh>& submeshes = Vector<Submesh>());
         void Update(const Vector<Vertex>& vertices, const Vector<unsigned int>& indices, const Vector<Submesh>& submeshes = Vector<Submesh>());
+        // rewrites part of the buffers in place, vertex and index counts and submeshes are kept
+        void UpdateRange(int vertex_start, const Vector<Vertex>& vertices, int index_start, const Vector<unsigned short>& indices);
         const Ref<BufferObject>& GetVertexBuffer() const { return m_vertex_buffer; }
         const Ref<BufferObject>& GetIndexBuffer() const { return m_index_buffer; }
+        const VertexLayout& GetVertexLayout() const { return m_vertex_layout; }
+        int GetVertexStreamOffset(int stream) const { return m_vertex_layout.GetStreamOffset(stream, m_buffer_vertex_count); }
         int GetVertexCount() const { return m_vertex_count; }
         int GetIndexCount() const { return m_index_count; }
         int GetSubmeshCount() const { return m_submeshes.Size(); }
@@ -52,8 +92,17 @@ namespace Viry3D
         void SetBindposes(const Vector<Matrix4x4>& bindposes) { m_bindposes = bindposes; }
         const Vector<Matrix4x4>& GetBindposes() const { return m_bindposes; }
         IndexType GetIndexType() const { return m_index_type; }
+        const Bounds& GetBounds() const { return m_bounds; }
+        // false for vertices moved on the gpu, as skinned copies, whose bounds are not known
+        bool HasBounds() const { return m_has_bounds; }
+
+    private:
+        void CreateVertexBuffer(const Vector<Vertex>& vertices, bool dynamic);
+        void UpdateVertexBuffer(const Vector<Vertex>& vertices);
+        void UpdateBounds(const Vector<Vertex>& vertices);
 
     private:
+        VertexLayout m_vertex_layout;
         Ref<BufferObject> m_vertex_buffer;
         Ref<BufferObject> m_index_buffer;
         IndexType m_index_type;
@@ -63,5 +112,10 @@ namespace Viry3D
         int m_buffer_index_count;
         Vector<Submesh> m_submeshes;
         Vector<Matrix4x4> m_bindposes;
+        Bounds m_bounds;
+        bool m_has_bounds = true;
+#if VR_VULKAN
+        Ref<Mesh> m_index_buffer_owner;
+#endif
     };
 }
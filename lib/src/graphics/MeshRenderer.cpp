@@ -49,6 +49,26 @@ namespace Viry3D
         return buffer;
     }
 
+    const VertexLayout& MeshRenderer::GetVertexLayout() const
+    {
+        if (m_mesh)
+        {
+            return m_mesh->GetVertexLayout();
+        }
+
+        return VertexLayout::Default();
+    }
+
+    int MeshRenderer::GetVertexStreamOffset(int stream) const
+    {
+        if (m_mesh)
+        {
+            return m_mesh->GetVertexStreamOffset(stream);
+        }
+
+        return 0;
+    }
+
     Ref<BufferObject> MeshRenderer::GetIndexBuffer() const
     {
         Ref<BufferObject> buffer;
@@ -77,6 +97,18 @@ namespace Viry3D
         m_draw_buffer_dirty = true;
     }
 
+    bool MeshRenderer::GetLocalBounds(Bounds& bounds) const
+    {
+        // instances are placed freely around the renderer, so only single draws are culled
+        if (m_mesh && m_mesh->HasBounds() && this->GetInstanceCount() == 1)
+        {
+            bounds = m_mesh->GetBounds();
+            return true;
+        }
+
+        return false;
+    }
+
     void MeshRenderer::UpdateDrawBuffer()
     {
 #if VR_VULKAN
@@ -128,7 +160,7 @@ namespace Viry3D
         }
         else
         {
-            Display::Instance()->UpdateBuffer(m_draw_buffer, 0, draws.Bytes(), draws.SizeInBytes());
+            Display::Instance()->QueueUpdateBuffer(m_draw_buffer, 0, draws.Bytes(), draws.SizeInBytes());
         }
 #elif VR_GLES
         const auto& materials = this->GetMaterials();
@@ -29,10 +29,13 @@ namespace Viry3D
         MeshRenderer();
         virtual ~MeshRenderer();
         virtual Ref<BufferObject> GetVertexBuffer() const;
+        virtual const VertexLayout& GetVertexLayout() const;
+        virtual int GetVertexStreamOffset(int stream) const;
         virtual Ref<BufferObject> GetIndexBuffer() const;
         virtual IndexType GetIndexType() const;
         const Ref<Mesh>& GetMesh() const { return m_mesh; }
         void SetMesh(const Ref<Mesh>& mesh);
+        virtual bool GetLocalBounds(Bounds& bounds) const;
 
     protected:
         virtual void UpdateDrawBuffer();
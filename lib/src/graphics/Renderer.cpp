@@ -298,12 +298,19 @@ namespace Viry3D
         Ref<BufferObject> vertex_buffer = this->GetVertexBuffer();
         Ref<BufferObject> index_buffer = this->GetIndexBuffer();
         const auto& draw_buffers = this->GetDrawBuffers();
+        const VertexLayout& vertex_layout = this->GetVertexLayout();
 
         if (materials.Size() == 0 || !vertex_buffer || !index_buffer || draw_buffers.Size() == 0)
         {
             return;
         }
 
+        Vector<int> vertex_stream_offsets(vertex_layout.GetStreamCount());
+        for (int i = 0; i < vertex_stream_offsets.Size(); ++i)
+        {
+            vertex_stream_offsets[i] = this->GetVertexStreamOffset(i);
+        }
+
         vertex_buffer->Bind();
         index_buffer->Bind();
 
@@ -321,7 +328,7 @@ namespace Viry3D
                 continue;
             }
 
-            shader->EnableVertexAttribs();
+            shader->EnableVertexAttribs(vertex_layout, vertex_stream_offsets);
             shader->ApplyRenderState();
             material->ApplyUniforms();
 
@@ -433,6 +440,18 @@ namespace Viry3D
         return sizeof(Vector4) * (4 + m_instance_extra_vector_count);
     }
 
+    bool Renderer::GetBounds(Bounds& bounds)
+    {
+        Bounds local_bounds;
+        if (this->GetLocalBounds(local_bounds))
+        {
+            bounds = local_bounds.Transform(this->GetLocalToWorldMatrix());
+            return true;
+        }
+
+        return false;
+    }
+
     void Renderer::UpdateInstanceBuffer()
     {
         int instance_count = this->GetInstanceCount();
@@ -466,7 +485,7 @@ namespace Viry3D
             }
             else
             {
-                Display::Instance()->UpdateBuffer(m_instance_buffer, 0, vectors.Bytes(), buffer_size);
+                Display::Instance()->QueueUpdateBuffer(m_instance_buffer, 0, vectors.Bytes(), buffer_size);
             }
 #endif
         }
@@ -22,6 +22,7 @@
 #include "memory/Ref.h"
 #include "container/List.h"
 #include "math/Matrix4x4.h"
+#include "math/Bounds.h"
 #include "string/String.h"
 
 namespace Viry3D
@@ -52,6 +53,8 @@ namespace Viry3D
         Renderer();
         virtual ~Renderer();
         virtual Ref<BufferObject> GetVertexBuffer() const { return Ref<BufferObject>(); }
+        virtual const VertexLayout& GetVertexLayout() const { return VertexLayout::Default(); }
+        virtual int GetVertexStreamOffset(int) const { return 0; }
         virtual Ref<BufferObject> GetIndexBuffer() const { return Ref<BufferObject>(); }
         virtual IndexType GetIndexType() const { return IndexType::Uint16; }
 #if VR_VULKAN
@@ -71,8 +74,8 @@ namespace Viry3D
         int GetLightmapIndex() const { return m_lightmap_index; }
         void SetLightmapIndex(int index);
         void SetLightmapScaleOffset(const Vector4& vec);
-        void OnAddToCamera(Camera* camera);
-        void OnRemoveFromCamera(Camera* camera);
+        virtual void OnAddToCamera(Camera* camera);
+        virtual void OnRemoveFromCamera(Camera* camera);
         Camera* GetCamera() const { return m_camera; }
         void MarkRendererOrderDirty();
 #if VR_VULKAN
@@ -85,6 +88,9 @@ namespace Viry3D
         void SetInstanceExtraVector(int instance_index, int vector_index, const Vector4& v);
         int GetInstanceCount() const;
         int GetInstanceStride() const;
+        // return false if renderer has no bounds and should never be culled
+        virtual bool GetLocalBounds(Bounds&) const { return false; }
+        bool GetBounds(Bounds& bounds);
 
     protected:
         virtual void OnMatrixDirty();
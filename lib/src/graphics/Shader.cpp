@@ -21,11 +21,14 @@
 #include "VertexAttribute.h"
 #include "io/File.h"
 #include "Debug.h"
+#include "memory/Memory.h"
 
 namespace Viry3D
 {
     List<Shader*> Shader::m_shaders;
 	Map<String, Ref<Shader>> Shader::m_shader_cache;
+    Map<String, int> Shader::m_property_ids;
+    Mutex Shader::m_property_mutex;
 
 	Ref<Shader> Shader::Find(const String& name)
 	{
@@ -55,6 +58,22 @@ namespace Viry3D
 		m_shader_cache.Clear();
 	}
 
+    int Shader::PropertyToID(const String& name)
+    {
+        std::lock_guard<Mutex> lock(m_property_mutex);
+
+        int* id_ptr;
+        if (m_property_ids.TryGet(name, &id_ptr))
+        {
+            return *id_ptr;
+        }
+
+        int id = m_property_ids.Size();
+        m_property_ids.Add(name, id);
+
+        return id;
+    }
+
 #if VR_VULKAN
 	void Shader::OnRenderPassDestroy(VkRenderPass render_pass)
 	{
@@ -222,14 +241,14 @@ namespace Viry3D
     }
 
 #if VR_VULKAN
-    VkPipeline Shader::GetPipeline(VkRenderPass render_pass, bool color_attachment, bool depth_attachment, int extra_color_attachment_count, int sample_count, bool instancing, int instance_stride)
+    VkPipeline Shader::GetPipeline(VkRenderPass render_pass, bool color_attachment, bool depth_attachment, int extra_color_attachment_count, int sample_count, bool instancing, int instance_stride, const VertexLayout& vertex_layout)
     {
         Vector<Pipeline>* pipelines_ptr = nullptr;
         if (m_pipelines.TryGet(render_pass, &pipelines_ptr))
         {
             for (int i = 0; i < pipelines_ptr->Size(); ++i)
             {
-                if ((*pipelines_ptr)[i].instancing == instancing)
+                if ((*pipelines_ptr)[i].instancing == instancing && (*pipelines_ptr)[i].vertex_layout == vertex_layout)
                 {
                     return (*pipelines_ptr)[i].pipeline;
                 }
@@ -238,10 +257,12 @@ namespace Viry3D
 
         Pipeline p;
         p.instancing = instancing;
+        p.vertex_layout = vertex_layout;
 
         Display::Instance()->CreatePipeline(
             render_pass,
             m_attributes,
+            vertex_layout,
             m_vs_module,
             m_fs_module,
             m_render_state,
@@ -440,6 +461,18 @@ namespace Viry3D
                     }
                     u.loc = glGetUniformLocation(program, u.name.CString());
 
+                    int id = Shader::PropertyToID(u.name);
+                    if (id >= m_uniform_indices.Size())
+                    {
+                        int old_size = m_uniform_indices.Size();
+                        m_uniform_indices.Resize(id + 1);
+                        for (int j = old_size; j < m_uniform_indices.Size(); ++j)
+                        {
+                            m_uniform_indices[j] = -1;
+                        }
+                    }
+                    m_uniform_indices[id] = m_uniforms.Size();
+
                     m_uniforms.Add(u);
                 }
 
@@ -470,15 +503,65 @@ namespace Viry3D
         }
     }
 
-    void Shader::EnableVertexAttribs() const
+    static void GetVertexFormat(VertexFormat format, GLenum* type, GLboolean* normalized)
+    {
+        switch (format)
+        {
+        case VertexFormat::Half2:
+        case VertexFormat::Half4:
+            *type = GL_HALF_FLOAT;
+            *normalized = GL_FALSE;
+            break;
+        case VertexFormat::Snorm8x4:
+            *type = GL_BYTE;
+            *normalized = GL_TRUE;
+            break;
+        case VertexFormat::Unorm8x4:
+            *type = GL_UNSIGNED_BYTE;
+            *normalized = GL_TRUE;
+            break;
+        case VertexFormat::Uint8x4:
+            *type = GL_UNSIGNED_BYTE;
+            *normalized = GL_FALSE;
+            break;
+        default:
+            *type = GL_FLOAT;
+            *normalized = GL_FALSE;
+            break;
+        }
+    }
+
+    void Shader::EnableVertexAttribs(const VertexLayout& vertex_layout, const Vector<int>& vertex_stream_offsets) const
     {
         for (int i = 0; i < (int) VertexAttributeType::Count; ++i)
         {
             int loc = glGetAttribLocation(m_program, VERTEX_ATTR_NAMES[i]);
             if (loc >= 0)
             {
-                glEnableVertexAttribArray(loc);
-                glVertexAttribPointer(loc, VERTEX_ATTR_SIZES[i] / 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*) (size_t) VERTEX_ATTR_OFFSETS[i]);
+                const VertexLayoutAttribute* attribute = vertex_layout.GetAttribute((VertexAttributeType) i);
+                if (attribute)
+                {
+                    GLenum type;
+                    GLboolean normalized;
+                    GetVertexFormat(attribute->format, &type, &normalized);
+                    int offset = vertex_stream_offsets[attribute->stream] + attribute->offset;
+
+                    glEnableVertexAttribArray(loc);
+                    glVertexAttribPointer(loc, VERTEX_FORMAT_COMPONENTS[(int) attribute->format], type, normalized, vertex_layout.GetStride(attribute->stream), (const void*) (size_t) offset);
+                }
+                else
+                {
+                    // not stored in the vertex buffer, read a constant instead
+                    glDisableVertexAttribArray(loc);
+                    if (i == (int) VertexAttributeType::Color)
+                    {
+                        glVertexAttrib4f(loc, 1, 1, 1, 1);
+                    }
+                    else
+                    {
+                        glVertexAttrib4f(loc, 0, 0, 0, 0);
+                    }
+                }
             }
         }
     }
@@ -495,55 +578,86 @@ namespace Viry3D
         }
     }
 
-    void Shader::SetUniform1f(const String& name, float value) const
+    const Shader::Uniform* Shader::FindUniform(int id) const
     {
-        for (int i = 0; i < m_uniforms.Size(); ++i)
+        if (id >= 0 && id < m_uniform_indices.Size())
         {
-            const Uniform& u = m_uniforms[i];
-            if (u.name == name)
+            int index = m_uniform_indices[id];
+            if (index >= 0)
             {
-                glUniform1f(u.loc, value);
-                break;
+                return &m_uniforms[index];
             }
         }
+
+        return nullptr;
     }
 
-    void Shader::SetUniform4f(const String& name, int count, const float* value) const
+    bool Shader::IsUniformChanged(const Uniform& u, const void* value, int size) const
     {
-        for (int i = 0; i < m_uniforms.Size(); ++i)
+        if (u.value.Size() == size && Memory::Compare(u.value.Bytes(), value, size) == 0)
         {
-            const Uniform& u = m_uniforms[i];
-            if (u.name == name)
-            {
-                glUniform4fv(u.loc, count, value);
-                break;
-            }
+            return false;
         }
+
+        u.value.Resize(size);
+        Memory::Copy(u.value.Bytes(), value, size);
+
+        return true;
+    }
+
+    void Shader::SetUniform1f(const String& name, float value) const
+    {
+        this->SetUniform1f(Shader::PropertyToID(name), value);
+    }
+
+    void Shader::SetUniform4f(const String& name, int count, const float* value) const
+    {
+        this->SetUniform4f(Shader::PropertyToID(name), count, value);
     }
 
     void Shader::SetUniform1i(const String& name, int value) const
     {
-        for (int i = 0; i < m_uniforms.Size(); ++i)
+        this->SetUniform1i(Shader::PropertyToID(name), value);
+    }
+
+    void Shader::SetUniformMatrix(const String& name, int count, const float* value) const
+    {
+        this->SetUniformMatrix(Shader::PropertyToID(name), count, value);
+    }
+
+    void Shader::SetUniform1f(int id, float value) const
+    {
+        const Uniform* u = this->FindUniform(id);
+        if (u && this->IsUniformChanged(*u, &value, sizeof(value)))
         {
-            const Uniform& u = m_uniforms[i];
-            if (u.name == name)
-            {
-                glUniform1i(u.loc, value);
-                break;
-            }
+            glUniform1f(u->loc, value);
         }
     }
 
-    void Shader::SetUniformMatrix(const String& name, int count, const float* value) const
+    void Shader::SetUniform4f(int id, int count, const float* value) const
     {
-        for (int i = 0; i < m_uniforms.Size(); ++i)
+        const Uniform* u = this->FindUniform(id);
+        if (u && this->IsUniformChanged(*u, value, sizeof(float) * 4 * count))
         {
-            const Uniform& u = m_uniforms[i];
-            if (u.name == name)
-            {
-                glUniformMatrix4fv(u.loc, count, GL_FALSE, value);
-                break;
-            }
+            glUniform4fv(u->loc, count, value);
+        }
+    }
+
+    void Shader::SetUniform1i(int id, int value) const
+    {
+        const Uniform* u = this->FindUniform(id);
+        if (u && this->IsUniformChanged(*u, &value, sizeof(value)))
+        {
+            glUniform1i(u->loc, value);
+        }
+    }
+
+    void Shader::SetUniformMatrix(int id, int count, const float* value) const
+    {
+        const Uniform* u = this->FindUniform(id);
+        if (u && this->IsUniformChanged(*u, value, sizeof(float) * 16 * count))
+        {
+            glUniformMatrix4fv(u->loc, count, GL_FALSE, value);
         }
     }
 
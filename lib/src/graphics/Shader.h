@@ -22,6 +22,7 @@
 #include "string/String.h"
 #include "container/List.h"
 #include "container/Map.h"
+#include "thread/ThreadPool.h"
 
 namespace Viry3D
 {
@@ -30,6 +31,7 @@ namespace Viry3D
     {
         VkPipeline pipeline;
         bool instancing;
+        VertexLayout vertex_layout;
     };
 #endif
 
@@ -40,6 +42,8 @@ namespace Viry3D
 		static void AddCache(const String& name, const Ref<Shader>& shader);
         static void RemoveCache(const String& name);
 		static void Done();
+        // interns a uniform name, ids are stable for the lifetime of the process
+        static int PropertyToID(const String& name);
         Shader(
             const String& vs_predefine,
             const Vector<String>& vs_includes,
@@ -54,18 +58,22 @@ namespace Viry3D
         bool IsComputeShader() const { return m_compute_shader; }
 #if VR_VULKAN
         static void OnRenderPassDestroy(VkRenderPass render_pass);
-        VkPipeline GetPipeline(VkRenderPass render_pass, bool color_attachment, bool depth_attachment, int extra_color_attachment_count, int sample_count, bool instancing, int instance_stride);
+        VkPipeline GetPipeline(VkRenderPass render_pass, bool color_attachment, bool depth_attachment, int extra_color_attachment_count, int sample_count, bool instancing, int instance_stride, const VertexLayout& vertex_layout);
         VkPipeline GetComputePipeline();
         void CreateDescriptorSets(Vector<VkDescriptorSet>& descriptor_sets, Vector<UniformSet>& uniform_sets);
         VkPipelineLayout GetPipelineLayout() const { return m_pipeline_layout; }
 #elif VR_GLES
         bool Use() const;
-        void EnableVertexAttribs() const;
+        void EnableVertexAttribs(const VertexLayout& vertex_layout, const Vector<int>& vertex_stream_offsets) const;
         void DisableVertexAttribs() const;
         void SetUniform1f(const String& name, float value) const;
         void SetUniform4f(const String& name, int count, const float* value) const;
         void SetUniform1i(const String& name, int value) const;
         void SetUniformMatrix(const String& name, int count, const float* value) const;
+        void SetUniform1f(int id, float value) const;
+        void SetUniform4f(int id, int count, const float* value) const;
+        void SetUniform1i(int id, int value) const;
+        void SetUniformMatrix(int id, int count, const float* value) const;
         void ApplyRenderState();
 #endif
 
@@ -86,8 +94,13 @@ namespace Viry3D
             GLenum type;
             int size;
             int loc;
+            // value last uploaded to the program, uniforms keep their values across glUseProgram
+            mutable Vector<byte> value;
         };
 
+        const Uniform* FindUniform(int id) const;
+        bool IsUniformChanged(const Uniform& u, const void* value, int size) const;
+
         void CreateProgram(
             const String& vs_predefine,
             const Vector<String>& vs_includes,
@@ -100,6 +113,8 @@ namespace Viry3D
     private:
         static List<Shader*> m_shaders;
 		static Map<String, Ref<Shader>> m_shader_cache;
+        static Map<String, int> m_property_ids;
+        static Mutex m_property_mutex;
 #if VR_VULKAN
         VkShaderModule m_cs_module;
         VkShaderModule m_vs_module;
@@ -116,6 +131,8 @@ namespace Viry3D
         GLuint m_program;
         Vector<Attribute> m_attributes;
         Vector<Uniform> m_uniforms;
+        // index into m_uniforms by property id, -1 if the program does not use it
+        Vector<int> m_uniform_indices;
 #endif
         RenderState m_render_state;
         bool m_compute_shader;
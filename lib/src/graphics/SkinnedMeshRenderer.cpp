@@ -17,18 +17,270 @@
 
 #include "SkinnedMeshRenderer.h"
 #include "Mesh.h"
+#include "Material.h"
+#include "BonePalette.h"
+#include "Computer.h"
+#include "Shader.h"
+#include "Camera.h"
+#include "BufferObject.h"
 #include "Debug.h"
+#include "animation/SkeletonBinding.h"
+
+#if VR_VULKAN
+#define BONE_PALETTE "BonePalette"
+#define BONE_OFFSET "u_bone_offset"
+#define SOURCE_VERTICES "SourceVertices"
+#define SKINNED_VERTICES "SkinnedVertices"
+#define SKINNING_SHADER_NAME "SkinnedMeshRenderer.Skinning"
+#define SKINNING_GROUP_SIZE 64
+#endif
 
 namespace Viry3D
 {
+#if VR_VULKAN
+    // one thread per vertex, vertex buffers are read as uint arrays with offsets and strides in words,
+    // only position, normal and tangent are written, everything else stays as copied from the mesh
+    static const char* SKINNING_SHADER_SOURCE = R"(#version 310 es
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+layout (std430, binding = 0) readonly buffer SourceVertices
+{
+    uint u_source[];
+};
+layout (std430, binding = 1) buffer SkinnedVertices
+{
+    uint u_skinned[];
+};
+layout (std430, binding = 2) readonly buffer BonePalette
+{
+    vec4 u_bone_palette[];
+};
+layout (binding = 3) uniform SkinningParams
+{
+    int u_vertex_count;
+    int u_bone_offset;
+    int u_position_offset;
+    int u_position_stride;
+    int u_position_format;
+    int u_normal_offset;
+    int u_normal_stride;
+    int u_normal_format;
+    int u_tangent_offset;
+    int u_tangent_stride;
+    int u_tangent_format;
+    int u_weight_offset;
+    int u_weight_stride;
+    int u_weight_format;
+    int u_index_offset;
+    int u_index_stride;
+    int u_index_format;
+};
+
+// VertexFormat values
+const int FORMAT_FLOAT3 = 2;
+const int FORMAT_FLOAT4 = 3;
+const int FORMAT_HALF4 = 5;
+const int FORMAT_SNORM8X4 = 6;
+const int FORMAT_UINT8X4 = 8;
+
+vec4 ReadVector(int offset, int format)
+{
+    if (format == FORMAT_SNORM8X4)
+    {
+        return unpackSnorm4x8(u_source[offset]);
+    }
+    else if (format == FORMAT_HALF4)
+    {
+        return vec4(unpackHalf2x16(u_source[offset]), unpackHalf2x16(u_source[offset + 1]));
+    }
+    else if (format == FORMAT_UINT8X4)
+    {
+        uint v = u_source[offset];
+        return vec4(float(v & 0xffu), float((v >> 8) & 0xffu), float((v >> 16) & 0xffu), float(v >> 24));
+    }
+
+    vec4 v = vec4(uintBitsToFloat(u_source[offset]), uintBitsToFloat(u_source[offset + 1]), uintBitsToFloat(u_source[offset + 2]), 0.0);
+    if (format == FORMAT_FLOAT4)
+    {
+        v.w = uintBitsToFloat(u_source[offset + 3]);
+    }
+    return v;
+}
+
+// w is left as copied, it holds the tangent sign
+void WriteVector(int offset, int format, vec4 v)
+{
+    if (format == FORMAT_SNORM8X4)
+    {
+        u_skinned[offset] = packSnorm4x8(v);
+        return;
+    }
+
+    u_skinned[offset] = floatBitsToUint(v.x);
+    u_skinned[offset + 1] = floatBitsToUint(v.y);
+    u_skinned[offset + 2] = floatBitsToUint(v.z);
+}
+
+void main()
+{
+    int vertex = int(gl_GlobalInvocationID.x);
+    if (vertex >= u_vertex_count)
+    {
+        return;
+    }
+
+    vec4 weights = ReadVector(u_weight_offset + vertex * u_weight_stride, u_weight_format);
+    ivec4 bones = ivec4(ReadVector(u_index_offset + vertex * u_index_stride, u_index_format)) * 3 + u_bone_offset;
+
+    // same as SKIN_MAT_OFFSET in Skin.vs
+    mat4 skin_mat =
+        mat4(u_bone_palette[bones.x], u_bone_palette[bones.x + 1], u_bone_palette[bones.x + 2], vec4(0, 0, 0, 1)) * weights.x +
+        mat4(u_bone_palette[bones.y], u_bone_palette[bones.y + 1], u_bone_palette[bones.y + 2], vec4(0, 0, 0, 1)) * weights.y +
+        mat4(u_bone_palette[bones.z], u_bone_palette[bones.z + 1], u_bone_palette[bones.z + 2], vec4(0, 0, 0, 1)) * weights.z +
+        mat4(u_bone_palette[bones.w], u_bone_palette[bones.w + 1], u_bone_palette[bones.w + 2], vec4(0, 0, 0, 1)) * weights.w;
+
+    int position = u_position_offset + vertex * u_position_stride;
+    vec4 pos = vec4(ReadVector(position, u_position_format).xyz, 1.0);
+    WriteVector(position, u_position_format, pos * skin_mat);
+
+    if (u_normal_format >= 0)
+    {
+        int normal = u_normal_offset + vertex * u_normal_stride;
+        vec4 n = vec4(ReadVector(normal, u_normal_format).xyz, 0.0);
+        WriteVector(normal, u_normal_format, vec4(normalize((n * skin_mat).xyz), 0.0));
+    }
+
+    if (u_tangent_format >= 0)
+    {
+        int tangent = u_tangent_offset + vertex * u_tangent_stride;
+        vec4 t = ReadVector(tangent, u_tangent_format);
+        WriteVector(tangent, u_tangent_format, vec4(normalize((vec4(t.xyz, 0.0) * skin_mat).xyz), t.w));
+    }
+}
+)";
+
+    static Ref<Shader> GetSkinningShader()
+    {
+        Ref<Shader> shader = Shader::Find(SKINNING_SHADER_NAME);
+        if (!shader)
+        {
+            shader = RefMake<Shader>(SKINNING_SHADER_SOURCE);
+            Shader::AddCache(SKINNING_SHADER_NAME, shader);
+        }
+        return shader;
+    }
+
+    // a storage buffer binding waits for the frames in flight, so only set buffers that changed
+    static void SetStorageBufferChanged(const Ref<Material>& material, const String& name, const Ref<BufferObject>& buffer)
+    {
+        const MaterialProperty* property;
+        if (!material->GetProperties().TryGet(name, &property) || property->buffer.lock() != buffer)
+        {
+            material->SetStorageBuffer(name, buffer);
+        }
+    }
+
+    static void SetIntChanged(const Ref<Material>& material, const String& name, int value)
+    {
+        const MaterialProperty* property;
+        if (!material->GetProperties().TryGet(name, &property) || property->data.int_value != value)
+        {
+            material->SetInt(name, value);
+        }
+    }
+
+    static bool IsSkinningFormat(const VertexLayoutAttribute* attribute, bool optional, VertexFormat a, VertexFormat b, VertexFormat c)
+    {
+        if (attribute == nullptr)
+        {
+            return optional;
+        }
+        return attribute->format == a || attribute->format == b || attribute->format == c;
+    }
+
+    static void SetSkinningAttribute(const Ref<Material>& material, const String& name, const Ref<Mesh>& mesh, VertexAttributeType type)
+    {
+        const auto& layout = mesh->GetVertexLayout();
+        const VertexLayoutAttribute* attribute = layout.GetAttribute(type);
+        int offset = 0;
+        int stride = 0;
+        int format = -1;
+
+        // every vertex format size is a multiple of 4 bytes
+        if (attribute)
+        {
+            offset = (mesh->GetVertexStreamOffset(attribute->stream) + attribute->offset) / 4;
+            stride = layout.GetStride(attribute->stream) / 4;
+            format = (int) attribute->format;
+        }
+
+        material->SetInt("u_" + name + "_offset", offset);
+        material->SetInt("u_" + name + "_stride", stride);
+        material->SetInt("u_" + name + "_format", format);
+    }
+#endif
+
+#if VR_VULKAN
+    Vector<SkinnedMeshRenderer*> SkinnedMeshRenderer::m_renderers;
+
+    void SkinnedMeshRenderer::BindBonePalettes()
+    {
+        // grow once for every range still to allocate
+        int reserve_size = 0;
+        for (auto i : m_renderers)
+        {
+            int bone_count = i->GetBoneCount();
+            if (bone_count > 0 && (i->m_bone_palette_offset < 0 || i->m_bone_palette_count != bone_count))
+            {
+                reserve_size += bone_count * 3;
+            }
+        }
+        if (reserve_size > 0)
+        {
+            BonePalette::Reserve(reserve_size);
+        }
+
+        for (auto i : m_renderers)
+        {
+            int bone_count = i->GetBoneCount();
+            if (bone_count > 0)
+            {
+                i->BindBonePalette(bone_count);
+            }
+        }
+    }
+
+    int SkinnedMeshRenderer::GetBoneCount() const
+    {
+        const auto& mesh = this->GetMesh();
+        if (this->GetMaterial() && mesh && m_bone_paths.Size() > 0)
+        {
+            return mesh->GetBindposes().Size();
+        }
+        return 0;
+    }
+#endif
+
     SkinnedMeshRenderer::SkinnedMeshRenderer()
     {
+#if VR_VULKAN
+        m_bone_palette_offset = -1;
+        m_bone_palette_count = 0;
+        m_compute_skinning = false;
 
+        m_renderers.Add(this);
+#endif
     }
 
     SkinnedMeshRenderer::~SkinnedMeshRenderer()
     {
+#if VR_VULKAN
+        m_renderers.Remove(this);
 
+        if (m_bone_palette_offset >= 0)
+        {
+            BonePalette::Free(m_bone_palette_offset, m_bone_palette_count);
+        }
+#endif
     }
 
     void SkinnedMeshRenderer::FindBones()
@@ -36,12 +288,21 @@ namespace Viry3D
         auto root = m_bones_root.lock();
         const auto& root_name = root->GetName();
 
+        // shared with the animations and other renderers of the same rig
+        m_skeleton = SkeletonBinding::Get(root.get());
+
+        // bones not found again after a rebuild must not keep their old nodes
+        m_bones.Clear();
         m_bones.Resize(m_bone_paths.Size());
         for (int i = 0; i < m_bones.Size(); ++i)
         {
             if (m_bone_paths[i].StartsWith(root_name))
             {
-                m_bones[i] = root->Find(m_bone_paths[i].Substring(root_name.Size() + 1));
+                int index = m_skeleton->FindIndex(m_bone_paths[i], root_name.Size() + 1);
+                if (index >= 0)
+                {
+                    m_bones[i] = m_skeleton->GetNode(index);
+                }
             }
             
             if (m_bones[i].expired())
@@ -61,6 +322,8 @@ namespace Viry3D
             const auto& bindposes = mesh->GetBindposes();
             int bone_count = bindposes.Size();
 
+            assert(m_bone_paths.Size() == bone_count);
+
 #if VR_GLES
             int bone_max;
             if (Display::Instance()->IsGLESv3())
@@ -71,32 +334,223 @@ namespace Viry3D
             {
                 bone_max = 30;
             }
-#else
-            const int bone_max = 70;
-#endif  
 
-            assert(m_bone_paths.Size() == bone_count);
             assert(m_bone_paths.Size() <= bone_max);
+#endif
 
-            if (m_bones.Empty())
+            if (m_bones.Empty() || !m_skeleton->IsBuiltFrom(m_bones_root.lock().get()))
             {
                 this->FindBones();
             }
 
             Vector<Vector4> bone_vectors(bone_count * 3);
 
+#if VR_VULKAN
+            // compute skinned vertices stay in the local space of this renderer and are drawn with its model matrix
+            Matrix4x4 world_to_local;
+            if (m_compute_skinning)
+            {
+                world_to_local = this->GetLocalToWorldMatrix().Inverse();
+            }
+#endif
+
             for (int i = 0; i < bone_count; ++i)
             {
                 Matrix4x4 mat = m_bones[i].lock()->GetLocalToWorldMatrix() * bindposes[i];
+#if VR_VULKAN
+                if (m_compute_skinning)
+                {
+                    mat = world_to_local * mat;
+                }
+#endif
 
                 bone_vectors[i * 3 + 0] = mat.GetRow(0);
                 bone_vectors[i * 3 + 1] = mat.GetRow(1);
                 bone_vectors[i * 3 + 2] = mat.GetRow(2);
             }
 
+#if VR_VULKAN
+            // bound in BindBonePalettes, only renderers added during the camera updates allocate here
+            if (m_bone_palette_offset < 0 || m_bone_palette_count != bone_count)
+            {
+                this->BindBonePalette(bone_count);
+            }
+            BonePalette::SetBones(m_bone_palette_offset, bone_vectors);
+#elif VR_GLES
             this->SetInstanceVectorArray("u_bones", bone_vectors);
+#endif
         }
 
         MeshRenderer::Update();
     }
+
+#if VR_VULKAN
+    void SkinnedMeshRenderer::BindBonePalette(int bone_count)
+    {
+        if (m_bone_palette_offset >= 0 && m_bone_palette_count != bone_count)
+        {
+            BonePalette::Free(m_bone_palette_offset, m_bone_palette_count);
+            m_bone_palette_offset = -1;
+        }
+
+        if (m_bone_palette_offset < 0)
+        {
+            m_bone_palette_offset = BonePalette::Allocate(bone_count);
+            m_bone_palette_count = bone_count;
+        }
+
+        if (m_compute_skinning)
+        {
+            this->BindSkinningComputer();
+            return;
+        }
+
+        const auto& buffer = BonePalette::GetBuffer();
+        for (const auto& i : this->GetMaterials())
+        {
+            if (i)
+            {
+                SetStorageBufferChanged(i, BONE_PALETTE, buffer);
+            }
+        }
+
+        // instance materials are recreated when the materials change
+        bool offset_dirty = this->GetInstanceMaterials().Empty();
+        for (const auto& i : this->GetInstanceMaterials())
+        {
+            const MaterialProperty* property;
+            if (i && (!i->GetProperties().TryGet(BONE_OFFSET, &property) || property->data.int_value != m_bone_palette_offset))
+            {
+                offset_dirty = true;
+            }
+        }
+        if (offset_dirty)
+        {
+            this->SetInstanceInt(BONE_OFFSET, m_bone_palette_offset);
+        }
+    }
+
+    void SkinnedMeshRenderer::BindSkinningComputer()
+    {
+        const auto& skinned_mesh = this->GetSkinnedMesh();
+        if (!skinned_mesh)
+        {
+            return;
+        }
+
+        const auto& material = m_skinning_computer->GetMaterial();
+        SetStorageBufferChanged(material, SOURCE_VERTICES, this->GetMesh()->GetVertexBuffer());
+        SetStorageBufferChanged(material, SKINNED_VERTICES, skinned_mesh->GetVertexBuffer());
+        SetStorageBufferChanged(material, BONE_PALETTE, BonePalette::GetBuffer());
+        SetIntChanged(material, BONE_OFFSET, m_bone_palette_offset);
+    }
+
+    void SkinnedMeshRenderer::OnAddToCamera(Camera* camera)
+    {
+        MeshRenderer::OnAddToCamera(camera);
+
+        if (m_skinning_computer && m_skinning_computer->GetCamera() == nullptr)
+        {
+            camera->AddRenderer(m_skinning_computer);
+        }
+    }
+
+    void SkinnedMeshRenderer::OnRemoveFromCamera(Camera* camera)
+    {
+        if (m_skinning_computer && m_skinning_computer->GetCamera() == camera)
+        {
+            camera->RemoveRenderer(m_skinning_computer);
+        }
+
+        MeshRenderer::OnRemoveFromCamera(camera);
+    }
+
+    void SkinnedMeshRenderer::SetComputeSkinning(bool enable)
+    {
+        if (m_compute_skinning == enable)
+        {
+            return;
+        }
+
+        m_compute_skinning = enable;
+
+        if (enable)
+        {
+            m_skinning_computer = RefMake<Computer>();
+            m_skinning_computer->SetMaterial(RefMake<Material>(GetSkinningShader()));
+
+            Camera* camera = this->GetCamera();
+            if (camera)
+            {
+                camera->AddRenderer(m_skinning_computer);
+            }
+        }
+        else
+        {
+            Camera* camera = m_skinning_computer->GetCamera();
+            if (camera)
+            {
+                camera->RemoveRenderer(m_skinning_computer);
+            }
+            m_skinning_computer.reset();
+            m_skinned_mesh.reset();
+        }
+
+        this->MarkInstanceCmdDirty();
+    }
+
+    const Ref<Mesh>& SkinnedMeshRenderer::GetSkinnedMesh()
+    {
+        const auto& mesh = this->GetMesh();
+        if (!m_compute_skinning || !mesh)
+        {
+            return m_skinned_mesh;
+        }
+
+        // the copy shares the index buffer of the mesh it was made from
+        if (m_skinned_mesh && m_skinned_mesh->GetIndexBuffer() == mesh->GetIndexBuffer())
+        {
+            return m_skinned_mesh;
+        }
+
+        const auto& layout = mesh->GetVertexLayout();
+        bool supported =
+            IsSkinningFormat(layout.GetAttribute(VertexAttributeType::Vertex), false, VertexFormat::Float3, VertexFormat::Float3, VertexFormat::Float3) &&
+            IsSkinningFormat(layout.GetAttribute(VertexAttributeType::Normal), true, VertexFormat::Float3, VertexFormat::Float4, VertexFormat::Snorm8x4) &&
+            IsSkinningFormat(layout.GetAttribute(VertexAttributeType::Tangent), true, VertexFormat::Float3, VertexFormat::Float4, VertexFormat::Snorm8x4) &&
+            IsSkinningFormat(layout.GetAttribute(VertexAttributeType::BlendWeight), false, VertexFormat::Float4, VertexFormat::Half4, VertexFormat::Half4) &&
+            IsSkinningFormat(layout.GetAttribute(VertexAttributeType::BlendIndices), false, VertexFormat::Float4, VertexFormat::Uint8x4, VertexFormat::Uint8x4);
+        if (!supported)
+        {
+            Log("vertex layout not supported by compute skinning");
+            assert(supported);
+            return m_skinned_mesh;
+        }
+
+        m_skinned_mesh = RefMake<Mesh>(mesh);
+
+        const auto& material = m_skinning_computer->GetMaterial();
+        material->SetInt("u_vertex_count", mesh->GetVertexCount());
+        SetSkinningAttribute(material, "position", mesh, VertexAttributeType::Vertex);
+        SetSkinningAttribute(material, "normal", mesh, VertexAttributeType::Normal);
+        SetSkinningAttribute(material, "tangent", mesh, VertexAttributeType::Tangent);
+        SetSkinningAttribute(material, "weight", mesh, VertexAttributeType::BlendWeight);
+        SetSkinningAttribute(material, "index", mesh, VertexAttributeType::BlendIndices);
+        m_skinning_computer->SetWorkgroupCount((mesh->GetVertexCount() + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE, 1, 1);
+
+        this->MarkInstanceCmdDirty();
+
+        return m_skinned_mesh;
+    }
+
+    Ref<BufferObject> SkinnedMeshRenderer::GetVertexBuffer() const
+    {
+        if (m_skinned_mesh)
+        {
+            return m_skinned_mesh->GetVertexBuffer();
+        }
+
+        return MeshRenderer::GetVertexBuffer();
+    }
+#endif
 }
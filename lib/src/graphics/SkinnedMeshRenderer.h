@@ -21,23 +21,61 @@
 
 namespace Viry3D
 {
+    class Computer;
+    class SkeletonBinding;
+
     class SkinnedMeshRenderer : public MeshRenderer
     {
     public:
+#if VR_VULKAN
+        // allocates and binds bone palette ranges of all renderers before cameras update,
+        // so the palette never grows after a renderer bound it in the same frame
+        static void BindBonePalettes();
+#endif
         SkinnedMeshRenderer();
         virtual ~SkinnedMeshRenderer();
         virtual void Update();
+#if VR_VULKAN
+        virtual void OnAddToCamera(Camera* camera);
+        virtual void OnRemoveFromCamera(Camera* camera);
+        virtual Ref<BufferObject> GetVertexBuffer() const;
+        // skins vertices once per frame with a compute shader instead of in the vertex shader of every pass,
+        // materials then use shaders without SKINNED_MESH, the skinning computer follows this renderer to its camera
+        void SetComputeSkinning(bool enable);
+        bool IsComputeSkinning() const { return m_compute_skinning; }
+        const Ref<Computer>& GetSkinningComputer() const { return m_skinning_computer; }
+        // skinned vertices in the local space of this renderer, other passes draw them as a plain mesh
+        const Ref<Mesh>& GetSkinnedMesh();
+#endif
+        // bones move vertices away from the bind pose bounds of mesh
+        virtual bool GetLocalBounds(Bounds&) const { return false; }
         const Vector<String>& GetBonePaths() const { return m_bone_paths; }
-        void SetBonePaths(const Vector<String>& bones) { m_bone_paths = bones; }
+        void SetBonePaths(const Vector<String>& bones) { m_bone_paths = bones; m_bones.Clear(); }
         Ref<Node> GetBonesRoot() const { return m_bones_root.lock(); }
-        void SetBonesRoot(const Ref<Node>& node) { m_bones_root = node; }
+        void SetBonesRoot(const Ref<Node>& node) { m_bones_root = node; m_bones.Clear(); }
 
     private:
         void FindBones();
+#if VR_VULKAN
+        int GetBoneCount() const;
+        void BindBonePalette(int bone_count);
+        void BindSkinningComputer();
+#endif
 
     private:
+#if VR_VULKAN
+        static Vector<SkinnedMeshRenderer*> m_renderers;
+#endif
         Vector<String> m_bone_paths;
         WeakRef<Node> m_bones_root;
+        Ref<SkeletonBinding> m_skeleton;
         Vector<WeakRef<Node>> m_bones;
+#if VR_VULKAN
+        int m_bone_palette_offset;
+        int m_bone_palette_count;
+        bool m_compute_skinning;
+        Ref<Computer> m_skinning_computer;
+        Ref<Mesh> m_skinned_mesh;
+#endif
     };
 }
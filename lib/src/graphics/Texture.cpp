@@ -1035,26 +1035,9 @@ namespace Viry3D
     void Texture::UpdateTexture2D(const ByteBuffer& pixels, int x, int y, int w, int h, int level)
     {
 #if VR_VULKAN
-        VkDevice device = Display::Instance()->GetDevice();
-
-        if (!m_image_buffer || m_image_buffer->GetSize() < pixels.Size())
-        {
-            m_image_buffer = Display::Instance()->CreateBuffer(pixels.Bytes(), pixels.Size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, VK_FORMAT_UNDEFINED);
-        }
-        else
-        {
-            Display::Instance()->UpdateBuffer(m_image_buffer, 0, pixels.Bytes(), pixels.Size());
-        }
-
         this->CopyBufferToImageBegin();
-        this->CopyBufferToImage(m_image_buffer, x, y, w, h, 0, level);
+        this->CopyBufferToImage(pixels, x, y, w, h, 0, level);
         this->CopyBufferToImageEnd();
-
-        if (!m_dynamic)
-        {
-            m_image_buffer->Destroy(device);
-            m_image_buffer.reset();
-        }
 #elif VR_GLES
         this->Bind();
 
@@ -1090,26 +1073,9 @@ namespace Viry3D
     void Texture::UpdateCubemap(const ByteBuffer& pixels, CubemapFace face, int level)
     {
 #if VR_VULKAN
-        VkDevice device = Display::Instance()->GetDevice();
-
-        if (!m_image_buffer || m_image_buffer->GetSize() < pixels.Size())
-        {
-            m_image_buffer = Display::Instance()->CreateBuffer(pixels.Bytes(), pixels.Size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, VK_FORMAT_UNDEFINED);
-        }
-        else
-        {
-            Display::Instance()->UpdateBuffer(m_image_buffer, 0, pixels.Bytes(), pixels.Size());
-        }
-
         this->CopyBufferToImageBegin();
-        this->CopyBufferToImage(m_image_buffer, 0, 0, m_width >> level, m_height >> level, (int) face, level);
+        this->CopyBufferToImage(pixels, 0, 0, m_width >> level, m_height >> level, (int) face, level);
         this->CopyBufferToImageEnd();
-
-        if (!m_dynamic)
-        {
-            m_image_buffer->Destroy(device);
-            m_image_buffer.reset();
-        }
 #elif VR_GLES
         this->Bind();
 
@@ -1126,26 +1092,9 @@ namespace Viry3D
         int w, int h)
     {
 #if VR_VULKAN
-        VkDevice device = Display::Instance()->GetDevice();
-
-        if (!m_image_buffer || m_image_buffer->GetSize() < pixels.Size())
-        {
-            m_image_buffer = Display::Instance()->CreateBuffer(pixels.Bytes(), pixels.Size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, VK_FORMAT_UNDEFINED);
-        }
-        else
-        {
-            Display::Instance()->UpdateBuffer(m_image_buffer, 0, pixels.Bytes(), pixels.Size());
-        }
-
         this->CopyBufferToImageBegin();
-        this->CopyBufferToImage(m_image_buffer, x, y, w, h, layer, level);
+        this->CopyBufferToImage(pixels, x, y, w, h, layer, level);
         this->CopyBufferToImageEnd();
-
-        if (!m_dynamic)
-        {
-            m_image_buffer->Destroy(device);
-            m_image_buffer.reset();
-        }
 #endif
     }
 
@@ -1302,11 +1251,14 @@ namespace Viry3D
             (VkAccessFlagBits) 0);
     }
     
-    void Texture::CopyBufferToImage(const Ref<BufferObject>& image_buffer, int x, int y, int w, int h, int layer, int level)
+    void Texture::CopyBufferToImage(const ByteBuffer& pixels, int x, int y, int w, int h, int layer, int level)
     {
+        int buffer_offset = 0;
+        Ref<BufferObject> image_buffer = Display::Instance()->StageData(pixels.Bytes(), pixels.Size(), &buffer_offset);
+
         VkBufferImageCopy copy;
         Memory::Zero(&copy, sizeof(copy));
-        copy.bufferOffset = 0;
+        copy.bufferOffset = buffer_offset;
         copy.bufferRowLength = 0;
         copy.bufferImageHeight = 0;
         copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, (uint32_t) level, (uint32_t) layer, 1 };
@@ -1515,10 +1467,8 @@ namespace Viry3D
         m_format(VK_FORMAT_UNDEFINED),
         m_image(VK_NULL_HANDLE),
         m_image_view(VK_NULL_HANDLE),
-        m_memory(VK_NULL_HANDLE),
         m_image_multi_sample(VK_NULL_HANDLE),
         m_image_view_multi_sample(VK_NULL_HANDLE),
-        m_memory_multi_sample(VK_NULL_HANDLE),
         m_sampler(VK_NULL_HANDLE),
         m_is_storage(false),
 #elif VR_GLES
@@ -1540,10 +1490,7 @@ namespace Viry3D
         m_array_size(1),
         m_sample_count(1)
     {
-#if VR_VULKAN
-        Memory::Zero(&m_memory_info, sizeof(m_memory_info));
-        Memory::Zero(&m_memory_info_multi_sample, sizeof(m_memory_info_multi_sample));
-#endif
+
     }
 
     Texture::~Texture()
@@ -1554,11 +1501,6 @@ namespace Viry3D
         // All submitted commands that refer to image, either directly or via a VkImageView, must have completed execution
         Display::Instance()->WaitDevice();
 
-        if (m_image_buffer)
-        {
-            m_image_buffer->Destroy(device);
-            m_image_buffer.reset();
-        }
         if (m_sampler)
         {
             vkDestroySampler(device, m_sampler, nullptr);
@@ -1567,11 +1509,11 @@ namespace Viry3D
         {
             vkDestroyImage(device, m_image_multi_sample, nullptr);
             vkDestroyImageView(device, m_image_view_multi_sample, nullptr);
-            vkFreeMemory(device, m_memory_multi_sample, nullptr);
+            Display::Instance()->FreeMemory(m_memory_multi_sample);
         }
         vkDestroyImage(device, m_image, nullptr);
         vkDestroyImageView(device, m_image_view, nullptr);
-        vkFreeMemory(device, m_memory, nullptr);
+        Display::Instance()->FreeMemory(m_memory);
 #elif VR_GLES
         if (m_texture)
         {
@@ -20,6 +20,7 @@
 #include "Object.h"
 #include "Display.h"
 #include "Image.h"
+#include "MemoryAllocator.h"
 #include "thread/ThreadPool.h"
 
 namespace Viry3D
@@ -197,7 +198,7 @@ namespace Viry3D
     private:
 #if VR_VULKAN
         void CopyBufferToImageBegin();
-        void CopyBufferToImage(const Ref<BufferObject>& image_buffer, int x, int y, int w, int h, int face, int level);
+        void CopyBufferToImage(const ByteBuffer& pixels, int x, int y, int w, int h, int face, int level);
         void CopyBufferToImageEnd();
 #elif VR_GLES
         static Ref<Texture> CreateTexture(
@@ -222,14 +223,11 @@ namespace Viry3D
         VkFormat m_format;
         VkImage m_image;
         VkImageView m_image_view;
-        VkDeviceMemory m_memory;
-        VkMemoryAllocateInfo m_memory_info;
+        MemoryAllocation m_memory;
         VkImage m_image_multi_sample;
         VkImageView m_image_view_multi_sample;
-        VkDeviceMemory m_memory_multi_sample;
-        VkMemoryAllocateInfo m_memory_info_multi_sample;
+        MemoryAllocation m_memory_multi_sample;
         VkSampler m_sampler;
-        Ref<BufferObject> m_image_buffer;
         bool m_is_storage;
 #elif VR_GLES
         GLuint m_texture;
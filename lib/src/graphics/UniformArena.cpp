@@ -0,0 +1,120 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "UniformArena.h"
+
+#if VR_VULKAN
+
+#include "BufferObject.h"
+#include "math/Mathf.h"
+
+#define UNIFORM_ARENA_PAGE_SIZE (256 * 1024)
+
+namespace Viry3D
+{
+    UniformArena::UniformArena(int alignment):
+        m_alignment(Mathf::Max(alignment, 1))
+    {
+
+    }
+
+    UniformArena::~UniformArena()
+    {
+        VkDevice device = Display::Instance()->GetDevice();
+
+        for (int i = 0; i < m_pages.Size(); ++i)
+        {
+            m_pages[i].buffer->Destroy(device);
+        }
+        m_pages.Clear();
+        m_free_slots.Clear();
+    }
+
+    int UniformArena::GetAlignedSize(int size) const
+    {
+        return (size + m_alignment - 1) / m_alignment * m_alignment;
+    }
+
+    void UniformArena::Allocate(int size, Ref<BufferObject>& buffer, int* offset)
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+
+        int aligned_size = this->GetAlignedSize(size);
+
+        Vector<Slot>* slots = nullptr;
+        if (m_free_slots.TryGet(aligned_size, &slots) && slots->Size() > 0)
+        {
+            const Slot& slot = (*slots)[slots->Size() - 1];
+            buffer = slot.buffer;
+            *offset = slot.offset;
+            slots->Remove(slots->Size() - 1);
+            return;
+        }
+
+        Page* page = nullptr;
+        if (m_pages.Size() > 0)
+        {
+            Page& last = m_pages[m_pages.Size() - 1];
+            if (last.used + aligned_size <= last.buffer->GetSize())
+            {
+                page = &last;
+            }
+        }
+
+        if (page == nullptr)
+        {
+            Page new_page;
+            new_page.buffer = Display::Instance()->CreateBuffer(
+                nullptr,
+                Mathf::Max(aligned_size, UNIFORM_ARENA_PAGE_SIZE),
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                true,
+                VK_FORMAT_UNDEFINED);
+            new_page.used = 0;
+            m_pages.Add(new_page);
+
+            page = &m_pages[m_pages.Size() - 1];
+        }
+
+        buffer = page->buffer;
+        *offset = page->used;
+        page->used += aligned_size;
+    }
+
+    void UniformArena::Free(const Ref<BufferObject>& buffer, int offset, int size)
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+
+        int aligned_size = this->GetAlignedSize(size);
+
+        Slot slot;
+        slot.buffer = buffer;
+        slot.offset = offset;
+
+        Vector<Slot>* slots = nullptr;
+        if (m_free_slots.TryGet(aligned_size, &slots))
+        {
+            slots->Add(slot);
+        }
+        else
+        {
+            m_free_slots.Add(aligned_size, Vector<Slot>({ slot }));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,65 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Display.h"
+
+#if VR_VULKAN
+
+#include "container/Vector.h"
+#include "container/Map.h"
+#include "thread/ThreadPool.h"
+
+namespace Viry3D
+{
+    // uniform blocks of all materials share a few large device local buffers,
+    // a block is referenced by buffer and offset and written through Display::QueueUpdateBuffer
+    class UniformArena
+    {
+    public:
+        UniformArena(int alignment);
+        ~UniformArena();
+        void Allocate(int size, Ref<BufferObject>& buffer, int* offset);
+        void Free(const Ref<BufferObject>& buffer, int offset, int size);
+        int GetPageCount() const { return m_pages.Size(); }
+
+    private:
+        struct Page
+        {
+            Ref<BufferObject> buffer;
+            int used;
+        };
+
+        struct Slot
+        {
+            Ref<BufferObject> buffer;
+            int offset;
+        };
+
+        int GetAlignedSize(int size) const;
+
+    private:
+        int m_alignment;
+        Vector<Page> m_pages;
+        // freed blocks by aligned size, blocks come in few distinct sizes so no coalescing is needed
+        Map<int, Vector<Slot>> m_free_slots;
+        Mutex m_mutex;
+    };
+}
+
+#endif
@@ -39,7 +39,13 @@ namespace Viry3D
         int stage;
         Vector<UniformMember> members;
         int size;
+        // page of the uniform arena holding this block, shared with other blocks
         Ref<BufferObject> buffer;
+        int offset = 0;
+        // cpu copy of the block, the dirty range is uploaded once per update
+        Vector<byte> data;
+        int dirty_begin = 0;
+        int dirty_end = 0;
     };
 
     struct UniformTexture
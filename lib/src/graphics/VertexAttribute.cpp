@@ -16,6 +16,9 @@
 */
 
 #include "VertexAttribute.h"
+#include "Debug.h"
+#include "memory/Memory.h"
+#include "math/Mathf.h"
 
 namespace Viry3D
 {
@@ -39,4 +42,273 @@ namespace Viry3D
     {
         0, 12, 28, 36, 44, 56, 72, 88
     };
+
+    const int VERTEX_FORMAT_SIZES[(int) VertexFormat::Count] =
+    {
+        4, 8, 12, 16, 4, 8, 4, 4, 4
+    };
+
+    const int VERTEX_FORMAT_COMPONENTS[(int) VertexFormat::Count] =
+    {
+        1, 2, 3, 4, 2, 4, 4, 4, 4
+    };
+
+    // round to nearest, denormals flush to zero, out of range and nan become infinity
+    static unsigned short FloatToHalf(float value)
+    {
+        unsigned int f;
+        Memory::Copy(&f, &value, sizeof(f));
+
+        unsigned int sign = (f >> 16) & 0x8000;
+        int exponent = (int) ((f >> 23) & 0xff) - 127 + 15;
+        unsigned int mantissa = f & 0x7fffff;
+
+        if (exponent <= 0)
+        {
+            return (unsigned short) sign;
+        }
+        if (exponent >= 31)
+        {
+            return (unsigned short) (sign | 0x7c00);
+        }
+
+        unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+        if (mantissa & 0x1000)
+        {
+            half += 1;
+        }
+
+        return (unsigned short) half;
+    }
+
+    static void WriteVertexAttribute(byte* dest, VertexFormat format, const float* src, int src_count)
+    {
+        float values[4] = { 0, 0, 0, 0 };
+        for (int i = 0; i < src_count && i < 4; ++i)
+        {
+            values[i] = src[i];
+        }
+
+        switch (format)
+        {
+        case VertexFormat::Float:
+        case VertexFormat::Float2:
+        case VertexFormat::Float3:
+        case VertexFormat::Float4:
+            Memory::Copy(dest, values, VERTEX_FORMAT_SIZES[(int) format]);
+            break;
+        case VertexFormat::Half2:
+        case VertexFormat::Half4:
+        {
+            unsigned short* half = (unsigned short*) dest;
+            for (int i = 0; i < VERTEX_FORMAT_COMPONENTS[(int) format]; ++i)
+            {
+                half[i] = FloatToHalf(values[i]);
+            }
+            break;
+        }
+        case VertexFormat::Snorm8x4:
+            for (int i = 0; i < 4; ++i)
+            {
+                float v = Mathf::Clamp(values[i], -1.0f, 1.0f) * 127.0f;
+                ((signed char*) dest)[i] = (signed char) (v < 0 ? v - 0.5f : v + 0.5f);
+            }
+            break;
+        case VertexFormat::Unorm8x4:
+            for (int i = 0; i < 4; ++i)
+            {
+                dest[i] = (byte) (Mathf::Clamp(values[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+            break;
+        case VertexFormat::Uint8x4:
+            for (int i = 0; i < 4; ++i)
+            {
+                dest[i] = (byte) (Mathf::Clamp(values[i], 0.0f, 255.0f) + 0.5f);
+            }
+            break;
+        default:
+            assert(!"invalid vertex format");
+            break;
+        }
+    }
+
+    static VertexLayout CreateDefaultLayout()
+    {
+        VertexLayout layout;
+        layout.AddAttribute(VertexAttributeType::Vertex, VertexFormat::Float3);
+        layout.AddAttribute(VertexAttributeType::Color, VertexFormat::Float4);
+        layout.AddAttribute(VertexAttributeType::Texcoord, VertexFormat::Float2);
+        layout.AddAttribute(VertexAttributeType::Texcoord2, VertexFormat::Float2);
+        layout.AddAttribute(VertexAttributeType::Normal, VertexFormat::Float3);
+        layout.AddAttribute(VertexAttributeType::Tangent, VertexFormat::Float4);
+        layout.AddAttribute(VertexAttributeType::BlendWeight, VertexFormat::Float4);
+        layout.AddAttribute(VertexAttributeType::BlendIndices, VertexFormat::Float4);
+        return layout;
+    }
+
+    const VertexLayout& VertexLayout::Default()
+    {
+        static VertexLayout s_layout = CreateDefaultLayout();
+        return s_layout;
+    }
+
+    VertexLayout VertexLayout::Compact(int attribute_mask)
+    {
+        // half float vertex attributes are optional before gles 3
+#if VR_VULKAN
+        return Compact(attribute_mask, true);
+#else
+        return Compact(attribute_mask, false);
+#endif
+    }
+
+    VertexLayout VertexLayout::Compact(int attribute_mask, bool half_float)
+    {
+        const VertexFormat half4 = half_float ? VertexFormat::Half4 : VertexFormat::Float4;
+        const VertexFormat formats[(int) VertexAttributeType::Count] =
+        {
+            VertexFormat::Float3,
+            VertexFormat::Unorm8x4,
+            // tiled uvs and lightmap uvs on large atlases need full precision
+            VertexFormat::Float2,
+            VertexFormat::Float2,
+            VertexFormat::Snorm8x4,
+            VertexFormat::Snorm8x4,
+            half4,
+            VertexFormat::Uint8x4,
+        };
+
+        VertexLayout layout;
+        layout.AddAttribute(VertexAttributeType::Vertex, formats[0], 0);
+
+        for (int i = 1; i < (int) VertexAttributeType::Count; ++i)
+        {
+            if (attribute_mask & GetAttributeMask((VertexAttributeType) i))
+            {
+                layout.AddAttribute((VertexAttributeType) i, formats[i], 1);
+            }
+        }
+
+        return layout;
+    }
+
+    VertexLayout::VertexLayout():
+        m_stream_count(0)
+    {
+        for (int i = 0; i < VERTEX_STREAM_MAX; ++i)
+        {
+            m_strides[i] = 0;
+        }
+    }
+
+    void VertexLayout::AddAttribute(VertexAttributeType type, VertexFormat format, int stream)
+    {
+        assert(stream >= 0 && stream < VERTEX_STREAM_MAX);
+        assert(this->GetAttribute(type) == nullptr);
+
+        VertexLayoutAttribute attribute;
+        attribute.type = type;
+        attribute.format = format;
+        attribute.stream = stream;
+        attribute.offset = m_strides[stream];
+        m_attributes.Add(attribute);
+
+        m_strides[stream] += VERTEX_FORMAT_SIZES[(int) format];
+        m_stream_count = Mathf::Max(m_stream_count, stream + 1);
+    }
+
+    const VertexLayoutAttribute* VertexLayout::GetAttribute(VertexAttributeType type) const
+    {
+        for (int i = 0; i < m_attributes.Size(); ++i)
+        {
+            if (m_attributes[i].type == type)
+            {
+                return &m_attributes[i];
+            }
+        }
+        return nullptr;
+    }
+
+    int VertexLayout::GetVertexSize() const
+    {
+        int size = 0;
+        for (int i = 0; i < m_stream_count; ++i)
+        {
+            size += m_strides[i];
+        }
+        return size;
+    }
+
+    int VertexLayout::GetStreamOffset(int stream, int vertex_capacity) const
+    {
+        int offset = 0;
+        for (int i = 0; i < stream; ++i)
+        {
+            offset += m_strides[i] * vertex_capacity;
+        }
+        return offset;
+    }
+
+    bool VertexLayout::IsSupported() const
+    {
+#if VR_GLES
+        for (const auto& i : m_attributes)
+        {
+            if (i.format == VertexFormat::Half2 || i.format == VertexFormat::Half4)
+            {
+                return false;
+            }
+        }
+#endif
+        return true;
+    }
+
+    void VertexLayout::Pack(const Vector<Vertex>& vertices, int vertex_capacity, Vector<byte>& data) const
+    {
+        assert(vertices.Size() <= vertex_capacity);
+
+        data.Resize(this->GetVertexSize() * vertex_capacity);
+
+        if (*this == VertexLayout::Default())
+        {
+            Memory::Copy(data.Bytes(), vertices.Bytes(), vertices.SizeInBytes());
+            return;
+        }
+
+        for (int i = 0; i < m_attributes.Size(); ++i)
+        {
+            const auto& attribute = m_attributes[i];
+            int stride = m_strides[attribute.stream];
+            int src_offset = VERTEX_ATTR_OFFSETS[(int) attribute.type];
+            int src_count = VERTEX_ATTR_SIZES[(int) attribute.type] / 4;
+            byte* dest = data.Bytes(this->GetStreamOffset(attribute.stream, vertex_capacity) + attribute.offset);
+
+            for (int j = 0; j < vertices.Size(); ++j)
+            {
+                const float* src = (const float*) ((const byte*) &vertices[j] + src_offset);
+                WriteVertexAttribute(dest, attribute.format, src, src_count);
+                dest += stride;
+            }
+        }
+    }
+
+    bool VertexLayout::operator ==(const VertexLayout& layout) const
+    {
+        if (m_stream_count != layout.m_stream_count || m_attributes.Size() != layout.m_attributes.Size())
+        {
+            return false;
+        }
+
+        for (int i = 0; i < m_attributes.Size(); ++i)
+        {
+            const auto& a = m_attributes[i];
+            const auto& b = layout.m_attributes[i];
+            if (a.type != b.type || a.format != b.format || a.stream != b.stream || a.offset != b.offset)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
 }
@@ -21,6 +21,9 @@
 #include "math/Vector2.h"
 #include "math/Vector3.h"
 #include "math/Vector4.h"
+#include "container/Vector.h"
+
+#define VERTEX_STREAM_MAX 4
 
 namespace Viry3D
 {
@@ -70,4 +73,66 @@ namespace Viry3D
         int location;
         int vector_size;
     };
+
+    // all formats read as float vectors in shaders
+    enum class VertexFormat
+    {
+        Float,
+        Float2,
+        Float3,
+        Float4,
+        Half2,
+        Half4,
+        // xyz in [-1, 1], w padding
+        Snorm8x4,
+        // [0, 1]
+        Unorm8x4,
+        // integer values 0 - 255, not normalized
+        Uint8x4,
+
+        Count
+    };
+
+    extern const int VERTEX_FORMAT_SIZES[(int) VertexFormat::Count];
+    extern const int VERTEX_FORMAT_COMPONENTS[(int) VertexFormat::Count];
+
+    struct VertexLayoutAttribute
+    {
+        VertexAttributeType type;
+        VertexFormat format;
+        int stream;
+        int offset;
+    };
+
+    // describes how vertices are stored in a vertex buffer,
+    // streams are stored one after another in the same buffer, each interleaved with its own stride
+    class VertexLayout
+    {
+    public:
+        // every attribute as float in one stream, same memory as Vertex
+        static const VertexLayout& Default();
+        // attributes in attribute_mask only, position in stream 0 and the others in stream 1
+        static VertexLayout Compact(int attribute_mask);
+        static VertexLayout Compact(int attribute_mask, bool half_float);
+        static int GetAttributeMask(VertexAttributeType type) { return 1 << (int) type; }
+        VertexLayout();
+        void AddAttribute(VertexAttributeType type, VertexFormat format, int stream = 0);
+        const Vector<VertexLayoutAttribute>& GetAttributes() const { return m_attributes; }
+        const VertexLayoutAttribute* GetAttribute(VertexAttributeType type) const;
+        int GetStreamCount() const { return m_stream_count; }
+        int GetStride(int stream) const { return m_strides[stream]; }
+        int GetVertexSize() const;
+        int GetStreamOffset(int stream, int vertex_capacity) const;
+        // false if the layout uses formats the current graphics api can not read
+        bool IsSupported() const;
+        // packs vertices into buffer data holding vertex_capacity vertices
+        void Pack(const Vector<Vertex>& vertices, int vertex_capacity, Vector<byte>& data) const;
+        bool operator ==(const VertexLayout& layout) const;
+        bool operator !=(const VertexLayout& layout) const { return !(*this == layout); }
+
+    private:
+        Vector<VertexLayoutAttribute> m_attributes;
+        int m_strides[VERTEX_STREAM_MAX];
+        int m_stream_count;
+    };
 }
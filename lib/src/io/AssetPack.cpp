@@ -0,0 +1,372 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "AssetPack.h"
+#include "File.h"
+#include "Directory.h"
+#include "Debug.h"
+#include "memory/Memory.h"
+#include "zlib/zlib.h"
+#include <algorithm>
+#include <fstream>
+
+#define ASSET_PACK_MAGIC "VPAK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 16
+
+namespace Viry3D
+{
+    // data of the entries follows the header, the entry index and names are at the end
+    struct AssetPackHeader
+    {
+        char magic[4];
+        int version;
+        int entry_count;
+        int index_offset;
+        int names_offset;
+        int names_size;
+    };
+
+    struct MountedPack
+    {
+        String pack_path;
+        String mount_path;
+        Ref<AssetPack> pack;
+    };
+
+    static Vector<MountedPack> g_mounted_packs;
+    static Mutex g_mount_mutex;
+
+    static String NormalizePath(const String& path)
+    {
+        return path.Replace("\\", "/");
+    }
+
+    uint64_t AssetPack::HashPath(const String& path)
+    {
+        // fnv-1a
+        uint64_t hash = 14695981039346656037ULL;
+        for (int i = 0; i < path.Size(); ++i)
+        {
+            hash ^= (byte) path[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    static void WritePadding(std::ofstream& os, int& offset)
+    {
+        static const char zeros[ASSET_PACK_ALIGNMENT] = { 0 };
+        int padding = (ASSET_PACK_ALIGNMENT - offset % ASSET_PACK_ALIGNMENT) % ASSET_PACK_ALIGNMENT;
+        os.write(zeros, padding);
+        offset += padding;
+    }
+
+    bool AssetPack::Build(const String& directory, const String& pack_path, bool compress)
+    {
+        String dir = NormalizePath(directory);
+        Vector<String> files = Directory::GetFiles(dir, true);
+
+        std::ofstream os(pack_path.CString(), std::ios::binary);
+        if (!os)
+        {
+            Log("can not create asset pack: %s", pack_path.CString());
+            return false;
+        }
+
+        AssetPackHeader header;
+        Memory::Zero(&header, sizeof(header));
+        os.write((const char*) &header, sizeof(header));
+        int offset = sizeof(header);
+
+        Vector<Entry> entries;
+        String names;
+
+        for (const auto& i : files)
+        {
+            // the pack itself may be written into the packed directory
+            if (NormalizePath(i) == NormalizePath(pack_path))
+            {
+                continue;
+            }
+
+            String name = NormalizePath(i).Substring(dir.Size() + 1);
+            ByteBuffer data = File::ReadAllBytes(i);
+
+            Entry entry;
+            entry.hash = HashPath(name);
+            entry.name_offset = names.Size();
+            entry.name_size = name.Size();
+            entry.size = data.Size();
+            entry.compressed_size = data.Size();
+            entry.compression = (int) Compression::None;
+            names += name;
+
+            ByteBuffer stored = data;
+            ByteBuffer compressed;
+
+            if (compress && data.Size() > 0)
+            {
+                uLongf compressed_size = compressBound(data.Size());
+                compressed = ByteBuffer((int) compressed_size);
+                int err = compress2(compressed.Bytes(), &compressed_size, data.Bytes(), data.Size(), Z_BEST_COMPRESSION);
+
+                // keep data that does not shrink by an eighth uncompressed, it can be used in place
+                if (err == Z_OK && (int) compressed_size < data.Size() - data.Size() / 8)
+                {
+                    stored = ByteBuffer(compressed.Bytes(), (int) compressed_size);
+                    entry.compressed_size = (int) compressed_size;
+                    entry.compression = (int) Compression::Zlib;
+                }
+            }
+
+            WritePadding(os, offset);
+            entry.offset = offset;
+            os.write((const char*) stored.Bytes(), stored.Size());
+            offset += stored.Size();
+
+            entries.Add(entry);
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return a.hash < b.hash;
+        });
+
+        WritePadding(os, offset);
+        header.index_offset = offset;
+        os.write((const char*) entries.Bytes(), entries.SizeInBytes());
+        offset += entries.SizeInBytes();
+
+        header.names_offset = offset;
+        header.names_size = names.Size();
+        os.write(names.CString(), names.Size());
+
+        Memory::Copy(header.magic, ASSET_PACK_MAGIC, 4);
+        header.version = ASSET_PACK_VERSION;
+        header.entry_count = entries.Size();
+        os.seekp(0);
+        os.write((const char*) &header, sizeof(header));
+
+        bool success = !os.fail();
+        os.close();
+
+        return success;
+    }
+
+    Ref<AssetPack> AssetPack::Open(const String& path)
+    {
+        Ref<MappedFile> file = MappedFile::Open(path);
+        if (!file)
+        {
+            Log("asset pack not exist: %s", path.CString());
+            return Ref<AssetPack>();
+        }
+
+        const AssetPackHeader* header = (const AssetPackHeader*) file->GetData();
+        if (file->GetSize() < (int) sizeof(AssetPackHeader) ||
+            Memory::Compare(header->magic, ASSET_PACK_MAGIC, 4) != 0 ||
+            header->version != ASSET_PACK_VERSION ||
+            // in size_t so a huge entry count can not overflow past the bounds check
+            header->entry_count < 0 ||
+            (size_t) header->entry_count > ((size_t) file->GetSize() - sizeof(AssetPackHeader)) / sizeof(Entry) ||
+            header->index_offset < 0 || (size_t) header->index_offset > (size_t) file->GetSize() - (size_t) header->entry_count * sizeof(Entry) ||
+            header->names_offset < 0 || header->names_size < 0 || header->names_offset > file->GetSize() - header->names_size)
+        {
+            Log("invalid asset pack: %s", path.CString());
+            return Ref<AssetPack>();
+        }
+
+        Ref<AssetPack> pack = RefMake<AssetPack>();
+        pack->SetName(path);
+        pack->m_file = file;
+        pack->m_entries = (const Entry*) &file->GetData()[header->index_offset];
+        pack->m_entry_count = header->entry_count;
+        pack->m_names = (const char*) &file->GetData()[header->names_offset];
+        pack->m_names_size = header->names_size;
+
+        return pack;
+    }
+
+    const AssetPack::Entry* AssetPack::FindEntry(const String& name) const
+    {
+        uint64_t hash = HashPath(name);
+
+        const Entry* end = m_entries + m_entry_count;
+        const Entry* entry = std::lower_bound(m_entries, end, hash, [](const Entry& a, uint64_t b) {
+            return a.hash < b;
+        });
+
+        // names with the same hash are next to each other
+        for (; entry != end && entry->hash == hash; ++entry)
+        {
+            if (entry->name_size == name.Size() &&
+                entry->name_offset >= 0 && entry->name_offset <= m_names_size - entry->name_size &&
+                Memory::Compare(&m_names[entry->name_offset], name.CString(), name.Size()) == 0)
+            {
+                return entry;
+            }
+        }
+
+        return nullptr;
+    }
+
+    String AssetPack::GetEntryName(const Entry* entry) const
+    {
+        return String(&m_names[entry->name_offset], entry->name_size);
+    }
+
+    Ref<MappedFile> AssetPack::OpenEntry(const Entry* entry) const
+    {
+        if (entry->offset < 0 || entry->compressed_size < 0 || entry->offset > m_file->GetSize() - entry->compressed_size)
+        {
+            Log("invalid asset pack entry: %s", this->GetEntryName(entry).CString());
+            return Ref<MappedFile>();
+        }
+
+        if (entry->compression == (int) Compression::None)
+        {
+            if (entry->size != entry->compressed_size)
+            {
+                Log("invalid asset pack entry: %s", this->GetEntryName(entry).CString());
+                return Ref<MappedFile>();
+            }
+
+            return MappedFile::CreateView(m_file, entry->offset, entry->size);
+        }
+        else if (entry->compression == (int) Compression::Zlib)
+        {
+            if (entry->size < 0)
+            {
+                Log("invalid asset pack entry: %s", this->GetEntryName(entry).CString());
+                return Ref<MappedFile>();
+            }
+
+            ByteBuffer buffer(entry->size);
+            uLongf size = entry->size;
+            int err = uncompress(buffer.Bytes(), &size, &m_file->GetData()[entry->offset], entry->compressed_size);
+            if (err != Z_OK || (int) size != entry->size)
+            {
+                Log("asset pack entry uncompress failed: %s", this->GetEntryName(entry).CString());
+                return Ref<MappedFile>();
+            }
+
+            return MappedFile::CreateFromBuffer(buffer);
+        }
+
+        Log("asset pack entry compression not support: %s", this->GetEntryName(entry).CString());
+        return Ref<MappedFile>();
+    }
+
+    bool AssetPack::Mount(const String& pack_path, const String& mount_path)
+    {
+        Ref<AssetPack> pack = AssetPack::Open(pack_path);
+        if (!pack)
+        {
+            return false;
+        }
+
+        MountedPack mounted;
+        mounted.pack_path = pack_path;
+        mounted.mount_path = NormalizePath(mount_path);
+        mounted.pack = pack;
+
+        if (!mounted.mount_path.EndsWith("/"))
+        {
+            mounted.mount_path += "/";
+        }
+
+        std::lock_guard<Mutex> lock(g_mount_mutex);
+        g_mounted_packs.Add(mounted);
+
+        return true;
+    }
+
+    void AssetPack::Unmount(const String& pack_path)
+    {
+        std::lock_guard<Mutex> lock(g_mount_mutex);
+
+        for (int i = g_mounted_packs.Size() - 1; i >= 0; --i)
+        {
+            if (g_mounted_packs[i].pack_path == pack_path)
+            {
+                g_mounted_packs.Remove(i);
+            }
+        }
+    }
+
+    bool AssetPack::FindMounted(const String& path, Ref<AssetPack>* pack, const Entry** entry)
+    {
+        std::lock_guard<Mutex> lock(g_mount_mutex);
+
+        if (g_mounted_packs.Empty())
+        {
+            return false;
+        }
+
+        String normalized = NormalizePath(path);
+
+        for (int i = g_mounted_packs.Size() - 1; i >= 0; --i)
+        {
+            const auto& mounted = g_mounted_packs[i];
+
+            if (normalized.StartsWith(mounted.mount_path))
+            {
+                const Entry* found = mounted.pack->FindEntry(normalized.Substring(mounted.mount_path.Size()));
+                if (found)
+                {
+                    *pack = mounted.pack;
+                    *entry = found;
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    bool AssetPack::Exist(const String& path)
+    {
+        Ref<AssetPack> pack;
+        const Entry* entry = nullptr;
+        return FindMounted(path, &pack, &entry);
+    }
+
+    bool AssetPack::ReadAllBytes(const String& path, ByteBuffer& buffer)
+    {
+        Ref<MappedFile> file = AssetPack::OpenFile(path);
+        if (file)
+        {
+            buffer = ByteBuffer(file->GetSize());
+            Memory::Copy(buffer.Bytes(), file->GetData(), file->GetSize());
+            return true;
+        }
+
+        return false;
+    }
+
+    Ref<MappedFile> AssetPack::OpenFile(const String& path)
+    {
+        Ref<AssetPack> pack;
+        const Entry* entry = nullptr;
+        if (FindMounted(path, &pack, &entry))
+        {
+            return pack->OpenEntry(entry);
+        }
+
+        return Ref<MappedFile>();
+    }
+}
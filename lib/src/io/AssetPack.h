@@ -0,0 +1,79 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Object.h"
+#include "MappedFile.h"
+#include "container/Vector.h"
+#include "thread/ThreadPool.h"
+#include <stdint.h>
+
+namespace Viry3D
+{
+    // read only archive of many files in one memory mapped file,
+    // entries are found by binary search on a path hash index sorted at build time
+    class AssetPack : public Object
+    {
+    public:
+        enum class Compression
+        {
+            None = 0,
+            Zlib = 1,
+        };
+
+        struct Entry
+        {
+            uint64_t hash;
+            int name_offset;
+            int name_size;
+            int offset;
+            int size;
+            int compressed_size;
+            int compression;
+        };
+
+    public:
+        // packs every file under directory with paths relative to it,
+        // entries are stored compressed when compress is set and it saves enough space
+        static bool Build(const String& directory, const String& pack_path, bool compress);
+        static Ref<AssetPack> Open(const String& path);
+        // reads of files under mount_path are served from the pack before the file system,
+        // packs mounted later are searched first
+        static bool Mount(const String& pack_path, const String& mount_path);
+        static void Unmount(const String& pack_path);
+        static bool Exist(const String& path);
+        static bool ReadAllBytes(const String& path, ByteBuffer& buffer);
+        static Ref<MappedFile> OpenFile(const String& path);
+        static uint64_t HashPath(const String& path);
+        int GetEntryCount() const { return m_entry_count; }
+        const Entry* FindEntry(const String& name) const;
+        String GetEntryName(const Entry* entry) const;
+        // uncompressed entries are views into the pack mapping
+        Ref<MappedFile> OpenEntry(const Entry* entry) const;
+
+    private:
+        static bool FindMounted(const String& path, Ref<AssetPack>* pack, const Entry** entry);
+
+    private:
+        Ref<MappedFile> m_file;
+        const Entry* m_entries;
+        int m_entry_count;
+        const char* m_names;
+        int m_names_size;
+    };
+}
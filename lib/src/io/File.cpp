@@ -17,12 +17,15 @@
 
 #include "File.h"
 #include "Directory.h"
+#include "AssetPack.h"
 #include "Debug.h"
 #include "zlib/unzip.h"
 #include <fstream>
 
 #if VR_WINDOWS
 #include <Windows.h>
+#elif !VR_UWP
+#include <sys/stat.h>
 #endif
 
 namespace Viry3D
@@ -34,11 +37,22 @@ namespace Viry3D
 
     bool File::Exist(const String& path)
     {
+        if (AssetPack::Exist(path))
+        {
+            return true;
+        }
+
         return FileExist(path);
     }
 
     ByteBuffer File::ReadAllBytes(const String& path)
     {
+        ByteBuffer buffer;
+        if (AssetPack::ReadAllBytes(path, buffer))
+        {
+            return buffer;
+        }
+
         return FileReadAllBytes(path);
     }
 
@@ -49,22 +63,30 @@ namespace Viry3D
 #else
     bool File::Exist(const String& path)
     {
-        std::ifstream is(path.CString(), std::ios::binary);
-
-        bool exist = !(!is);
-
-        if (exist)
+        if (AssetPack::Exist(path))
         {
-            is.close();
+            return true;
         }
 
-        return exist;
+        // query attributes only, opening the file is much slower on some storage
+#if VR_WINDOWS
+        DWORD attributes = GetFileAttributesA(path.CString());
+        return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+#else
+        struct stat st;
+        return stat(path.CString(), &st) == 0 && S_ISREG(st.st_mode);
+#endif
     }
 
     ByteBuffer File::ReadAllBytes(const String& path)
     {
         ByteBuffer buffer;
 
+        if (AssetPack::ReadAllBytes(path, buffer))
+        {
+            return buffer;
+        }
+
         std::ifstream is(path.CString(), std::ios::binary);
         if (is)
         {
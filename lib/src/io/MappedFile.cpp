@@ -0,0 +1,181 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "MappedFile.h"
+#include "File.h"
+#include "AssetPack.h"
+#include "Debug.h"
+
+#if VR_WINDOWS
+#include <Windows.h>
+#elif !VR_UWP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Viry3D
+{
+    MappedFile::MappedFile():
+        m_data(nullptr),
+        m_size(0),
+        m_mapped(false)
+#if VR_WINDOWS
+        , m_file(INVALID_HANDLE_VALUE)
+        , m_mapping(nullptr)
+#endif
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+#if VR_WINDOWS
+        if (m_mapped)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping)
+        {
+            CloseHandle(m_mapping);
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+        }
+#elif !VR_UWP
+        if (m_mapped)
+        {
+            munmap((void*) m_data, m_size);
+        }
+#endif
+    }
+
+    Ref<MappedFile> MappedFile::Open(const String& path)
+    {
+        Ref<MappedFile> file = AssetPack::OpenFile(path);
+        if (!file)
+        {
+            file = MappedFile::OpenFile(path);
+        }
+        return file;
+    }
+
+    Ref<MappedFile> MappedFile::CreateView(const Ref<MappedFile>& source, int offset, int size)
+    {
+        assert(offset >= 0 && size >= 0 && offset <= source->GetSize() - size);
+
+        Ref<MappedFile> file = RefMake<MappedFile>();
+        file->m_source = source;
+        file->m_data = source->GetData() + offset;
+        file->m_size = size;
+
+        return file;
+    }
+
+    Ref<MappedFile> MappedFile::CreateFromBuffer(const ByteBuffer& buffer)
+    {
+        Ref<MappedFile> file = RefMake<MappedFile>();
+        file->m_buffer = buffer;
+        file->m_data = buffer.Bytes();
+        file->m_size = buffer.Size();
+
+        return file;
+    }
+
+#if VR_WINDOWS
+    Ref<MappedFile> MappedFile::OpenFile(const String& path)
+    {
+        Ref<MappedFile> file = RefMake<MappedFile>();
+
+        file->m_file = CreateFileA(path.CString(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file->m_file == INVALID_HANDLE_VALUE)
+        {
+            return Ref<MappedFile>();
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file->m_file, &size) || size.QuadPart == 0)
+        {
+            return Ref<MappedFile>();
+        }
+
+        file->m_mapping = CreateFileMappingA(file->m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (file->m_mapping == nullptr)
+        {
+            return Ref<MappedFile>();
+        }
+
+        file->m_data = (const byte*) MapViewOfFile(file->m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (file->m_data == nullptr)
+        {
+            return Ref<MappedFile>();
+        }
+        file->m_size = (int) size.QuadPart;
+        file->m_mapped = true;
+
+        return file;
+    }
+#elif VR_UWP
+    Ref<MappedFile> MappedFile::OpenFile(const String& path)
+    {
+        // no file mapping for app package files, read into memory instead
+        if (!File::Exist(path))
+        {
+            return Ref<MappedFile>();
+        }
+
+        return MappedFile::CreateFromBuffer(File::ReadAllBytes(path));
+    }
+#else
+    Ref<MappedFile> MappedFile::OpenFile(const String& path)
+    {
+        int fd = open(path.CString(), O_RDONLY);
+        if (fd < 0)
+        {
+            return Ref<MappedFile>();
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            close(fd);
+            return Ref<MappedFile>();
+        }
+
+        void* data = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps the file referenced
+        close(fd);
+
+        if (data == MAP_FAILED)
+        {
+            Log("mmap failed: %s", path.CString());
+            return Ref<MappedFile>();
+        }
+
+        // start paging in now, the whole file is read right after
+        posix_madvise(data, (size_t) st.st_size, POSIX_MADV_WILLNEED);
+
+        Ref<MappedFile> file = RefMake<MappedFile>();
+        file->m_data = (const byte*) data;
+        file->m_size = (int) st.st_size;
+        file->m_mapped = true;
+
+        return file;
+    }
+#endif
+}
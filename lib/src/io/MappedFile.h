@@ -0,0 +1,54 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "string/String.h"
+#include "memory/ByteBuffer.h"
+
+namespace Viry3D
+{
+    // read only view of a whole file, memory mapped where the platform allows,
+    // so file content can go to the gpu upload path without an intermediate copy
+    class MappedFile
+    {
+    public:
+        // files in mounted asset packs are opened from the pack
+        static Ref<MappedFile> Open(const String& path);
+        // a range of another mapped file, which is kept alive by the view
+        static Ref<MappedFile> CreateView(const Ref<MappedFile>& source, int offset, int size);
+        static Ref<MappedFile> CreateFromBuffer(const ByteBuffer& buffer);
+        MappedFile();
+        ~MappedFile();
+        const byte* GetData() const { return m_data; }
+        int GetSize() const { return m_size; }
+
+    private:
+        static Ref<MappedFile> OpenFile(const String& path);
+
+    private:
+        const byte* m_data;
+        int m_size;
+        bool m_mapped;
+        Ref<MappedFile> m_source;
+        ByteBuffer m_buffer;
+#if VR_WINDOWS
+        void* m_file;
+        void* m_mapping;
+#endif
+    };
+}
@@ -16,6 +16,8 @@
 */
 
 #include "Bounds.h"
+#include "Matrix4x4.h"
+#include <math.h>
 
 namespace Viry3D
 {
@@ -37,4 +39,16 @@ namespace Viry3D
 		return !(point.x < m_min.x || point.y < m_min.y || point.z < m_min.z ||
 			point.x > m_max.x || point.y > m_max.y || point.z > m_max.z);
 	}
+
+	Bounds Bounds::Transform(const Matrix4x4& mat) const
+	{
+		Vector3 center = mat.MultiplyPoint3x4(this->GetCenter());
+		Vector3 extents = this->GetExtents();
+		Vector3 world_extents(
+			fabs(mat.m00) * extents.x + fabs(mat.m01) * extents.y + fabs(mat.m02) * extents.z,
+			fabs(mat.m10) * extents.x + fabs(mat.m11) * extents.y + fabs(mat.m12) * extents.z,
+			fabs(mat.m20) * extents.x + fabs(mat.m21) * extents.y + fabs(mat.m22) * extents.z);
+
+		return Bounds(center - world_extents, center + world_extents);
+	}
 }
@@ -21,6 +21,8 @@
 
 namespace Viry3D
 {
+	struct Matrix4x4;
+
 	class Bounds
 	{
 	public:
@@ -28,7 +30,11 @@ namespace Viry3D
 		Bounds(const Vector3& min, const Vector3& max);
 		const Vector3& Min() const { return m_min; }
 		const Vector3& Max() const { return m_max; }
+		Vector3 GetCenter() const { return (m_min + m_max) * 0.5f; }
+		Vector3 GetExtents() const { return (m_max - m_min) * 0.5f; }
 		bool Contains(const Vector3& point) const;
+		// axis aligned bounds enclosing this box after transformed by mat
+		Bounds Transform(const Matrix4x4& mat) const;
 
 	private:
 		Vector3 m_min;
@@ -172,17 +172,39 @@ namespace Viry3D
 
 	ContainsResult Frustum::ContainsBounds(const Vector3& min, const Vector3& max) const
 	{
-		Vector<Vector3> corners(8);
-		corners[0] = max;
-		corners[1] = Vector3(min.x, max.y, max.z);
-		corners[2] = Vector3(max.x, min.y, max.z);
-		corners[3] = Vector3(max.x, max.y, min.z);
-		corners[4] = Vector3(min.x, min.y, max.z);
-		corners[5] = Vector3(min.x, max.y, min.z);
-		corners[6] = Vector3(max.x, min.y, min.z);
-		corners[7] = min;
-
-		return ContainsPoints(corners, nullptr);
+		bool all_in = true;
+
+		for (int i = 0; i < 6; ++i)
+		{
+			const Vector4& plane = m_planes[i];
+
+			// corner farthest along plane normal, and the opposite one
+			Vector3 positive(
+				plane.x >= 0 ? max.x : min.x,
+				plane.y >= 0 ? max.y : min.y,
+				plane.z >= 0 ? max.z : min.z);
+			Vector3 negative(
+				plane.x >= 0 ? min.x : max.x,
+				plane.y >= 0 ? min.y : max.y,
+				plane.z >= 0 ? min.z : max.z);
+
+			if (DistanceToPlane(positive, i) < 0)
+			{
+				return ContainsResult::Out;
+			}
+
+			if (DistanceToPlane(negative, i) < 0)
+			{
+				all_in = false;
+			}
+		}
+
+		if (!all_in)
+		{
+			return ContainsResult::Cross;
+		}
+
+		return ContainsResult::In;
 	}
 
 	ContainsResult Frustum::ContainsPoints(const Vector<Vector3>& points, const Matrix4x4* matrix) const
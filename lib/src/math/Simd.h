@@ -0,0 +1,104 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VR_SIMD_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VR_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace Viry3D
+{
+    // 4 wide float vector ops on sse, neon or scalar fallback,
+    // loads and stores are unaligned since Vector storage is only aligned by malloc
+#if VR_SIMD_SSE
+    typedef __m128 SimdFloat4;
+#elif VR_SIMD_NEON
+    typedef float32x4_t SimdFloat4;
+#else
+    struct SimdFloat4
+    {
+        float v[4];
+    };
+#endif
+
+    class Simd
+    {
+    public:
+#if VR_SIMD_SSE
+        static SimdFloat4 Load(const float* p) { return _mm_loadu_ps(p); }
+        static void Store(float* p, SimdFloat4 a) { _mm_storeu_ps(p, a); }
+        static SimdFloat4 Set(float v) { return _mm_set1_ps(v); }
+        static SimdFloat4 Add(SimdFloat4 a, SimdFloat4 b) { return _mm_add_ps(a, b); }
+        static SimdFloat4 Sub(SimdFloat4 a, SimdFloat4 b) { return _mm_sub_ps(a, b); }
+        static SimdFloat4 Mul(SimdFloat4 a, SimdFloat4 b) { return _mm_mul_ps(a, b); }
+        // a + b * c
+        static SimdFloat4 MulAdd(SimdFloat4 a, SimdFloat4 b, SimdFloat4 c) { return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+#elif VR_SIMD_NEON
+        static SimdFloat4 Load(const float* p) { return vld1q_f32(p); }
+        static void Store(float* p, SimdFloat4 a) { vst1q_f32(p, a); }
+        static SimdFloat4 Set(float v) { return vdupq_n_f32(v); }
+        static SimdFloat4 Add(SimdFloat4 a, SimdFloat4 b) { return vaddq_f32(a, b); }
+        static SimdFloat4 Sub(SimdFloat4 a, SimdFloat4 b) { return vsubq_f32(a, b); }
+        static SimdFloat4 Mul(SimdFloat4 a, SimdFloat4 b) { return vmulq_f32(a, b); }
+        static SimdFloat4 MulAdd(SimdFloat4 a, SimdFloat4 b, SimdFloat4 c) { return vmlaq_f32(a, b, c); }
+#else
+        static SimdFloat4 Load(const float* p) { return SimdFloat4({ { p[0], p[1], p[2], p[3] } }); }
+        static void Store(float* p, SimdFloat4 a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+        static SimdFloat4 Set(float v) { return SimdFloat4({ { v, v, v, v } }); }
+        static SimdFloat4 Add(SimdFloat4 a, SimdFloat4 b) { return SimdFloat4({ { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }); }
+        static SimdFloat4 Sub(SimdFloat4 a, SimdFloat4 b) { return SimdFloat4({ { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }); }
+        static SimdFloat4 Mul(SimdFloat4 a, SimdFloat4 b) { return SimdFloat4({ { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }); }
+        static SimdFloat4 MulAdd(SimdFloat4 a, SimdFloat4 b, SimdFloat4 c) { return Add(a, Mul(b, c)); }
+#endif
+
+        // out = a + (b - a) * t, count is a multiple of 4
+        static void Lerp(const float* a, const float* b, float t, float* out, int count)
+        {
+            SimdFloat4 t4 = Set(t);
+            for (int i = 0; i < count; i += 4)
+            {
+                SimdFloat4 a4 = Load(&a[i]);
+                Store(&out[i], MulAdd(a4, Sub(Load(&b[i]), a4), t4));
+            }
+        }
+
+        // out = out + a * t, count is a multiple of 4
+        static void MulAdd(const float* a, float t, float* out, int count)
+        {
+            SimdFloat4 t4 = Set(t);
+            for (int i = 0; i < count; i += 4)
+            {
+                Store(&out[i], MulAdd(Load(&out[i]), Load(&a[i]), t4));
+            }
+        }
+
+        // out = a * t, count is a multiple of 4
+        static void Mul(const float* a, float t, float* out, int count)
+        {
+            SimdFloat4 t4 = Set(t);
+            for (int i = 0; i < count; i += 4)
+            {
+                Store(&out[i], Mul(Load(&a[i]), t4));
+            }
+        }
+    };
+}
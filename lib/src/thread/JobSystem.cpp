@@ -0,0 +1,465 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "JobSystem.h"
+#include "math/Mathf.h"
+#include <assert.h>
+
+#define JOB_QUEUE_CAPACITY 4096
+#define JOB_SPIN_COUNT 64
+
+namespace Viry3D
+{
+    // chase lev deque, the owner pushes and pops at the bottom, thieves take from the top
+    class JobQueue
+    {
+    public:
+        JobQueue():
+            m_top(0),
+            m_bottom(0)
+        {
+            for (int i = 0; i < JOB_QUEUE_CAPACITY; ++i)
+            {
+                m_jobs[i] = nullptr;
+            }
+        }
+
+        // owner only, false when full
+        bool Push(Job* job)
+        {
+            int64_t b = m_bottom.load(std::memory_order_relaxed);
+            int64_t t = m_top.load(std::memory_order_acquire);
+            if (b - t >= JOB_QUEUE_CAPACITY)
+            {
+                return false;
+            }
+
+            m_jobs[b & (JOB_QUEUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        // owner only, newest job first
+        Job* Pop()
+        {
+            int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+            m_bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = m_top.load(std::memory_order_relaxed);
+
+            Job* job = nullptr;
+            if (t <= b)
+            {
+                job = m_jobs[b & (JOB_QUEUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+                if (t == b)
+                {
+                    // last job, race thieves for it
+                    if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    {
+                        job = nullptr;
+                    }
+                    m_bottom.store(b + 1, std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+
+            return job;
+        }
+
+        // any thread, oldest job first
+        Job* Steal()
+        {
+            int64_t t = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = m_bottom.load(std::memory_order_acquire);
+
+            if (t < b)
+            {
+                Job* job = m_jobs[t & (JOB_QUEUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+                if (m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    return job;
+                }
+            }
+
+            return nullptr;
+        }
+
+    private:
+        std::atomic<int64_t> m_top;
+        std::atomic<int64_t> m_bottom;
+        std::atomic<Job*> m_jobs[JOB_QUEUE_CAPACITY];
+    };
+
+    static thread_local JobSystem* g_thread_job_system = nullptr;
+    static thread_local JobQueue* g_thread_job_queue = nullptr;
+
+    int JobSystem::GetHardwareWorkerCount()
+    {
+#if VR_WASM
+        return 0;
+#else
+        int core_count = (int) std::thread::hardware_concurrency();
+        return Mathf::Max(core_count - 1, 1);
+#endif
+    }
+
+    JobSystem::JobSystem(int worker_count):
+        m_injected_count(0),
+        m_queued_count(0),
+        m_sleeping_count(0),
+        m_close(false)
+    {
+        m_queues.Resize(worker_count + 1);
+        for (int i = 0; i < m_queues.Size(); ++i)
+        {
+            m_queues[i] = RefMake<JobQueue>();
+        }
+
+        g_thread_job_system = this;
+        g_thread_job_queue = m_queues[0].get();
+
+        m_workers.Resize(worker_count);
+        for (int i = 0; i < m_workers.Size(); ++i)
+        {
+            m_workers[i] = RefMake<std::thread>(&JobSystem::WorkerRun, this, i + 1);
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard<Mutex> lock(m_sleep_mutex);
+            m_close = true;
+            m_condition.notify_all();
+        }
+
+        for (int i = 0; i < m_workers.Size(); ++i)
+        {
+            m_workers[i]->join();
+        }
+        m_workers.Clear();
+
+        if (g_thread_job_system == this)
+        {
+            g_thread_job_system = nullptr;
+            g_thread_job_queue = nullptr;
+        }
+    }
+
+    void JobSystem::WorkerRun(int index)
+    {
+        g_thread_job_system = this;
+        g_thread_job_queue = m_queues[index].get();
+
+        while (true)
+        {
+            Job* job = this->GetJob(g_thread_job_queue);
+
+            // jobs of a frame come in bursts, spin a little before going to sleep
+            for (int i = 0; i < JOB_SPIN_COUNT && job == nullptr; ++i)
+            {
+                std::this_thread::yield();
+                job = this->GetJob(g_thread_job_queue);
+            }
+
+            if (job)
+            {
+                this->Execute(job);
+                continue;
+            }
+
+            if (m_close)
+            {
+                break;
+            }
+
+            std::unique_lock<Mutex> lock(m_sleep_mutex);
+            m_sleeping_count += 1;
+            m_condition.wait(lock, [this]() {
+                return m_queued_count > 0 || m_close;
+            });
+            m_sleeping_count -= 1;
+        }
+
+        g_thread_job_system = nullptr;
+        g_thread_job_queue = nullptr;
+    }
+
+    JobHandle JobSystem::Create(Action func, const JobHandle& parent)
+    {
+        JobHandle job = RefMake<Job>();
+        job->m_func = func;
+
+        if (parent)
+        {
+            assert(!parent->IsFinished());
+
+            parent->m_unfinished += 1;
+            job->m_parent = parent;
+        }
+
+        return job;
+    }
+
+    void JobSystem::AddDependency(const JobHandle& job, const JobHandle& dependency)
+    {
+        assert(!job->m_self);
+
+        std::lock_guard<Mutex> lock(dependency->m_mutex);
+        if (!dependency->IsFinished())
+        {
+            job->m_dependencies += 1;
+            dependency->m_continuations.Add(job);
+        }
+    }
+
+    void JobSystem::Run(const JobHandle& job)
+    {
+        assert(!job->m_self);
+
+        job->m_self = job;
+        if (--job->m_dependencies == 0)
+        {
+            this->Push(job.get());
+        }
+    }
+
+    JobHandle JobSystem::Schedule(Action func, const JobHandle& dependency)
+    {
+        JobHandle job = this->Create(func);
+        if (dependency)
+        {
+            this->AddDependency(job, dependency);
+        }
+        this->Run(job);
+
+        return job;
+    }
+
+    JobHandle JobSystem::Schedule(Action func, const Vector<JobHandle>& dependencies)
+    {
+        JobHandle job = this->Create(func);
+        for (const auto& i : dependencies)
+        {
+            this->AddDependency(job, i);
+        }
+        this->Run(job);
+
+        return job;
+    }
+
+    void JobSystem::Wait(const JobHandle& job)
+    {
+        JobQueue* queue = g_thread_job_system == this ? g_thread_job_queue : nullptr;
+
+        while (!job->IsFinished())
+        {
+            Job* other = this->GetJob(queue);
+            if (other)
+            {
+                this->Execute(other);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    JobHandle JobSystem::ScheduleParallelFor(int count, int grain_size, RangeFunc func, const JobHandle& dependency)
+    {
+        if (grain_size <= 0)
+        {
+            // a few ranges per thread leave room for stealing when ranges cost differently
+            grain_size = Mathf::Max(count / ((m_workers.Size() + 1) * 4), 1);
+        }
+
+        Ref<RangeFunc> range_func = RefMake<RangeFunc>(func);
+        JobHandle root = this->Create(nullptr);
+        WeakRef<Job> weak_root = root;
+
+        root->m_func = [=]() {
+            // the running job keeps itself alive
+            JobHandle self = weak_root.lock();
+            this->SplitRange(self, 0, count, grain_size, range_func);
+        };
+
+        if (dependency)
+        {
+            this->AddDependency(root, dependency);
+        }
+        this->Run(root);
+
+        return root;
+    }
+
+    void JobSystem::ParallelFor(int count, int grain_size, RangeFunc func)
+    {
+        if (count <= 0)
+        {
+            return;
+        }
+
+        this->Wait(this->ScheduleParallelFor(count, grain_size, func));
+    }
+
+    void JobSystem::SplitRange(const JobHandle& root, int begin, int end, int grain_size, const Ref<RangeFunc>& func)
+    {
+        // hand the upper half to thieves and keep splitting the lower half here
+        while (end - begin > grain_size)
+        {
+            int middle = begin + (end - begin) / 2;
+            int split_end = end;
+
+            JobHandle child = this->Create([=]() {
+                this->SplitRange(root, middle, split_end, grain_size, func);
+            }, root);
+            this->Run(child);
+
+            end = middle;
+        }
+
+        if (end > begin)
+        {
+            (*func)(begin, end);
+        }
+    }
+
+    void JobSystem::Push(Job* job)
+    {
+        // without workers nobody else would pick the job up
+        if (m_workers.Empty())
+        {
+            this->Execute(job);
+            return;
+        }
+
+        m_queued_count += 1;
+
+        if (g_thread_job_system == this)
+        {
+            if (!g_thread_job_queue->Push(job))
+            {
+                m_queued_count -= 1;
+                this->Execute(job);
+                return;
+            }
+        }
+        else
+        {
+            std::lock_guard<Mutex> lock(m_injected_mutex);
+            m_injected_jobs.AddLast(job);
+            m_injected_count += 1;
+        }
+
+        if (m_sleeping_count > 0)
+        {
+            std::lock_guard<Mutex> lock(m_sleep_mutex);
+            m_condition.notify_one();
+        }
+    }
+
+    Job* JobSystem::GetJob(JobQueue* own_queue)
+    {
+        Job* job = nullptr;
+
+        if (own_queue)
+        {
+            job = own_queue->Pop();
+        }
+
+        if (job == nullptr && m_injected_count > 0)
+        {
+            std::lock_guard<Mutex> lock(m_injected_mutex);
+            if (!m_injected_jobs.Empty())
+            {
+                job = m_injected_jobs.First();
+                m_injected_jobs.RemoveFirst();
+                m_injected_count -= 1;
+            }
+        }
+
+        if (job == nullptr)
+        {
+            // start at a different victim per thread so thieves spread out
+            int start = (int) (((size_t) own_queue >> 6) % m_queues.Size());
+            for (int i = 0; i < m_queues.Size() && job == nullptr; ++i)
+            {
+                JobQueue* queue = m_queues[(start + i) % m_queues.Size()].get();
+                if (queue != own_queue)
+                {
+                    job = queue->Steal();
+                }
+            }
+        }
+
+        if (job)
+        {
+            m_queued_count -= 1;
+        }
+
+        return job;
+    }
+
+    void JobSystem::Execute(Job* job)
+    {
+        if (job->m_func)
+        {
+            job->m_func();
+            job->m_func = nullptr;
+        }
+
+        this->Finish(job);
+    }
+
+    void JobSystem::Finish(Job* job)
+    {
+        if (--job->m_unfinished > 0)
+        {
+            return;
+        }
+
+        Vector<Ref<Job>> continuations;
+        {
+            std::lock_guard<Mutex> lock(job->m_mutex);
+            continuations = std::move(job->m_continuations);
+        }
+
+        for (const auto& i : continuations)
+        {
+            if (--i->m_dependencies == 0)
+            {
+                this->Push(i.get());
+            }
+        }
+
+        if (job->m_parent)
+        {
+            JobHandle parent = std::move(job->m_parent);
+            this->Finish(parent.get());
+        }
+
+        // may release the last reference
+        JobHandle self = std::move(job->m_self);
+    }
+}
@@ -0,0 +1,100 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "ThreadPool.h"
+#include <atomic>
+
+namespace Viry3D
+{
+    class JobQueue;
+    class JobSystem;
+
+    class Job
+    {
+    public:
+        Job(): m_unfinished(1), m_dependencies(1) { }
+        bool IsFinished() const { return m_unfinished.load() == 0; }
+
+    private:
+        friend class JobSystem;
+
+        Action m_func;
+        Ref<Job> m_parent;
+        // this job and its unfinished children
+        std::atomic<int> m_unfinished;
+        // unfinished dependencies, plus one until the job is run
+        std::atomic<int> m_dependencies;
+        Mutex m_mutex;
+        Vector<Ref<Job>> m_continuations;
+        // queues hold raw pointers, a queued job keeps itself alive until finished
+        Ref<Job> m_self;
+    };
+
+    typedef Ref<Job> JobHandle;
+
+    // short compute jobs for frame work as animation sampling, culling and command recording,
+    // every worker owns a lock free deque and steals from the others when it runs dry.
+    // blocking work as file loading belongs to ThreadPool
+    class JobSystem
+    {
+    public:
+        typedef std::function<void(int begin, int end)> RangeFunc;
+
+        // one worker per core besides the thread driving the frame
+        static int GetHardwareWorkerCount();
+        JobSystem(int worker_count);
+        ~JobSystem();
+        int GetWorkerCount() const { return m_workers.Size(); }
+        // the job does not start before Run, dependencies and children can be added until then,
+        // a parent is finished when its own func and all children are finished
+        JobHandle Create(Action func, const JobHandle& parent = JobHandle());
+        void AddDependency(const JobHandle& job, const JobHandle& dependency);
+        void Run(const JobHandle& job);
+        // create and run, dependency makes the job a continuation of it
+        JobHandle Schedule(Action func, const JobHandle& dependency = JobHandle());
+        JobHandle Schedule(Action func, const Vector<JobHandle>& dependencies);
+        // executes other jobs while waiting, so it is safe to call from inside a job
+        void Wait(const JobHandle& job);
+        // func is called with sub ranges of [0, count) no longer than grain_size, grain_size <= 0 picks one
+        JobHandle ScheduleParallelFor(int count, int grain_size, RangeFunc func, const JobHandle& dependency = JobHandle());
+        void ParallelFor(int count, int grain_size, RangeFunc func);
+
+    private:
+        void WorkerRun(int index);
+        void Push(Job* job);
+        Job* GetJob(JobQueue* own_queue);
+        void Execute(Job* job);
+        void Finish(Job* job);
+        void SplitRange(const JobHandle& root, int begin, int end, int grain_size, const Ref<RangeFunc>& func);
+
+    private:
+        Vector<Ref<std::thread>> m_workers;
+        // index 0 belongs to the thread which created the system, others to workers
+        Vector<Ref<JobQueue>> m_queues;
+        // jobs run from threads without a queue
+        List<Job*> m_injected_jobs;
+        std::atomic<int> m_injected_count;
+        Mutex m_injected_mutex;
+        std::atomic<int> m_queued_count;
+        std::atomic<int> m_sleeping_count;
+        std::atomic<bool> m_close;
+        Mutex m_sleep_mutex;
+        std::condition_variable m_condition;
+    };
+}
@@ -0,0 +1,217 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "AtlasPacker.h"
+#include "math/Mathf.h"
+
+namespace Viry3D
+{
+    static bool IsRectContained(const Recti& a, const Recti& b)
+    {
+        return a.x >= b.x && a.y >= b.y && a.x + a.w <= b.x + b.w && a.y + a.h <= b.y + b.h;
+    }
+
+    AtlasPacker::AtlasPacker(int width, int height):
+        m_width(width),
+        m_height(height),
+        m_used_area(0)
+    {
+        this->Clear();
+    }
+
+    void AtlasPacker::Clear()
+    {
+        m_free_rects.Clear();
+        m_free_rects.Add(Recti(0, 0, m_width, m_height));
+        m_used_area = 0;
+    }
+
+    bool AtlasPacker::Insert(int w, int h, Recti& rect)
+    {
+        int best = -1;
+        int best_short_side = 0;
+        int best_long_side = 0;
+
+        // best short side fit
+        for (int i = 0; i < m_free_rects.Size(); ++i)
+        {
+            const Recti& free_rect = m_free_rects[i];
+            if (free_rect.w >= w && free_rect.h >= h)
+            {
+                int remain_w = free_rect.w - w;
+                int remain_h = free_rect.h - h;
+                int short_side = Mathf::Min(remain_w, remain_h);
+                int long_side = Mathf::Max(remain_w, remain_h);
+
+                if (best < 0 || short_side < best_short_side || (short_side == best_short_side && long_side < best_long_side))
+                {
+                    best = i;
+                    best_short_side = short_side;
+                    best_long_side = long_side;
+                }
+            }
+        }
+
+        if (best < 0)
+        {
+            return false;
+        }
+
+        rect = Recti(m_free_rects[best].x, m_free_rects[best].y, w, h);
+
+        int free_count = m_free_rects.Size();
+        for (int i = 0; i < free_count; )
+        {
+            if (this->SplitFreeRect(m_free_rects[i], rect))
+            {
+                m_free_rects.Remove(i);
+                free_count -= 1;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        this->PruneFreeRects();
+
+        m_used_area += w * h;
+
+        return true;
+    }
+
+    void AtlasPacker::Free(const Recti& rect)
+    {
+        m_free_rects.Add(rect);
+        m_used_area -= rect.w * rect.h;
+
+        if (m_used_area == 0)
+        {
+            this->Clear();
+            return;
+        }
+
+        this->MergeFreeRects();
+        this->PruneFreeRects();
+    }
+
+    int AtlasPacker::GetLargestFreeArea() const
+    {
+        int area = 0;
+        for (const auto& i : m_free_rects)
+        {
+            area = Mathf::Max(area, i.w * i.h);
+        }
+        return area;
+    }
+
+    // adds the parts of free_rect outside used_rect to the end of the list, false if they do not intersect
+    bool AtlasPacker::SplitFreeRect(const Recti& free_rect, const Recti& used_rect)
+    {
+        if (used_rect.x >= free_rect.x + free_rect.w || used_rect.x + used_rect.w <= free_rect.x ||
+            used_rect.y >= free_rect.y + free_rect.h || used_rect.y + used_rect.h <= free_rect.y)
+        {
+            return false;
+        }
+
+        Recti free = free_rect;
+
+        if (used_rect.x > free.x)
+        {
+            m_free_rects.Add(Recti(free.x, free.y, used_rect.x - free.x, free.h));
+        }
+        if (used_rect.x + used_rect.w < free.x + free.w)
+        {
+            int x = used_rect.x + used_rect.w;
+            m_free_rects.Add(Recti(x, free.y, free.x + free.w - x, free.h));
+        }
+        if (used_rect.y > free.y)
+        {
+            m_free_rects.Add(Recti(free.x, free.y, free.w, used_rect.y - free.y));
+        }
+        if (used_rect.y + used_rect.h < free.y + free.h)
+        {
+            int y = used_rect.y + used_rect.h;
+            m_free_rects.Add(Recti(free.x, y, free.w, free.y + free.h - y));
+        }
+
+        return true;
+    }
+
+    // joins free rects sharing a whole edge, so freed neighbours become one region again
+    void AtlasPacker::MergeFreeRects()
+    {
+        bool merged = true;
+        while (merged)
+        {
+            merged = false;
+
+            for (int i = 0; i < m_free_rects.Size() && !merged; ++i)
+            {
+                for (int j = i + 1; j < m_free_rects.Size(); ++j)
+                {
+                    Recti& a = m_free_rects[i];
+                    const Recti& b = m_free_rects[j];
+
+                    if (a.x == b.x && a.w == b.w && (a.y + a.h == b.y || b.y + b.h == a.y))
+                    {
+                        a.y = Mathf::Min(a.y, b.y);
+                        a.h += b.h;
+                    }
+                    else if (a.y == b.y && a.h == b.h && (a.x + a.w == b.x || b.x + b.w == a.x))
+                    {
+                        a.x = Mathf::Min(a.x, b.x);
+                        a.w += b.w;
+                    }
+                    else
+                    {
+                        continue;
+                    }
+
+                    m_free_rects.Remove(j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    void AtlasPacker::PruneFreeRects()
+    {
+        for (int i = 0; i < m_free_rects.Size(); ++i)
+        {
+            for (int j = i + 1; j < m_free_rects.Size(); )
+            {
+                if (IsRectContained(m_free_rects[i], m_free_rects[j]))
+                {
+                    m_free_rects.Remove(i);
+                    --i;
+                    break;
+                }
+                else if (IsRectContained(m_free_rects[j], m_free_rects[i]))
+                {
+                    m_free_rects.Remove(j);
+                }
+                else
+                {
+                    ++j;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,50 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include "container/Vector.h"
+#include "math/Recti.h"
+
+namespace Viry3D
+{
+    // max rects packer of one atlas layer, freed rects are given back to the free list
+    class AtlasPacker
+    {
+    public:
+        AtlasPacker(int width, int height);
+        void Clear();
+        bool Insert(int w, int h, Recti& rect);
+        void Free(const Recti& rect);
+        int GetWidth() const { return m_width; }
+        int GetHeight() const { return m_height; }
+        int GetUsedArea() const { return m_used_area; }
+        int GetLargestFreeArea() const;
+
+    private:
+        bool SplitFreeRect(const Recti& free_rect, const Recti& used_rect);
+        void MergeFreeRects();
+        void PruneFreeRects();
+
+    private:
+        int m_width;
+        int m_height;
+        int m_used_area;
+        Vector<Recti> m_free_rects;
+    };
+}
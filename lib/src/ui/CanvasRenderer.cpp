@@ -30,15 +30,19 @@
 #include "graphics/Image.h"
 #include "memory/Memory.h"
 #include "container/List.h"
+#include "time/Time.h"
+#include "math/Mathf.h"
 
 #define ATLAS_SIZE 2048
 #define PADDING_SIZE 1
+#define ATLAS_DEFRAG_INTERVAL 600
 
 namespace Viry3D
 {
 	CanvasRenderer::CanvasRenderer(FilterMode filter_mode):
 		m_canvas_dirty(true),
         m_atlas_array_size(0),
+        m_atlas_defrag_frame(0),
         m_filter_mode(filter_mode)
 	{
 		this->CreateMaterial();
@@ -47,23 +51,19 @@ namespace Viry3D
 
 	CanvasRenderer::~CanvasRenderer()
 	{
-        for (int i = 0; i < m_atlas_tree.Size(); ++i)
+        for (auto& i : m_view_ranges)
         {
-            this->ReleaseAtlasTreeNode(m_atlas_tree[i]);
-            delete m_atlas_tree[i];
+            this->ReleaseAtlasEntries(i.atlas_entries);
         }
-        m_atlas_tree.Clear();
-	}
+        m_view_ranges.Clear();
 
-    void CanvasRenderer::ReleaseAtlasTreeNode(AtlasTreeNode* node)
-    {
-        for (int i = 0; i < node->children.Size(); ++i)
+        for (auto i : m_atlas_entries)
         {
-            this->ReleaseAtlasTreeNode(node->children[i]);
-            delete node->children[i];
+            delete i;
         }
-        node->children.Clear();
-    }
+        m_atlas_entries.Clear();
+        m_atlas_cache.Clear();
+	}
 
     void CanvasRenderer::CreateMaterial()
     {
@@ -87,15 +87,18 @@ Input(0) vec3 a_pos;
 Input(1) vec4 a_color;
 Input(2) vec2 a_uv;
 Input(3) vec2 a_uv2;
+Input(4) vec3 a_normal;
 
 Output(0) vec3 v_uv;
 Output(1) vec4 v_color;
+Output(2) vec3 v_sdf;
 
 void main()
 {
 	gl_Position = vec4(a_pos, 1.0) * buf_1_0.u_model_matrix * buf_0_0.u_view_matrix * buf_0_0.u_projection_matrix;
 	v_uv = vec3(a_uv, a_uv2.x);
 	v_color = a_color;
+	v_sdf = a_normal;
 
 	vulkan_convert();
 }
@@ -112,12 +115,31 @@ UniformBuffer(0, 2) uniform UniformBuffer00
 
 Input(0) vec3 v_uv;
 Input(1) vec4 v_color;
+Input(2) vec3 v_sdf;
 
 Output(0) vec4 o_frag;
 
+// distance fields need bilinear filtering whatever the atlas sampler does,
+// taps at texel centers read exact texels from nearest and linear samplers alike
+vec4 SampleBilinear(vec3 uv)
+{
+    vec2 texel = uv.xy * ATLAS_SIZE - 0.5;
+    vec2 f = fract(texel);
+    vec2 base = (floor(texel) + 0.5) / ATLAS_SIZE;
+    float d = 1.0 / ATLAS_SIZE;
+    vec4 c00 = texture(u_texture, vec3(base, uv.z));
+    vec4 c10 = texture(u_texture, vec3(base + vec2(d, 0.0), uv.z));
+    vec4 c01 = texture(u_texture, vec3(base + vec2(0.0, d), uv.z));
+    vec4 c11 = texture(u_texture, vec3(base + vec2(d, d), uv.z));
+    return mix(mix(c00, c10, f.x), mix(c01, c11, f.x), f.y);
+}
+
 void main()
 {
-    o_frag = texture(u_texture, v_uv) * v_color * buf_0_2.u_color;
+    vec4 c = v_sdf.x > 0.5 ? SampleBilinear(v_uv) : texture(u_texture, v_uv);
+    float sdf_alpha = clamp((c.a - v_sdf.y) / max(v_sdf.z, 0.001) * 0.5 + 0.5, 0.0, 1.0);
+    c.a = mix(c.a, sdf_alpha, v_sdf.x);
+    o_frag = c * v_color * buf_0_2.u_color;
 }
 )";
 #elif VR_GLES
@@ -129,15 +151,18 @@ uniform mat4 u_model_matrix;
 attribute vec3 a_pos;
 attribute vec4 a_color;
 attribute vec2 a_uv;
+attribute vec3 a_normal;
 
 varying vec2 v_uv;
 varying vec4 v_color;
+varying vec3 v_sdf;
 
 void main()
 {
 	gl_Position = vec4(a_pos, 1.0) * u_model_matrix * u_view_matrix * u_projection_matrix;
     v_uv = a_uv;
 	v_color = a_color;
+	v_sdf = a_normal;
 }
 )";
             String fs = R"(
@@ -148,10 +173,29 @@ uniform vec4 u_color;
 
 varying vec2 v_uv;
 varying vec4 v_color;
+varying vec3 v_sdf;
+
+// distance fields need bilinear filtering whatever the atlas sampler does,
+// taps at texel centers read exact texels from nearest and linear samplers alike
+vec4 SampleBilinear(vec2 uv)
+{
+    vec2 texel = uv * ATLAS_SIZE - 0.5;
+    vec2 f = fract(texel);
+    vec2 base = (floor(texel) + 0.5) / ATLAS_SIZE;
+    float d = 1.0 / ATLAS_SIZE;
+    vec4 c00 = texture2D(u_texture, base);
+    vec4 c10 = texture2D(u_texture, base + vec2(d, 0.0));
+    vec4 c01 = texture2D(u_texture, base + vec2(0.0, d));
+    vec4 c11 = texture2D(u_texture, base + vec2(d, d));
+    return mix(mix(c00, c10, f.x), mix(c01, c11, f.x), f.y);
+}
 
 void main()
 {
-    gl_FragColor = texture2D(u_texture, v_uv) * v_color * u_color;
+    vec4 c = v_sdf.x > 0.5 ? SampleBilinear(v_uv) : texture2D(u_texture, v_uv);
+    float sdf_alpha = clamp((c.a - v_sdf.y) / max(v_sdf.z, 0.001) * 0.5 + 0.5, 0.0, 1.0);
+    c.a = mix(c.a, sdf_alpha, v_sdf.x);
+    gl_FragColor = c * v_color * u_color;
 }
 )";
 #endif
@@ -168,7 +212,7 @@ void main()
                 "",
                 Vector<String>(),
                 vs,
-                "",
+                String::Format("#define ATLAS_SIZE %d.0", ATLAS_SIZE),
                 Vector<String>(),
                 fs,
                 render_state);
@@ -182,58 +226,53 @@ void main()
         this->SetMaterial(material);
     }
 
-    void CanvasRenderer::NewAtlasTextureLayer()
+    Ref<Texture> CanvasRenderer::CreateAtlasTexture(int array_size)
     {
         ByteBuffer buffer(ATLAS_SIZE * ATLAS_SIZE * 4);
         Memory::Set(&buffer[0], 0, buffer.Size());
 
-        if (!m_atlas)
-        {
-            m_atlas_array_size = 1;
-
 #if VR_VULKAN
-            Vector<ByteBuffer> pixels(m_atlas_array_size, buffer);
-
-            m_atlas = Texture::CreateTexture2DArrayFromMemory(
-                pixels,
-                ATLAS_SIZE,
-                ATLAS_SIZE,
-                m_atlas_array_size,
-                TextureFormat::R8G8B8A8,
-                m_filter_mode,
-                SamplerAddressMode::ClampToEdge,
-                false,
-                true);
+        Vector<ByteBuffer> pixels(array_size, buffer);
+
+        return Texture::CreateTexture2DArrayFromMemory(
+            pixels,
+            ATLAS_SIZE,
+            ATLAS_SIZE,
+            array_size,
+            TextureFormat::R8G8B8A8,
+            m_filter_mode,
+            SamplerAddressMode::ClampToEdge,
+            false,
+            true);
 #elif VR_GLES
-            m_atlas = Texture::CreateTexture2DFromMemory(
-                buffer,
-                ATLAS_SIZE,
-                ATLAS_SIZE,
-                TextureFormat::R8G8B8A8,
-                m_filter_mode,
-                SamplerAddressMode::ClampToEdge,
-                false,
-                true,
-                false);
+        assert(array_size == 1);
+
+        return Texture::CreateTexture2DFromMemory(
+            buffer,
+            ATLAS_SIZE,
+            ATLAS_SIZE,
+            TextureFormat::R8G8B8A8,
+            m_filter_mode,
+            SamplerAddressMode::ClampToEdge,
+            false,
+            true,
+            false);
 #endif
+    }
+
+    void CanvasRenderer::NewAtlasTextureLayer()
+    {
+        if (!m_atlas)
+        {
+            m_atlas_array_size = 1;
+            m_atlas = this->CreateAtlasTexture(m_atlas_array_size);
         }
         else
         {
 #if VR_VULKAN
             int new_array_size = m_atlas_array_size + 1;
 
-            Vector<ByteBuffer> pixels(new_array_size, buffer);
-
-            Ref<Texture> new_atlas = Texture::CreateTexture2DArrayFromMemory(
-                pixels,
-                ATLAS_SIZE,
-                ATLAS_SIZE,
-                new_array_size,
-                TextureFormat::R8G8B8A8,
-                m_filter_mode,
-                SamplerAddressMode::ClampToEdge,
-                false,
-                true);
+            Ref<Texture> new_atlas = this->CreateAtlasTexture(new_array_size);
 
             for (int i = 0; i < m_atlas_array_size; ++i)
             {
@@ -254,13 +293,7 @@ void main()
 #endif
         }
 
-        AtlasTreeNode* layer = new AtlasTreeNode();
-        layer->rect.x = 0;
-        layer->rect.y = 0;
-        layer->rect.w = ATLAS_SIZE;
-        layer->rect.h = ATLAS_SIZE;
-        layer->layer = m_atlas_tree.Size();
-        m_atlas_tree.Add(layer);
+        m_atlas_layers.Add(AtlasPacker(ATLAS_SIZE, ATLAS_SIZE));
 
         const auto& materials = this->GetMaterials();
         for (auto& i : materials)
@@ -276,6 +309,16 @@ void main()
             m_views[i]->Update();
         }
 
+        if (!m_canvas_dirty && m_dirty_views.Size() > 0)
+        {
+            // views that outgrew their room or changed clipping fall back to a full rebuild
+            if (!this->UpdateDirtyViews())
+            {
+                m_canvas_dirty = true;
+            }
+            m_dirty_views.Clear();
+        }
+
 		if (m_canvas_dirty)
 		{
 			m_canvas_dirty = false;
@@ -350,104 +393,137 @@ void main()
 		m_canvas_dirty = true;
 	}
 
-    void CanvasRenderer::UpdateCanvas()
+    void CanvasRenderer::MarkViewDirty(View* view)
     {
-        m_view_meshes.Clear();
+        view->m_canvas_dynamic = true;
 
-        for (int i = 0; i < m_views.Size(); ++i)
+        if (m_canvas_dirty || view->m_canvas_dirty)
         {
-            m_views[i]->UpdateLayout();
-            m_views[i]->FillMeshes(m_view_meshes, Rect(0, 0, 1, 1));
+            return;
         }
 
-        List<ViewMesh*> mesh_list;
+        view->m_canvas_dirty = true;
+        m_dirty_views.Add(view);
+    }
+
+    static bool IsMeshDrawn(const ViewMesh& mesh)
+    {
+        return mesh.vertices.Size() > 0 && mesh.indices.Size() > 0 && (mesh.texture || mesh.image);
+    }
 
-        for (int i = 0; i < m_view_meshes.Size(); ++i)
+    static void AddSubmeshIndices(Vector<Mesh::Submesh>& submeshes, Vector<Rect>& clip_rects, const Rect& clip_rect, int index_first, int index_count)
+    {
+        if (clip_rects.Size() == 0 || clip_rect != clip_rects[clip_rects.Size() - 1])
         {
-            mesh_list.AddLast(&m_view_meshes[i]);
+            clip_rects.Add(clip_rect);
+
+            Mesh::Submesh submesh;
+            submesh.index_first = index_first;
+            submesh.index_count = index_count;
+            submeshes.Add(submesh);
+        }
+        else
+        {
+            submeshes[submeshes.Size() - 1].index_count += index_count;
         }
+    }
 
-        mesh_list.Sort([](const ViewMesh* a, const ViewMesh* b) {
-            if (!a->HasTextureOrImage() && b->HasTextureOrImage())
-            {
-                return true;
-            }
-            else if (a->HasTextureOrImage() && !b->HasTextureOrImage())
-            {
-                return false;
-            }
-            else if (!a->HasTextureOrImage() && !b->HasTextureOrImage())
-            {
-                return false;
-            }
-            else
+    void CanvasRenderer::UpdateCanvas()
+    {
+        // old ranges keep their atlas entries until the new ones are acquired
+        Vector<CanvasViewRange> old_ranges = std::move(m_view_ranges);
+        m_view_ranges.Clear();
+        m_dirty_views.Clear();
+
+        for (int i = 0; i < m_views.Size(); ++i)
+        {
+            m_views[i]->UpdateLayout();
+            this->FillViewRanges(m_views[i].get(), Rect(0, 0, 1, 1));
+        }
+
+        Vector<ViewMesh*> view_meshes;
+        for (auto& i : m_view_ranges)
+        {
+            for (auto& j : i.meshes)
             {
-                if (a->GetTextureOrImageWidth() == b->GetTextureOrImageWidth())
-                {
-                    return a->GetTextureOrImageHeight() > b->GetTextureOrImageHeight();
-                }
-                else
-                {
-                    return a->GetTextureOrImageWidth() > b->GetTextureOrImageWidth();
-                }
+                view_meshes.Add(&j);
             }
-        });
+        }
 
-        bool atlas_updated = false;
-        for (auto i : mesh_list)
+        bool atlas_updated = this->UpdateMeshesAtlas(view_meshes);
+
+        for (auto& i : m_view_ranges)
         {
-            if (i->texture || i->image)
-            {
-                bool updated;
-                this->UpdateAtlas(*i, updated);
+            this->AcquireAtlasEntries(i);
+        }
+        for (auto& i : old_ranges)
+        {
+            this->ReleaseAtlasEntries(i.atlas_entries);
+        }
+        old_ranges.Clear();
 
-                if (updated)
-                {
-                    atlas_updated = true;
-                }
-            }
+        if (this->IsAtlasFragmented())
+        {
+            this->DefragAtlas();
+            atlas_updated = true;
         }
 
         Vector<Mesh::Submesh> submeshes;
         Vector<Rect> clip_rects;
-        Vector<Vertex> vertices;
-        Vector<unsigned short> indices;
-        
-        for (const auto& i : m_view_meshes)
+        m_vertices.Clear();
+        m_indices.Clear();
+
+        for (auto& i : m_view_ranges)
         {
-            if (i.vertices.Size() > 0 && i.indices.Size() > 0 && (i.texture || i.image))
-            {
-                int index_offset = vertices.Size();
+            int vertex_count = 0;
+            int index_count = 0;
+            bool same_clip = true;
 
-                if (clip_rects.Size() == 0 || i.clip_rect != clip_rects[clip_rects.Size() - 1])
+            for (const auto& j : i.meshes)
+            {
+                if (IsMeshDrawn(j))
                 {
-                    clip_rects.Add(i.clip_rect);
+                    vertex_count += j.vertices.Size();
+                    index_count += j.indices.Size();
 
-                    Mesh::Submesh submesh;
-                    submesh.index_first = indices.Size();
-                    submesh.index_count = i.indices.Size();
-                    submeshes.Add(submesh);
-                }
-                else
-                {
-                    submeshes[submeshes.Size() - 1].index_count += i.indices.Size();
+                    if (j.clip_rect != i.clip_rect)
+                    {
+                        same_clip = false;
+                    }
                 }
+            }
 
-                vertices.AddRange(i.vertices);
+            i.vertex_start = m_vertices.Size();
+            i.vertex_capacity = vertex_count;
+            i.index_start = m_indices.Size();
+            i.index_capacity = index_count;
 
-                for (int j = 0; j < i.indices.Size(); ++j)
-                {
-                    indices.Add(index_offset + i.indices[j]);
-                }
+            // views changed before are likely to change again, reserve room to patch them in place
+            if (i.view->m_canvas_dynamic && same_clip)
+            {
+                i.vertex_capacity += vertex_count / 2 + 4;
+                i.index_capacity += index_count / 2 + 6;
             }
+
+            m_vertices.Resize(i.vertex_start + i.vertex_capacity);
+            m_indices.Resize(i.index_start + i.index_capacity);
+
+            this->WriteViewRange(i, &submeshes, &clip_rects);
         }
 
         auto mesh = this->GetMesh();
-        if (vertices.Size() > 0 && indices.Size() > 0)
+        if (m_vertices.Size() > 0 && m_indices.Size() > 0)
         {
-            if (!mesh || vertices.Size() > mesh->GetVertexCount() || indices.Size() > mesh->GetIndexCount())
+            if (!mesh || m_vertices.Size() > mesh->GetVertexCount() || m_indices.Size() > mesh->GetIndexCount())
             {
-                mesh = RefMake<Mesh>(vertices, indices, submeshes, true);
+                // uv2.x holds the atlas layer, normal the distance field parameters of glyphs
+                static const VertexLayout layout = VertexLayout::Compact(
+                    VertexLayout::GetAttributeMask(VertexAttributeType::Color) |
+                    VertexLayout::GetAttributeMask(VertexAttributeType::Texcoord) |
+                    VertexLayout::GetAttributeMask(VertexAttributeType::Texcoord2) |
+                    VertexLayout::GetAttributeMask(VertexAttributeType::Normal));
+
+                mesh = RefMake<Mesh>(m_vertices, m_indices, submeshes, true, layout);
                 this->SetMesh(mesh);
 
 #if VR_VULKAN
@@ -456,7 +532,7 @@ void main()
             }
             else
             {
-                mesh->Update(vertices, indices, submeshes);
+                mesh->Update(m_vertices, m_indices, submeshes);
 
                 m_draw_buffer_dirty = true;
             }
@@ -527,84 +603,311 @@ void main()
 #endif
     }
 
-    void CanvasRenderer::UpdateAtlas(ViewMesh& mesh, bool& updated)
+    void CanvasRenderer::FillViewRanges(View* view, const Rect& clip_rect)
     {
-        int texture_width = mesh.GetTextureOrImageWidth();
-        int texture_height = mesh.GetTextureOrImageHeight();
+        int index = m_view_ranges.Size();
+        m_view_ranges.Add(CanvasViewRange());
 
-        assert(texture_width <= ATLAS_SIZE - PADDING_SIZE && texture_height <= ATLAS_SIZE - PADDING_SIZE);
+        {
+            CanvasViewRange& range = m_view_ranges[index];
+            range.view = view;
+            range.parent_clip_rect = clip_rect;
+            range.clip_rect = Rect::Min(view->GetClipRect(), clip_rect);
+            view->FillSelfMeshes(range.meshes, clip_rect);
+        }
 
-        AtlasTreeNode* node = nullptr;
+        view->m_canvas_dirty = false;
+        view->m_canvas_range = index;
 
-        AtlasTreeNode** node_ptr;
-        if ((mesh.texture && m_atlas_cache.TryGet(mesh.texture.get(), &node_ptr)) ||
-            (mesh.image && m_atlas_cache.TryGet(mesh.image.get(), &node_ptr)))
+        // ranges may move while subviews are added
+        Rect clip = m_view_ranges[index].clip_rect;
+        for (int i = 0; i < view->GetSubviewCount(); ++i)
         {
-            node = *node_ptr;
-
-            updated = false;
+            this->FillViewRanges(view->GetSubview(i).get(), clip);
         }
-        else
+
+        m_view_ranges[index].subtree_end = m_view_ranges.Size();
+    }
+
+    bool CanvasRenderer::UpdateDirtyViews()
+    {
+        Vector<int> ranges;
+
+        for (auto view : m_dirty_views)
         {
-            for (int i = 0; i < m_atlas_tree.Size(); ++i)
+            // refilled already with a dirty parent
+            if (!view->m_canvas_dirty)
+            {
+                continue;
+            }
+
+            bool parent_dirty = false;
+            for (View* parent = view->GetParentView(); parent; parent = parent->GetParentView())
             {
-                node = this->FindAtlasTreeNodeToInsert(texture_width, texture_height, m_atlas_tree[i]);
-                if (node)
+                if (parent->m_canvas_dirty)
                 {
+                    parent_dirty = true;
                     break;
                 }
             }
 
-            if (node == nullptr)
+            // the parent refills this view with its subviews
+            if (parent_dirty)
             {
-                this->NewAtlasTextureLayer();
+                continue;
+            }
 
-                node = this->FindAtlasTreeNodeToInsert(texture_width, texture_height, m_atlas_tree[m_atlas_tree.Size() - 1]);
+            if (view->m_canvas_range < 0 || view->m_canvas_range >= m_view_ranges.Size() || m_view_ranges[view->m_canvas_range].view != view)
+            {
+                return false;
             }
 
-            assert(node);
+            view->UpdateLayout();
 
-            // split node
-            AtlasTreeNode* left = new AtlasTreeNode();
-            AtlasTreeNode* right = new AtlasTreeNode();
+            Rect clip_rect = m_view_ranges[view->m_canvas_range].parent_clip_rect;
+            if (!this->RefillViewRange(view, clip_rect, ranges))
+            {
+                return false;
+            }
+        }
 
-            int remain_w = node->rect.w - texture_width - PADDING_SIZE;
-            int remain_h = node->rect.h - texture_height - PADDING_SIZE;
+        if (ranges.Size() == 0)
+        {
+            return true;
+        }
 
-            if (remain_w <= remain_h)
+        Vector<ViewMesh*> view_meshes;
+        for (int i : ranges)
+        {
+            for (auto& j : m_view_ranges[i].meshes)
             {
-                left->rect.x = node->rect.x + texture_width + PADDING_SIZE;
-                left->rect.y = node->rect.y;
-                left->rect.w = remain_w;
-                left->rect.h = texture_height;
-                left->layer = node->layer;
+                view_meshes.Add(&j);
+            }
+        }
+
+        this->UpdateMeshesAtlas(view_meshes);
+
+        for (int i : ranges)
+        {
+            Vector<AtlasEntry*> entries = std::move(m_view_ranges[i].atlas_entries);
+            m_view_ranges[i].atlas_entries.Clear();
+            this->AcquireAtlasEntries(m_view_ranges[i]);
+            this->ReleaseAtlasEntries(entries);
+        }
+
+        auto mesh = this->GetMesh();
+
+        for (int i : ranges)
+        {
+            const CanvasViewRange& range = m_view_ranges[i];
+
+            this->WriteViewRange(range, nullptr, nullptr);
+
+            if (mesh && range.vertex_capacity > 0 && range.index_capacity > 0)
+            {
+                Vector<Vertex> vertices(range.vertex_capacity);
+                for (int j = 0; j < range.vertex_capacity; ++j)
+                {
+                    vertices[j] = m_vertices[range.vertex_start + j];
+                }
+
+                Vector<unsigned short> indices(range.index_capacity);
+                for (int j = 0; j < range.index_capacity; ++j)
+                {
+                    indices[j] = m_indices[range.index_start + j];
+                }
+
+                mesh->UpdateRange(range.vertex_start, vertices, range.index_start, indices);
+            }
+        }
+
+        return true;
+    }
+
+    bool CanvasRenderer::RefillViewRange(View* view, const Rect& clip_rect, Vector<int>& ranges)
+    {
+        int index = view->m_canvas_range;
+        view->m_canvas_dirty = false;
+
+        if (index < 0 || index >= m_view_ranges.Size() || m_view_ranges[index].view != view)
+        {
+            return false;
+        }
+
+        Vector<ViewMesh> meshes;
+        view->FillSelfMeshes(meshes, clip_rect);
+
+        CanvasViewRange& range = m_view_ranges[index];
+        Rect clip = Rect::Min(view->GetClipRect(), clip_rect);
+        if (clip != range.clip_rect)
+        {
+            return false;
+        }
+
+        int vertex_count = 0;
+        int index_count = 0;
+
+        for (const auto& i : meshes)
+        {
+            if (IsMeshDrawn(i))
+            {
+                if (i.clip_rect != range.clip_rect)
+                {
+                    return false;
+                }
+
+                vertex_count += i.vertices.Size();
+                index_count += i.indices.Size();
+            }
+        }
+
+        if (vertex_count > range.vertex_capacity || index_count > range.index_capacity)
+        {
+            return false;
+        }
+
+        range.meshes = std::move(meshes);
+        range.parent_clip_rect = clip_rect;
+        ranges.Add(index);
+
+        for (int i = 0; i < view->GetSubviewCount(); ++i)
+        {
+            if (!this->RefillViewRange(view->GetSubview(i).get(), clip, ranges))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void CanvasRenderer::WriteViewRange(const CanvasViewRange& range, Vector<Mesh::Submesh>* submeshes, Vector<Rect>* clip_rects)
+    {
+        int vertex = range.vertex_start;
+        int index = range.index_start;
+
+        for (const auto& i : range.meshes)
+        {
+            if (IsMeshDrawn(i))
+            {
+                if (submeshes)
+                {
+                    AddSubmeshIndices(*submeshes, *clip_rects, i.clip_rect, index, i.indices.Size());
+                }
+
+                for (int j = 0; j < i.indices.Size(); ++j)
+                {
+                    m_indices[index + j] = vertex + i.indices[j];
+                }
+                for (int j = 0; j < i.vertices.Size(); ++j)
+                {
+                    m_vertices[vertex + j] = i.vertices[j];
+                }
+
+                vertex += i.vertices.Size();
+                index += i.indices.Size();
+            }
+        }
+
+        // unused room is filled with degenerate triangles
+        int vertex_end = range.vertex_start + range.vertex_capacity;
+        for (; vertex < vertex_end; ++vertex)
+        {
+            Memory::Zero(&m_vertices[vertex], sizeof(Vertex));
+        }
+
+        int index_end = range.index_start + range.index_capacity;
+        if (submeshes && index < index_end)
+        {
+            AddSubmeshIndices(*submeshes, *clip_rects, range.clip_rect, index, index_end - index);
+        }
+        for (; index < index_end; ++index)
+        {
+            m_indices[index] = range.vertex_start;
+        }
+    }
+
+    bool CanvasRenderer::UpdateMeshesAtlas(const Vector<ViewMesh*>& meshes)
+    {
+        List<ViewMesh*> mesh_list;
+
+        for (int i = 0; i < meshes.Size(); ++i)
+        {
+            mesh_list.AddLast(meshes[i]);
+        }
 
-                right->rect.x = node->rect.x;
-                right->rect.y = node->rect.y + texture_height + PADDING_SIZE;
-                right->rect.w = node->rect.w;
-                right->rect.h = remain_h;
-                right->layer = node->layer;
+        mesh_list.Sort([](const ViewMesh* a, const ViewMesh* b) {
+            if (!a->HasTextureOrImage() && b->HasTextureOrImage())
+            {
+                return true;
+            }
+            else if (a->HasTextureOrImage() && !b->HasTextureOrImage())
+            {
+                return false;
+            }
+            else if (!a->HasTextureOrImage() && !b->HasTextureOrImage())
+            {
+                return false;
             }
             else
             {
-                left->rect.x = node->rect.x;
-                left->rect.y = node->rect.y + texture_height + PADDING_SIZE;
-                left->rect.w = texture_width;
-                left->rect.h = remain_h;
-                left->layer = node->layer;
+                if (a->GetTextureOrImageWidth() == b->GetTextureOrImageWidth())
+                {
+                    return a->GetTextureOrImageHeight() > b->GetTextureOrImageHeight();
+                }
+                else
+                {
+                    return a->GetTextureOrImageWidth() > b->GetTextureOrImageWidth();
+                }
+            }
+        });
 
-                right->rect.x = node->rect.x + texture_width + PADDING_SIZE;
-                right->rect.y = node->rect.y;
-                right->rect.w = remain_w;
-                right->rect.h = node->rect.h;
-                right->layer = node->layer;
+        bool atlas_updated = false;
+        for (auto i : mesh_list)
+        {
+            if (i->texture || i->image)
+            {
+                bool updated;
+                this->UpdateAtlas(*i, updated);
+
+                if (updated)
+                {
+                    atlas_updated = true;
+                }
             }
+        }
+
+        return atlas_updated;
+    }
 
-            node->rect.w = texture_width;
-            node->rect.h = texture_height;
-            node->children.Resize(2);
-            node->children[0] = left;
-            node->children[1] = right;
+    void CanvasRenderer::UpdateAtlas(ViewMesh& mesh, bool& updated)
+    {
+        int texture_width = mesh.GetTextureOrImageWidth();
+        int texture_height = mesh.GetTextureOrImageHeight();
+
+        assert(texture_width <= ATLAS_SIZE - PADDING_SIZE && texture_height <= ATLAS_SIZE - PADDING_SIZE);
+
+        AtlasEntry* entry = this->FindAtlasEntry(mesh);
+        if (entry)
+        {
+            updated = false;
+        }
+        else
+        {
+            // unused entries make room before the atlas grows
+            Recti rect;
+            int layer = 0;
+            while (!this->InsertAtlasRect(texture_width + PADDING_SIZE, texture_height + PADDING_SIZE, rect, layer))
+            {
+                if (!this->EvictAtlasEntry())
+                {
+                    this->NewAtlasTextureLayer();
+                }
+            }
+
+            entry = new AtlasEntry();
+            entry->rect = Recti(rect.x, rect.y, texture_width, texture_height);
+            entry->layer = layer;
 
             // copy texture to atlas
             // add cache
@@ -614,72 +917,329 @@ void main()
                     mesh.texture,
                     0, 0,
                     0, 0,
-                    node->rect.w, node->rect.h,
-                    node->layer, 0,
-                    node->rect.x, node->rect.y,
-                    node->rect.w, node->rect.h);
+                    entry->rect.w, entry->rect.h,
+                    entry->layer, 0,
+                    entry->rect.x, entry->rect.y,
+                    entry->rect.w, entry->rect.h);
 
-                m_atlas_cache.Add(mesh.texture.get(), node);
+                entry->key = mesh.texture.get();
+                entry->texture = mesh.texture;
             }
             else if (mesh.image)
             {
 #if VR_VULKAN
                 m_atlas->UpdateTexture2DArray(
                     mesh.image->data,
-                    node->layer, 0,
-                    node->rect.x, node->rect.y,
-                    node->rect.w, node->rect.h);
+                    entry->layer, 0,
+                    entry->rect.x, entry->rect.y,
+                    entry->rect.w, entry->rect.h);
 #elif VR_GLES
                 m_atlas->UpdateTexture2D(
                     mesh.image->data,
-                    node->rect.x, node->rect.y,
-                    node->rect.w, node->rect.h,
+                    entry->rect.x, entry->rect.y,
+                    entry->rect.w, entry->rect.h,
                     0);
 #endif
 
-                m_atlas_cache.Add(mesh.image.get(), node);
+                entry->key = mesh.image.get();
+                entry->image = mesh.image;
             }
 
+            m_atlas_entries.Add(entry);
+            m_atlas_cache.Add(entry->key, entry);
+
             updated = true;
         }
 
+        entry->used_frame = Time::GetFrameCount();
+
         // update uv
-        Vector2 uv_offset(node->rect.x / (float) ATLAS_SIZE, node->rect.y / (float) ATLAS_SIZE);
-        Vector2 uv_scale(node->rect.w / (float) ATLAS_SIZE, node->rect.h / (float) ATLAS_SIZE);
+        Vector2 uv_offset(entry->rect.x / (float) ATLAS_SIZE, entry->rect.y / (float) ATLAS_SIZE);
+        Vector2 uv_scale(entry->rect.w / (float) ATLAS_SIZE, entry->rect.h / (float) ATLAS_SIZE);
 
         for (int i = 0; i < mesh.vertices.Size(); ++i)
         {
             mesh.vertices[i].uv.x = mesh.vertices[i].uv.x * uv_scale.x + uv_offset.x;
             mesh.vertices[i].uv.y = mesh.vertices[i].uv.y * uv_scale.y + uv_offset.y;
-            mesh.vertices[i].uv2.x = (float) node->layer;
+            mesh.vertices[i].uv2.x = (float) entry->layer;
+        }
+    }
+
+    bool CanvasRenderer::InsertAtlasRect(int w, int h, Recti& rect, int& layer)
+    {
+        for (int i = 0; i < m_atlas_layers.Size(); ++i)
+        {
+            if (m_atlas_layers[i].Insert(w, h, rect))
+            {
+                layer = i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    AtlasEntry* CanvasRenderer::FindAtlasEntry(const ViewMesh& mesh)
+    {
+        void* key = mesh.texture ? (void*) mesh.texture.get() : (void*) mesh.image.get();
+
+        AtlasEntry** entry_ptr;
+        if (!m_atlas_cache.TryGet(key, &entry_ptr))
+        {
+            return nullptr;
+        }
+
+        AtlasEntry* entry = *entry_ptr;
+        if ((mesh.texture && entry->texture.lock() == mesh.texture) ||
+            (mesh.image && entry->image.lock() == mesh.image))
+        {
+            return entry;
+        }
+
+        // the source of the entry is gone and a new one reuses its address,
+        // entries still drawn by old ranges are freed on release
+        m_atlas_cache.Remove(key);
+        entry->key = nullptr;
+
+        if (entry->ref_count == 0)
+        {
+            this->FreeAtlasEntry(entry);
+        }
+
+        return nullptr;
+    }
+
+    bool CanvasRenderer::EvictAtlasEntry()
+    {
+        int frame = Time::GetFrameCount();
+        AtlasEntry* evict = nullptr;
+        int evict_frame = 0;
+
+        // entries of released sources go first, entries used this frame may be waiting for their ref
+        for (auto i : m_atlas_entries)
+        {
+            if (i->ref_count == 0 && i->used_frame != frame)
+            {
+                int used_frame = (i->texture.expired() && i->image.expired()) ? -1 : i->used_frame;
+                if (evict == nullptr || used_frame < evict_frame)
+                {
+                    evict = i;
+                    evict_frame = used_frame;
+                }
+            }
+        }
+
+        if (evict == nullptr)
+        {
+            return false;
+        }
+
+        this->FreeAtlasEntry(evict);
+
+        return true;
+    }
+
+    void CanvasRenderer::FreeAtlasEntry(AtlasEntry* entry)
+    {
+        assert(entry->ref_count == 0);
+
+        if (entry->key)
+        {
+            m_atlas_cache.Remove(entry->key);
         }
+
+        m_atlas_layers[entry->layer].Free(Recti(entry->rect.x, entry->rect.y, entry->rect.w + PADDING_SIZE, entry->rect.h + PADDING_SIZE));
+        m_atlas_entries.Remove(entry);
+
+        delete entry;
     }
 
-    AtlasTreeNode* CanvasRenderer::FindAtlasTreeNodeToInsert(int w, int h, AtlasTreeNode* node)
+    void CanvasRenderer::AcquireAtlasEntries(CanvasViewRange& range)
     {
-        if (node->children.Size() == 0)
+        for (const auto& i : range.meshes)
         {
-            if (node->rect.w - PADDING_SIZE >= w && node->rect.h - PADDING_SIZE >= h)
+            if (i.texture || i.image)
             {
-                return node;
+                AtlasEntry* entry = this->FindAtlasEntry(i);
+                assert(entry);
+
+                entry->ref_count += 1;
+                range.atlas_entries.Add(entry);
+            }
+        }
+    }
+
+    void CanvasRenderer::ReleaseAtlasEntries(Vector<AtlasEntry*>& entries)
+    {
+        for (auto i : entries)
+        {
+            i->ref_count -= 1;
+            assert(i->ref_count >= 0);
+
+            if (i->ref_count == 0 && i->key == nullptr)
+            {
+                this->FreeAtlasEntry(i);
+            }
+        }
+        entries.Clear();
+    }
+
+    bool CanvasRenderer::IsAtlasFragmented() const
+    {
+        if (Time::GetFrameCount() - m_atlas_defrag_frame < ATLAS_DEFRAG_INTERVAL)
+        {
+            return false;
+        }
+
+        int layer_area = ATLAS_SIZE * ATLAS_SIZE;
+        int live_area = 0;
+        for (auto i : m_atlas_entries)
+        {
+            if (i->ref_count > 0)
+            {
+                live_area += (i->rect.w + PADDING_SIZE) * (i->rect.h + PADDING_SIZE);
+            }
+        }
+
+        // live entries would fit in fewer layers
+        if (m_atlas_layers.Size() > 1 && live_area < (m_atlas_layers.Size() - 1) * layer_area / 4 * 3)
+        {
+            return true;
+        }
+
+        // most of the free space is scattered into small holes
+        int free_area = 0;
+        int largest_free_area = 0;
+        for (const auto& i : m_atlas_layers)
+        {
+            free_area += layer_area - i.GetUsedArea();
+            largest_free_area = Mathf::Max(largest_free_area, i.GetLargestFreeArea());
+        }
+
+        return free_area > m_atlas_layers.Size() * layer_area / 2 && largest_free_area < free_area / 4;
+    }
+
+    // drops unused entries and repacks live ones into a new atlas, then patches the uv of range meshes
+    void CanvasRenderer::DefragAtlas()
+    {
+        m_atlas_defrag_frame = Time::GetFrameCount();
+
+        List<AtlasEntry*> entries;
+        Vector<AtlasEntry*> unused;
+        for (auto i : m_atlas_entries)
+        {
+            if (i->ref_count > 0)
+            {
+                entries.AddLast(i);
             }
             else
             {
-                return nullptr;
+                unused.Add(i);
             }
         }
-        else
+        for (auto i : unused)
         {
-            AtlasTreeNode* left = this->FindAtlasTreeNodeToInsert(w, h, node->children[0]);
-            if (left)
+            this->FreeAtlasEntry(i);
+        }
+
+        entries.Sort([](const AtlasEntry* a, const AtlasEntry* b) {
+            if (a->rect.h == b->rect.h)
             {
-                return left;
+                return a->rect.w > b->rect.w;
             }
             else
             {
-                return this->FindAtlasTreeNodeToInsert(w, h, node->children[1]);
+                return a->rect.h > b->rect.h;
+            }
+        });
+
+        Vector<AtlasPacker> layers;
+        layers.Add(AtlasPacker(ATLAS_SIZE, ATLAS_SIZE));
+        Map<AtlasEntry*, int> entry_indices;
+        Vector<Recti> rects;
+        Vector<int> rect_layers;
+
+        for (auto i : entries)
+        {
+            Recti rect;
+            int layer = layers.Size() - 1;
+            for (int j = 0; j < layers.Size(); ++j)
+            {
+                if (layers[j].Insert(i->rect.w + PADDING_SIZE, i->rect.h + PADDING_SIZE, rect))
+                {
+                    layer = j;
+                    break;
+                }
+                else if (j == layers.Size() - 1)
+                {
+                    // repacking needs more layers than the atlas has, keep the current one
+                    if (layers.Size() >= m_atlas_layers.Size())
+                    {
+                        return;
+                    }
+
+                    layers.Add(AtlasPacker(ATLAS_SIZE, ATLAS_SIZE));
+                }
+            }
+
+            entry_indices.Add(i, rects.Size());
+            rects.Add(Recti(rect.x, rect.y, i->rect.w, i->rect.h));
+            rect_layers.Add(layer);
+        }
+
+        Ref<Texture> new_atlas = this->CreateAtlasTexture(layers.Size());
+
+        for (auto i : entries)
+        {
+            int index = entry_indices[i];
+            new_atlas->CopyTexture(
+                m_atlas,
+                i->layer, 0,
+                i->rect.x, i->rect.y,
+                i->rect.w, i->rect.h,
+                rect_layers[index], 0,
+                rects[index].x, rects[index].y,
+                rects[index].w, rects[index].h);
+        }
+
+        for (auto& i : m_view_ranges)
+        {
+            int k = 0;
+            for (auto& j : i.meshes)
+            {
+                if (j.texture || j.image)
+                {
+                    AtlasEntry* entry = i.atlas_entries[k++];
+                    int index = entry_indices[entry];
+                    float offset_x = (rects[index].x - entry->rect.x) / (float) ATLAS_SIZE;
+                    float offset_y = (rects[index].y - entry->rect.y) / (float) ATLAS_SIZE;
+
+                    for (auto& v : j.vertices)
+                    {
+                        v.uv.x += offset_x;
+                        v.uv.y += offset_y;
+                        v.uv2.x = (float) rect_layers[index];
+                    }
+                }
             }
         }
+
+        for (auto i : entries)
+        {
+            int index = entry_indices[i];
+            i->rect = rects[index];
+            i->layer = rect_layers[index];
+        }
+
+        m_atlas = new_atlas;
+        m_atlas_array_size = layers.Size();
+        m_atlas_layers = layers;
+
+        const auto& materials = this->GetMaterials();
+        for (auto& i : materials)
+        {
+            i->SetTexture("u_texture", m_atlas);
+        }
     }
 
     void CanvasRenderer::HandleTouchEvent()
@@ -737,6 +1297,18 @@ void main()
         return all_positive || all_negative;
     }
 
+    static const ViewMesh* FindBaseViewMesh(const CanvasViewRange& range)
+    {
+        for (const auto& i : range.meshes)
+        {
+            if (i.base_view)
+            {
+                return &i;
+            }
+        }
+        return nullptr;
+    }
+
     void CanvasRenderer::HitViews(const Touch& t)
     {
         Vector2i pos = Vector2i((int) t.position.x, (int) t.position.y);
@@ -744,13 +1316,14 @@ void main()
 
         if (t.phase == TouchPhase::Began)
         {
-            for (int i = m_view_meshes.Size() - 1; i >= 0; --i)
+            for (int i = m_view_ranges.Size() - 1; i >= 0; --i)
             {
-                if (m_view_meshes[i].base_view)
+                const ViewMesh* mesh = FindBaseViewMesh(m_view_ranges[i]);
+                if (mesh)
                 {
-                    if (IsPointInView(pos, m_view_meshes[i].vertices))
+                    if (IsPointInView(pos, mesh->vertices))
                     {
-                        View* view = m_view_meshes[i].view;
+                        View* view = mesh->view;
 
                         List<View*>* touch_down_views_ptr;
                         if (m_touch_down_views.TryGet(t.fingerId, &touch_down_views_ptr))
@@ -790,13 +1363,14 @@ void main()
                 }
             }
 
-            for (int i = m_view_meshes.Size() - 1; i >= 0; --i)
+            for (int i = m_view_ranges.Size() - 1; i >= 0; --i)
             {
-                if (m_view_meshes[i].base_view)
+                const ViewMesh* mesh = FindBaseViewMesh(m_view_ranges[i]);
+                if (mesh)
                 {
-                    if (IsPointInView(pos, m_view_meshes[i].vertices))
+                    if (IsPointInView(pos, mesh->vertices))
                     {
-                        View* view = m_view_meshes[i].view;
+                        View* view = mesh->view;
 
                         bool block_event = view->OnTouchMoveInside(pos);
 
@@ -810,13 +1384,14 @@ void main()
         }
         else if (t.phase == TouchPhase::Ended)
         {
-            for (int i = m_view_meshes.Size() - 1; i >= 0; --i)
+            for (int i = m_view_ranges.Size() - 1; i >= 0; --i)
             {
-                if (m_view_meshes[i].base_view)
+                const ViewMesh* mesh = FindBaseViewMesh(m_view_ranges[i]);
+                if (mesh)
                 {
-                    View* view = m_view_meshes[i].view;
+                    View* view = mesh->view;
 
-                    if (IsPointInView(pos, m_view_meshes[i].vertices))
+                    if (IsPointInView(pos, mesh->vertices))
                     {
                         bool block_event = view->OnTouchUpInside(pos);
 
@@ -828,13 +1403,14 @@ void main()
                 }
             }
 
-            for (int i = m_view_meshes.Size() - 1; i >= 0; --i)
+            for (int i = m_view_ranges.Size() - 1; i >= 0; --i)
             {
-                if (m_view_meshes[i].base_view)
+                const ViewMesh* mesh = FindBaseViewMesh(m_view_ranges[i]);
+                if (mesh)
                 {
-                    View* view = m_view_meshes[i].view;
+                    View* view = mesh->view;
 
-                    if (!IsPointInView(pos, m_view_meshes[i].vertices))
+                    if (!IsPointInView(pos, mesh->vertices))
                     {
                         bool block_event = view->OnTouchUpOutside(pos);
 
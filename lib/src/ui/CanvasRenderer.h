@@ -18,23 +18,49 @@
 #pragma once
 
 #include "graphics/MeshRenderer.h"
+#include "graphics/Mesh.h"
 #include "graphics/Texture.h"
 #include "container/Vector.h"
 #include "container/Map.h"
 #include "math/Recti.h"
+#include "AtlasPacker.h"
 #include "View.h"
 
 namespace Viry3D
 {
 	class View;
 	class Mesh;
+    class Image;
     struct Touch;
 
-    struct AtlasTreeNode
+    // region of a texture or image copied into the atlas
+    struct AtlasEntry
     {
+        void* key = nullptr;
+        WeakRef<Texture> texture;
+        WeakRef<Image> image;
         Recti rect;
-        int layer;
-        Vector<AtlasTreeNode*> children;
+        int layer = 0;
+        // view ranges drawing it, entries without refs are evicted least recently used first
+        int ref_count = 0;
+        int used_frame = 0;
+    };
+
+    // geometry of one view in the canvas buffers, in fill order
+    struct CanvasViewRange
+    {
+        View* view = nullptr;
+        Vector<ViewMesh> meshes;
+        Rect parent_clip_rect = Rect(0, 0, 1, 1);
+        Rect clip_rect = Rect(0, 0, 1, 1);
+        int vertex_start = 0;
+        int vertex_capacity = 0;
+        int index_start = 0;
+        int index_capacity = 0;
+        // ranges of subviews follow, up to this one
+        int subtree_end = 0;
+        // one per textured mesh, in mesh order
+        Vector<AtlasEntry*> atlas_entries;
     };
 
     class CanvasRenderer : public MeshRenderer
@@ -49,14 +75,27 @@ namespace Viry3D
 		void RemoveView(const Ref<View>& view);
         void RemoveAllViews();
 		void MarkCanvasDirty();
+        void MarkViewDirty(View* view);
 
 	private:
         void CreateMaterial();
         void NewAtlasTextureLayer();
         void UpdateCanvas();
+        void FillViewRanges(View* view, const Rect& clip_rect);
+        bool UpdateDirtyViews();
+        bool RefillViewRange(View* view, const Rect& clip_rect, Vector<int>& ranges);
+        void WriteViewRange(const CanvasViewRange& range, Vector<Mesh::Submesh>* submeshes, Vector<Rect>* clip_rects);
+        bool UpdateMeshesAtlas(const Vector<ViewMesh*>& meshes);
         void UpdateAtlas(ViewMesh& mesh, bool& updated);
-        AtlasTreeNode* FindAtlasTreeNodeToInsert(int w, int h, AtlasTreeNode* node);
-        void ReleaseAtlasTreeNode(AtlasTreeNode* node);
+        Ref<Texture> CreateAtlasTexture(int array_size);
+        bool InsertAtlasRect(int w, int h, Recti& rect, int& layer);
+        AtlasEntry* FindAtlasEntry(const ViewMesh& mesh);
+        bool EvictAtlasEntry();
+        void FreeAtlasEntry(AtlasEntry* entry);
+        void AcquireAtlasEntries(CanvasViewRange& range);
+        void ReleaseAtlasEntries(Vector<AtlasEntry*>& entries);
+        bool IsAtlasFragmented() const;
+        void DefragAtlas();
         void HandleTouchEvent();
         void HitViews(const Touch& t);
 
@@ -65,9 +104,15 @@ namespace Viry3D
 		bool m_canvas_dirty;
         Ref<Texture> m_atlas;
         int m_atlas_array_size;
-        Vector<AtlasTreeNode*> m_atlas_tree;
-        Map<void*, AtlasTreeNode*> m_atlas_cache;
-        Vector<ViewMesh> m_view_meshes;
+        Vector<AtlasPacker> m_atlas_layers;
+        Vector<AtlasEntry*> m_atlas_entries;
+        Map<void*, AtlasEntry*> m_atlas_cache;
+        int m_atlas_defrag_frame;
+        Vector<CanvasViewRange> m_view_ranges;
+        Vector<View*> m_dirty_views;
+        // copy of the buffer content, patched by ranges
+        Vector<Vertex> m_vertices;
+        Vector<unsigned short> m_indices;
         Map<int, List<View*>> m_touch_down_views;
         FilterMode m_filter_mode;
 	};
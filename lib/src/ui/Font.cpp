@@ -19,11 +19,13 @@
 #include "io/File.h"
 #include "memory/Memory.h"
 #include "graphics/Texture.h"
+#include "graphics/Image.h"
+#include "math/Mathf.h"
 #include "Debug.h"
 #include "Application.h"
+#include "thread/ThreadPool.h"
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include "ftoutln.h"
 
 extern "C"
 {
@@ -31,11 +33,93 @@ extern "C"
     void z_error(char* m) { }
 }
 
+// glyphs rasterized by one worker task
+#define GLYPH_TASK_SIZE 32
+
 namespace Viry3D
 {
 	static FT_Library g_ft_lib;
+    // faces are created and destroyed on worker threads too, the library is not thread safe for that
+    static Mutex g_ft_mutex;
     Map<FontType, Ref<Font>> Font::m_fonts;
 
+    // worker side of a font, a face can only be used by one thread at a time so each worker takes its own,
+    // queued tasks keep it alive when the font is released before they run
+    class GlyphRasterizer
+    {
+    public:
+        GlyphRasterizer(const ByteBuffer& face_buffer):
+            m_face_buffer(face_buffer)
+        {
+        }
+
+        ~GlyphRasterizer()
+        {
+            std::lock_guard<Mutex> lock(g_ft_mutex);
+            for (auto i : m_faces)
+            {
+                FT_Done_Face(i);
+            }
+        }
+
+        FT_Face AcquireFace()
+        {
+            {
+                std::lock_guard<Mutex> lock(m_mutex);
+                if (m_faces.Size() > 0)
+                {
+                    FT_Face face = m_faces[m_faces.Size() - 1];
+                    m_faces.Remove(m_faces.Size() - 1);
+                    return face;
+                }
+            }
+
+            std::lock_guard<Mutex> lock(g_ft_mutex);
+            FT_Face face;
+            auto err = FT_New_Memory_Face(g_ft_lib, m_face_buffer.Bytes(), m_face_buffer.Size(), 0, &face);
+            if (err)
+            {
+                return nullptr;
+            }
+            FT_Set_Char_Size(face, SDF_GLYPH_SIZE << 6, SDF_GLYPH_SIZE << 6, 0, 0);
+            return face;
+        }
+
+        void ReleaseFace(FT_Face face)
+        {
+            std::lock_guard<Mutex> lock(m_mutex);
+            m_faces.Add(face);
+        }
+
+        void AddGlyph(const GlyphInfo& glyph)
+        {
+            std::lock_guard<Mutex> lock(m_mutex);
+            m_done_glyphs.Add(glyph);
+        }
+
+        void AddFailed(char32_t c)
+        {
+            std::lock_guard<Mutex> lock(m_mutex);
+            m_failed_chars.Add(c);
+        }
+
+        void TakeGlyphs(Vector<GlyphInfo>& glyphs, Vector<char32_t>& failed)
+        {
+            std::lock_guard<Mutex> lock(m_mutex);
+            glyphs = std::move(m_done_glyphs);
+            failed = std::move(m_failed_chars);
+            m_done_glyphs.Clear();
+            m_failed_chars.Clear();
+        }
+
+    private:
+        ByteBuffer m_face_buffer;
+        Mutex m_mutex;
+        Vector<FT_Face> m_faces;
+        Vector<GlyphInfo> m_done_glyphs;
+        Vector<char32_t> m_failed_chars;
+    };
+
 	void Font::Init()
 	{
 		FT_Init_FreeType(&g_ft_lib);
@@ -43,6 +127,13 @@ namespace Viry3D
 
 	void Font::Done()
 	{
+        // wait for glyph tasks still using faces of the library
+        ThreadPool* thread_pool = Application::Instance()->GetThreadPool();
+        if (thread_pool)
+        {
+            thread_pool->WaitAll();
+        }
+
         m_fonts.Clear();
 
 		FT_Done_FreeType(g_ft_lib);
@@ -94,12 +185,19 @@ namespace Viry3D
             auto buffer = File::ReadAllBytes(file);
 
             FT_Face face;
-            auto err = FT_New_Memory_Face(g_ft_lib, buffer.Bytes(), buffer.Size(), 0, &face);
+            FT_Error err;
+            {
+                std::lock_guard<Mutex> lock(g_ft_mutex);
+                err = FT_New_Memory_Face(g_ft_lib, buffer.Bytes(), buffer.Size(), 0, &face);
+            }
 			if (!err)
 			{
 				font = Ref<Font>(new Font());
 				font->m_font = (void*) face;
                 font->m_face_buffer = buffer;
+                font->m_rasterizer = RefMake<GlyphRasterizer>(buffer);
+
+                FT_Set_Char_Size(face, SDF_GLYPH_SIZE << 6, SDF_GLYPH_SIZE << 6, 0, 0);
 			}
 		}
         else
@@ -110,8 +208,26 @@ namespace Viry3D
 		return font;
 	}
 
+    void Font::WarmGlyphs(FontType type, const Vector<String>& strings)
+    {
+        Ref<Font> font = Font::GetFont(type);
+        if (!font)
+        {
+            return;
+        }
+
+        Vector<char32_t> chars;
+        for (const auto& i : strings)
+        {
+            chars.AddRange(i.ToUnicode32());
+        }
+
+        font->RequestGlyphs(chars);
+    }
+
 	Font::Font():
-		m_font(nullptr)
+		m_font(nullptr),
+        m_glyph_version(0)
 	{
 
 	}
@@ -120,137 +236,244 @@ namespace Viry3D
 	{
 		if (m_font)
 		{
+            std::lock_guard<Mutex> lock(g_ft_mutex);
 			FT_Done_Face((FT_Face) m_font);
 		}
 	}
 
-	GlyphInfo Font::GetGlyph(char32_t c, int size, bool bold, bool italic, bool mono)
-	{
-		int size_key = size | (bold ? (1 << 24) : 0) | (italic ? (1 << 16) : 0);
+    // signed distance to the glyph edge, 0.5 on the edge and SDF_GLYPH_SPREAD pixels away at 0 or 1,
+    // pixels next to the edge use their coverage for a sub pixel estimate
+    static ByteBuffer CreateDistanceField(const unsigned char* coverage, int pitch, int width, int height)
+    {
+        const int spread = SDF_GLYPH_SPREAD;
+        const int search = SDF_GLYPH_SPREAD + 1;
+        int sdf_width = width + spread * 2;
+        int sdf_height = height + spread * 2;
 
-		Map<int, GlyphInfo>* p_size_glyphs;
-		if (!m_glyphs.TryGet(c, &p_size_glyphs))
-		{
-			Map<int, GlyphInfo> size_glyphs;
-			m_glyphs.Add(c, size_glyphs);
+        auto sample = [=](int x, int y) {
+            if (x < 0 || y < 0 || x >= width || y >= height)
+            {
+                return 0;
+            }
+            return (int) coverage[y * pitch + x];
+        };
 
-			p_size_glyphs = &m_glyphs[c];
-		}
+        ByteBuffer pixels(sdf_width * sdf_height * 4);
 
-		GlyphInfo* p_glyph;
-		if (!p_size_glyphs->TryGet(size_key, &p_glyph))
-		{
-			GlyphInfo glyph;
-			p_size_glyphs->Add(size_key, glyph);
+        for (int i = 0; i < sdf_height; ++i)
+        {
+            for (int j = 0; j < sdf_width; ++j)
+            {
+                int x = j - spread;
+                int y = i - spread;
+                int alpha = sample(x, y);
+                bool inside = alpha >= 128;
 
-			p_glyph = &(*p_size_glyphs)[size_key];
-		}
-		else
-		{
-			return *p_glyph;
-		}
+                int min_distance_sq = search * search;
+                for (int m = -search; m <= search; ++m)
+                {
+                    for (int n = -search; n <= search; ++n)
+                    {
+                        int distance_sq = m * m + n * n;
+                        if (distance_sq < min_distance_sq && (sample(x + n, y + m) >= 128) != inside)
+                        {
+                            min_distance_sq = distance_sq;
+                        }
+                    }
+                }
 
-		p_glyph->c = c;
-		p_glyph->size = size;
-		p_glyph->bold = bold;
-		p_glyph->italic = italic;
-		p_glyph->mono = mono;
+                float distance = sqrt((float) min_distance_sq) - 0.5f;
+                if (!inside)
+                {
+                    distance = -distance;
+                }
+                if (alpha > 0 && alpha < 255)
+                {
+                    distance = alpha / 255.0f - 0.5f;
+                }
+
+                float value = Mathf::Clamp01(0.5f + distance / (spread * 2));
 
-		FT_Face face = (FT_Face) m_font;
-        FT_Set_Char_Size(face, size << 6, size << 6, 0, 0);
+                byte* p = &pixels[(i * sdf_width + j) * 4];
+                p[0] = 255;
+                p[1] = 255;
+                p[2] = 255;
+                p[3] = (byte) (value * 255.0f + 0.5f);
+            }
+        }
+
+        return pixels;
+    }
+
+    // called on worker threads with their own face
+    static GlyphInfo RasterizeGlyph(FT_Face face, char32_t c)
+    {
+		GlyphInfo glyph;
+		glyph.c = c;
 
 		FT_GlyphSlot slot = face->glyph;
-		auto glyph_index = FT_Get_Char_Index(face, c);
 
-		if (mono)
-		{
-			FT_Load_Char(face, c, FT_LOAD_MONOCHROME | FT_LOAD_TARGET_MONO);
-		}
-		else
-		{
-			FT_Load_Char(face, c, FT_LOAD_DEFAULT);
-		}
+        // hinting at the reference size would distort the scaled shapes
+		glyph.glyph_index = FT_Get_Char_Index(face, c);
+		FT_Load_Glyph(face, glyph.glyph_index, FT_LOAD_NO_HINTING);
+		FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL);
 
-		if (bold)
-		{
-			FT_Outline_Embolden(&face->glyph->outline, 1 << 6);
-		}
+        glyph.width = (short) slot->bitmap.width;
+        glyph.height = (short) slot->bitmap.rows;
+		glyph.bearing_x = (short) slot->bitmap_left;
+		glyph.bearing_y = (short) slot->bitmap_top;
+		glyph.advance_x = (short) slot->advance.x;
+		glyph.advance_y = (short) slot->advance.y;
 
-		if (italic)
-		{
-			float lean = 0.5f;
-			FT_Matrix matrix;
-			matrix.xx = 1 << 16;
-			matrix.xy = (int) (lean * (1 << 16));
-			matrix.yx = 0;
-			matrix.yy = (1 << 16);
-			FT_Outline_Transform(&face->glyph->outline, &matrix);
-		}
+        if (glyph.width > 0 && glyph.height > 0)
+        {
+            glyph.image = RefMake<Image>();
+            glyph.image->width = glyph.width + SDF_GLYPH_SPREAD * 2;
+            glyph.image->height = glyph.height + SDF_GLYPH_SPREAD * 2;
+            glyph.image->format = ImageFormat::R8G8B8A8;
+            glyph.image->data = CreateDistanceField(slot->bitmap.buffer, slot->bitmap.pitch, glyph.width, glyph.height);
+        }
 
-		if (mono)
-		{
-			FT_Render_Glyph(face->glyph, FT_RENDER_MODE_MONO);
-		}
-		else
+        return glyph;
+    }
+
+	const GlyphInfo& Font::GetGlyph(char32_t c)
+	{
+		GlyphInfo* p_glyph;
+		if (m_glyphs.TryGet(c, &p_glyph))
 		{
-			FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL);
+			return *p_glyph;
 		}
 
-		p_glyph->glyph_index = glyph_index;
-        p_glyph->width = slot->bitmap.width;
-        p_glyph->height = slot->bitmap.rows;
-		p_glyph->bearing_x = slot->bitmap_left;
-		p_glyph->bearing_y = slot->bitmap_top;
-		p_glyph->advance_x = (int) (slot->advance.x >> 6);
-		p_glyph->advance_y = (int) (slot->advance.y >> 6);
+        this->MergeGlyphs();
+        if (m_glyphs.TryGet(c, &p_glyph))
+        {
+            return *p_glyph;
+        }
+
+        m_glyphs.Add(c, RasterizeGlyph((FT_Face) m_font, c));
+
+		return m_glyphs[c];
+	}
 
-        if (p_glyph->width > 0 && p_glyph->height > 0)
+    const GlyphInfo* Font::FindGlyph(char32_t c)
+    {
+        GlyphInfo* p_glyph;
+        if (m_glyphs.TryGet(c, &p_glyph))
         {
-            ByteBuffer pixels = ByteBuffer(p_glyph->width * p_glyph->height * 4);
+            return p_glyph;
+        }
+
+        // no worker threads, rasterize in place
+        if (Application::Instance()->GetThreadPool() == nullptr)
+        {
+            return &this->GetGlyph(c);
+        }
+
+        this->MergeGlyphs();
+        if (m_glyphs.TryGet(c, &p_glyph))
+        {
+            return p_glyph;
+        }
+
+        this->RequestGlyphs(Vector<char32_t>({ c }));
+
+        return nullptr;
+    }
+
+    void Font::RequestGlyphs(const String& text)
+    {
+        this->RequestGlyphs(text.ToUnicode32());
+    }
 
-            if (mono)
+    void Font::RequestGlyphs(const Vector<char32_t>& chars)
+    {
+        ThreadPool* thread_pool = Application::Instance()->GetThreadPool();
+
+        Vector<char32_t> missing;
+        for (auto c : chars)
+        {
+            if (!m_glyphs.Contains(c) && !m_glyph_requests.Contains(c))
             {
-                for (int i = 0; i < p_glyph->height; ++i)
+                if (thread_pool)
                 {
-                    for (int j = 0; j < p_glyph->width; ++j)
-                    {
-                        unsigned char bit = slot->bitmap.buffer[i * slot->bitmap.pitch + j / 8] & (0x1 << (7 - j % 8));
-                        bit = bit == 0 ? 0 : 255;
-
-                        pixels[i * p_glyph->width * 4 + j * 4 + 0] = 255;
-                        pixels[i * p_glyph->width * 4 + j * 4 + 1] = 255;
-                        pixels[i * p_glyph->width * 4 + j * 4 + 2] = 255;
-                        pixels[i * p_glyph->width * 4 + j * 4 + 3] = bit;
-                    }
+                    m_glyph_requests.Add(c, true);
+                    missing.Add(c);
+                }
+                else
+                {
+                    this->GetGlyph(c);
                 }
             }
-            else
-            {
-                for (int i = 0; i < p_glyph->height; ++i)
+        }
+
+        for (int i = 0; i < missing.Size(); i += GLYPH_TASK_SIZE)
+        {
+            Ref<GlyphRasterizer> rasterizer = m_rasterizer;
+            Vector<char32_t> batch;
+            batch.AddRange(&missing[i], Mathf::Min(GLYPH_TASK_SIZE, missing.Size() - i));
+
+            Thread::Task task;
+            task.job = [=]() {
+                FT_Face face = rasterizer->AcquireFace();
+                for (auto c : batch)
                 {
-                    for (int j = 0; j < p_glyph->width; ++j)
+                    if (face)
                     {
-                        unsigned char alpha = slot->bitmap.buffer[i * slot->bitmap.pitch + j];
-
-                        pixels[i * p_glyph->width * 4 + j * 4 + 0] = 255;
-                        pixels[i * p_glyph->width * 4 + j * 4 + 1] = 255;
-                        pixels[i * p_glyph->width * 4 + j * 4 + 2] = 255;
-                        pixels[i * p_glyph->width * 4 + j * 4 + 3] = alpha;
+                        rasterizer->AddGlyph(RasterizeGlyph(face, c));
+                    }
+                    else
+                    {
+                        rasterizer->AddFailed(c);
                     }
                 }
-            }
+                if (face)
+                {
+                    rasterizer->ReleaseFace(face);
+                }
 
-            p_glyph->image = RefMake<Image>();
-            *p_glyph->image = {
-                p_glyph->width,
-                p_glyph->height,
-                ImageFormat::R8G8B8A8,
-                pixels
+                return Ref<Object>();
             };
+            thread_pool->AddTask(task);
         }
+    }
 
-		return *p_glyph;
-	}
+    // moves glyphs finished by workers into the glyph map, only on the main thread
+    void Font::MergeGlyphs()
+    {
+        Vector<GlyphInfo> glyphs;
+        Vector<char32_t> failed;
+        m_rasterizer->TakeGlyphs(glyphs, failed);
+
+        if (glyphs.Size() == 0 && failed.Size() == 0)
+        {
+            return;
+        }
+
+        for (const auto& i : glyphs)
+        {
+            m_glyph_requests.Remove(i.c);
+            if (!m_glyphs.Contains(i.c))
+            {
+                m_glyphs.Add(i.c, i);
+            }
+        }
+
+        // a worker could not open its face
+        for (auto c : failed)
+        {
+            m_glyph_requests.Remove(c);
+            this->GetGlyph(c);
+        }
+
+        m_glyph_version++;
+    }
+
+    int Font::GetGlyphVersion()
+    {
+        this->MergeGlyphs();
+        return m_glyph_version;
+    }
 
     bool Font::HasKerning() const
     {
@@ -265,6 +488,6 @@ namespace Viry3D
         FT_Vector kerning;
         FT_Get_Kerning(face, previous_glyph_index, glyph_index, FT_KERNING_UNFITTED, &kerning);
 
-        return Vector2i((int) kerning.x >> 6, (int) kerning.x >> 6);
+        return Vector2i((int) kerning.x, (int) kerning.y);
     }
 }
@@ -20,9 +20,16 @@
 #include "Object.h"
 #include "memory/Ref.h"
 #include "container/Map.h"
+#include "container/Vector.h"
 #include "string/String.h"
 #include "math/Vector2i.h"
 
+// glyphs are rasterized once at this size into signed distance fields,
+// the ui shader scales them to any font size
+#define SDF_GLYPH_SIZE 32
+// distance range in pixels at SDF_GLYPH_SIZE, also the padding around glyph images
+#define SDF_GLYPH_SPREAD 4
+
 namespace Viry3D
 {
     enum class FontType
@@ -34,21 +41,21 @@ namespace Viry3D
     };
 
     class Image;
+    class GlyphRasterizer;
 
+    // metrics in pixels at SDF_GLYPH_SIZE
 	struct GlyphInfo
 	{
 		char32_t c;
-		int size;
 		unsigned int glyph_index;
-        int width;
-        int height;
-		int bearing_x;
-		int bearing_y;
-		int advance_x;
-		int advance_y;
-		bool bold;
-		bool italic;
-		bool mono;
+        short width;
+        short height;
+		short bearing_x;
+		short bearing_y;
+        // 26.6 fixed point
+		short advance_x;
+		short advance_y;
+        // distance field of width + SDF_GLYPH_SPREAD * 2 by height + SDF_GLYPH_SPREAD * 2, null for empty glyphs
         Ref<Image> image;
 	};
 
@@ -60,17 +67,30 @@ namespace Viry3D
         static Ref<Font> GetFont(FontType type);
 		static Ref<Font> LoadFromFile(const String& file);
 		virtual ~Font();
-		GlyphInfo GetGlyph(char32_t c, int size, bool bold, bool italic, bool mono);
+        // rasterizes the glyphs of the strings on worker threads, call at startup with the ui string table
+        static void WarmGlyphs(FontType type, const Vector<String>& strings);
+		const GlyphInfo& GetGlyph(char32_t c);
+        // returns null and queues the glyph for a worker thread when it is not rasterized yet
+        const GlyphInfo* FindGlyph(char32_t c);
+        void RequestGlyphs(const String& text);
+        void RequestGlyphs(const Vector<char32_t>& chars);
+        // changes when glyphs rasterized by workers become available
+        int GetGlyphVersion();
         bool HasKerning() const;
+        // 26.6 fixed point at SDF_GLYPH_SIZE
         Vector2i GetKerning(unsigned int previous_glyph_index, unsigned int glyph_index);
 
 	private:
 		Font();
+        void MergeGlyphs();
 
     private:
         static Map<FontType, Ref<Font>> m_fonts;
 		void* m_font;
         ByteBuffer m_face_buffer;
-		Map<char32_t, Map<int, GlyphInfo>> m_glyphs;
+		Map<char32_t, GlyphInfo> m_glyphs;
+        Ref<GlyphRasterizer> m_rasterizer;
+        Map<char32_t, bool> m_glyph_requests;
+        int m_glyph_version;
 	};
 }
@@ -295,7 +295,11 @@ void main()
             {
                 if (!mesh || vertices.Size() > mesh->GetVertexCount() || indices.Size() > mesh->GetIndexCount())
                 {
-                    mesh = RefMake<Mesh>(vertices, indices, submeshes, true);
+                    static const VertexLayout layout = VertexLayout::Compact(
+                        VertexLayout::GetAttributeMask(VertexAttributeType::Color) |
+                        VertexLayout::GetAttributeMask(VertexAttributeType::Texcoord));
+
+                    mesh = RefMake<Mesh>(vertices, indices, submeshes, true, layout);
                     this->SetMesh(mesh);
 
 #if VR_VULKAN
@@ -89,6 +89,9 @@ namespace Viry3D
 
     void InputField::Update()
     {
+        // the text label shapes again when its glyphs finish rasterizing
+        View::Update();
+
         // blink caret
         if (m_focused)
         {
@@ -159,7 +162,7 @@ namespace Viry3D
                             this->SetText(m_label->GetText() + split);
 
                             const auto& lines = m_label->GetLines();
-                            this->SetCaretPos(0, lines[0].meshes.Size() - 1);
+                            this->SetCaretPos(0, lines[0].glyph_count - 1);
                         }
 
                         if (r_index >= 0)
@@ -180,7 +183,7 @@ namespace Viry3D
                                 this->SetText(String(&m_unicodes[0], m_unicodes.Size()));
 
                                 const auto& lines = m_label->GetLines();
-                                this->SetCaretPos(0, lines[0].meshes.Size() - 1);
+                                this->SetCaretPos(0, lines[0].glyph_count - 1);
                             }
                             else
                             {
@@ -246,7 +249,7 @@ namespace Viry3D
         const auto& lines = m_label->GetLines();
         if (lines.Size() > 0)
         {
-            this->SetCaretPos(0, lines[0].meshes.Size() - 1);
+            this->SetCaretPos(0, lines[0].glyph_count - 1);
         }
         else
         {
@@ -280,7 +283,8 @@ namespace Viry3D
         }
         else
         {
-            m_caret->SetOffset(Vector2i((int) m_label_margin.x + lines[line].meshes[index].vertices[3].x, 0));
+            const auto& glyphs = m_label->GetGlyphs();
+            m_caret->SetOffset(Vector2i((int) m_label_margin.x + glyphs[lines[line].glyph_start + index].x_max, 0));
         }
         m_caret_pos.x = line;
         m_caret_pos.y = index;
@@ -20,6 +20,9 @@
 #include "Font.h"
 #include "graphics/Texture.h"
 
+#define ITALIC_LEAN 0.5f
+#define SHAPED_TEXT_CACHE_SIZE 256
+
 namespace Viry3D
 {
     enum class TagType
@@ -210,6 +213,9 @@ namespace Viry3D
     }
 
 
+    static Map<String, Ref<ShapedText>> g_shaped_texts;
+    static const GlyphInfo g_pending_glyph = { 0, 0, 0, 0, 0, 0, (SDF_GLYPH_SIZE / 2) << 6, 0, Ref<Image>() };
+
     Label::Label():
         m_font_style(FontStyle::Normal),
         m_font_size(20),
@@ -217,6 +223,7 @@ namespace Viry3D
         m_rich(false),
         m_mono(false),
         m_text_alignment(ViewAlignment::HCenter | ViewAlignment::VCenter),
+        m_glyph_version(0),
         m_lines_dirty(false)
     {
     
@@ -292,38 +299,128 @@ namespace Viry3D
             m_lines_dirty = false;
             this->ProcessText();
         }
-        return m_lines;
+
+        static const Vector<LabelLine> s_empty_lines;
+        return m_shaped ? m_shaped->lines : s_empty_lines;
+    }
+
+    const Vector<ShapedGlyph>& Label::GetGlyphs()
+    {
+        if (m_lines_dirty)
+        {
+            m_lines_dirty = false;
+            this->ProcessText();
+        }
+
+        static const Vector<ShapedGlyph> s_empty_glyphs;
+        return m_shaped ? m_shaped->glyphs : s_empty_glyphs;
     }
 
     void Label::ProcessText()
     {
-        m_lines.Clear();
+        m_shaped.reset();
+        m_content_size = Vector2i(0, 0);
 
         if (!m_font)
         {
             return;
         }
 
+        // labels showing the same text share its shape, so setting it again skips parsing, glyph lookups and kerning
+        String key = String::Format("%p %d %d %d %d ", m_font.get(), m_font_size, (int) m_font_style, m_rich ? 1 : 0, m_mono ? 1 : 0) + m_text;
+
+        Ref<ShapedText>* shaped_ptr;
+        if (g_shaped_texts.TryGet(key, &shaped_ptr) && (*shaped_ptr)->font.lock() == m_font)
+        {
+            m_shaped = *shaped_ptr;
+        }
+        else
+        {
+            // taken before shaping so glyphs merged meanwhile still trigger a new shape
+            m_glyph_version = m_font->GetGlyphVersion();
+            m_shaped = this->ShapeText();
+
+            // incomplete shapes are not shared, their label shapes again once the glyphs arrive
+            g_shaped_texts.Remove(key);
+            if (m_shaped->complete)
+            {
+                g_shaped_texts.Add(key, m_shaped);
+            }
+
+            // drop shapes no label uses any more
+            if (g_shaped_texts.Size() > SHAPED_TEXT_CACHE_SIZE)
+            {
+                for (auto i = g_shaped_texts.begin(); i != g_shaped_texts.end(); )
+                {
+                    if (i->second.use_count() == 1)
+                    {
+                        i = g_shaped_texts.Remove(i);
+                    }
+                    else
+                    {
+                        ++i;
+                    }
+                }
+            }
+        }
+
+        int line_count = m_shaped->lines.Size();
+        m_content_size.x = m_shaped->width;
+        m_content_size.y = line_count * m_font_size;
+        if (line_count > 0)
+        {
+            m_content_size.y += (line_count - 1) * m_line_space;
+        }
+    }
+
+    Ref<ShapedText> Label::ShapeText() const
+    {
+        Ref<ShapedText> shaped = RefMake<ShapedText>();
+        shaped->font = m_font;
+
         auto chars = m_text.ToUnicode32();
 
+        // queue all missing glyphs of the text for the workers at once
+        m_font->RequestGlyphs(chars);
+
         Vector<TagInfo> tags;
         if (m_rich)
         {
             tags = ParseRichTag(chars);
         }
 
-        int pen_x = 0;
+        float pen_x = 0;
         int pen_y = 0;
         int x_max = 0;
-        int y_min = 0;
-        int y_max = INT_MIN;
         int line_x_max = 0;
         int line_y_min = 0;
         int font_size = m_font_size;
+        float scale = font_size / (float) SDF_GLYPH_SIZE;
         bool mono = m_mono;
         bool has_kerning = m_font->HasKerning();
         unsigned int previous = 0;
         LabelLine line;
+        line.glyph_start = 0;
+
+        const GlyphInfo& base_info = m_font->GetGlyph('A');
+        float base_y0 = base_info.bearing_y * scale;
+        float base_y1 = (base_info.bearing_y - base_info.height) * scale;
+        int baseline = Mathf::RoundToInt(base_y0 + (font_size - base_y0 + base_y1) * 0.5f);
+        const int char_space = 0;
+
+        // one screen pixel in distance units
+        float pixel = 1.0f / (SDF_GLYPH_SPREAD * 2 * scale);
+        float padding = SDF_GLYPH_SPREAD * scale;
+        float smoothing = mono ? 0.01f : pixel * 0.5f;
+
+        auto add_line = [&]() {
+            line.width = line_x_max;
+            line.height = pen_y - line_y_min;
+            line.glyph_count = shaped->glyphs.Size() - line.glyph_start;
+            shaped->lines.Add(line);
+
+            line.glyph_start = shaped->glyphs.Size();
+        };
 
         for (int i = 0; i < chars.Size(); ++i)
         {
@@ -331,20 +428,19 @@ namespace Viry3D
 
             if (c == '\n')
             {
-                line.width = line_x_max;
-                line.height = pen_y - line_y_min;
+                add_line();
+
                 line_x_max = 0;
                 line_y_min = 0;
                 pen_x = 0;
-                pen_y += -(font_size + m_line_space);
-
-                m_lines.Add(line);
-                line.Clear();
+                pen_y += -font_size;
 
                 continue;
             }
 
-            Color color = this->GetColor();
+            // label color is applied when filling meshes, except to colors set by tags
+            Color color(1, 1, 1, 1);
+            bool tint = true;
             bool bold = m_font_style == FontStyle::Bold || m_font_style == FontStyle::BoldAndItalic;
             bool italic = m_font_style == FontStyle::Italic || m_font_style == FontStyle::BoldAndItalic;
             Ref<Color> color_shadow;
@@ -361,6 +457,7 @@ namespace Viry3D
                         {
                         case TagType::Color:
                             color = Color::Parse(j.value);
+                            tint = false;
                             break;
                         case TagType::Bold:
                             bold = true;
@@ -382,42 +479,42 @@ namespace Viry3D
                 }
             }
 
-            GlyphInfo info = m_font->GetGlyph(c, font_size, bold, italic, mono);
+            // glyphs not rasterized yet are laid out as blanks of half the font size
+            const GlyphInfo* glyph_ptr = m_font->FindGlyph(c);
+            if (glyph_ptr == nullptr)
+            {
+                glyph_ptr = &g_pending_glyph;
+                shaped->complete = false;
+            }
+            const GlyphInfo& info = *glyph_ptr;
 
             //	kerning
             if (has_kerning && previous && info.glyph_index)
             {
-                pen_x += m_font->GetKerning(previous, info.glyph_index).x;
+                pen_x += m_font->GetKerning(previous, info.glyph_index).x / 64.0f * scale;
             }
 
-            auto base_info = m_font->GetGlyph('A', font_size, bold, italic, mono);
-            int base_y0 = base_info.bearing_y;
-            int base_y1 = base_info.bearing_y - base_info.height;
-            int baseline = Mathf::RoundToInt(base_y0 + (font_size - base_y0 + base_y1) * 0.5f);
-            const int char_space = 0;
+            int pen = Mathf::RoundToInt(pen_x);
+            int advance = Mathf::RoundToInt(info.advance_x / 64.0f * scale);
+            float glyph_x0 = pen + info.bearing_x * scale;
+            float glyph_y0 = pen_y + info.bearing_y * scale - baseline;
+            float glyph_x1 = glyph_x0 + info.width * scale;
+            float glyph_y1 = glyph_y0 - info.height * scale;
+            float glyph_baseline = (float) (pen_y - baseline);
+            float lean = italic ? ITALIC_LEAN : 0.0f;
 
-            int x0 = pen_x + info.bearing_x;
-            int y0 = pen_y + info.bearing_y - baseline;
-            int x1 = x0 + info.width;
+            // bold grows one pixel, italic leans the top right
+            int x1 = Mathf::RoundToInt(glyph_x1 + (bold ? 1 : 0) + (glyph_y0 - glyph_baseline) * lean);
             if (c == ' ' || c == '\t')
             {
-                x1 = pen_x + info.advance_x + char_space;
+                x1 = pen + advance + char_space;
             }
-            int y1 = y0 - info.height;
+            int y1 = Mathf::RoundToInt(glyph_y1);
 
             if (x_max < x1)
             {
                 x_max = x1;
             }
-            if (y_min > y1)
-            {
-                y_min = y1;
-            }
-            if (y_max < y0)
-            {
-                y_max = y0;
-            }
-
             if (line_x_max < x1)
             {
                 line_x_max = x1;
@@ -427,151 +524,110 @@ namespace Viry3D
                 line_y_min = y1;
             }
 
-            pen_x += info.advance_x + char_space;
-
-            CharMesh mesh;
-            mesh.c = c;
-            mesh.image = info.image;
-
-            float uv_x0 = 0;
-            float uv_y0 = 0;
-            float uv_x1 = 1;
-            float uv_y1 = 1;
-            int vertex_count = 0;
+            pen_x += info.advance_x / 64.0f * scale + char_space;
+
+            ShapedGlyph glyph;
+            glyph.c = c;
+            glyph.image = info.image;
+            glyph.vertex_start = shaped->vertices.Size();
+            glyph.x_max = x1;
+
+            // the quad covers the distance field padding, bold and outline move the edge in the shader
+            float edge = bold ? 0.5f - pixel * 0.5f : 0.5f;
+            float outline_edge = Mathf::Max(edge - pixel, 0.01f);
+
+            float quad_x0 = glyph_x0 - padding;
+            float quad_y0 = glyph_y0 + padding;
+            float quad_x1 = glyph_x1 + padding;
+            float quad_y1 = glyph_y1 - padding;
+            float quad_lean0 = (quad_y0 - glyph_baseline) * lean;
+            float quad_lean1 = (quad_y1 - glyph_baseline) * lean;
+
+            auto add_quad = [&](const Vector2i& offset, const Color& quad_color, bool quad_tint, float quad_edge) {
+                shaped->vertices.Add(Vector2i(Mathf::RoundToInt(quad_x0 + quad_lean0), Mathf::RoundToInt(quad_y0)) + offset);
+                shaped->vertices.Add(Vector2i(Mathf::RoundToInt(quad_x0 + quad_lean1), Mathf::RoundToInt(quad_y1)) + offset);
+                shaped->vertices.Add(Vector2i(Mathf::RoundToInt(quad_x1 + quad_lean1), Mathf::RoundToInt(quad_y1)) + offset);
+                shaped->vertices.Add(Vector2i(Mathf::RoundToInt(quad_x1 + quad_lean0), Mathf::RoundToInt(quad_y0)) + offset);
+                shaped->uv.Add(Vector2(0, 0));
+                shaped->uv.Add(Vector2(0, 1));
+                shaped->uv.Add(Vector2(1, 1));
+                shaped->uv.Add(Vector2(1, 0));
+                for (int j = 0; j < 4; ++j)
+                {
+                    shaped->colors.Add(quad_color);
+                    shaped->tints.Add(quad_tint ? 1 : 0);
+                    shaped->sdf.Add(Vector3(1, quad_edge, smoothing));
+                }
+            };
 
             if (color_shadow)
             {
-                Vector2i offset = Vector2i(1, -1);
-
-                mesh.vertices.Add(Vector2i(x0, y0) + offset);
-                mesh.vertices.Add(Vector2i(x0, y1) + offset);
-                mesh.vertices.Add(Vector2i(x1, y1) + offset);
-                mesh.vertices.Add(Vector2i(x1, y0) + offset);
-                mesh.uv.Add(Vector2(uv_x0, uv_y0));
-                mesh.uv.Add(Vector2(uv_x0, uv_y1));
-                mesh.uv.Add(Vector2(uv_x1, uv_y1));
-                mesh.uv.Add(Vector2(uv_x1, uv_y0));
-                mesh.colors.Add(*color_shadow);
-                mesh.colors.Add(*color_shadow);
-                mesh.colors.Add(*color_shadow);
-                mesh.colors.Add(*color_shadow);
-                mesh.indices.Add(vertex_count + 0);
-                mesh.indices.Add(vertex_count + 1);
-                mesh.indices.Add(vertex_count + 2);
-                mesh.indices.Add(vertex_count + 0);
-                mesh.indices.Add(vertex_count + 2);
-                mesh.indices.Add(vertex_count + 3);
-
-                vertex_count += 4;
+                add_quad(Vector2i(1, -1), *color_shadow, false, edge);
             }
 
             if (color_outline)
             {
-                Vector2i offsets[4];
-                offsets[0] = Vector2i(-1, 1);
-                offsets[1] = Vector2i(-1, -1);
-                offsets[2] = Vector2i(1, -1);
-                offsets[3] = Vector2i(1, 1);
-
-                for (int j = 0; j < 4; ++j)
-                {
-                    mesh.vertices.Add(Vector2i(x0, y0) + offsets[j]);
-                    mesh.vertices.Add(Vector2i(x0, y1) + offsets[j]);
-                    mesh.vertices.Add(Vector2i(x1, y1) + offsets[j]);
-                    mesh.vertices.Add(Vector2i(x1, y0) + offsets[j]);
-                    mesh.uv.Add(Vector2(uv_x0, uv_y0));
-                    mesh.uv.Add(Vector2(uv_x0, uv_y1));
-                    mesh.uv.Add(Vector2(uv_x1, uv_y1));
-                    mesh.uv.Add(Vector2(uv_x1, uv_y0));
-                    mesh.colors.Add(*color_outline);
-                    mesh.colors.Add(*color_outline);
-                    mesh.colors.Add(*color_outline);
-                    mesh.colors.Add(*color_outline);
-                    mesh.indices.Add(vertex_count + 0);
-                    mesh.indices.Add(vertex_count + 1);
-                    mesh.indices.Add(vertex_count + 2);
-                    mesh.indices.Add(vertex_count + 0);
-                    mesh.indices.Add(vertex_count + 2);
-                    mesh.indices.Add(vertex_count + 3);
-
-                    vertex_count += 4;
-                }
+                add_quad(Vector2i(0, 0), *color_outline, false, outline_edge);
             }
 
-            {
-                mesh.vertices.Add(Vector2i(x0, y0));
-                mesh.vertices.Add(Vector2i(x0, y1));
-                mesh.vertices.Add(Vector2i(x1, y1));
-                mesh.vertices.Add(Vector2i(x1, y0));
-                mesh.uv.Add(Vector2(uv_x0, uv_y0));
-                mesh.uv.Add(Vector2(uv_x0, uv_y1));
-                mesh.uv.Add(Vector2(uv_x1, uv_y1));
-                mesh.uv.Add(Vector2(uv_x1, uv_y0));
-                mesh.colors.Add(color);
-                mesh.colors.Add(color);
-                mesh.colors.Add(color);
-                mesh.colors.Add(color);
-                mesh.indices.Add(vertex_count + 0);
-                mesh.indices.Add(vertex_count + 1);
-                mesh.indices.Add(vertex_count + 2);
-                mesh.indices.Add(vertex_count + 0);
-                mesh.indices.Add(vertex_count + 2);
-                mesh.indices.Add(vertex_count + 3);
+            add_quad(Vector2i(0, 0), color, tint, edge);
 
-                vertex_count += 4;
-            }
+            glyph.vertex_count = shaped->vertices.Size() - glyph.vertex_start;
+            shaped->glyphs.Add(glyph);
 
             previous = info.glyph_index;
 
-            line.meshes.Add(mesh);
-
             if (underline)
             {
-                CharMesh underline_mesh;
-                underline_mesh.c = 0;
-                underline_mesh.image = Texture::GetSharedWhiteImage();
-
-                int ux0 = pen_x - (info.advance_x + char_space);
+                int ux0 = pen;
                 int uy0 = pen_y - baseline - 2;
-                int ux1 = ux0 + info.advance_x + char_space;
+                int ux1 = ux0 + advance + char_space;
                 int uy1 = uy0 - 1;
 
-                underline_mesh.vertices.Add(Vector2i(ux0, uy0));
-                underline_mesh.vertices.Add(Vector2i(ux0, uy1));
-                underline_mesh.vertices.Add(Vector2i(ux1, uy1));
-                underline_mesh.vertices.Add(Vector2i(ux1, uy0));
-                underline_mesh.uv.Add(Vector2(1.0f / 3, 1.0f / 3));
-                underline_mesh.uv.Add(Vector2(1.0f / 3, 2.0f / 3));
-                underline_mesh.uv.Add(Vector2(2.0f / 3, 2.0f / 3));
-                underline_mesh.uv.Add(Vector2(2.0f / 3, 1.0f / 3));
-                underline_mesh.colors.Add(color);
-                underline_mesh.colors.Add(color);
-                underline_mesh.colors.Add(color);
-                underline_mesh.colors.Add(color);
-                underline_mesh.indices.Add(0);
-                underline_mesh.indices.Add(1);
-                underline_mesh.indices.Add(2);
-                underline_mesh.indices.Add(0);
-                underline_mesh.indices.Add(2);
-                underline_mesh.indices.Add(3);
-
-                line.meshes.Add(underline_mesh);
+                ShapedGlyph underline_glyph;
+                underline_glyph.c = 0;
+                underline_glyph.image = Texture::GetSharedWhiteImage();
+                underline_glyph.vertex_start = shaped->vertices.Size();
+                underline_glyph.vertex_count = 4;
+                underline_glyph.x_max = ux1;
+
+                shaped->vertices.Add(Vector2i(ux0, uy0));
+                shaped->vertices.Add(Vector2i(ux0, uy1));
+                shaped->vertices.Add(Vector2i(ux1, uy1));
+                shaped->vertices.Add(Vector2i(ux1, uy0));
+                shaped->uv.Add(Vector2(1.0f / 3, 1.0f / 3));
+                shaped->uv.Add(Vector2(1.0f / 3, 2.0f / 3));
+                shaped->uv.Add(Vector2(2.0f / 3, 2.0f / 3));
+                shaped->uv.Add(Vector2(2.0f / 3, 1.0f / 3));
+                for (int j = 0; j < 4; ++j)
+                {
+                    shaped->colors.Add(color);
+                    shaped->tints.Add(tint ? 1 : 0);
+                    shaped->sdf.Add(Vector3(0, 0, 0));
+                }
+
+                shaped->glyphs.Add(underline_glyph);
             }
         }
 
-        if (line.meshes.Size() > 0)
+        if (shaped->glyphs.Size() > line.glyph_start)
         {
-            line.width = line_x_max;
-            line.height = pen_y - line_y_min;
-
-            m_lines.Add(line);
+            add_line();
         }
 
-        m_content_size = Vector2i(x_max, -y_min);
-        m_content_size.y = m_lines.Size() * font_size;
-        if (m_lines.Size() > 0)
+        shaped->width = x_max;
+
+        return shaped;
+    }
+
+    void Label::Update()
+    {
+        View::Update();
+
+        if (m_shaped && !m_shaped->complete && m_font && m_font->GetGlyphVersion() != m_glyph_version)
         {
-            m_content_size.y += (m_lines.Size() - 1) * m_line_space;
+            m_lines_dirty = true;
+            this->MarkCanvasDirty();
         }
     }
 
@@ -631,29 +687,51 @@ namespace Viry3D
 
         Vector2i offset_pos = this->ApplyTextAlignment(Vector2i(rect.w, rect.h));
 
-        for (int i = 0; i < m_lines.Size(); ++i)
+        if (!m_shaped)
         {
-            const LabelLine& line = m_lines[i];
-            
-            for (int j = 0; j < line.meshes.Size(); ++j)
+            return;
+        }
+
+        const ShapedText& shaped = *m_shaped;
+        const Color& label_color = this->GetColor();
+        Color label_alpha(1, 1, 1, label_color.a);
+
+        for (int i = 0; i < shaped.lines.Size(); ++i)
+        {
+            const LabelLine& line = shaped.lines[i];
+            int line_offset = -i * m_line_space;
+
+            for (int j = 0; j < line.glyph_count; ++j)
             {
-                const CharMesh& char_mesh = line.meshes[j];
+                const ShapedGlyph& glyph = shaped.glyphs[line.glyph_start + j];
 
                 ViewMesh mesh;
-                mesh.vertices.Resize(char_mesh.vertices.Size());
+                mesh.vertices.Resize(glyph.vertex_count);
+                mesh.indices.Resize(glyph.vertex_count / 4 * 6);
 
-                for (int k = 0; k < mesh.vertices.Size(); ++k)
+                for (int k = 0; k < glyph.vertex_count; ++k)
                 {
-                    int x = rect.x + offset_pos.x + char_mesh.vertices[k].x;
-                    int y = rect.y + offset_pos.y + char_mesh.vertices[k].y;
+                    int index = glyph.vertex_start + k;
+                    int x = rect.x + offset_pos.x + shaped.vertices[index].x;
+                    int y = rect.y + offset_pos.y + line_offset + shaped.vertices[index].y;
 
                     mesh.vertices[k].vertex = vertex_matrix.MultiplyPoint3x4(Vector3((float) x, (float) y, 0));
-                    mesh.vertices[k].uv = char_mesh.uv[k];
-                    mesh.vertices[k].color = char_mesh.colors[k] * this->GetColor();
+                    mesh.vertices[k].uv = shaped.uv[index];
+                    mesh.vertices[k].color = shaped.colors[index] * (shaped.tints[index] ? label_color : label_alpha);
+                    mesh.vertices[k].normal = shaped.sdf[index];
+                }
+
+                for (int k = 0; k < glyph.vertex_count / 4; ++k)
+                {
+                    mesh.indices[k * 6 + 0] = k * 4 + 0;
+                    mesh.indices[k * 6 + 1] = k * 4 + 1;
+                    mesh.indices[k * 6 + 2] = k * 4 + 2;
+                    mesh.indices[k * 6 + 3] = k * 4 + 0;
+                    mesh.indices[k * 6 + 4] = k * 4 + 2;
+                    mesh.indices[k * 6 + 5] = k * 4 + 3;
                 }
 
-                mesh.indices.AddRange(char_mesh.indices);
-                mesh.image = char_mesh.image;
+                mesh.image = glyph.image;
                 mesh.view = this;
                 mesh.base_view = false;
                 mesh.clip_rect = clip;
@@ -30,37 +30,52 @@ namespace Viry3D
         BoldAndItalic
     };
 
-    struct CharMesh
+    class Font;
+
+    // glyph of a shaped text, its quads are the 4 vertices each from vertex_start in the arrays of ShapedText
+    struct ShapedGlyph
     {
         char32_t c;
-        Vector<Vector2i> vertices;
-        Vector<Vector2> uv;
-        Vector<Color> colors;
-        Vector<unsigned short> indices;
         Ref<Image> image;
+        int vertex_start;
+        int vertex_count;
+        // right edge of the glyph without distance field padding
+        int x_max;
     };
 
     struct LabelLine
     {
         int width;
         int height;
-        Vector<CharMesh> meshes;
-
-        void Clear()
-        {
-            width = 0;
-            height = 0;
-            meshes.Clear();
-        }
+        int glyph_start;
+        int glyph_count;
     };
 
-    class Font;
+    // text laid out for one font, size and style, shared by all labels showing it,
+    // line space is applied when filling meshes so it needs no new shape
+    struct ShapedText
+    {
+        WeakRef<Font> font;
+        Vector<ShapedGlyph> glyphs;
+        Vector<LabelLine> lines;
+        Vector<Vector2i> vertices;
+        Vector<Vector2> uv;
+        Vector<Color> colors;
+        // 1 where the label color applies, colors of rich text tags only take the label alpha
+        Vector<byte> tints;
+        // x is 1 for distance field glyphs, y the edge and z the smoothing width in distance units
+        Vector<Vector3> sdf;
+        int width = 0;
+        // false when glyphs still rasterizing on workers were laid out as blanks
+        bool complete = true;
+    };
 
     class Label : public View
     {
     public:
         Label();
         virtual ~Label();
+        virtual void Update();
         virtual void UpdateLayout();
         void SetFont(const Ref<Font>& font);
         void SetFontStyle(FontStyle style);
@@ -73,12 +88,14 @@ namespace Viry3D
         // use ViewAlignment
         void SetTextAlignment(int alignment);
         const Vector<LabelLine>& GetLines();
+        const Vector<ShapedGlyph>& GetGlyphs();
 
     protected:
         virtual void FillSelfMeshes(Vector<ViewMesh>& meshes, const Rect& clip_rect);
 
     private:
         void ProcessText();
+        Ref<ShapedText> ShapeText() const;
         Vector2i ApplyTextAlignment(const Vector2i& target_size);
 
     private:
@@ -90,7 +107,8 @@ namespace Viry3D
         bool m_rich;
         bool m_mono;
         int m_text_alignment;
-        Vector<LabelLine> m_lines;
+        Ref<ShapedText> m_shaped;
+        int m_glyph_version;
         Vector2i m_content_size;
         bool m_lines_dirty;
     };
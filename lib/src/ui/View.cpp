@@ -47,7 +47,10 @@ namespace Viry3D
         m_local_scale(1, 1),
         m_clip_rect(false),
         m_rect(0, 0, 0, 0),
-        m_vertex_matrix(Matrix4x4::Identity())
+        m_vertex_matrix(Matrix4x4::Identity()),
+        m_canvas_dirty(false),
+        m_canvas_dynamic(false),
+        m_canvas_range(-1)
 	{
 	
 	}
@@ -83,12 +86,12 @@ namespace Viry3D
         return nullptr;
     }
 
-    void View::MarkCanvasDirty() const
+    void View::MarkCanvasDirty()
     {
         CanvasRenderer* canvas = this->GetCanvas();
         if (canvas)
         {
-            canvas->MarkCanvasDirty();
+            canvas->MarkViewDirty(this);
         }
     }
 
@@ -99,7 +102,11 @@ namespace Viry3D
 
         m_subviews.Add(view);
 
-        this->MarkCanvasDirty();
+        CanvasRenderer* canvas = this->GetCanvas();
+        if (canvas)
+        {
+            canvas->MarkCanvasDirty();
+        }
     }
 
     void View::RemoveSubview(const Ref<View>& view)
@@ -109,7 +116,11 @@ namespace Viry3D
         
         m_subviews.Remove(view);
 
-        this->MarkCanvasDirty();
+        CanvasRenderer* canvas = this->GetCanvas();
+        if (canvas)
+        {
+            canvas->MarkCanvasDirty();
+        }
     }
 
     void View::ClearSubviews()
@@ -128,11 +128,14 @@ namespace Viry3D
         bool OnTouchDrag(const Vector2i& pos) const;
 
     protected:
-        void MarkCanvasDirty() const;
+        // geometry of this view and its subviews is rebuilt, structure changes rebuild the whole canvas
+        void MarkCanvasDirty();
         virtual void FillSelfMeshes(Vector<ViewMesh>& meshes, const Rect& clip_rect);
         void ComputeVerticesMatrix();
 
 	private:
+        friend class CanvasRenderer;
+
 		CanvasRenderer* m_canvas;
         View* m_parent_view;
 		Vector<Ref<View>> m_subviews;
@@ -152,5 +155,9 @@ namespace Viry3D
         InputAction m_on_touch_up_inside;
         InputAction m_on_touch_up_outside;
         InputAction m_on_touch_drag;
+        // state of the canvas incremental rebuild
+        bool m_canvas_dirty;
+        bool m_canvas_dynamic;
+        int m_canvas_range;
 	};
 }